@@ -406,7 +406,8 @@ TEST_CASE("ws client encrypts outbound payloads when enabled", "[net][ws]")
     };
 
     TEST_ASSERT_EQUAL(ESP_OK, ws_client_start(&cfg, capture_rx, NULL));
-    TEST_ASSERT_NULL(s_last_config.headers);
+    TEST_ASSERT_NOT_NULL(s_last_config.headers);
+    TEST_ASSERT_NOT_NULL(strstr(s_last_config.headers, "X-WS-Cipher: aes-256-gcm\r\n"));
 
     esp_websocket_event_data_t evt = {
         .data_ptr = NULL,
@@ -1,7 +1,11 @@
 #include "ws_security.h"
 
+#include "esp_timer.h"
+#include "mbedtls/md.h"
+#include "totp.h"
 #include "unity.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 TEST_CASE("ws security encrypts and decrypts payloads", "[net][ws]")
@@ -28,16 +32,19 @@ TEST_CASE("ws security encrypts and decrypts payloads", "[net][ws]")
     size_t frame_len = 0;
     TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&tx_ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
     TEST_ASSERT_GREATER_THAN(sizeof(payload), frame_len);
+    uint8_t resent[sizeof(frame)];
+    memcpy(resent, frame, frame_len);
 
     size_t plaintext_len = 0;
-    uint64_t counter_state = 0;
-    TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &counter_state));
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, WS_SECURITY_REPLAY_WINDOW));
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
     TEST_ASSERT_EQUAL(sizeof(payload), plaintext_len);
     TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, frame, sizeof(payload));
 
-    // Replay of the same frame must be rejected.
+    // Replay of the same frame must be rejected (decryption is in place, so resend the saved copy).
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE,
-                      ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &counter_state));
+                      ws_security_decrypt(&rx_ctx, resent, frame_len, &plaintext_len, &replay));
 }
 
 TEST_CASE("ws security rejects tampered ciphertext", "[net][ws]")
@@ -61,9 +68,10 @@ TEST_CASE("ws security rejects tampered ciphertext", "[net][ws]")
 
     frame[frame_len - 1] ^= 0xAA;
     size_t plaintext_len = 0;
-    uint64_t counter = 0;
+    replay_window_t replay;
+    replay_window_init(&replay, WS_SECURITY_REPLAY_WINDOW);
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE,
-                      ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &counter));
+                      ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
 }
 
 TEST_CASE("ws security encrypts burst of frames", "[net][ws]")
@@ -79,6 +87,8 @@ TEST_CASE("ws security encrypts burst of frames", "[net][ws]")
     TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&tx_ctx, &cfg));
     TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&rx_ctx, &cfg));
 
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, WS_SECURITY_REPLAY_WINDOW));
     uint8_t payload[16] = {0};
     for (uint32_t i = 0; i < 256; ++i) {
         for (size_t j = 0; j < sizeof(payload); ++j) {
@@ -88,13 +98,148 @@ TEST_CASE("ws security encrypts burst of frames", "[net][ws]")
         size_t frame_len = 0;
         TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&tx_ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
         size_t plaintext_len = 0;
-        uint64_t counter = 0;
-        TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &counter));
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
         TEST_ASSERT_EQUAL(sizeof(payload), plaintext_len);
         TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, frame, sizeof(payload));
     }
 }
 
+TEST_CASE("ws security accepts reordered frames within the replay window", "[net][ws]")
+{
+    const uint8_t secret[32] = {0x33};
+    ws_security_config_t cfg = {
+        .secret = secret,
+        .secret_len = sizeof(secret),
+        .enable_encryption = true,
+    };
+    ws_security_context_t tx_ctx = {0};
+    ws_security_context_t rx_ctx = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&tx_ctx, &cfg));
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&rx_ctx, &cfg));
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, 64));
+
+    enum { FRAMES = 4, FRAME_CAP = 64 };
+    static uint8_t frames[FRAMES][FRAME_CAP];
+    static uint8_t copies[FRAMES][FRAME_CAP];
+    size_t lens[FRAMES] = {0};
+    for (uint8_t i = 0; i < FRAMES; ++i) {
+        const uint8_t payload[] = {i, (uint8_t)(i + 1U)};
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&tx_ctx, payload, sizeof(payload), frames[i], FRAME_CAP,
+                                                      &lens[i]));
+        memcpy(copies[i], frames[i], lens[i]);
+    }
+
+    // Deliver 3, 1, 4, 2 (counters are 1-based): every frame decrypts once.
+    static const uint8_t order[FRAMES] = {2, 0, 3, 1};
+    for (size_t k = 0; k < FRAMES; ++k) {
+        uint8_t i = order[k];
+        size_t plaintext_len = 0;
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frames[i], lens[i], &plaintext_len, &replay));
+        TEST_ASSERT_EQUAL(2, plaintext_len);
+        TEST_ASSERT_EQUAL_UINT8(i, frames[i][0]);
+    }
+    for (size_t i = 0; i < FRAMES; ++i) {
+        size_t plaintext_len = 0;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE,
+                          ws_security_decrypt(&rx_ctx, copies[i], lens[i], &plaintext_len, &replay));
+    }
+
+    // A forged frame with a fresh counter must not advance the window.
+    uint8_t forged[FRAME_CAP];
+    memcpy(forged, copies[0], lens[0]);
+    const uint64_t far_counter = 1000;
+    memcpy(forged + 2, &far_counter, sizeof(far_counter));
+    size_t plaintext_len = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE,
+                      ws_security_decrypt(&rx_ctx, forged, lens[0], &plaintext_len, &replay));
+    TEST_ASSERT_EQUAL_UINT64(FRAMES, replay.highest);
+
+    ws_security_context_deinit(&tx_ctx);
+    ws_security_context_deinit(&rx_ctx);
+}
+
+#if WS_SECURITY_HAVE_CHACHAPOLY
+TEST_CASE("ws security round-trips chacha20-poly1305 frames", "[net][ws]")
+{
+    const uint8_t secret[32] = {0x5a};
+    ws_security_config_t cfg = {
+        .secret = secret,
+        .secret_len = sizeof(secret),
+        .enable_encryption = true,
+        .cipher_suite = WS_SECURITY_SUITE_CHACHA20_POLY1305,
+    };
+    ws_security_context_t tx_ctx = {0};
+    ws_security_context_t rx_ctx = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&tx_ctx, &cfg));
+    cfg.cipher_suite = WS_SECURITY_SUITE_AES256_GCM;
+    cfg.accepted_suites = WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_AES256_GCM) |
+                          WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_CHACHA20_POLY1305);
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&rx_ctx, &cfg));
+
+    const uint8_t payload[] = {0x10, 0x20, 0x30, 0x40, 0x50};
+    uint8_t frame[128] = {0};
+    size_t frame_len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&tx_ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
+    TEST_ASSERT_EQUAL_UINT8(WS_SECURITY_SUITE_CHACHA20_POLY1305, frame[1]);
+    size_t plaintext_len = 0;
+    replay_window_t replay;
+    replay_window_init(&replay, WS_SECURITY_REPLAY_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
+    TEST_ASSERT_EQUAL(sizeof(payload), plaintext_len);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(payload, frame, sizeof(payload));
+
+    // The receiver's own suite stays usable and the header byte selects the AEAD.
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&rx_ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
+    TEST_ASSERT_EQUAL_UINT8(WS_SECURITY_SUITE_AES256_GCM, frame[1]);
+    replay_window_reset(&replay);
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
+
+    // Flipping the suite byte is caught by the AAD.
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&tx_ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
+    frame[1] = WS_SECURITY_SUITE_AES256_GCM;
+    replay_window_reset(&replay);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE,
+                      ws_security_decrypt(&rx_ctx, frame, frame_len, &plaintext_len, &replay));
+
+    ws_security_context_deinit(&tx_ctx);
+    ws_security_context_deinit(&rx_ctx);
+}
+#endif
+
+TEST_CASE("ws security rejects suites outside the accepted set", "[net][ws]")
+{
+    const uint8_t secret[32] = {0x11};
+    ws_security_config_t cfg = {
+        .secret = secret,
+        .secret_len = sizeof(secret),
+        .enable_encryption = true,
+    };
+    ws_security_context_t ctx = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&ctx, &cfg));
+    TEST_ASSERT_TRUE(ws_security_suite_accepted(&ctx, WS_SECURITY_SUITE_AES256_GCM));
+    TEST_ASSERT_FALSE(ws_security_suite_accepted(&ctx, WS_SECURITY_SUITE_CHACHA20_POLY1305));
+
+    const uint8_t payload[] = {0x01};
+    uint8_t frame[64] = {0};
+    size_t frame_len = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, ws_security_encrypt_suite(&ctx, WS_SECURITY_SUITE_CHACHA20_POLY1305,
+                                                                       payload, sizeof(payload), frame, sizeof(frame),
+                                                                       &frame_len));
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&ctx, payload, sizeof(payload), frame, sizeof(frame), &frame_len));
+    frame[1] = 0x7F;
+    size_t plaintext_len = 0;
+    replay_window_t replay;
+    replay_window_init(&replay, WS_SECURITY_REPLAY_WINDOW);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, ws_security_decrypt(&ctx, frame, frame_len, &plaintext_len, &replay));
+
+    ws_security_suite_t suite = WS_SECURITY_SUITE_AES256_GCM;
+    TEST_ASSERT_TRUE(ws_security_suite_from_name("ChaCha20-Poly1305", &suite));
+    TEST_ASSERT_EQUAL(WS_SECURITY_SUITE_CHACHA20_POLY1305, suite);
+    TEST_ASSERT_FALSE(ws_security_suite_from_name("aes-128-cbc", &suite));
+    ws_security_context_deinit(&ctx);
+}
+
 TEST_CASE("ws security validates handshake signatures", "[net][ws]")
 {
     const uint8_t secret[] = {
@@ -159,3 +304,166 @@ TEST_CASE("ws security computes and verifies totp codes", "[net][ws]")
     TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 59, 11111111, &match));
     TEST_ASSERT_FALSE(match);
 }
+
+TEST_CASE("ws security caches totp codes per time step", "[net][ws]")
+{
+    static const uint8_t secret[] = "12345678901234567890";
+    ws_security_config_t cfg = {
+        .enable_totp = true,
+        .totp_secret = secret,
+        .totp_secret_len = sizeof(secret) - 1U,
+        .totp_period_s = 30,
+        .totp_digits = 8,
+        .totp_window = WS_SECURITY_TOTP_MAX_WINDOW + 1U,
+    };
+    ws_security_context_t ctx = {0};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, ws_security_context_init(&ctx, &cfg));
+    cfg.totp_window = 1;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&ctx, &cfg));
+
+    uint32_t previous = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_compute_totp(&ctx, 1111111109ULL - 30U, &previous));
+    bool match = false;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 1111111109ULL, 7081804, &match));
+    TEST_ASSERT_TRUE(match);
+    uint32_t misses = ctx.totp_cache_misses;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3, misses);
+
+    for (int i = 0; i < 10; ++i) {
+        match = false;
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 1111111109ULL, previous, &match));
+        TEST_ASSERT_TRUE(match);
+    }
+    match = true;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 1111111109ULL, 11111111, &match));
+    TEST_ASSERT_FALSE(match);
+    TEST_ASSERT_EQUAL_UINT32(3, ctx.totp_cache_misses);
+
+    // Moving to the next period only costs the newly exposed step.
+    match = false;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 1111111109ULL + 30U, 7081804, &match));
+    TEST_ASSERT_TRUE(match);
+    TEST_ASSERT_EQUAL_UINT32(3, ctx.totp_cache_misses);
+    match = true;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_verify_totp(&ctx, 1111111109ULL + 30U, 11111111, &match));
+    TEST_ASSERT_EQUAL_UINT32(4, ctx.totp_cache_misses);
+}
+
+TEST_CASE("ws security handshake benchmark", "[net][ws][perf]")
+{
+    static const uint8_t secret[32] = {0x42};
+    static const uint8_t totp_secret[] = "12345678901234567890";
+    ws_security_config_t cfg = {
+        .secret = secret,
+        .secret_len = sizeof(secret),
+        .enable_handshake = true,
+        .enable_totp = true,
+        .totp_secret = totp_secret,
+        .totp_secret_len = sizeof(totp_secret) - 1U,
+        .totp_period_s = 30,
+        .totp_digits = 8,
+        .totp_window = 1,
+    };
+    static ws_security_context_t ctx;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&ctx, &cfg));
+    totp_config_t totp_cfg = {
+        .secret = totp_secret,
+        .secret_len = sizeof(totp_secret) - 1U,
+        .period_s = 30,
+        .digits = 8,
+    };
+    const mbedtls_md_info_t *sha256 = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    const char token[] = "Bearer ExampleToken";
+    const uint64_t now = 1700000000ULL;
+    const int handshakes = 1000;
+    uint32_t code = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, ws_security_compute_totp(&ctx, now, &code));
+
+    // Baseline: what every handshake cost before the pad states and codes were cached.
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < handshakes; ++i) {
+        uint8_t nonce[WS_SECURITY_NONCE_LEN] = {0};
+        memcpy(nonce, &i, sizeof(i));
+        uint8_t message[WS_SECURITY_NONCE_LEN + sizeof(token)];
+        memcpy(message, nonce, sizeof(nonce));
+        memcpy(message + sizeof(nonce), token, sizeof(token) - 1U);
+        uint8_t mac[32];
+        TEST_ASSERT_EQUAL(0, mbedtls_md_hmac(sha256, ctx.handshake_key, sizeof(ctx.handshake_key), message,
+                                             sizeof(nonce) + sizeof(token) - 1U, mac));
+        bool match = false;
+        for (int64_t offset = -1; offset <= 1 && !match; ++offset) {
+            uint32_t expected = 0;
+            TEST_ASSERT_EQUAL(ESP_OK, totp_compute(&totp_cfg, (uint64_t)((int64_t)now + offset * 30), &expected));
+            match = expected == code;
+        }
+        TEST_ASSERT_TRUE(match);
+    }
+    int64_t baseline_us = esp_timer_get_time() - start;
+
+    int64_t cached_us = 0;
+    for (int i = 0; i < handshakes; ++i) {
+        uint8_t nonce[WS_SECURITY_NONCE_LEN] = {0};
+        memcpy(nonce, &i, sizeof(i));
+        uint8_t signature[32];
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_compute_handshake_signature(&ctx, nonce, sizeof(nonce), token,
+                                                                          signature, sizeof(signature)));
+        start = esp_timer_get_time();
+        esp_err_t sig_err = ws_security_verify_handshake(&ctx, nonce, sizeof(nonce), token, signature, sizeof(signature));
+        bool match = false;
+        esp_err_t totp_err = ws_security_verify_totp(&ctx, now, code, &match);
+        cached_us += esp_timer_get_time() - start;
+        TEST_ASSERT_EQUAL(ESP_OK, sig_err);
+        TEST_ASSERT_EQUAL(ESP_OK, totp_err);
+        TEST_ASSERT_TRUE(match);
+    }
+
+    printf("%d handshakes verified: from scratch %lld us, precomputed %lld us\n", handshakes, (long long)baseline_us,
+           (long long)cached_us);
+    TEST_ASSERT_LESS_THAN(baseline_us, cached_us);
+}
+
+TEST_CASE("ws security AEAD benchmark across frame sizes", "[net][ws][perf]")
+{
+    static const uint8_t secret[32] = {0x24};
+    static const size_t sizes[] = {16, 64, 256, 1024, 2048};
+    static uint8_t plaintext[2048];
+    static uint8_t frame[2048 + WS_SECURITY_HEADER_LEN + WS_SECURITY_TAG_LEN];
+    static ws_security_context_t ctx;
+    const int iterations = 2000;
+    for (size_t i = 0; i < sizeof(plaintext); ++i) {
+        plaintext[i] = (uint8_t)(i * 7U);
+    }
+
+    for (unsigned suite = 0; suite < WS_SECURITY_SUITE_COUNT; ++suite) {
+        if (suite == WS_SECURITY_SUITE_CHACHA20_POLY1305 && !WS_SECURITY_HAVE_CHACHAPOLY) {
+            printf("%-18s not compiled in (MBEDTLS_CHACHAPOLY_C)\n", ws_security_suite_name(suite));
+            continue;
+        }
+        ws_security_config_t cfg = {
+            .secret = secret,
+            .secret_len = sizeof(secret),
+            .enable_encryption = true,
+            .cipher_suite = (ws_security_suite_t)suite,
+        };
+        TEST_ASSERT_EQUAL(ESP_OK, ws_security_context_init(&ctx, &cfg));
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+            size_t frame_len = 0;
+            int64_t seal_us = 0;
+            int64_t open_us = 0;
+            for (int i = 0; i < iterations; ++i) {
+                int64_t start = esp_timer_get_time();
+                TEST_ASSERT_EQUAL(ESP_OK, ws_security_encrypt(&ctx, plaintext, sizes[s], frame, sizeof(frame),
+                                                              &frame_len));
+                int64_t mid = esp_timer_get_time();
+                size_t plaintext_len = 0;
+                TEST_ASSERT_EQUAL(ESP_OK, ws_security_decrypt(&ctx, frame, frame_len, &plaintext_len, NULL));
+                open_us += esp_timer_get_time() - mid;
+                seal_us += mid - start;
+                TEST_ASSERT_EQUAL(sizes[s], plaintext_len);
+            }
+            printf("%-18s %5u B: seal %6.2f us/frame, open %6.2f us/frame\n", ws_security_suite_name(suite),
+                   (unsigned)sizes[s], (double)seal_us / iterations, (double)open_us / iterations);
+        }
+        ws_security_context_deinit(&ctx);
+    }
+}
@@ -41,6 +41,10 @@ static int s_register_uri_calls;
 static int s_register_hook_calls;
 static TickType_t s_fake_tick_count;
 static uint64_t s_fake_time_unix;
+static uint8_t s_rx_payload[16];
+static size_t s_rx_payload_len;
+static uint32_t s_rx_sessions[4];
+static size_t s_rx_count;
 
 static uint64_t fake_time_unix(void)
 {
@@ -105,11 +109,26 @@ static esp_err_t fake_httpd_ws_send(httpd_handle_t handle, int fd, httpd_ws_fram
 static esp_err_t fake_httpd_ws_recv(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len)
 {
     (void)req;
-    (void)frame;
-    (void)max_len;
+    frame->type = HTTPD_WS_TYPE_TEXT;
+    frame->len = s_rx_payload_len;
+    if (max_len > 0 && frame->payload) {
+        memcpy(frame->payload, s_rx_payload, s_rx_payload_len);
+    }
     return ESP_OK;
 }
 
+static void record_rx(const uint8_t *data, size_t len, uint32_t crc32, uint32_t session_id, void *ctx)
+{
+    (void)data;
+    (void)len;
+    (void)crc32;
+    (void)ctx;
+    if (s_rx_count < sizeof(s_rx_sessions) / sizeof(s_rx_sessions[0])) {
+        s_rx_sessions[s_rx_count] = session_id;
+    }
+    ++s_rx_count;
+}
+
 static int fake_httpd_req_to_sockfd(httpd_req_t *req)
 {
     (void)req;
@@ -277,6 +296,9 @@ static void reset_state(void)
     s_fake_tick_count = 0;
     s_last_payload_len = 0;
     s_fake_time_unix = 0;
+    s_rx_payload_len = 0;
+    s_rx_count = 0;
+    memset(s_rx_sessions, 0, sizeof(s_rx_sessions));
 }
 
 void setUp(void)
@@ -364,6 +386,35 @@ TEST_CASE("ws server drops clients when send fails", "[net][ws]")
     TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)ws_server_active_client_count());
 }
 
+TEST_CASE("ws server gives a reconnect on the same socket a new session", "[net][ws]")
+{
+    uint8_t cert[] = {0x30};
+    uint8_t key[] = {0x31};
+    ws_server_config_t cfg = {
+        .port = 9443,
+        .server_cert = cert,
+        .server_cert_len = sizeof(cert),
+        .server_key = key,
+        .server_key_len = sizeof(key),
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, ws_server_start(&cfg, record_rx, NULL));
+    httpd_req_t req = {0};
+    s_rx_payload[0] = '{';
+    s_rx_payload_len = 1;
+
+    /* fake_httpd_req_to_sockfd() reports socket 7 for every request. */
+    TEST_ASSERT_EQUAL(ESP_OK, ws_server_add_client_for_test(7));
+    TEST_ASSERT_EQUAL(ESP_OK, s_registered_ws_uri.handler(&req));
+    TEST_ASSERT_EQUAL(ESP_OK, s_registered_ws_uri.handler(&req));
+    ws_server_clear_clients_for_test();
+    TEST_ASSERT_EQUAL(ESP_OK, ws_server_add_client_for_test(7));
+    TEST_ASSERT_EQUAL(ESP_OK, s_registered_ws_uri.handler(&req));
+
+    TEST_ASSERT_EQUAL_UINT32(3, (uint32_t)s_rx_count);
+    TEST_ASSERT_EQUAL_UINT32(s_rx_sessions[0], s_rx_sessions[1]);
+    TEST_ASSERT_NOT_EQUAL(s_rx_sessions[1], s_rx_sessions[2]);
+}
+
 TEST_CASE("ws server validates totp configuration", "[net][ws]")
 {
     uint8_t cert[] = {0x01};
@@ -26,10 +26,11 @@ static uint32_t s_reconnect_min_ms;
 static uint32_t s_reconnect_max_ms;
 static char *s_header_block;
 static ws_security_context_t s_security_ctx;
-static uint64_t s_rx_counter;
+static replay_window_t s_rx_replay;
 static const char *s_token_ref;
 static size_t s_header_len;
 static bool s_handshake_enabled;
+static bool s_encryption_enabled;
 static bool s_totp_enabled;
 static uint8_t s_totp_digits;
 static uint64_t (*s_time_fn)(void);
@@ -107,6 +108,15 @@ static esp_err_t regenerate_headers(void)
         }
         offset += (size_t)written;
     }
+    if (s_encryption_enabled) {
+        int written = snprintf(s_header_block + offset, s_header_len - offset + 1U,
+                               WS_SECURITY_CIPHER_HEADER ": %s\r\n",
+                               ws_security_suite_name(ws_security_tx_suite(&s_security_ctx)));
+        if (written < 0 || (size_t)written > s_header_len - offset) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        offset += (size_t)written;
+    }
     if (s_totp_enabled) {
         uint32_t code = 0;
         esp_err_t totp_err = ws_security_compute_totp(&s_security_ctx, get_current_unix_time(), &code);
@@ -318,7 +328,7 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
         s_reconnect_delay_ms = s_reconnect_min_ms;
         ESP_LOGI(TAG, "Connected to %s", s_platform->client_get_uri(s_client));
         ws_security_reset_counters(&s_security_ctx);
-        s_rx_counter = 0;
+        replay_window_reset(&s_rx_replay);
         break;
     case WEBSOCKET_EVENT_DISCONNECTED:
         s_connected = false;
@@ -343,7 +353,8 @@ static void websocket_event_handler(void *handler_args, esp_event_base_t base, i
             size_t len = data->payload_len;
             if (ws_security_is_encryption_enabled(&s_security_ctx) && data->op_code == WS_TRANSPORT_OPCODES_BINARY) {
                 size_t plaintext_len = 0;
-                esp_err_t dec_err = ws_security_decrypt(&s_security_ctx, payload, len, &plaintext_len, &s_rx_counter);
+                esp_err_t dec_err =
+                    ws_security_decrypt(&s_security_ctx, payload, len, &plaintext_len, &s_rx_replay);
                 if (dec_err != ESP_OK) {
                     ESP_LOGW(TAG, "Failed to decrypt frame: %s", esp_err_to_name(dec_err));
                     break;
@@ -414,11 +425,12 @@ static void cleanup_client(void)
     s_error_cb = NULL;
     s_error_ctx = NULL;
     s_connected = false;
-    s_rx_counter = 0;
-    memset(&s_security_ctx, 0, sizeof(s_security_ctx));
+    replay_window_reset(&s_rx_replay);
+    ws_security_context_deinit(&s_security_ctx);
     s_token_ref = NULL;
     s_header_len = 0;
     s_handshake_enabled = false;
+    s_encryption_enabled = false;
     s_totp_enabled = false;
     s_totp_digits = 0;
     s_time_fn = NULL;
@@ -445,6 +457,7 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
         .secret = config->crypto_secret,
         .secret_len = config->crypto_secret_len,
         .enable_encryption = config->enable_frame_encryption,
+        .cipher_suite = config->cipher_suite,
         .enable_handshake = config->enable_handshake_token,
         .enable_totp = config->enable_totp,
         .totp_secret = config->totp_secret,
@@ -458,7 +471,7 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
         return sec_err;
     }
     ws_security_reset_counters(&s_security_ctx);
-    s_rx_counter = 0;
+    replay_window_init(&s_rx_replay, WS_SECURITY_REPLAY_WINDOW);
 
     esp_websocket_client_config_t ws_cfg = {
         .uri = config->uri,
@@ -477,6 +490,7 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
     const char *token = config->auth_token ? config->auth_token : "";
     const bool have_token = token[0] != '\0';
     s_handshake_enabled = ws_security_is_handshake_enabled(&s_security_ctx);
+    s_encryption_enabled = ws_security_is_encryption_enabled(&s_security_ctx);
     s_totp_enabled = ws_security_is_totp_enabled(&s_security_ctx);
     s_totp_digits = ws_security_totp_digits(&s_security_ctx);
     s_time_fn = config->get_time_unix;
@@ -488,6 +502,10 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
         header_len += strlen("X-WS-Nonce: ") + (WS_SECURITY_NONCE_LEN * 2U) + 2U;
         header_len += strlen("X-WS-Signature: ") + 44U + 2U;
     }
+    if (s_encryption_enabled) {
+        header_len += strlen(WS_SECURITY_CIPHER_HEADER ": ") +
+                      strlen(ws_security_suite_name(ws_security_tx_suite(&s_security_ctx))) + 2U;
+    }
     if (s_totp_enabled && s_totp_digits > 0) {
         header_len += strlen("X-WS-TOTP: ") + s_totp_digits + 2U;
     }
@@ -499,6 +517,7 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
             free(s_header_block);
             s_header_block = NULL;
             s_header_len = 0;
+            ws_security_context_deinit(&s_security_ctx);
             return hdr_err;
         }
         ws_cfg.headers = s_header_block;
@@ -508,6 +527,7 @@ esp_err_t ws_client_start(const ws_client_config_t *config, ws_client_rx_cb_t cb
     if (!s_client) {
         free(s_header_block);
         s_header_block = NULL;
+        ws_security_context_deinit(&s_security_ctx);
         return ESP_ERR_NO_MEM;
     }
 
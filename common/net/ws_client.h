@@ -5,6 +5,7 @@
 #include "esp_websocket_client.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/timers.h"
+#include "ws_security.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -26,6 +27,7 @@ typedef struct {
     const uint8_t *crypto_secret;
     size_t crypto_secret_len;
     bool enable_frame_encryption;
+    ws_security_suite_t cipher_suite;
     bool enable_handshake_token;
     bool enable_totp;
     const uint8_t *totp_secret;
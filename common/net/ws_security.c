@@ -3,11 +3,13 @@
 #include "esp_log.h"
 #include "esp_system.h"
 #include "totp.h"
+#include "mbedtls/chachapoly.h"
 #include "mbedtls/gcm.h"
 #include "mbedtls/md.h"
 #include "mbedtls/platform_util.h"
 #include <inttypes.h>
 #include <string.h>
+#include <strings.h>
 
 #define TAG "ws_security"
 
@@ -46,15 +48,62 @@ static esp_err_t derive_key(const uint8_t *secret, size_t secret_len, const char
     return ESP_OK;
 }
 
-esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security_config_t *config)
+static void free_ciphers(ws_security_context_t *ctx)
 {
-    if (!ctx) {
-        return ESP_ERR_INVALID_ARG;
+    mbedtls_gcm_free(&ctx->gcm_tx);
+    mbedtls_gcm_free(&ctx->gcm_rx);
+#if WS_SECURITY_HAVE_CHACHAPOLY
+    mbedtls_chachapoly_free(&ctx->chachapoly_tx);
+    mbedtls_chachapoly_free(&ctx->chachapoly_rx);
+#endif
+}
+
+/**
+ * @brief Key the per-direction AEAD contexts once so frames skip the key schedule.
+ *
+ * AES-GCM keeps the historical "ws-frame" key; ChaCha20-Poly1305 gets its own
+ * derived key so the two suites never share key material.
+ */
+static esp_err_t setup_ciphers(ws_security_context_t *ctx, const uint8_t *secret, size_t secret_len)
+{
+    mbedtls_gcm_init(&ctx->gcm_tx);
+    mbedtls_gcm_init(&ctx->gcm_rx);
+    const unsigned int key_bits = (unsigned int)sizeof(ctx->frame_key) * 8U;
+    int rc = mbedtls_gcm_setkey(&ctx->gcm_tx, MBEDTLS_CIPHER_ID_AES, ctx->frame_key, key_bits);
+    if (rc == 0) {
+        rc = mbedtls_gcm_setkey(&ctx->gcm_rx, MBEDTLS_CIPHER_ID_AES, ctx->frame_key, key_bits);
+    }
+#if WS_SECURITY_HAVE_CHACHAPOLY
+    mbedtls_chachapoly_init(&ctx->chachapoly_tx);
+    mbedtls_chachapoly_init(&ctx->chachapoly_rx);
+    if (rc == 0 && (ctx->accepted_suites & WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_CHACHA20_POLY1305))) {
+        uint8_t chacha_key[32];
+        esp_err_t err = derive_key(secret, secret_len, "ws-frame-chacha", chacha_key, sizeof(chacha_key));
+        if (err != ESP_OK) {
+            rc = -1;
+        }
+        if (rc == 0) {
+            rc = mbedtls_chachapoly_setkey(&ctx->chachapoly_tx, chacha_key);
+        }
+        if (rc == 0) {
+            rc = mbedtls_chachapoly_setkey(&ctx->chachapoly_rx, chacha_key);
+        }
+        mbedtls_platform_zeroize(chacha_key, sizeof(chacha_key));
     }
-    memset(ctx, 0, sizeof(*ctx));
-    if (!config) {
-        return ESP_OK;
+#else
+    (void)secret;
+    (void)secret_len;
+#endif
+    if (rc != 0) {
+        ESP_LOGE(TAG, "AEAD key setup failed (%d)", rc);
+        free_ciphers(ctx);
+        return ESP_FAIL;
     }
+    return ESP_OK;
+}
+
+static esp_err_t init_features(ws_security_context_t *ctx, const ws_security_config_t *config)
+{
     if ((!config->secret || config->secret_len == 0) && (config->enable_encryption || config->enable_handshake)) {
         ESP_LOGE(TAG, "Security secret missing while features are enabled");
         return ESP_ERR_INVALID_ARG;
@@ -62,17 +111,38 @@ esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security
     if (config->enable_handshake) {
         esp_err_t err = derive_key(config->secret, config->secret_len, "ws-handshake", ctx->handshake_key,
                                    sizeof(ctx->handshake_key));
+        if (err == ESP_OK) {
+            err = hmac_sha256_key_init(&ctx->handshake_mac, ctx->handshake_key, sizeof(ctx->handshake_key));
+        }
         if (err != ESP_OK) {
             return err;
         }
         ctx->handshake_enabled = true;
     }
     if (config->enable_encryption) {
+        if ((unsigned)config->cipher_suite >= WS_SECURITY_SUITE_COUNT ||
+            (config->accepted_suites & ~((1U << WS_SECURITY_SUITE_COUNT) - 1U)) != 0U) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        /* An empty mask keeps the pre-negotiation behaviour: AES-GCM only. */
+        uint8_t accepted = config->accepted_suites ? config->accepted_suites
+                                                   : WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_AES256_GCM);
+        accepted |= WS_SECURITY_SUITE_BIT(config->cipher_suite);
+        if (!WS_SECURITY_HAVE_CHACHAPOLY && (accepted & WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_CHACHA20_POLY1305))) {
+            ESP_LOGE(TAG, "ChaCha20-Poly1305 requested but MBEDTLS_CHACHAPOLY_C is disabled");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
         esp_err_t err = derive_key(config->secret, config->secret_len, "ws-frame", ctx->frame_key,
                                    sizeof(ctx->frame_key));
         if (err != ESP_OK) {
             return err;
         }
+        ctx->tx_suite = config->cipher_suite;
+        ctx->accepted_suites = accepted;
+        err = setup_ciphers(ctx, config->secret, config->secret_len);
+        if (err != ESP_OK) {
+            return err;
+        }
         ctx->encryption_enabled = true;
         ctx->tx_counter = 0;
     }
@@ -80,9 +150,14 @@ esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security
         if (!config->totp_secret || config->totp_secret_len == 0 || config->totp_secret_len > sizeof(ctx->totp_secret)) {
             return ESP_ERR_INVALID_ARG;
         }
-        if (config->totp_digits < 6 || config->totp_digits > 8 || config->totp_period_s == 0) {
+        if (config->totp_digits < 6 || config->totp_digits > 8 || config->totp_period_s == 0 ||
+            config->totp_window > WS_SECURITY_TOTP_MAX_WINDOW) {
             return ESP_ERR_INVALID_ARG;
         }
+        esp_err_t err = hmac_sha1_key_init(&ctx->totp_mac, config->totp_secret, config->totp_secret_len);
+        if (err != ESP_OK) {
+            return err;
+        }
         memcpy(ctx->totp_secret, config->totp_secret, config->totp_secret_len);
         ctx->totp_secret_len = config->totp_secret_len;
         ctx->totp_digits = config->totp_digits;
@@ -93,6 +168,49 @@ esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security
     return ESP_OK;
 }
 
+/**
+ * @brief Derive keys and cipher state for @p config.
+ *
+ * The context must be zeroed or deinitialised; on failure it is left deinitialised.
+ */
+esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security_config_t *config)
+{
+    if (!ctx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    if (!config) {
+        return ESP_OK;
+    }
+    esp_err_t err = init_features(ctx, config);
+    if (err != ESP_OK) {
+        ws_security_context_deinit(ctx);
+    }
+    return err;
+}
+
+/**
+ * @brief Release cipher and hash state and wipe key material.
+ *
+ * Safe on a zeroed context; the context may be re-initialised afterwards.
+ */
+void ws_security_context_deinit(ws_security_context_t *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    if (ctx->encryption_enabled) {
+        free_ciphers(ctx);
+    }
+    if (ctx->handshake_enabled) {
+        hmac_sha256_key_free(&ctx->handshake_mac);
+    }
+    if (ctx->totp_enabled) {
+        hmac_sha1_key_free(&ctx->totp_mac);
+    }
+    mbedtls_platform_zeroize(ctx, sizeof(*ctx));
+}
+
 size_t ws_security_encrypted_size(const ws_security_context_t *ctx, size_t plaintext_len)
 {
     if (!ctx || !ctx->encryption_enabled) {
@@ -106,8 +224,56 @@ static void generate_iv(uint8_t *iv, size_t len)
     esp_fill_random(iv, len);
 }
 
+static int aead_seal(ws_security_context_t *ctx, ws_security_suite_t suite, const uint8_t *iv, const uint8_t *aad,
+                     const uint8_t *plaintext, size_t len, uint8_t *ciphertext, uint8_t *tag)
+{
+    switch (suite) {
+    case WS_SECURITY_SUITE_AES256_GCM:
+        return mbedtls_gcm_crypt_and_tag(&ctx->gcm_tx, MBEDTLS_GCM_ENCRYPT, len, iv, WS_SECURITY_IV_LEN, aad,
+                                         WS_SECURITY_FIXED_HEADER_LEN, plaintext, ciphertext, WS_SECURITY_TAG_LEN,
+                                         tag);
+#if WS_SECURITY_HAVE_CHACHAPOLY
+    case WS_SECURITY_SUITE_CHACHA20_POLY1305:
+        return mbedtls_chachapoly_encrypt_and_tag(&ctx->chachapoly_tx, len, iv, aad, WS_SECURITY_FIXED_HEADER_LEN,
+                                                  plaintext, ciphertext, tag);
+#endif
+    default:
+        return -1;
+    }
+}
+
+static int aead_open(ws_security_context_t *ctx, ws_security_suite_t suite, const uint8_t *iv, const uint8_t *aad,
+                     const uint8_t *tag, uint8_t *ciphertext, size_t len)
+{
+    switch (suite) {
+    case WS_SECURITY_SUITE_AES256_GCM:
+        return mbedtls_gcm_auth_decrypt(&ctx->gcm_rx, len, iv, WS_SECURITY_IV_LEN, aad, WS_SECURITY_FIXED_HEADER_LEN,
+                                        tag, WS_SECURITY_TAG_LEN, ciphertext, ciphertext);
+#if WS_SECURITY_HAVE_CHACHAPOLY
+    case WS_SECURITY_SUITE_CHACHA20_POLY1305:
+        return mbedtls_chachapoly_auth_decrypt(&ctx->chachapoly_rx, len, iv, aad, WS_SECURITY_FIXED_HEADER_LEN, tag,
+                                               ciphertext, ciphertext);
+#endif
+    default:
+        return -1;
+    }
+}
+
 esp_err_t ws_security_encrypt(ws_security_context_t *ctx, const uint8_t *plaintext, size_t plaintext_len,
                               uint8_t *out, size_t out_size, size_t *out_len)
+{
+    return ws_security_encrypt_suite(ctx, ctx ? ctx->tx_suite : WS_SECURITY_SUITE_AES256_GCM, plaintext,
+                                     plaintext_len, out, out_size, out_len);
+}
+
+/**
+ * @brief Encrypt one frame with an explicit AEAD, e.g. the suite negotiated by a given peer.
+ *
+ * @p suite must be one of the suites accepted by @p ctx. Not thread-safe; callers
+ * serialise senders sharing a context.
+ */
+esp_err_t ws_security_encrypt_suite(ws_security_context_t *ctx, ws_security_suite_t suite, const uint8_t *plaintext,
+                                    size_t plaintext_len, uint8_t *out, size_t out_size, size_t *out_len)
 {
     if (!ctx || !plaintext || !out) {
         return ESP_ERR_INVALID_ARG;
@@ -122,13 +288,16 @@ esp_err_t ws_security_encrypt(ws_security_context_t *ctx, const uint8_t *plainte
         }
         return ESP_OK;
     }
+    if (!ws_security_suite_accepted(ctx, suite)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
     size_t required = ws_security_encrypted_size(ctx, plaintext_len);
     if (out_size < required) {
         return ESP_ERR_NO_MEM;
     }
     uint8_t *cursor = out;
     cursor[0] = WS_SECURITY_VERSION;
-    cursor[1] = 0U;
+    cursor[1] = (uint8_t)suite;
     uint64_t counter = ++ctx->tx_counter;
     memcpy(cursor + 2, &counter, sizeof(counter));
     uint8_t *iv = cursor + WS_SECURITY_FIXED_HEADER_LEN;
@@ -136,16 +305,9 @@ esp_err_t ws_security_encrypt(ws_security_context_t *ctx, const uint8_t *plainte
     uint8_t *ciphertext = iv + WS_SECURITY_IV_LEN;
     uint8_t *tag = ciphertext + plaintext_len;
 
-    mbedtls_gcm_context gcm;
-    mbedtls_gcm_init(&gcm);
-    int rc = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, ctx->frame_key, (unsigned int)sizeof(ctx->frame_key) * 8U);
-    if (rc == 0) {
-        rc = mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, plaintext_len, iv, WS_SECURITY_IV_LEN, cursor,
-                                       WS_SECURITY_FIXED_HEADER_LEN, plaintext, ciphertext, WS_SECURITY_TAG_LEN, tag);
-    }
-    mbedtls_gcm_free(&gcm);
+    int rc = aead_seal(ctx, suite, iv, cursor, plaintext, plaintext_len, ciphertext, tag);
     if (rc != 0) {
-        ESP_LOGE(TAG, "AES-GCM encrypt failed (%d)", rc);
+        ESP_LOGE(TAG, "%s encrypt failed (%d)", ws_security_suite_name(suite), rc);
         return ESP_FAIL;
     }
     if (out_len) {
@@ -154,8 +316,15 @@ esp_err_t ws_security_encrypt(ws_security_context_t *ctx, const uint8_t *plainte
     return ESP_OK;
 }
 
-esp_err_t ws_security_decrypt(const ws_security_context_t *ctx, uint8_t *buffer, size_t buffer_len,
-                              size_t *plaintext_len, uint64_t *counter_state)
+/**
+ * @brief Authenticate and decrypt one frame in place.
+ *
+ * @param replay Per-peer anti-replay window, or NULL to skip replay protection. The
+ *               counter is checked before authentication and only recorded after it,
+ *               so frames may arrive reordered within the window but never twice.
+ */
+esp_err_t ws_security_decrypt(ws_security_context_t *ctx, uint8_t *buffer, size_t buffer_len,
+                              size_t *plaintext_len, replay_window_t *replay)
 {
     if (!ctx || !buffer) {
         return ESP_ERR_INVALID_ARG;
@@ -172,41 +341,32 @@ esp_err_t ws_security_decrypt(const ws_security_context_t *ctx, uint8_t *buffer,
     if (buffer[0] != WS_SECURITY_VERSION) {
         return ESP_ERR_INVALID_VERSION;
     }
-    uint8_t flags = buffer[1];
-    if (flags != 0U) {
+    ws_security_suite_t suite = (ws_security_suite_t)buffer[1];
+    if (!ws_security_suite_accepted(ctx, suite)) {
         return ESP_ERR_INVALID_STATE;
     }
     uint64_t counter = 0;
     memcpy(&counter, buffer + 2, sizeof(counter));
-    if (counter_state) {
-        if (counter <= *counter_state) {
-            ESP_LOGW(TAG, "Replay detected (counter=%" PRIu64 ")", counter);
-            return ESP_ERR_INVALID_RESPONSE;
-        }
+    if (replay && !replay_window_check(replay, counter)) {
+        ESP_LOGW(TAG, "Replay detected (counter=%" PRIu64 ")", counter);
+        return ESP_ERR_INVALID_RESPONSE;
     }
     uint8_t *iv = buffer + WS_SECURITY_FIXED_HEADER_LEN;
     uint8_t *ciphertext = iv + WS_SECURITY_IV_LEN;
     size_t ciphertext_len = buffer_len - WS_SECURITY_HEADER_LEN - WS_SECURITY_TAG_LEN;
     uint8_t *tag = ciphertext + ciphertext_len;
 
-    mbedtls_gcm_context gcm;
-    mbedtls_gcm_init(&gcm);
-    int rc = mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, ctx->frame_key, (unsigned int)sizeof(ctx->frame_key) * 8U);
-    if (rc == 0) {
-        rc = mbedtls_gcm_auth_decrypt(&gcm, ciphertext_len, iv, WS_SECURITY_IV_LEN, buffer, WS_SECURITY_FIXED_HEADER_LEN,
-                                      ciphertext, ciphertext, WS_SECURITY_TAG_LEN, tag);
-    }
-    mbedtls_gcm_free(&gcm);
+    int rc = aead_open(ctx, suite, iv, buffer, tag, ciphertext, ciphertext_len);
     if (rc != 0) {
-        ESP_LOGW(TAG, "AES-GCM decrypt failed (%d)", rc);
+        ESP_LOGW(TAG, "%s decrypt failed (%d)", ws_security_suite_name(suite), rc);
         return ESP_ERR_INVALID_RESPONSE;
     }
     memmove(buffer, ciphertext, ciphertext_len);
     if (plaintext_len) {
         *plaintext_len = ciphertext_len;
     }
-    if (counter_state) {
-        *counter_state = counter;
+    if (replay) {
+        replay_window_update(replay, counter);
     }
     return ESP_OK;
 }
@@ -220,30 +380,8 @@ static esp_err_t handshake_hmac(const ws_security_context_t *ctx, const uint8_t
     if (!ctx->handshake_enabled) {
         return ESP_ERR_INVALID_STATE;
     }
-    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
-    if (!info) {
-        return ESP_FAIL;
-    }
-    mbedtls_md_context_t md;
-    mbedtls_md_init(&md);
-    int rc = mbedtls_md_setup(&md, info, 1);
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_starts(&md, ctx->handshake_key, sizeof(ctx->handshake_key));
-    }
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_update(&md, nonce, nonce_len);
-    }
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_update(&md, (const unsigned char *)auth_token, strlen(auth_token));
-    }
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_finish(&md, signature);
-    }
-    mbedtls_md_free(&md);
-    if (rc != 0) {
-        return ESP_FAIL;
-    }
-    return ESP_OK;
+    return hmac_sha256_compute(&ctx->handshake_mac, nonce, nonce_len, (const uint8_t *)auth_token,
+                               strlen(auth_token), signature);
 }
 
 esp_err_t ws_security_compute_handshake_signature(const ws_security_context_t *ctx, const uint8_t *nonce,
@@ -275,6 +413,44 @@ bool ws_security_is_encryption_enabled(const ws_security_context_t *ctx)
     return ctx && ctx->encryption_enabled;
 }
 
+ws_security_suite_t ws_security_tx_suite(const ws_security_context_t *ctx)
+{
+    return ctx ? ctx->tx_suite : WS_SECURITY_SUITE_AES256_GCM;
+}
+
+bool ws_security_suite_accepted(const ws_security_context_t *ctx, ws_security_suite_t suite)
+{
+    return ctx && (unsigned)suite < WS_SECURITY_SUITE_COUNT &&
+           (ctx->accepted_suites & WS_SECURITY_SUITE_BIT(suite)) != 0U;
+}
+
+static const char *const s_suite_names[WS_SECURITY_SUITE_COUNT] = {
+    [WS_SECURITY_SUITE_AES256_GCM] = "aes-256-gcm",
+    [WS_SECURITY_SUITE_CHACHA20_POLY1305] = "chacha20-poly1305",
+};
+
+const char *ws_security_suite_name(ws_security_suite_t suite)
+{
+    return (unsigned)suite < WS_SECURITY_SUITE_COUNT ? s_suite_names[suite] : "unknown";
+}
+
+/**
+ * @brief Parse the value of the X-WS-Cipher handshake header (case-insensitive).
+ */
+bool ws_security_suite_from_name(const char *name, ws_security_suite_t *suite)
+{
+    if (!name || !suite) {
+        return false;
+    }
+    for (unsigned i = 0; i < WS_SECURITY_SUITE_COUNT; ++i) {
+        if (strcasecmp(name, s_suite_names[i]) == 0) {
+            *suite = (ws_security_suite_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
 bool ws_security_is_handshake_enabled(const ws_security_context_t *ctx)
 {
     return ctx && ctx->handshake_enabled;
@@ -303,25 +479,55 @@ esp_err_t ws_security_compute_totp(const ws_security_context_t *ctx, uint64_t un
     if (!ctx || !ctx->totp_enabled) {
         return ESP_ERR_INVALID_STATE;
     }
-    totp_config_t cfg = {
-        .secret = ctx->totp_secret,
-        .secret_len = ctx->totp_secret_len,
-        .period_s = ctx->totp_period_s,
-        .digits = ctx->totp_digits,
-    };
-    return totp_compute(&cfg, unix_time, code);
+    return totp_compute_step(&ctx->totp_mac, unix_time / ctx->totp_period_s, ctx->totp_digits, code);
 }
 
-esp_err_t ws_security_verify_totp(const ws_security_context_t *ctx, uint64_t unix_time, uint32_t code, bool *match)
+static esp_err_t cached_totp_code(ws_security_context_t *ctx, uint64_t step, uint32_t *code)
+{
+    ws_security_totp_entry_t *entry = &ctx->totp_cache[step % WS_SECURITY_TOTP_CACHE_SLOTS];
+    if (!entry->valid || entry->step != step) {
+        esp_err_t err = totp_compute_step(&ctx->totp_mac, step, ctx->totp_digits, &entry->code);
+        if (err != ESP_OK) {
+            entry->valid = false;
+            return err;
+        }
+        entry->step = step;
+        entry->valid = true;
+        ++ctx->totp_cache_misses;
+    }
+    *code = entry->code;
+    return ESP_OK;
+}
+
+/**
+ * @brief Check @p code against every time step of the configured window.
+ *
+ * Codes are served from the per-step cache, so only steps not seen since the
+ * previous call cost an HMAC. Not thread-safe; callers serialise verification.
+ */
+esp_err_t ws_security_verify_totp(ws_security_context_t *ctx, uint64_t unix_time, uint32_t code, bool *match)
 {
     if (!ctx || !ctx->totp_enabled) {
         return ESP_ERR_INVALID_STATE;
     }
-    totp_config_t cfg = {
-        .secret = ctx->totp_secret,
-        .secret_len = ctx->totp_secret_len,
-        .period_s = ctx->totp_period_s,
-        .digits = ctx->totp_digits,
-    };
-    return totp_verify(&cfg, unix_time, ctx->totp_window, code, match);
+    if (!match) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *match = false;
+    uint64_t step = unix_time / ctx->totp_period_s;
+    for (int32_t offset = -(int32_t)ctx->totp_window; offset <= (int32_t)ctx->totp_window; ++offset) {
+        if (offset < 0 && (uint64_t)(-offset) > step) {
+            continue;
+        }
+        uint32_t expected = 0;
+        esp_err_t err = cached_totp_code(ctx, step + (uint64_t)(int64_t)offset, &expected);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (expected == code) {
+            *match = true;
+            return ESP_OK;
+        }
+    }
+    return ESP_OK;
 }
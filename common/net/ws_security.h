@@ -1,6 +1,11 @@
 #pragma once
 
 #include "esp_err.h"
+#include "hmac_precomp.h"
+#include "replay_window.h"
+#include "sdkconfig.h"
+#include "mbedtls/chachapoly.h"
+#include "mbedtls/gcm.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -12,11 +17,43 @@
 #define WS_SECURITY_FIXED_HEADER_LEN (1U + 1U + WS_SECURITY_COUNTER_LEN)
 #define WS_SECURITY_HEADER_LEN (WS_SECURITY_FIXED_HEADER_LEN + WS_SECURITY_IV_LEN)
 #define WS_SECURITY_NONCE_LEN 16U
+#define WS_SECURITY_TOTP_MAX_WINDOW 4U
+#define WS_SECURITY_TOTP_CACHE_SLOTS (2U * WS_SECURITY_TOTP_MAX_WINDOW + 1U)
+#define WS_SECURITY_CIPHER_HEADER "X-WS-Cipher"
+
+#ifdef CONFIG_COMMON_WS_REPLAY_WINDOW
+#define WS_SECURITY_REPLAY_WINDOW CONFIG_COMMON_WS_REPLAY_WINDOW
+#else
+#define WS_SECURITY_REPLAY_WINDOW 256U
+#endif
+_Static_assert(WS_SECURITY_REPLAY_WINDOW % 64U == 0 && WS_SECURITY_REPLAY_WINDOW >= REPLAY_WINDOW_MIN_BITS &&
+                   WS_SECURITY_REPLAY_WINDOW <= REPLAY_WINDOW_MAX_BITS,
+               "CONFIG_COMMON_WS_REPLAY_WINDOW must be a multiple of 64 within the replay window limits");
+
+#if defined(MBEDTLS_CHACHAPOLY_C)
+#define WS_SECURITY_HAVE_CHACHAPOLY 1
+#else
+#define WS_SECURITY_HAVE_CHACHAPOLY 0
+#endif
+
+/**
+ * AEAD carried in the second header byte of every encrypted frame (formerly a
+ * reserved zero flags byte, so AES-GCM frames are unchanged on the wire).
+ */
+typedef enum {
+    WS_SECURITY_SUITE_AES256_GCM = 0,
+    WS_SECURITY_SUITE_CHACHA20_POLY1305 = 1,
+    WS_SECURITY_SUITE_COUNT,
+} ws_security_suite_t;
+
+#define WS_SECURITY_SUITE_BIT(suite) (1U << (unsigned)(suite))
 
 typedef struct {
     const uint8_t *secret;
     size_t secret_len;
     bool enable_encryption;
+    ws_security_suite_t cipher_suite;
+    uint8_t accepted_suites;
     bool enable_handshake;
     bool enable_totp;
     const uint8_t *totp_secret;
@@ -26,35 +63,69 @@ typedef struct {
     uint32_t totp_window;
 } ws_security_config_t;
 
+typedef struct {
+    uint64_t step;
+    uint32_t code;
+    bool valid;
+} ws_security_totp_entry_t;
+
+/**
+ * Per-connection-endpoint security state.
+ *
+ * HMAC pad states and the AEAD key schedules are derived once at init; verified
+ * TOTP codes are cached per time step (indexed by step modulo the slot count) so a
+ * reconnect storm within one period costs at most one HMAC per step of the
+ * acceptance window. Encryption and decryption use separate cipher contexts, so
+ * one sender and one receiver may use a context concurrently.
+ */
 typedef struct {
     bool handshake_enabled;
     bool encryption_enabled;
     bool totp_enabled;
     uint8_t handshake_key[32];
+    hmac_sha256_key_t handshake_mac;
     uint8_t frame_key[32];
+    ws_security_suite_t tx_suite;
+    uint8_t accepted_suites;
+    mbedtls_gcm_context gcm_tx;
+    mbedtls_gcm_context gcm_rx;
+#if WS_SECURITY_HAVE_CHACHAPOLY
+    mbedtls_chachapoly_context chachapoly_tx;
+    mbedtls_chachapoly_context chachapoly_rx;
+#endif
     uint64_t tx_counter;
     uint8_t totp_secret[64];
     size_t totp_secret_len;
     uint32_t totp_period_s;
     uint8_t totp_digits;
     uint32_t totp_window;
+    hmac_sha1_key_t totp_mac;
+    ws_security_totp_entry_t totp_cache[WS_SECURITY_TOTP_CACHE_SLOTS];
+    uint32_t totp_cache_misses;
 } ws_security_context_t;
 
 esp_err_t ws_security_context_init(ws_security_context_t *ctx, const ws_security_config_t *config);
+void ws_security_context_deinit(ws_security_context_t *ctx);
 size_t ws_security_encrypted_size(const ws_security_context_t *ctx, size_t plaintext_len);
 esp_err_t ws_security_encrypt(ws_security_context_t *ctx, const uint8_t *plaintext, size_t plaintext_len,
                               uint8_t *out, size_t out_size, size_t *out_len);
-esp_err_t ws_security_decrypt(const ws_security_context_t *ctx, uint8_t *buffer, size_t buffer_len,
-                              size_t *plaintext_len, uint64_t *counter_state);
+esp_err_t ws_security_encrypt_suite(ws_security_context_t *ctx, ws_security_suite_t suite, const uint8_t *plaintext,
+                                    size_t plaintext_len, uint8_t *out, size_t out_size, size_t *out_len);
+esp_err_t ws_security_decrypt(ws_security_context_t *ctx, uint8_t *buffer, size_t buffer_len,
+                              size_t *plaintext_len, replay_window_t *replay);
 esp_err_t ws_security_compute_handshake_signature(const ws_security_context_t *ctx, const uint8_t *nonce,
                                                   size_t nonce_len, const char *auth_token, uint8_t *signature,
                                                   size_t signature_len);
 esp_err_t ws_security_verify_handshake(const ws_security_context_t *ctx, const uint8_t *nonce, size_t nonce_len,
                                        const char *auth_token, const uint8_t *signature, size_t signature_len);
 bool ws_security_is_encryption_enabled(const ws_security_context_t *ctx);
+ws_security_suite_t ws_security_tx_suite(const ws_security_context_t *ctx);
+bool ws_security_suite_accepted(const ws_security_context_t *ctx, ws_security_suite_t suite);
+const char *ws_security_suite_name(ws_security_suite_t suite);
+bool ws_security_suite_from_name(const char *name, ws_security_suite_t *suite);
 bool ws_security_is_handshake_enabled(const ws_security_context_t *ctx);
 void ws_security_reset_counters(ws_security_context_t *ctx);
 bool ws_security_is_totp_enabled(const ws_security_context_t *ctx);
 uint8_t ws_security_totp_digits(const ws_security_context_t *ctx);
 esp_err_t ws_security_compute_totp(const ws_security_context_t *ctx, uint64_t unix_time, uint32_t *code);
-esp_err_t ws_security_verify_totp(const ws_security_context_t *ctx, uint64_t unix_time, uint32_t code, bool *match);
+esp_err_t ws_security_verify_totp(ws_security_context_t *ctx, uint64_t unix_time, uint32_t code, bool *match);
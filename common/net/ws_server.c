@@ -16,10 +16,12 @@
 
 typedef struct {
     int fd;
+    uint32_t session_id;
     TickType_t last_seen;
     bool awaiting_pong;
     bool handshake_verified;
-    uint64_t last_counter;
+    ws_security_suite_t suite;
+    replay_window_t replay;
 } ws_client_t;
 
 static const char *TAG = "ws_server";
@@ -30,6 +32,7 @@ static ws_client_t *s_clients;
 static size_t s_client_capacity;
 static ws_server_rx_cb_t s_rx_cb;
 static void *s_rx_ctx;
+static uint32_t s_next_session_id;
 static SemaphoreHandle_t s_client_lock;
 static StaticSemaphore_t s_client_lock_storage;
 static TimerHandle_t s_ping_timer;
@@ -498,7 +501,7 @@ static void drop_client_locked(int fd)
             s_clients[i].last_seen = 0;
             s_clients[i].awaiting_pong = false;
             s_clients[i].handshake_verified = !ws_security_is_handshake_enabled(&s_security_ctx);
-            s_clients[i].last_counter = 0;
+            replay_window_reset(&s_clients[i].replay);
             break;
         }
     }
@@ -521,9 +524,10 @@ static void drop_client(int fd)
  * @brief Add a client socket to the active table.
  *
  * @param fd Client socket descriptor to register.
+ * @param suite AEAD negotiated during the upgrade request.
  * @return ESP_OK on success or ESP_FAIL when capacity is exhausted.
  */
-static esp_err_t add_client(int fd)
+static esp_err_t add_client(int fd, ws_security_suite_t suite)
 {
     esp_err_t err = ESP_FAIL;
     clients_lock();
@@ -533,10 +537,12 @@ static esp_err_t add_client(int fd)
         for (size_t i = 0; i < s_client_capacity; ++i) {
             if (s_clients[i].fd < 0) {
                 s_clients[i].fd = fd;
+                s_clients[i].session_id = ++s_next_session_id;
                 s_clients[i].last_seen = xTaskGetTickCount();
                 s_clients[i].awaiting_pong = false;
                 s_clients[i].handshake_verified = !ws_security_is_handshake_enabled(&s_security_ctx);
-                s_clients[i].last_counter = 0;
+                s_clients[i].suite = suite;
+                replay_window_reset(&s_clients[i].replay);
                 ESP_LOGI(TAG, "Client registered: %d", fd);
                 err = ESP_OK;
                 break;
@@ -553,18 +559,43 @@ static void mark_client_verified(int fd)
     ws_client_t *client = find_client(fd);
     if (client) {
         client->handshake_verified = true;
-        client->last_counter = 0;
+        replay_window_reset(&client->replay);
     }
     clients_unlock();
 }
 
+/**
+ * @brief Pick the frame AEAD from the optional X-WS-Cipher header.
+ *
+ * Clients that predate suite negotiation send no header and get AES-GCM.
+ *
+ * @return false when the client asks for a suite this server does not accept.
+ */
+static bool negotiate_suite(httpd_req_t *req, ws_security_suite_t *suite)
+{
+    *suite = WS_SECURITY_SUITE_AES256_GCM;
+    if (!ws_security_is_encryption_enabled(&s_security_ctx)) {
+        return true;
+    }
+    char value[32] = {0};
+    if (httpd_req_get_hdr_value_str(req, WS_SECURITY_CIPHER_HEADER, value, sizeof(value)) != ESP_OK) {
+        return true;
+    }
+    if (!ws_security_suite_from_name(value, suite) || !ws_security_suite_accepted(&s_security_ctx, *suite)) {
+        ESP_LOGW(TAG, "Unsupported cipher suite requested: %s", value);
+        return false;
+    }
+    return true;
+}
+
 /**
  * @brief Validate the Authorization header against the configured token.
  *
  * @param req HTTP request context.
+ * @param suite Output receiving the negotiated frame AEAD.
  * @return true when the request is authorized, false otherwise.
  */
-static bool authorize_request(httpd_req_t *req)
+static bool authorize_request(httpd_req_t *req, ws_security_suite_t *suite)
 {
     const char *token = s_cfg.auth_token ? s_cfg.auth_token : "";
     if (token[0] != '\0') {
@@ -653,7 +684,7 @@ static bool authorize_request(httpd_req_t *req)
             return false;
         }
     }
-    return true;
+    return negotiate_suite(req, suite);
 }
 
 /**
@@ -725,14 +756,15 @@ static void ping_timer_cb(TimerHandle_t timer)
 static esp_err_t ws_handler(httpd_req_t *req)
 {
     if (req->method == HTTP_GET) {
-        if (!authorize_request(req)) {
+        ws_security_suite_t suite = WS_SECURITY_SUITE_AES256_GCM;
+        if (!authorize_request(req, &suite)) {
             s_platform->httpd_resp_set_status(req, "401 Unauthorized");
             s_platform->httpd_resp_set_hdr(req, "WWW-Authenticate", "Bearer");
             s_platform->httpd_resp_send(req, "Unauthorized", HTTPD_RESP_USE_STRLEN);
             return ESP_FAIL;
         }
         int fd = s_platform->httpd_req_to_sockfd(req);
-        if (add_client(fd) != ESP_OK) {
+        if (add_client(fd, suite) != ESP_OK) {
             s_platform->httpd_resp_set_status(req, "503 Service Unavailable");
             s_platform->httpd_resp_send(req, "Too many clients", HTTPD_RESP_USE_STRLEN);
             return ESP_FAIL;
@@ -789,9 +821,15 @@ static esp_err_t ws_handler(httpd_req_t *req)
                 ESP_LOGW(TAG, "Encrypted frame from unverified client %d", fd);
                 return ESP_ERR_INVALID_STATE;
             }
+            if (frame.len < 2U || frame.payload[1] != (uint8_t)client->suite) {
+                ESP_LOGW(TAG, "Cipher suite mismatch from client %d", fd);
+                s_platform->httpd_sess_trigger_close(s_server, fd);
+                drop_client(fd);
+                return ESP_ERR_INVALID_STATE;
+            }
             size_t plaintext_len = 0;
             esp_err_t dec_err = ws_security_decrypt(&s_security_ctx, frame.payload, frame.len, &plaintext_len,
-                                                    &client->last_counter);
+                                                    &client->replay);
             if (dec_err != ESP_OK) {
                 ESP_LOGW(TAG, "Decrypt failed for client %d: %s", fd, esp_err_to_name(dec_err));
                 s_platform->httpd_sess_trigger_close(s_server, fd);
@@ -806,7 +844,7 @@ static esp_err_t ws_handler(httpd_req_t *req)
             payload += sizeof(uint32_t);
             len -= sizeof(uint32_t);
         }
-        s_rx_cb(payload, len, crc32, s_rx_ctx);
+        s_rx_cb(payload, len, crc32, client->session_id, s_rx_ctx);
     }
     client->awaiting_pong = false;
     return ESP_OK;
@@ -910,6 +948,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         .secret = s_cfg.crypto_secret,
         .secret_len = s_cfg.crypto_secret_len,
         .enable_encryption = s_cfg.enable_frame_encryption,
+        .accepted_suites = s_cfg.cipher_suites,
         .enable_handshake = s_cfg.enable_handshake_token,
         .enable_totp = s_cfg.enable_totp,
         .totp_secret = s_cfg.totp_secret,
@@ -934,6 +973,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         }
         s_nonce_cache = calloc(s_nonce_capacity, sizeof(ws_nonce_entry_t));
         if (!s_nonce_cache) {
+            ws_security_context_deinit(&s_security_ctx);
             return ESP_ERR_NO_MEM;
         }
     }
@@ -944,11 +984,13 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         free(s_nonce_cache);
         s_nonce_cache = NULL;
         s_nonce_capacity = 0;
+        ws_security_context_deinit(&s_security_ctx);
         return ESP_ERR_NO_MEM;
     }
     for (size_t i = 0; i < s_client_capacity; ++i) {
         s_clients[i].fd = -1;
         s_clients[i].handshake_verified = !ws_security_is_handshake_enabled(&s_security_ctx);
+        replay_window_init(&s_clients[i].replay, WS_SECURITY_REPLAY_WINDOW);
     }
 
     s_rx_buffer = malloc(s_cfg.rx_buffer_size + 1);
@@ -958,6 +1000,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         s_nonce_capacity = 0;
         free(s_clients);
         s_clients = NULL;
+        ws_security_context_deinit(&s_security_ctx);
         return ESP_ERR_NO_MEM;
     }
 
@@ -970,6 +1013,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         s_nonce_capacity = 0;
         free(s_clients);
         s_clients = NULL;
+        ws_security_context_deinit(&s_security_ctx);
         return ESP_ERR_NO_MEM;
     }
 
@@ -985,6 +1029,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         s_nonce_capacity = 0;
         free(s_clients);
         s_clients = NULL;
+        ws_security_context_deinit(&s_security_ctx);
         return ESP_ERR_NO_MEM;
     }
 
@@ -1017,6 +1062,7 @@ esp_err_t ws_server_start(const ws_server_config_t *config, ws_server_rx_cb_t cb
         s_nonce_capacity = 0;
         free(s_clients);
         s_clients = NULL;
+        ws_security_context_deinit(&s_security_ctx);
         return ret;
     }
 
@@ -1074,7 +1120,7 @@ void ws_server_stop(void)
     s_nonce_cache = NULL;
     s_nonce_capacity = 0;
     s_nonce_ttl_ticks = 0;
-    memset(&s_security_ctx, 0, sizeof(s_security_ctx));
+    ws_security_context_deinit(&s_security_ctx);
     s_time_fn = NULL;
 }
 
@@ -1092,29 +1138,38 @@ esp_err_t ws_server_send(const uint8_t *data, size_t len)
     }
     esp_err_t result = ESP_OK;
     clients_lock();
-    const uint8_t *frame_data = data;
-    size_t frame_len = len;
-    uint8_t *encrypted = NULL;
-    if (ws_security_is_encryption_enabled(&s_security_ctx)) {
-        size_t required = ws_security_encrypted_size(&s_security_ctx, len);
-        encrypted = (uint8_t *)malloc(required);
-        if (!encrypted) {
-            clients_unlock();
-            return ESP_ERR_NO_MEM;
-        }
-        esp_err_t enc_err = ws_security_encrypt(&s_security_ctx, data, len, encrypted, required, &frame_len);
-        if (enc_err != ESP_OK) {
-            free(encrypted);
-            clients_unlock();
-            return enc_err;
-        }
-        frame_data = encrypted;
-    }
+    const bool encrypt = ws_security_is_encryption_enabled(&s_security_ctx);
+    const size_t required = ws_security_encrypted_size(&s_security_ctx, len);
+    uint8_t *encrypted[WS_SECURITY_SUITE_COUNT] = {0};
+    size_t encrypted_len[WS_SECURITY_SUITE_COUNT] = {0};
     for (size_t i = 0; i < s_client_capacity; ++i) {
         ws_client_t *client = &s_clients[i];
         if (client->fd < 0) {
             continue;
         }
+        const uint8_t *frame_data = data;
+        size_t frame_len = len;
+        if (encrypt) {
+            // Each negotiated suite is sealed once and shared by every client using it.
+            ws_security_suite_t suite = client->suite;
+            if (!encrypted[suite]) {
+                encrypted[suite] = (uint8_t *)malloc(required);
+                if (!encrypted[suite]) {
+                    result = ESP_ERR_NO_MEM;
+                    break;
+                }
+                esp_err_t enc_err = ws_security_encrypt_suite(&s_security_ctx, suite, data, len, encrypted[suite],
+                                                              required, &encrypted_len[suite]);
+                if (enc_err != ESP_OK) {
+                    free(encrypted[suite]);
+                    encrypted[suite] = NULL;
+                    result = enc_err;
+                    break;
+                }
+            }
+            frame_data = encrypted[suite];
+            frame_len = encrypted_len[suite];
+        }
         esp_err_t err = send_ws_frame(client->fd, HTTPD_WS_TYPE_BINARY, frame_data, frame_len);
         if (err != ESP_OK) {
             ESP_LOGW(TAG, "Send failed to %d: %s", client->fd, esp_err_to_name(err));
@@ -1123,7 +1178,9 @@ esp_err_t ws_server_send(const uint8_t *data, size_t len)
             result = err;
         }
     }
-    free(encrypted);
+    for (size_t i = 0; i < WS_SECURITY_SUITE_COUNT; ++i) {
+        free(encrypted[i]);
+    }
     clients_unlock();
     return result;
 }
@@ -1156,7 +1213,7 @@ size_t ws_server_active_client_count(void)
  */
 esp_err_t ws_server_add_client_for_test(int fd)
 {
-    return add_client(fd);
+    return add_client(fd, WS_SECURITY_SUITE_AES256_GCM);
 }
 
 /**
@@ -1173,7 +1230,7 @@ void ws_server_clear_clients_for_test(void)
             s_clients[i].last_seen = 0;
             s_clients[i].awaiting_pong = false;
             s_clients[i].handshake_verified = !ws_security_is_handshake_enabled(&s_security_ctx);
-            s_clients[i].last_counter = 0;
+            replay_window_reset(&s_clients[i].replay);
         }
     }
     clients_unlock();
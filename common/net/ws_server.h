@@ -22,6 +22,7 @@ typedef struct {
     const uint8_t *crypto_secret;
     size_t crypto_secret_len;
     bool enable_frame_encryption;
+    uint8_t cipher_suites; /**< WS_SECURITY_SUITE_BIT() mask clients may negotiate; 0 = AES-GCM only. */
     bool enable_handshake_token;
     uint32_t handshake_replay_window_ms;
     size_t handshake_cache_size;
@@ -34,7 +35,8 @@ typedef struct {
     uint64_t (*get_time_unix)(void);
 } ws_server_config_t;
 
-typedef void (*ws_server_rx_cb_t)(const uint8_t *data, size_t len, uint32_t crc32, void *ctx);
+/** @p session_id names the connection a frame arrived on; ids are never reused while the server runs. */
+typedef void (*ws_server_rx_cb_t)(const uint8_t *data, size_t len, uint32_t crc32, uint32_t session_id, void *ctx);
 
 typedef struct {
     esp_err_t (*httpd_ssl_start)(httpd_handle_t *handle, const httpd_ssl_config_t *config);
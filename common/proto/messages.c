@@ -1,6 +1,7 @@
 #include "messages.h"
 
 #include "proto_crc32.h"
+#include "ts_codec.h"
 #include "esp_log.h"
 #include "sdkconfig.h"
 
@@ -11,6 +12,7 @@
 #include <string.h>
 
 #include "cJSON.h"
+#include "mbedtls/base64.h"
 
 #if CONFIG_USE_CBOR
 #include "tinycbor/cbor.h"
@@ -35,8 +37,8 @@ static bool json_append(char **cursor, size_t *remaining, const char *fmt, ...)
     return true;
 }
 
-static bool encode_sensor_update_json_into(const proto_sensor_update_t *msg, uint8_t *buffer,
-                                      size_t *buffer_len, uint32_t *crc32)
+static bool encode_sensor_update_json_into(const proto_sensor_update_t *msg, const char *type, uint8_t *buffer,
+                                           size_t *buffer_len, uint32_t *crc32)
 {
     if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
         return false;
@@ -44,16 +46,25 @@ static bool encode_sensor_update_json_into(const proto_sensor_update_t *msg, uin
     char *cursor = (char *)buffer;
     size_t remaining = *buffer_len;
     if (!json_append(&cursor, &remaining,
-                     "{\"v\":1,\"type\":\"sensor_update\",\"ts\":%" PRIu32 ",\"seq\":%" PRIu32 ",\"sht20\":[",
+                     "{\"v\":1,\"type\":\"%s\",\"ts\":%" PRIu32 ",\"seq\":%" PRIu32 ",\"sht20\":[", type,
                      msg->timestamp_ms, msg->sequence_id)) {
         return false;
     }
     for (size_t i = 0; i < msg->sht20_count; ++i) {
         const proto_sht20_reading_t *entry = &msg->sht20[i];
         if (!json_append(&cursor, &remaining,
-                         "%s{\"id\":\"%s\",\"t\":%.2f,\"rh\":%.2f,\"ok\":%s}",
-                         i > 0 ? "," : "", entry->id, entry->temperature_c, entry->humidity_percent,
-                         entry->valid ? "true" : "false")) {
+                         "%s{\"id\":\"%s\",\"t\":%.2f,\"rh\":%.2f,",
+                         i > 0 ? "," : "", entry->id, entry->temperature_c, entry->humidity_percent)) {
+            return false;
+        }
+        if (entry->pressure_pa > 0.0f && !json_append(&cursor, &remaining, "\"p\":%.1f,", entry->pressure_pa)) {
+            return false;
+        }
+        if (entry->sample_ms > 0 &&
+            !json_append(&cursor, &remaining, "\"ts\":%" PRIu32 ",", entry->sample_ms)) {
+            return false;
+        }
+        if (!json_append(&cursor, &remaining, "\"ok\":%s}", entry->valid ? "true" : "false")) {
             return false;
         }
     }
@@ -67,10 +78,17 @@ static bool encode_sensor_update_json_into(const proto_sensor_update_t *msg, uin
             snprintf(&rom[b * 2], sizeof(rom) - (b * 2), "%02X", entry->rom_code[b]);
         }
         if (!json_append(&cursor, &remaining,
-                         "%s{\"rom\":\"%s\",\"t\":%.2f}",
+                         "%s{\"rom\":\"%s\",\"t\":%.2f",
                          i > 0 ? "," : "", rom, entry->temperature_c)) {
             return false;
         }
+        if (entry->sample_ms > 0 &&
+            !json_append(&cursor, &remaining, ",\"ts\":%" PRIu32, entry->sample_ms)) {
+            return false;
+        }
+        if (!json_append(&cursor, &remaining, "}")) {
+            return false;
+        }
     }
     if (!json_append(&cursor, &remaining,
                      "],\"gpio\":{\"mcp0\":{\"A\":%u,\"B\":%u},\"mcp1\":{\"A\":%u,\"B\":%u}},\"pwm\":{\"pca9685\":{\"freq\":%u,\"duty\":[",
@@ -107,10 +125,22 @@ static bool encode_command_json_into(const proto_command_t *msg, uint8_t *buffer
                      msg->timestamp_ms, msg->sequence_id)) {
         return false;
     }
-    if (msg->has_pwm_update) {
-        if (!json_append(&cursor, &remaining,
-                         ",\"set_pwm\":{\"ch\":%u,\"duty\":%u}",
-                         msg->pwm_update.channel, msg->pwm_update.duty_cycle)) {
+    if (msg->pwm_update_count > PROTO_MAX_PWM_UPDATES || msg->gpio_write_count > PROTO_MAX_GPIO_WRITES) {
+        return false;
+    }
+    if (msg->pwm_update_count > 0) {
+        const bool batched = msg->pwm_update_count > 1;
+        if (!json_append(&cursor, &remaining, ",\"set_pwm\":%s", batched ? "[" : "")) {
+            return false;
+        }
+        for (size_t i = 0; i < msg->pwm_update_count; ++i) {
+            if (!json_append(&cursor, &remaining,
+                             "%s{\"ch\":%u,\"duty\":%u}",
+                             i > 0 ? "," : "", msg->pwm_updates[i].channel, msg->pwm_updates[i].duty_cycle)) {
+                return false;
+            }
+        }
+        if (batched && !json_append(&cursor, &remaining, "]")) {
             return false;
         }
     }
@@ -120,12 +150,22 @@ static bool encode_command_json_into(const proto_command_t *msg, uint8_t *buffer
             return false;
         }
     }
-    if (msg->has_gpio_write) {
-        const char *dev = msg->gpio_write.device_index == 0 ? "mcp0" : "mcp1";
-        char port = msg->gpio_write.port == 0 ? 'A' : 'B';
-        if (!json_append(&cursor, &remaining,
-                         ",\"write_gpio\":{\"dev\":\"%s\",\"port\":\"%c\",\"mask\":%u,\"value\":%u}",
-                         dev, port, msg->gpio_write.mask, msg->gpio_write.value)) {
+    if (msg->gpio_write_count > 0) {
+        const bool batched = msg->gpio_write_count > 1;
+        if (!json_append(&cursor, &remaining, ",\"write_gpio\":%s", batched ? "[" : "")) {
+            return false;
+        }
+        for (size_t i = 0; i < msg->gpio_write_count; ++i) {
+            const proto_gpio_write_t *entry = &msg->gpio_writes[i];
+            const char *dev = entry->device_index == 0 ? "mcp0" : "mcp1";
+            char port = entry->port == 0 ? 'A' : 'B';
+            if (!json_append(&cursor, &remaining,
+                             "%s{\"dev\":\"%s\",\"port\":\"%c\",\"mask\":%u,\"value\":%u}",
+                             i > 0 ? "," : "", dev, port, entry->mask, entry->value)) {
+                return false;
+            }
+        }
+        if (batched && !json_append(&cursor, &remaining, "]")) {
             return false;
         }
     }
@@ -140,11 +180,108 @@ static bool encode_command_json_into(const proto_command_t *msg, uint8_t *buffer
     return true;
 }
 
+static bool encode_command_ack_json_into(const proto_command_ack_t *msg, uint8_t *buffer, size_t *buffer_len,
+                                         uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
+        return false;
+    }
+    char *cursor = (char *)buffer;
+    size_t remaining = *buffer_len;
+    if (!json_append(&cursor, &remaining,
+                     "{\"v\":1,\"type\":\"ack\",\"ts\":%" PRIu32 ",\"seq\":%" PRIu32 ",\"status\":%u}",
+                     msg->timestamp_ms, msg->sequence_id, msg->status)) {
+        return false;
+    }
+    size_t used = *buffer_len - remaining;
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
+    }
+    *buffer_len = used;
+    return true;
+}
+
+static bool encode_history_request_json_into(const proto_history_request_t *msg, uint8_t *buffer,
+                                             size_t *buffer_len, uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
+        return false;
+    }
+    char *cursor = (char *)buffer;
+    size_t remaining = *buffer_len;
+    if (!json_append(&cursor, &remaining,
+                     "{\"v\":1,\"type\":\"hist_req\",\"seq\":%" PRIu32 ",\"ch\":%u,\"tier\":%u,\"from\":%" PRIu32
+                     ",\"max\":%u}",
+                     msg->sequence_id, msg->channel, msg->tier, msg->from_s, msg->max_points)) {
+        return false;
+    }
+    size_t used = *buffer_len - remaining;
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
+    }
+    *buffer_len = used;
+    return true;
+}
+
+_Static_assert(PROTO_HISTORY_NONE == TS_CODEC_FIXED_NONE, "history gaps must map onto codec gaps");
+
+/* Each column travels as one ts_codec fixed-point stream. */
+static bool decode_history_column(const uint8_t *data, size_t len, uint16_t count, int16_t *out)
+{
+    size_t consumed = len;
+    return ts_codec_decode_fixed(data, &consumed, out, count) && consumed == len;
+}
+
+static bool json_append_history_column(char **cursor, size_t *remaining, const char *key, const int16_t *values,
+                                       uint16_t count)
+{
+    uint8_t column[PROTO_HISTORY_COLUMN_MAX];
+    size_t len = sizeof(column);
+    if (!ts_codec_encode_fixed(values, count, column, &len) || !json_append(cursor, remaining, ",\"%s\":\"", key)) {
+        return false;
+    }
+    size_t written = 0;
+    if (mbedtls_base64_encode((unsigned char *)*cursor, *remaining, &written, column, len) != 0 ||
+        written >= *remaining) {
+        return false;
+    }
+    *cursor += written;
+    *remaining -= written;
+    return json_append(cursor, remaining, "\"");
+}
+
+static bool encode_history_json_into(const proto_history_t *msg, uint8_t *buffer, size_t *buffer_len,
+                                     uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0 || msg->count > PROTO_MAX_HISTORY_POINTS) {
+        return false;
+    }
+    char *cursor = (char *)buffer;
+    size_t remaining = *buffer_len;
+    if (!json_append(&cursor, &remaining,
+                     "{\"v\":1,\"type\":\"hist\",\"seq\":%" PRIu32 ",\"ch\":%u,\"tier\":%u,\"now\":%" PRIu32
+                     ",\"period\":%" PRIu32 ",\"start\":%" PRIu32 ",\"more\":%s,\"n\":%u",
+                     msg->sequence_id, msg->channel, msg->tier, msg->now_s, msg->period_s, msg->start_s,
+                     msg->more ? "true" : "false", msg->count) ||
+        !json_append_history_column(&cursor, &remaining, "min", msg->min, msg->count) ||
+        !json_append_history_column(&cursor, &remaining, "max", msg->max, msg->count) ||
+        !json_append_history_column(&cursor, &remaining, "mean", msg->mean, msg->count) ||
+        !json_append(&cursor, &remaining, "}")) {
+        return false;
+    }
+    size_t used = *buffer_len - remaining;
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
+    }
+    *buffer_len = used;
+    return true;
+}
+
 #if CONFIG_USE_CBOR
 #define CBOR_CHECK(x)                                                                                                   do {                                                                                                                    CborError __err = (x);                                                                                              if (__err != CborNoError) {                                                                                            return false;                                                                                                   }                                                                                                               } while (0)
 
-static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, uint8_t *buffer, size_t *buffer_len,
-                                           uint32_t *crc32)
+static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, const char *type, uint8_t *buffer,
+                                           size_t *buffer_len, uint32_t *crc32)
 {
     if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
         return false;
@@ -156,7 +293,7 @@ static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, uin
     CBOR_CHECK(cbor_encode_text_stringz(&map, "v"));
     CBOR_CHECK(cbor_encode_uint(&map, 1));
     CBOR_CHECK(cbor_encode_text_stringz(&map, "type"));
-    CBOR_CHECK(cbor_encode_text_stringz(&map, "sensor_update"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, type));
     CBOR_CHECK(cbor_encode_text_stringz(&map, "ts"));
     CBOR_CHECK(cbor_encode_uint(&map, msg->timestamp_ms));
     CBOR_CHECK(cbor_encode_text_stringz(&map, "seq"));
@@ -167,13 +304,23 @@ static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, uin
     CBOR_CHECK(cbor_encoder_create_array(&map, &sht_arr, msg->sht20_count));
     for (size_t i = 0; i < msg->sht20_count; ++i) {
         CborEncoder item;
-        CBOR_CHECK(cbor_encoder_create_map(&sht_arr, &item, 4));
+        bool has_pressure = msg->sht20[i].pressure_pa > 0.0f;
+        bool has_ts = msg->sht20[i].sample_ms > 0;
+        CBOR_CHECK(cbor_encoder_create_map(&sht_arr, &item, 4U + (has_pressure ? 1U : 0U) + (has_ts ? 1U : 0U)));
         CBOR_CHECK(cbor_encode_text_stringz(&item, "id"));
         CBOR_CHECK(cbor_encode_text_stringz(&item, msg->sht20[i].id));
         CBOR_CHECK(cbor_encode_text_stringz(&item, "t"));
         CBOR_CHECK(cbor_encode_float(&item, msg->sht20[i].temperature_c));
         CBOR_CHECK(cbor_encode_text_stringz(&item, "rh"));
         CBOR_CHECK(cbor_encode_float(&item, msg->sht20[i].humidity_percent));
+        if (has_pressure) {
+            CBOR_CHECK(cbor_encode_text_stringz(&item, "p"));
+            CBOR_CHECK(cbor_encode_float(&item, msg->sht20[i].pressure_pa));
+        }
+        if (has_ts) {
+            CBOR_CHECK(cbor_encode_text_stringz(&item, "ts"));
+            CBOR_CHECK(cbor_encode_uint(&item, msg->sht20[i].sample_ms));
+        }
         CBOR_CHECK(cbor_encode_text_stringz(&item, "ok"));
         CBOR_CHECK(cbor_encode_boolean(&item, msg->sht20[i].valid));
         CBOR_CHECK(cbor_encoder_close_container(&sht_arr, &item));
@@ -185,7 +332,8 @@ static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, uin
     CBOR_CHECK(cbor_encoder_create_array(&map, &ds_arr, msg->ds18b20_count));
     for (size_t i = 0; i < msg->ds18b20_count; ++i) {
         CborEncoder item;
-        CBOR_CHECK(cbor_encoder_create_map(&ds_arr, &item, 2));
+        bool has_ts = msg->ds18b20[i].sample_ms > 0;
+        CBOR_CHECK(cbor_encoder_create_map(&ds_arr, &item, has_ts ? 3 : 2));
         CBOR_CHECK(cbor_encode_text_stringz(&item, "rom"));
         char rom_str[17] = {0};
         for (size_t b = 0; b < sizeof(msg->ds18b20[i].rom_code); ++b) {
@@ -194,6 +342,10 @@ static bool encode_sensor_update_cbor_into(const proto_sensor_update_t *msg, uin
         CBOR_CHECK(cbor_encode_text_stringz(&item, rom_str));
         CBOR_CHECK(cbor_encode_text_stringz(&item, "t"));
         CBOR_CHECK(cbor_encode_float(&item, msg->ds18b20[i].temperature_c));
+        if (has_ts) {
+            CBOR_CHECK(cbor_encode_text_stringz(&item, "ts"));
+            CBOR_CHECK(cbor_encode_uint(&item, msg->ds18b20[i].sample_ms));
+        }
         CBOR_CHECK(cbor_encoder_close_container(&ds_arr, &item));
     }
     CBOR_CHECK(cbor_encoder_close_container(&map, &ds_arr));
@@ -264,15 +416,30 @@ static bool encode_command_cbor_into(const proto_command_t *msg, uint8_t *buffer
     CBOR_CHECK(cbor_encode_text_stringz(&map, "seq"));
     CBOR_CHECK(cbor_encode_uint(&map, msg->sequence_id));
 
-    if (msg->has_pwm_update) {
+    if (msg->pwm_update_count > PROTO_MAX_PWM_UPDATES || msg->gpio_write_count > PROTO_MAX_GPIO_WRITES) {
+        return false;
+    }
+    if (msg->pwm_update_count > 0) {
         CBOR_CHECK(cbor_encode_text_stringz(&map, "set_pwm"));
-        CborEncoder pwm;
-        CBOR_CHECK(cbor_encoder_create_map(&map, &pwm, 2));
-        CBOR_CHECK(cbor_encode_text_stringz(&pwm, "ch"));
-        CBOR_CHECK(cbor_encode_uint(&pwm, msg->pwm_update.channel));
-        CBOR_CHECK(cbor_encode_text_stringz(&pwm, "duty"));
-        CBOR_CHECK(cbor_encode_uint(&pwm, msg->pwm_update.duty_cycle));
-        CBOR_CHECK(cbor_encoder_close_container(&map, &pwm));
+        const bool batched = msg->pwm_update_count > 1;
+        CborEncoder arr;
+        CborEncoder *parent = &map;
+        if (batched) {
+            CBOR_CHECK(cbor_encoder_create_array(&map, &arr, msg->pwm_update_count));
+            parent = &arr;
+        }
+        for (size_t i = 0; i < msg->pwm_update_count; ++i) {
+            CborEncoder pwm;
+            CBOR_CHECK(cbor_encoder_create_map(parent, &pwm, 2));
+            CBOR_CHECK(cbor_encode_text_stringz(&pwm, "ch"));
+            CBOR_CHECK(cbor_encode_uint(&pwm, msg->pwm_updates[i].channel));
+            CBOR_CHECK(cbor_encode_text_stringz(&pwm, "duty"));
+            CBOR_CHECK(cbor_encode_uint(&pwm, msg->pwm_updates[i].duty_cycle));
+            CBOR_CHECK(cbor_encoder_close_container(parent, &pwm));
+        }
+        if (batched) {
+            CBOR_CHECK(cbor_encoder_close_container(&map, &arr));
+        }
     }
     if (msg->has_pwm_frequency) {
         CBOR_CHECK(cbor_encode_text_stringz(&map, "pwm_freq"));
@@ -282,21 +449,160 @@ static bool encode_command_cbor_into(const proto_command_t *msg, uint8_t *buffer
         CBOR_CHECK(cbor_encode_uint(&freq, msg->pwm_frequency));
         CBOR_CHECK(cbor_encoder_close_container(&map, &freq));
     }
-    if (msg->has_gpio_write) {
+    if (msg->gpio_write_count > 0) {
         CBOR_CHECK(cbor_encode_text_stringz(&map, "write_gpio"));
-        CborEncoder gpio;
-        CBOR_CHECK(cbor_encoder_create_map(&map, &gpio, 4));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, "dev"));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, msg->gpio_write.device_index == 0 ? "mcp0" : "mcp1"));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, "port"));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, msg->gpio_write.port == 0 ? "A" : "B"));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, "mask"));
-        CBOR_CHECK(cbor_encode_uint(&gpio, msg->gpio_write.mask));
-        CBOR_CHECK(cbor_encode_text_stringz(&gpio, "value"));
-        CBOR_CHECK(cbor_encode_uint(&gpio, msg->gpio_write.value));
-        CBOR_CHECK(cbor_encoder_close_container(&map, &gpio));
+        const bool batched = msg->gpio_write_count > 1;
+        CborEncoder arr;
+        CborEncoder *parent = &map;
+        if (batched) {
+            CBOR_CHECK(cbor_encoder_create_array(&map, &arr, msg->gpio_write_count));
+            parent = &arr;
+        }
+        for (size_t i = 0; i < msg->gpio_write_count; ++i) {
+            const proto_gpio_write_t *entry = &msg->gpio_writes[i];
+            CborEncoder gpio;
+            CBOR_CHECK(cbor_encoder_create_map(parent, &gpio, 4));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, "dev"));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, entry->device_index == 0 ? "mcp0" : "mcp1"));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, "port"));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, entry->port == 0 ? "A" : "B"));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, "mask"));
+            CBOR_CHECK(cbor_encode_uint(&gpio, entry->mask));
+            CBOR_CHECK(cbor_encode_text_stringz(&gpio, "value"));
+            CBOR_CHECK(cbor_encode_uint(&gpio, entry->value));
+            CBOR_CHECK(cbor_encoder_close_container(parent, &gpio));
+        }
+        if (batched) {
+            CBOR_CHECK(cbor_encoder_close_container(&map, &arr));
+        }
+    }
+
+    CBOR_CHECK(cbor_encoder_close_container(&encoder, &map));
+    if (cbor_encoder_get_extra_bytes_needed(&encoder) > 0) {
+        return false;
+    }
+    size_t used = cbor_encoder_get_buffer_size(&encoder, buffer);
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
+    }
+    *buffer_len = used;
+    return true;
+}
+
+static bool encode_command_ack_cbor_into(const proto_command_ack_t *msg, uint8_t *buffer, size_t *buffer_len,
+                                         uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
+        return false;
+    }
+    CborEncoder encoder;
+    cbor_encoder_init(&encoder, buffer, *buffer_len, 0);
+    CborEncoder map;
+    CBOR_CHECK(cbor_encoder_create_map(&encoder, &map, 5));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "v"));
+    CBOR_CHECK(cbor_encode_uint(&map, 1));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "type"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "ack"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "ts"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->timestamp_ms));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "seq"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->sequence_id));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "status"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->status));
+    CBOR_CHECK(cbor_encoder_close_container(&encoder, &map));
+    if (cbor_encoder_get_extra_bytes_needed(&encoder) > 0) {
+        return false;
+    }
+    size_t used = cbor_encoder_get_buffer_size(&encoder, buffer);
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
+    }
+    *buffer_len = used;
+    return true;
+}
+static bool encode_history_request_cbor_into(const proto_history_request_t *msg, uint8_t *buffer,
+                                             size_t *buffer_len, uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0) {
+        return false;
+    }
+    CborEncoder encoder;
+    cbor_encoder_init(&encoder, buffer, *buffer_len, 0);
+    CborEncoder map;
+    CBOR_CHECK(cbor_encoder_create_map(&encoder, &map, 7));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "v"));
+    CBOR_CHECK(cbor_encode_uint(&map, 1));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "type"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "hist_req"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "seq"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->sequence_id));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "ch"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->channel));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "tier"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->tier));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "from"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->from_s));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "max"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->max_points));
+    CBOR_CHECK(cbor_encoder_close_container(&encoder, &map));
+    if (cbor_encoder_get_extra_bytes_needed(&encoder) > 0) {
+        return false;
+    }
+    size_t used = cbor_encoder_get_buffer_size(&encoder, buffer);
+    if (crc32) {
+        *crc32 = proto_crc32(buffer, used);
     }
+    *buffer_len = used;
+    return true;
+}
 
+static bool cbor_encode_history_column(CborEncoder *map, const char *key, const int16_t *values, uint16_t count)
+{
+    uint8_t column[PROTO_HISTORY_COLUMN_MAX];
+    size_t len = sizeof(column);
+    if (!ts_codec_encode_fixed(values, count, column, &len)) {
+        return false;
+    }
+    CBOR_CHECK(cbor_encode_text_stringz(map, key));
+    CBOR_CHECK(cbor_encode_byte_string(map, column, len));
+    return true;
+}
+
+static bool encode_history_cbor_into(const proto_history_t *msg, uint8_t *buffer, size_t *buffer_len,
+                                     uint32_t *crc32)
+{
+    if (!msg || !buffer || !buffer_len || *buffer_len == 0 || msg->count > PROTO_MAX_HISTORY_POINTS) {
+        return false;
+    }
+    CborEncoder encoder;
+    cbor_encoder_init(&encoder, buffer, *buffer_len, 0);
+    CborEncoder map;
+    CBOR_CHECK(cbor_encoder_create_map(&encoder, &map, 13));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "v"));
+    CBOR_CHECK(cbor_encode_uint(&map, 1));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "type"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "hist"));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "seq"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->sequence_id));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "ch"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->channel));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "tier"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->tier));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "now"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->now_s));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "period"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->period_s));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "start"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->start_s));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "more"));
+    CBOR_CHECK(cbor_encode_boolean(&map, msg->more));
+    CBOR_CHECK(cbor_encode_text_stringz(&map, "n"));
+    CBOR_CHECK(cbor_encode_uint(&map, msg->count));
+    if (!cbor_encode_history_column(&map, "min", msg->min, msg->count) ||
+        !cbor_encode_history_column(&map, "max", msg->max, msg->count) ||
+        !cbor_encode_history_column(&map, "mean", msg->mean, msg->count)) {
+        return false;
+    }
     CBOR_CHECK(cbor_encoder_close_container(&encoder, &map));
     if (cbor_encoder_get_extra_bytes_needed(&encoder) > 0) {
         return false;
@@ -310,17 +616,35 @@ static bool encode_command_cbor_into(const proto_command_t *msg, uint8_t *buffer
 }
 #endif
 
-bool proto_encode_sensor_update_into(const proto_sensor_update_t *msg, bool use_cbor, uint8_t *buffer,
-                                     size_t *buffer_len, uint32_t *crc32)
+static bool encode_sensor_state_into(const proto_sensor_update_t *msg, const char *type, bool use_cbor,
+                                     uint8_t *buffer, size_t *buffer_len, uint32_t *crc32)
 {
 #if CONFIG_USE_CBOR
     if (use_cbor) {
-        return encode_sensor_update_cbor_into(msg, buffer, buffer_len, crc32);
+        return encode_sensor_update_cbor_into(msg, type, buffer, buffer_len, crc32);
     }
 #else
     (void)use_cbor;
 #endif
-    return encode_sensor_update_json_into(msg, buffer, buffer_len, crc32);
+    return encode_sensor_update_json_into(msg, type, buffer, buffer_len, crc32);
+}
+
+bool proto_encode_sensor_update_into(const proto_sensor_update_t *msg, bool use_cbor, uint8_t *buffer,
+                                     size_t *buffer_len, uint32_t *crc32)
+{
+    return encode_sensor_state_into(msg, "sensor_update", use_cbor, buffer, buffer_len, crc32);
+}
+
+/**
+ * @brief Encode a past sensor state replayed from the sensor's journal.
+ *
+ * Same body as a sensor update under the "sensor_replay" type, so receivers can
+ * keep it out of live state; proto_decode_sensor_update() decodes both.
+ */
+bool proto_encode_sensor_replay_into(const proto_sensor_update_t *msg, bool use_cbor, uint8_t *buffer,
+                                     size_t *buffer_len, uint32_t *crc32)
+{
+    return encode_sensor_state_into(msg, "sensor_replay", use_cbor, buffer, buffer_len, crc32);
 }
 
 bool proto_encode_command_into(const proto_command_t *msg, bool use_cbor, uint8_t *buffer, size_t *buffer_len,
@@ -336,6 +660,45 @@ bool proto_encode_command_into(const proto_command_t *msg, bool use_cbor, uint8_
     return encode_command_json_into(msg, buffer, buffer_len, crc32);
 }
 
+bool proto_encode_command_ack_into(const proto_command_ack_t *msg, bool use_cbor, uint8_t *buffer,
+                                   size_t *buffer_len, uint32_t *crc32)
+{
+#if CONFIG_USE_CBOR
+    if (use_cbor) {
+        return encode_command_ack_cbor_into(msg, buffer, buffer_len, crc32);
+    }
+#else
+    (void)use_cbor;
+#endif
+    return encode_command_ack_json_into(msg, buffer, buffer_len, crc32);
+}
+
+bool proto_encode_history_request_into(const proto_history_request_t *msg, bool use_cbor, uint8_t *buffer,
+                                       size_t *buffer_len, uint32_t *crc32)
+{
+#if CONFIG_USE_CBOR
+    if (use_cbor) {
+        return encode_history_request_cbor_into(msg, buffer, buffer_len, crc32);
+    }
+#else
+    (void)use_cbor;
+#endif
+    return encode_history_request_json_into(msg, buffer, buffer_len, crc32);
+}
+
+bool proto_encode_history_into(const proto_history_t *msg, bool use_cbor, uint8_t *buffer, size_t *buffer_len,
+                               uint32_t *crc32)
+{
+#if CONFIG_USE_CBOR
+    if (use_cbor) {
+        return encode_history_cbor_into(msg, buffer, buffer_len, crc32);
+    }
+#else
+    (void)use_cbor;
+#endif
+    return encode_history_json_into(msg, buffer, buffer_len, crc32);
+}
+
 static bool parse_rom(const char *rom_str, uint8_t out[8])
 {
     size_t len = strlen(rom_str);
@@ -352,6 +715,127 @@ static bool parse_rom(const char *rom_str, uint8_t out[8])
     return true;
 }
 
+static void decode_pwm_entry_json(const cJSON *obj, proto_command_t *out_msg)
+{
+    if (out_msg->pwm_update_count >= PROTO_MAX_PWM_UPDATES) {
+        return;
+    }
+    proto_pwm_update_t *entry = &out_msg->pwm_updates[out_msg->pwm_update_count++];
+    entry->channel = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(obj, "ch"));
+    entry->duty_cycle = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(obj, "duty"));
+}
+
+static void decode_gpio_entry_json(const cJSON *obj, proto_command_t *out_msg)
+{
+    if (out_msg->gpio_write_count >= PROTO_MAX_GPIO_WRITES) {
+        return;
+    }
+    proto_gpio_write_t *entry = &out_msg->gpio_writes[out_msg->gpio_write_count++];
+    const cJSON *dev = cJSON_GetObjectItem(obj, "dev");
+    const cJSON *port = cJSON_GetObjectItem(obj, "port");
+    entry->device_index = (dev && dev->valuestring && strcmp(dev->valuestring, "mcp1") == 0) ? 1 : 0;
+    entry->port = (port && port->valuestring && port->valuestring[0] == 'B') ? 1 : 0;
+    entry->mask = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(obj, "mask"));
+    entry->value = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(obj, "value"));
+}
+
+#if CONFIG_USE_CBOR
+typedef bool (*cbor_entry_decoder_t)(CborValue *entry_map, proto_command_t *out_msg);
+
+static bool decode_pwm_entry_cbor(CborValue *pwm_map, proto_command_t *out_msg)
+{
+    proto_pwm_update_t entry = {0};
+    while (!cbor_value_at_end(pwm_map)) {
+        char sub[8] = {0};
+        size_t sub_len = sizeof(sub) - 1;
+        if (cbor_value_copy_text_string(pwm_map, sub, &sub_len, pwm_map) != CborNoError) {
+            return false;
+        }
+        if (!strcmp(sub, "ch")) {
+            uint64_t ch = 0;
+            cbor_value_get_uint64(pwm_map, &ch);
+            entry.channel = (uint8_t)ch;
+        } else if (!strcmp(sub, "duty")) {
+            uint64_t duty = 0;
+            cbor_value_get_uint64(pwm_map, &duty);
+            entry.duty_cycle = (uint16_t)duty;
+        }
+        cbor_value_advance(pwm_map);
+    }
+    if (out_msg->pwm_update_count < PROTO_MAX_PWM_UPDATES) {
+        out_msg->pwm_updates[out_msg->pwm_update_count++] = entry;
+    }
+    return true;
+}
+
+static bool decode_gpio_entry_cbor(CborValue *gpio_map, proto_command_t *out_msg)
+{
+    proto_gpio_write_t entry = {0};
+    while (!cbor_value_at_end(gpio_map)) {
+        char sub[12] = {0};
+        size_t sub_len = sizeof(sub) - 1;
+        if (cbor_value_copy_text_string(gpio_map, sub, &sub_len, gpio_map) != CborNoError) {
+            return false;
+        }
+        if (!strcmp(sub, "dev")) {
+            char dev[8] = {0};
+            size_t dev_len = sizeof(dev) - 1;
+            cbor_value_copy_text_string(gpio_map, dev, &dev_len, gpio_map);
+            entry.device_index = strcmp(dev, "mcp1") == 0 ? 1 : 0;
+            continue;
+        } else if (!strcmp(sub, "port")) {
+            char port[2] = {0};
+            size_t port_len = sizeof(port) - 1;
+            cbor_value_copy_text_string(gpio_map, port, &port_len, gpio_map);
+            entry.port = (port[0] == 'B');
+            continue;
+        } else if (!strcmp(sub, "mask")) {
+            uint64_t mask = 0;
+            cbor_value_get_uint64(gpio_map, &mask);
+            entry.mask = (uint16_t)mask;
+        } else if (!strcmp(sub, "value")) {
+            uint64_t val = 0;
+            cbor_value_get_uint64(gpio_map, &val);
+            entry.value = (uint16_t)val;
+        }
+        cbor_value_advance(gpio_map);
+    }
+    if (out_msg->gpio_write_count < PROTO_MAX_GPIO_WRITES) {
+        out_msg->gpio_writes[out_msg->gpio_write_count++] = entry;
+    }
+    return true;
+}
+
+/**
+ * @brief Decode a command field holding either one entry map or an array of them.
+ */
+static bool decode_entries_cbor(CborValue *value, proto_command_t *out_msg, cbor_entry_decoder_t decode)
+{
+    if (cbor_value_is_map(value)) {
+        CborValue entry_map;
+        if (cbor_value_enter_container(value, &entry_map) != CborNoError || !decode(&entry_map, out_msg)) {
+            return false;
+        }
+        return cbor_value_leave_container(value, &entry_map) == CborNoError;
+    }
+    if (!cbor_value_is_array(value)) {
+        return false;
+    }
+    CborValue arr;
+    if (cbor_value_enter_container(value, &arr) != CborNoError) {
+        return false;
+    }
+    while (!cbor_value_at_end(&arr)) {
+        CborValue entry_map;
+        if (!cbor_value_is_map(&arr) || cbor_value_enter_container(&arr, &entry_map) != CborNoError ||
+            !decode(&entry_map, out_msg) || cbor_value_leave_container(&arr, &entry_map) != CborNoError) {
+            return false;
+        }
+    }
+    return cbor_value_leave_container(value, &arr) == CborNoError;
+}
+#endif
+
 bool proto_decode_command(const uint8_t *payload, size_t payload_len, bool is_cbor,
                           proto_command_t *out_msg, uint32_t expected_crc32)
 {
@@ -402,30 +886,9 @@ bool proto_decode_command(const uint8_t *payload, size_t payload_len, bool is_cb
                 out_msg->sequence_id = (uint32_t)seq;
                 cbor_value_advance(&map);
             } else if (!strcmp(key, "set_pwm")) {
-                CborValue pwm_map;
-                if (cbor_value_enter_container(&map, &pwm_map) != CborNoError) {
+                if (!decode_entries_cbor(&map, out_msg, decode_pwm_entry_cbor)) {
                     return false;
                 }
-                while (!cbor_value_at_end(&pwm_map)) {
-                    char sub[8] = {0};
-                    size_t sub_len = sizeof(sub) - 1;
-                    if (cbor_value_copy_text_string(&pwm_map, sub, &sub_len, &pwm_map) != CborNoError) {
-                        return false;
-                    }
-                    if (!strcmp(sub, "ch")) {
-                        uint64_t ch = 0;
-                        cbor_value_get_uint64(&pwm_map, &ch);
-                        out_msg->pwm_update.channel = (uint8_t)ch;
-                    } else if (!strcmp(sub, "duty")) {
-                        uint64_t duty = 0;
-                        cbor_value_get_uint64(&pwm_map, &duty);
-                        out_msg->pwm_update.duty_cycle = (uint16_t)duty;
-                    }
-                    cbor_value_advance(&pwm_map);
-                }
-                cbor_value_leave_container(&map, &pwm_map);
-                out_msg->has_pwm_update = true;
-                cbor_value_advance(&map);
             } else if (!strcmp(key, "pwm_freq")) {
                 CborValue freq_map;
                 if (cbor_value_enter_container(&map, &freq_map) != CborNoError) {
@@ -444,40 +907,10 @@ bool proto_decode_command(const uint8_t *payload, size_t payload_len, bool is_cb
                     cbor_value_advance(&freq_map);
                 }
                 cbor_value_leave_container(&map, &freq_map);
-                cbor_value_advance(&map);
             } else if (!strcmp(key, "write_gpio")) {
-                CborValue gpio_map;
-                if (cbor_value_enter_container(&map, &gpio_map) != CborNoError) {
+                if (!decode_entries_cbor(&map, out_msg, decode_gpio_entry_cbor)) {
                     return false;
                 }
-                while (!cbor_value_at_end(&gpio_map)) {
-                    char sub[12] = {0};
-                    size_t sub_len = sizeof(sub) - 1;
-                    cbor_value_copy_text_string(&gpio_map, sub, &sub_len, &gpio_map);
-                    if (!strcmp(sub, "dev")) {
-                        char dev[8] = {0};
-                        size_t dev_len = sizeof(dev) - 1;
-                        cbor_value_copy_text_string(&gpio_map, dev, &dev_len, &gpio_map);
-                        out_msg->gpio_write.device_index = strcmp(dev, "mcp1") == 0 ? 1 : 0;
-                    } else if (!strcmp(sub, "port")) {
-                        char port[2] = {0};
-                        size_t port_len = sizeof(port) - 1;
-                        cbor_value_copy_text_string(&gpio_map, port, &port_len, &gpio_map);
-                        out_msg->gpio_write.port = (port[0] == 'B');
-                    } else if (!strcmp(sub, "mask")) {
-                        uint64_t mask = 0;
-                        cbor_value_get_uint64(&gpio_map, &mask);
-                        out_msg->gpio_write.mask = (uint16_t)mask;
-                    } else if (!strcmp(sub, "value")) {
-                        uint64_t val = 0;
-                        cbor_value_get_uint64(&gpio_map, &val);
-                        out_msg->gpio_write.value = (uint16_t)val;
-                    }
-                    cbor_value_advance(&gpio_map);
-                }
-                cbor_value_leave_container(&map, &gpio_map);
-                out_msg->has_gpio_write = true;
-                cbor_value_advance(&map);
             } else {
                 cbor_value_advance(&map);
             }
@@ -496,26 +929,34 @@ bool proto_decode_command(const uint8_t *payload, size_t payload_len, bool is_cb
     out_msg->timestamp_ms = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "ts"));
     out_msg->sequence_id = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "seq"));
 
-    cJSON *set_pwm = cJSON_GetObjectItem(root, "set_pwm");
+    const cJSON *set_pwm = cJSON_GetObjectItem(root, "set_pwm");
     if (cJSON_IsObject(set_pwm)) {
-        out_msg->pwm_update.channel = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(set_pwm, "ch"));
-        out_msg->pwm_update.duty_cycle = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(set_pwm, "duty"));
-        out_msg->has_pwm_update = true;
+        decode_pwm_entry_json(set_pwm, out_msg);
+    } else if (cJSON_IsArray(set_pwm)) {
+        const cJSON *item = NULL;
+        cJSON_ArrayForEach(item, set_pwm)
+        {
+            if (cJSON_IsObject(item)) {
+                decode_pwm_entry_json(item, out_msg);
+            }
+        }
     }
     cJSON *pwm_freq = cJSON_GetObjectItem(root, "pwm_freq");
     if (cJSON_IsObject(pwm_freq)) {
         out_msg->pwm_frequency = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(pwm_freq, "freq"));
         out_msg->has_pwm_frequency = true;
     }
-    cJSON *write_gpio = cJSON_GetObjectItem(root, "write_gpio");
+    const cJSON *write_gpio = cJSON_GetObjectItem(root, "write_gpio");
     if (cJSON_IsObject(write_gpio)) {
-        const cJSON *dev = cJSON_GetObjectItem(write_gpio, "dev");
-        const cJSON *port = cJSON_GetObjectItem(write_gpio, "port");
-        out_msg->gpio_write.device_index = (dev && dev->valuestring && strcmp(dev->valuestring, "mcp1") == 0) ? 1 : 0;
-        out_msg->gpio_write.port = (port && port->valuestring && port->valuestring[0] == 'B') ? 1 : 0;
-        out_msg->gpio_write.mask = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(write_gpio, "mask"));
-        out_msg->gpio_write.value = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(write_gpio, "value"));
-        out_msg->has_gpio_write = true;
+        decode_gpio_entry_json(write_gpio, out_msg);
+    } else if (cJSON_IsArray(write_gpio)) {
+        const cJSON *item = NULL;
+        cJSON_ArrayForEach(item, write_gpio)
+        {
+            if (cJSON_IsObject(item)) {
+                decode_gpio_entry_json(item, out_msg);
+            }
+        }
     }
 
     cJSON_Delete(root);
@@ -598,6 +1039,14 @@ bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool
                             double val;
                             cbor_value_get_double(&item, &val);
                             out_msg->sht20[idx].humidity_percent = (float)val;
+                        } else if (!strcmp(sub, "p")) {
+                            double val;
+                            cbor_value_get_double(&item, &val);
+                            out_msg->sht20[idx].pressure_pa = (float)val;
+                        } else if (!strcmp(sub, "ts")) {
+                            uint64_t ts = 0;
+                            cbor_value_get_uint64(&item, &ts);
+                            out_msg->sht20[idx].sample_ms = (uint32_t)ts;
                         } else if (!strcmp(sub, "ok")) {
                             bool ok = false;
                             if (cbor_value_get_boolean(&item, &ok) != CborNoError) {
@@ -639,6 +1088,10 @@ bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool
                             double val;
                             cbor_value_get_double(&item, &val);
                             out_msg->ds18b20[idx].temperature_c = (float)val;
+                        } else if (!strcmp(sub, "ts")) {
+                            uint64_t ts = 0;
+                            cbor_value_get_uint64(&item, &ts);
+                            out_msg->ds18b20[idx].sample_ms = (uint32_t)ts;
                         }
                         cbor_value_advance(&item);
                     }
@@ -767,6 +1220,14 @@ bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool
             }
             out_msg->sht20[idx].temperature_c = (float)cJSON_GetNumberValue(t);
             out_msg->sht20[idx].humidity_percent = (float)cJSON_GetNumberValue(rh);
+            const cJSON *p = cJSON_GetObjectItem(item, "p");
+            if (cJSON_IsNumber(p)) {
+                out_msg->sht20[idx].pressure_pa = (float)cJSON_GetNumberValue(p);
+            }
+            const cJSON *ts = cJSON_GetObjectItem(item, "ts");
+            if (cJSON_IsNumber(ts)) {
+                out_msg->sht20[idx].sample_ms = (uint32_t)cJSON_GetNumberValue(ts);
+            }
             out_msg->sht20[idx].valid = cJSON_IsTrue(ok);
             idx++;
         }
@@ -788,6 +1249,10 @@ bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool
                 parse_rom(rom->valuestring, out_msg->ds18b20[idx].rom_code);
             }
             out_msg->ds18b20[idx].temperature_c = (float)cJSON_GetNumberValue(temp);
+            const cJSON *ts = cJSON_GetObjectItem(item, "ts");
+            if (cJSON_IsNumber(ts)) {
+                out_msg->ds18b20[idx].sample_ms = (uint32_t)cJSON_GetNumberValue(ts);
+            }
             idx++;
         }
     }
@@ -828,3 +1293,449 @@ bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool
     cJSON_Delete(root);
     return true;
 }
+
+bool proto_decode_command_ack(const uint8_t *payload, size_t payload_len, bool is_cbor,
+                              proto_command_ack_t *out_msg, uint32_t expected_crc32)
+{
+    if (!payload || !out_msg) {
+        return false;
+    }
+    if (expected_crc32 != 0) {
+        uint32_t crc = proto_crc32(payload, payload_len);
+        if (crc != expected_crc32) {
+            ESP_LOGW(TAG, "Ack CRC mismatch");
+            return false;
+        }
+    }
+    memset(out_msg, 0, sizeof(*out_msg));
+
+#if CONFIG_USE_CBOR
+    if (is_cbor) {
+        CborParser parser;
+        CborValue root;
+        if (cbor_parser_init(payload, payload_len, 0, &parser, &root) != CborNoError ||
+            !cbor_value_is_map(&root)) {
+            return false;
+        }
+        CborValue map;
+        if (cbor_value_enter_container(&root, &map) != CborNoError) {
+            return false;
+        }
+        bool is_ack = false;
+        while (!cbor_value_at_end(&map)) {
+            char key[16] = {0};
+            size_t key_len = sizeof(key) - 1;
+            if (cbor_value_copy_text_string(&map, key, &key_len, &map) != CborNoError) {
+                return false;
+            }
+            if (!strcmp(key, "type")) {
+                char type[16] = {0};
+                size_t type_len = sizeof(type) - 1;
+                if (cbor_value_copy_text_string(&map, type, &type_len, &map) != CborNoError) {
+                    return false;
+                }
+                is_ack = !strcmp(type, "ack");
+                continue;
+            }
+            uint64_t val = 0;
+            if (cbor_value_is_unsigned_integer(&map)) {
+                cbor_value_get_uint64(&map, &val);
+            }
+            if (!strcmp(key, "ts")) {
+                out_msg->timestamp_ms = (uint32_t)val;
+            } else if (!strcmp(key, "seq")) {
+                out_msg->sequence_id = (uint32_t)val;
+            } else if (!strcmp(key, "status")) {
+                out_msg->status = (uint8_t)val;
+            }
+            cbor_value_advance(&map);
+        }
+        return is_ack;
+    }
+#else
+    (void)is_cbor;
+#endif
+
+    cJSON *root = cJSON_ParseWithLengthOpts((const char *)payload, payload_len, NULL, false);
+    if (!root) {
+        return false;
+    }
+    const cJSON *type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type) || strcmp(type->valuestring, "ack") != 0) {
+        cJSON_Delete(root);
+        return false;
+    }
+    out_msg->timestamp_ms = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "ts"));
+    out_msg->sequence_id = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "seq"));
+    out_msg->status = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "status"));
+    cJSON_Delete(root);
+    return true;
+}
+
+bool proto_decode_history_request(const uint8_t *payload, size_t payload_len, bool is_cbor,
+                                  proto_history_request_t *out_msg, uint32_t expected_crc32)
+{
+    if (!payload || !out_msg) {
+        return false;
+    }
+    if (expected_crc32 != 0 && proto_crc32(payload, payload_len) != expected_crc32) {
+        ESP_LOGW(TAG, "History request CRC mismatch");
+        return false;
+    }
+    memset(out_msg, 0, sizeof(*out_msg));
+
+#if CONFIG_USE_CBOR
+    if (is_cbor) {
+        CborParser parser;
+        CborValue root;
+        CborValue map;
+        if (cbor_parser_init(payload, payload_len, 0, &parser, &root) != CborNoError || !cbor_value_is_map(&root) ||
+            cbor_value_enter_container(&root, &map) != CborNoError) {
+            return false;
+        }
+        bool is_request = false;
+        while (!cbor_value_at_end(&map)) {
+            char key[16] = {0};
+            size_t key_len = sizeof(key) - 1;
+            if (cbor_value_copy_text_string(&map, key, &key_len, &map) != CborNoError) {
+                return false;
+            }
+            if (!strcmp(key, "type")) {
+                char type[16] = {0};
+                size_t type_len = sizeof(type) - 1;
+                if (cbor_value_copy_text_string(&map, type, &type_len, &map) != CborNoError) {
+                    return false;
+                }
+                is_request = !strcmp(type, "hist_req");
+                continue;
+            }
+            uint64_t val = 0;
+            if (cbor_value_is_unsigned_integer(&map)) {
+                cbor_value_get_uint64(&map, &val);
+            }
+            if (!strcmp(key, "seq")) {
+                out_msg->sequence_id = (uint32_t)val;
+            } else if (!strcmp(key, "ch")) {
+                out_msg->channel = (uint8_t)val;
+            } else if (!strcmp(key, "tier")) {
+                out_msg->tier = (uint8_t)val;
+            } else if (!strcmp(key, "from")) {
+                out_msg->from_s = (uint32_t)val;
+            } else if (!strcmp(key, "max")) {
+                out_msg->max_points = (uint16_t)val;
+            }
+            cbor_value_advance(&map);
+        }
+        return is_request;
+    }
+#else
+    (void)is_cbor;
+#endif
+
+    cJSON *root = cJSON_ParseWithLengthOpts((const char *)payload, payload_len, NULL, false);
+    if (!root) {
+        return false;
+    }
+    const cJSON *type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type) || strcmp(type->valuestring, "hist_req") != 0) {
+        cJSON_Delete(root);
+        return false;
+    }
+    out_msg->sequence_id = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "seq"));
+    out_msg->channel = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "ch"));
+    out_msg->tier = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "tier"));
+    out_msg->from_s = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "from"));
+    out_msg->max_points = (uint16_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "max"));
+    cJSON_Delete(root);
+    return true;
+}
+
+static bool decode_history_column_json(const cJSON *item, uint8_t *scratch, uint16_t count, int16_t *out)
+{
+    if (!cJSON_IsString(item)) {
+        return false;
+    }
+    size_t len = 0;
+    const char *text = item->valuestring;
+    return mbedtls_base64_decode(scratch, PROTO_HISTORY_COLUMN_MAX, &len, (const unsigned char *)text,
+                                 strlen(text)) == 0 &&
+           decode_history_column(scratch, len, count, out);
+}
+
+bool proto_decode_history(const uint8_t *payload, size_t payload_len, bool is_cbor, proto_history_t *out_msg,
+                          uint32_t expected_crc32)
+{
+    if (!payload || !out_msg) {
+        return false;
+    }
+    if (expected_crc32 != 0 && proto_crc32(payload, payload_len) != expected_crc32) {
+        ESP_LOGW(TAG, "History CRC mismatch");
+        return false;
+    }
+    memset(out_msg, 0, sizeof(*out_msg));
+    uint8_t column[PROTO_HISTORY_COLUMN_MAX];
+
+#if CONFIG_USE_CBOR
+    if (is_cbor) {
+        /* Map keys are unordered: remember where each column is and decode it once "n" is known. */
+        uint64_t count = UINT64_MAX;
+        unsigned columns = 0;
+        CborValue column_at[3];
+        CborParser parser;
+        CborValue root;
+        CborValue map;
+        if (cbor_parser_init(payload, payload_len, 0, &parser, &root) != CborNoError || !cbor_value_is_map(&root) ||
+            cbor_value_enter_container(&root, &map) != CborNoError) {
+            return false;
+        }
+        bool is_history = false;
+        while (!cbor_value_at_end(&map)) {
+            char key[16] = {0};
+            size_t key_len = sizeof(key) - 1;
+            if (cbor_value_copy_text_string(&map, key, &key_len, &map) != CborNoError) {
+                return false;
+            }
+            if (!strcmp(key, "type")) {
+                char type[16] = {0};
+                size_t type_len = sizeof(type) - 1;
+                if (cbor_value_copy_text_string(&map, type, &type_len, &map) != CborNoError) {
+                    return false;
+                }
+                is_history = !strcmp(type, "hist");
+                continue;
+            }
+            if (!strcmp(key, "min") || !strcmp(key, "max") || !strcmp(key, "mean")) {
+                size_t col = key[1] == 'i' ? 0 : key[1] == 'a' ? 1 : 2;
+                if (!cbor_value_is_byte_string(&map)) {
+                    return false;
+                }
+                column_at[col] = map;
+                columns |= 1U << col;
+                cbor_value_advance(&map);
+                continue;
+            }
+            if (!strcmp(key, "more")) {
+                bool more = false;
+                cbor_value_get_boolean(&map, &more);
+                out_msg->more = more;
+                cbor_value_advance(&map);
+                continue;
+            }
+            uint64_t val = 0;
+            if (cbor_value_is_unsigned_integer(&map)) {
+                cbor_value_get_uint64(&map, &val);
+            }
+            if (!strcmp(key, "seq")) {
+                out_msg->sequence_id = (uint32_t)val;
+            } else if (!strcmp(key, "ch")) {
+                out_msg->channel = (uint8_t)val;
+            } else if (!strcmp(key, "tier")) {
+                out_msg->tier = (uint8_t)val;
+            } else if (!strcmp(key, "now")) {
+                out_msg->now_s = (uint32_t)val;
+            } else if (!strcmp(key, "period")) {
+                out_msg->period_s = (uint32_t)val;
+            } else if (!strcmp(key, "start")) {
+                out_msg->start_s = (uint32_t)val;
+            } else if (!strcmp(key, "n")) {
+                count = val;
+            }
+            cbor_value_advance(&map);
+        }
+        if (!is_history || columns != 0x7U || count > PROTO_MAX_HISTORY_POINTS) {
+            return false;
+        }
+        int16_t *outs[3] = {out_msg->min, out_msg->max, out_msg->mean};
+        for (size_t col = 0; col < 3; ++col) {
+            size_t len = sizeof(column);
+            if (cbor_value_copy_byte_string(&column_at[col], column, &len, NULL) != CborNoError ||
+                !decode_history_column(column, len, (uint16_t)count, outs[col])) {
+                return false;
+            }
+        }
+        out_msg->count = (uint16_t)count;
+        return true;
+    }
+#else
+    (void)is_cbor;
+#endif
+
+    cJSON *root = cJSON_ParseWithLengthOpts((const char *)payload, payload_len, NULL, false);
+    if (!root) {
+        return false;
+    }
+    const cJSON *type = cJSON_GetObjectItem(root, "type");
+    const cJSON *n = cJSON_GetObjectItem(root, "n");
+    double points = cJSON_IsNumber(n) ? cJSON_GetNumberValue(n) : -1.0;
+    bool ok = cJSON_IsString(type) && strcmp(type->valuestring, "hist") == 0 && points >= 0 &&
+              points <= PROTO_MAX_HISTORY_POINTS;
+    if (ok) {
+        out_msg->count = (uint16_t)points;
+        ok = decode_history_column_json(cJSON_GetObjectItem(root, "min"), column, out_msg->count, out_msg->min) &&
+             decode_history_column_json(cJSON_GetObjectItem(root, "max"), column, out_msg->count, out_msg->max) &&
+             decode_history_column_json(cJSON_GetObjectItem(root, "mean"), column, out_msg->count, out_msg->mean);
+    }
+    if (ok) {
+        out_msg->sequence_id = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "seq"));
+        out_msg->channel = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "ch"));
+        out_msg->tier = (uint8_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "tier"));
+        out_msg->now_s = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "now"));
+        out_msg->period_s = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "period"));
+        out_msg->start_s = (uint32_t)cJSON_GetNumberValue(cJSON_GetObjectItem(root, "start"));
+        out_msg->more = cJSON_IsTrue(cJSON_GetObjectItem(root, "more"));
+    }
+    cJSON_Delete(root);
+    return ok;
+}
+
+static proto_msg_type_t msg_type_from_string(const char *type, size_t len)
+{
+    if (len == strlen("sensor_update") && !memcmp(type, "sensor_update", len)) {
+        return PROTO_MSG_SENSOR_UPDATE;
+    }
+    if (len == strlen("sensor_replay") && !memcmp(type, "sensor_replay", len)) {
+        return PROTO_MSG_SENSOR_REPLAY;
+    }
+    if (len == strlen("cmd") && !memcmp(type, "cmd", len)) {
+        return PROTO_MSG_COMMAND;
+    }
+    if (len == strlen("ack") && !memcmp(type, "ack", len)) {
+        return PROTO_MSG_COMMAND_ACK;
+    }
+    if (len == strlen("hist_req") && !memcmp(type, "hist_req", len)) {
+        return PROTO_MSG_HISTORY_REQUEST;
+    }
+    if (len == strlen("hist") && !memcmp(type, "hist", len)) {
+        return PROTO_MSG_HISTORY;
+    }
+    return PROTO_MSG_UNKNOWN;
+}
+
+static bool json_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/** @brief Index of the quote closing a string whose contents start at @p i, or @p len if unterminated. */
+static size_t json_skip_string(const char *json, size_t len, size_t i)
+{
+    while (i < len && json[i] != '"') {
+        i += json[i] == '\\' ? 2 : 1;
+    }
+    return i < len ? i : len;
+}
+
+/**
+ * @brief Locate the value of the top-level "type" member without building a tree.
+ *
+ * Strings are skipped whole and nesting is tracked, so a "type" key inside a
+ * nested object or a string value is never mistaken for the message type.
+ */
+static bool json_find_type(const char *json, size_t len, const char **value, size_t *value_len)
+{
+    size_t depth = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char c = json[i];
+        if (c == '{' || c == '[') {
+            ++depth;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            if (depth <= 1) {
+                return false;
+            }
+            --depth;
+            continue;
+        }
+        if (c != '"') {
+            continue;
+        }
+        size_t start = i + 1;
+        i = json_skip_string(json, len, start);
+        if (i == len) {
+            return false;
+        }
+        if (depth != 1) {
+            continue;
+        }
+        size_t next = i + 1;
+        while (next < len && json_is_space(json[next])) {
+            ++next;
+        }
+        if (next == len || json[next] != ':') {
+            continue; /* A string value, not a key. */
+        }
+        if (i - start != 4 || memcmp(&json[start], "type", 4) != 0) {
+            i = next;
+            continue;
+        }
+        ++next;
+        while (next < len && json_is_space(json[next])) {
+            ++next;
+        }
+        if (next == len || json[next] != '"') {
+            return false;
+        }
+        size_t close = json_skip_string(json, len, next + 1);
+        if (close == len) {
+            return false;
+        }
+        *value = &json[next + 1];
+        *value_len = close - (next + 1);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Classify a payload without decoding it.
+ *
+ * Only the top-level keys are walked, and the walk stops at "type"; every encoder
+ * emits it right after the version key, so dispatch stays cheap for the large
+ * sensor updates while payloads from other encoders (any key order, any
+ * whitespace) are classified too.
+ */
+proto_msg_type_t proto_peek_type(const uint8_t *payload, size_t payload_len, bool is_cbor)
+{
+    if (!payload || payload_len == 0) {
+        return PROTO_MSG_UNKNOWN;
+    }
+#if CONFIG_USE_CBOR
+    if (is_cbor) {
+        CborParser parser;
+        CborValue root;
+        CborValue map;
+        if (cbor_parser_init(payload, payload_len, 0, &parser, &root) != CborNoError || !cbor_value_is_map(&root) ||
+            cbor_value_enter_container(&root, &map) != CborNoError) {
+            return PROTO_MSG_UNKNOWN;
+        }
+        while (!cbor_value_at_end(&map)) {
+            bool is_type = false;
+            if (cbor_value_text_string_equals(&map, "type", &is_type) != CborNoError ||
+                cbor_value_advance(&map) != CborNoError) {
+                return PROTO_MSG_UNKNOWN;
+            }
+            if (is_type) {
+                char type[16] = {0};
+                size_t type_len = sizeof(type) - 1;
+                if (cbor_value_copy_text_string(&map, type, &type_len, NULL) != CborNoError) {
+                    return PROTO_MSG_UNKNOWN;
+                }
+                return msg_type_from_string(type, type_len);
+            }
+            if (cbor_value_advance(&map) != CborNoError) {
+                return PROTO_MSG_UNKNOWN;
+            }
+        }
+        return PROTO_MSG_UNKNOWN;
+    }
+#else
+    (void)is_cbor;
+#endif
+    const char *type = NULL;
+    size_t type_len = 0;
+    if (!json_find_type((const char *)payload, payload_len, &type, &type_len)) {
+        return PROTO_MSG_UNKNOWN;
+    }
+    return msg_type_from_string(type, type_len);
+}
@@ -4,18 +4,47 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define PROTO_MAX_COMMAND_SIZE 512U
+#include "ts_codec.h"
+
+#define PROTO_MAX_COMMAND_SIZE 1024U
+#define PROTO_MAX_PWM_UPDATES 16U
+#define PROTO_MAX_GPIO_WRITES 4U
+#define PROTO_MAX_ACK_SIZE 96U
+#define PROTO_MAX_HISTORY_REQUEST_SIZE 128U
+#define PROTO_MAX_HISTORY_SIZE 1792U
+#define PROTO_MAX_HISTORY_POINTS 128U
+#define PROTO_HISTORY_NONE INT16_MIN /* bucket without samples */
+#define PROTO_HISTORY_COLUMN_MAX TS_CODEC_FIXED_MAX_BYTES(PROTO_MAX_HISTORY_POINTS)
+
+typedef enum {
+    PROTO_MSG_UNKNOWN = 0,
+    PROTO_MSG_SENSOR_UPDATE,
+    PROTO_MSG_COMMAND,
+    PROTO_MSG_COMMAND_ACK,
+    PROTO_MSG_HISTORY_REQUEST,
+    PROTO_MSG_HISTORY,
+    PROTO_MSG_SENSOR_REPLAY, /* journaled past state, not the current one */
+} proto_msg_type_t;
+
+typedef enum {
+    PROTO_ACK_OK = 0,        /* command applied */
+    PROTO_ACK_DUPLICATE = 1, /* already applied, retransmit suppressed */
+    PROTO_ACK_BUSY = 2,      /* actuator queue full, retransmit later */
+} proto_ack_status_t;
 
 typedef struct {
     char id[16];
     float temperature_c;
     float humidity_percent;
+    float pressure_pa; /* 0 when the ambient sensor has no barometer */
+    uint32_t sample_ms; /* monotonic time the reading was taken; 0 when unknown */
     bool valid;
 } proto_sht20_reading_t;
 
 typedef struct {
     uint8_t rom_code[8];
     float temperature_c;
+    uint32_t sample_ms; /* monotonic time the conversion started; 0 when unknown */
 } proto_ds18b20_reading_t;
 
 typedef struct {
@@ -39,31 +68,119 @@ typedef struct {
     proto_pca9685_state_t pwm;
 } proto_sensor_update_t;
 
+typedef struct {
+    uint8_t channel;
+    uint16_t duty_cycle;
+} proto_pwm_update_t;
+
+typedef struct {
+    uint8_t device_index;
+    uint8_t port; /* 0 -> A, 1 -> B */
+    uint16_t mask;
+    uint16_t value;
+} proto_gpio_write_t;
+
+/*
+ * A command may batch several actuator updates. On the wire a single entry keeps the
+ * original object form ("set_pwm":{...}); two or more are sent as an array.
+ */
 typedef struct {
     uint32_t timestamp_ms;
     uint32_t sequence_id;
-    bool has_pwm_update;
-    struct {
-        uint8_t channel;
-        uint16_t duty_cycle;
-    } pwm_update;
+    size_t pwm_update_count;
+    proto_pwm_update_t pwm_updates[PROTO_MAX_PWM_UPDATES];
     bool has_pwm_frequency;
     uint16_t pwm_frequency;
-    bool has_gpio_write;
-    struct {
-        uint8_t device_index;
-        uint8_t port; /* 0 -> A, 1 -> B */
-        uint16_t mask;
-        uint16_t value;
-    } gpio_write;
+    size_t gpio_write_count;
+    proto_gpio_write_t gpio_writes[PROTO_MAX_GPIO_WRITES];
 } proto_command_t;
 
+typedef struct {
+    uint32_t timestamp_ms;
+    uint32_t sequence_id; /* sequence_id of the acknowledged command */
+    uint8_t status;       /* proto_ack_status_t */
+} proto_command_ack_t;
+
+/*
+ * History channels and their fixed-point units. Values travel as int16 in these
+ * units so a page stays small and the sensor stores them without conversion.
+ */
+typedef enum {
+    PROTO_HISTORY_CH_AMBIENT_TEMP_0 = 0, /* 0.01 °C */
+    PROTO_HISTORY_CH_AMBIENT_TEMP_1,
+    PROTO_HISTORY_CH_AMBIENT_HUMIDITY_0, /* 0.01 %RH */
+    PROTO_HISTORY_CH_AMBIENT_HUMIDITY_1,
+    PROTO_HISTORY_CH_AMBIENT_PRESSURE_0, /* 10 Pa */
+    PROTO_HISTORY_CH_AMBIENT_PRESSURE_1,
+    PROTO_HISTORY_CH_DS18B20_0, /* 0.01 °C */
+    PROTO_HISTORY_CH_DS18B20_1,
+    PROTO_HISTORY_CH_DS18B20_2,
+    PROTO_HISTORY_CH_DS18B20_3,
+    PROTO_HISTORY_CHANNEL_COUNT,
+} proto_history_channel_t;
+
+typedef enum {
+    PROTO_HISTORY_TIER_RAW = 0,
+    PROTO_HISTORY_TIER_MINUTE,
+    PROTO_HISTORY_TIER_HOUR,
+    PROTO_HISTORY_TIER_COUNT,
+} proto_history_tier_t;
+
+/*
+ * Ask for up to max_points buckets of one channel and tier, starting with the
+ * bucket that contains from_s (sensor uptime seconds; 0 = oldest kept).
+ */
+typedef struct {
+    uint32_t sequence_id; /* echoed in the response so a client can match pages */
+    uint8_t channel;      /* proto_history_channel_t */
+    uint8_t tier;         /* proto_history_tier_t */
+    uint32_t from_s;
+    uint16_t max_points;
+} proto_history_request_t;
+
+/*
+ * One page of consecutive buckets, column by column. Bucket i covers
+ * [start_s + i * period_s, start_s + (i + 1) * period_s); now_s is the sensor
+ * uptime when the page was served, so a client can place the buckets on its own
+ * clock. Continue from start_s + count * period_s while more is set.
+ *
+ * On the wire "n" carries count and each column is one ts_codec fixed-point
+ * stream: base64 in JSON, a byte string in CBOR.
+ */
+typedef struct {
+    uint32_t sequence_id;
+    uint8_t channel;
+    uint8_t tier;
+    uint32_t now_s;
+    uint32_t period_s;
+    uint32_t start_s;
+    bool more;
+    uint16_t count;
+    int16_t min[PROTO_MAX_HISTORY_POINTS];
+    int16_t max[PROTO_MAX_HISTORY_POINTS];
+    int16_t mean[PROTO_MAX_HISTORY_POINTS];
+} proto_history_t;
+
 bool proto_encode_sensor_update_into(const proto_sensor_update_t *msg, bool use_cbor, uint8_t *buffer,
                                      size_t *buffer_len, uint32_t *crc32);
+bool proto_encode_sensor_replay_into(const proto_sensor_update_t *msg, bool use_cbor, uint8_t *buffer,
+                                     size_t *buffer_len, uint32_t *crc32);
 bool proto_encode_command_into(const proto_command_t *msg, bool use_cbor, uint8_t *buffer,
                                size_t *buffer_len, uint32_t *crc32);
+bool proto_encode_command_ack_into(const proto_command_ack_t *msg, bool use_cbor, uint8_t *buffer,
+                                   size_t *buffer_len, uint32_t *crc32);
+bool proto_encode_history_request_into(const proto_history_request_t *msg, bool use_cbor, uint8_t *buffer,
+                                       size_t *buffer_len, uint32_t *crc32);
+bool proto_encode_history_into(const proto_history_t *msg, bool use_cbor, uint8_t *buffer, size_t *buffer_len,
+                               uint32_t *crc32);
 bool proto_decode_command(const uint8_t *payload, size_t payload_len, bool is_cbor,
                           proto_command_t *out_msg, uint32_t expected_crc32);
 bool proto_decode_sensor_update(const uint8_t *payload, size_t payload_len, bool is_cbor,
                                 proto_sensor_update_t *out_msg, uint32_t expected_crc32);
-
+bool proto_decode_command_ack(const uint8_t *payload, size_t payload_len, bool is_cbor,
+                              proto_command_ack_t *out_msg, uint32_t expected_crc32);
+bool proto_decode_history_request(const uint8_t *payload, size_t payload_len, bool is_cbor,
+                                  proto_history_request_t *out_msg, uint32_t expected_crc32);
+bool proto_decode_history(const uint8_t *payload, size_t payload_len, bool is_cbor, proto_history_t *out_msg,
+                          uint32_t expected_crc32);
+proto_msg_type_t proto_peek_type(const uint8_t *payload, size_t payload_len, bool is_cbor);
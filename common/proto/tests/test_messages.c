@@ -1,8 +1,13 @@
 #include "messages.h"
 
+#include "sdkconfig.h"
 #include "unity.h"
 #include <string.h>
 
+#if CONFIG_USE_CBOR
+#include "tinycbor/cbor.h"
+#endif
+
 TEST_CASE("proto encode/decode sensor update json", "[proto]")
 {
     proto_sensor_update_t update = {
@@ -39,25 +44,77 @@ TEST_CASE("proto encode/decode sensor update json", "[proto]")
     TEST_ASSERT_EQUAL_UINT16(update.mcp[0].port_a, decoded.mcp[0].port_a);
 }
 
+TEST_CASE("proto carries ambient pressure only when measured", "[proto]")
+{
+    proto_sensor_update_t update = {
+        .sht20_count = 2,
+    };
+    strcpy(update.sht20[0].id, "BME280_1");
+    update.sht20[0].temperature_c = 21.0f;
+    update.sht20[0].humidity_percent = 40.0f;
+    update.sht20[0].pressure_pa = 100653.3f;
+    update.sht20[0].valid = true;
+    strcpy(update.sht20[1].id, "SHT20_2");
+    update.sht20[1].valid = true;
+
+    uint8_t buffer[512];
+    size_t len = sizeof(buffer) - 1;
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_sensor_update_into(&update, false, buffer, &len, &crc));
+    buffer[len] = '\0';
+    TEST_ASSERT_NOT_NULL(strstr((const char *)buffer, "\"p\":100653.3"));
+    TEST_ASSERT_NULL(strstr(strstr((const char *)buffer, "SHT20_2"), "\"p\""));
+
+    proto_sensor_update_t decoded = {0};
+    TEST_ASSERT_TRUE(proto_decode_sensor_update(buffer, len, false, &decoded, crc));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 100653.3f, decoded.sht20[0].pressure_pa);
+    TEST_ASSERT_EQUAL(0.0f, decoded.sht20[1].pressure_pa);
+}
+
+TEST_CASE("proto carries per-reading sample timestamps", "[proto]")
+{
+    proto_sensor_update_t update = {
+        .timestamp_ms = 5000,
+        .sht20_count = 1,
+        .ds18b20_count = 2,
+    };
+    strcpy(update.sht20[0].id, "SHT20_1");
+    update.sht20[0].valid = true;
+    update.sht20[0].sample_ms = 4810;
+    update.ds18b20[0].sample_ms = 4250;
+
+    uint8_t buffer[512];
+    size_t len = sizeof(buffer) - 1;
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_sensor_update_into(&update, false, buffer, &len, &crc));
+    buffer[len] = '\0';
+    TEST_ASSERT_NOT_NULL(strstr((const char *)buffer, "\"ts\":4810"));
+    const char *ds_ts = strstr((const char *)buffer, "\"ts\":4250");
+    TEST_ASSERT_NOT_NULL(ds_ts);
+    TEST_ASSERT_NULL(strstr(ds_ts + 1, "\"ts\""));
+
+    proto_sensor_update_t decoded = {0};
+    TEST_ASSERT_TRUE(proto_decode_sensor_update(buffer, len, false, &decoded, crc));
+    TEST_ASSERT_EQUAL_UINT32(5000, decoded.timestamp_ms);
+    TEST_ASSERT_EQUAL_UINT32(4810, decoded.sht20[0].sample_ms);
+    TEST_ASSERT_EQUAL_UINT32(4250, decoded.ds18b20[0].sample_ms);
+    TEST_ASSERT_EQUAL_UINT32(0, decoded.ds18b20[1].sample_ms);
+}
+
 TEST_CASE("proto encode/decode command json", "[proto]")
 {
     proto_command_t cmd = {
         .timestamp_ms = 4321,
         .sequence_id = 7,
-        .has_pwm_update = true,
-        .pwm_update = {
-            .channel = 2,
-            .duty_cycle = 2048,
+        .pwm_update_count = 1,
+        .pwm_updates = {
+            {.channel = 2, .duty_cycle = 2048},
         },
         .has_pwm_frequency = true,
         .pwm_frequency = 800,
-        .has_gpio_write = true,
-        .gpio_write = {
-            .device_index = 1,
-            .port = 1,
-            .port = 0,
-            .mask = 0x03,
-            .value = 0x02,
+        .gpio_write_count = 1,
+        .gpio_writes = {
+            {.device_index = 1, .port = 1, .mask = 0x03, .value = 0x02},
         },
     };
     uint8_t buffer[256];
@@ -66,9 +123,294 @@ TEST_CASE("proto encode/decode command json", "[proto]")
     TEST_ASSERT_TRUE(proto_encode_command_into(&cmd, false, buffer, &len, &crc));
     proto_command_t decoded = {0};
     TEST_ASSERT_TRUE(proto_decode_command(buffer, len, false, &decoded, crc));
-    TEST_ASSERT_EQUAL_UINT8(cmd.pwm_update.channel, decoded.pwm_update.channel);
+    TEST_ASSERT_EQUAL(1, decoded.pwm_update_count);
+    TEST_ASSERT_EQUAL_UINT8(cmd.pwm_updates[0].channel, decoded.pwm_updates[0].channel);
     TEST_ASSERT_EQUAL_UINT16(cmd.pwm_frequency, decoded.pwm_frequency);
-    TEST_ASSERT_TRUE(decoded.has_gpio_write);
-    TEST_ASSERT_EQUAL_UINT8(1, decoded.gpio_write.port);
-    TEST_ASSERT_EQUAL_UINT16(cmd.gpio_write.value, decoded.gpio_write.value);
+    TEST_ASSERT_EQUAL(1, decoded.gpio_write_count);
+    TEST_ASSERT_EQUAL_UINT8(1, decoded.gpio_writes[0].port);
+    TEST_ASSERT_EQUAL_UINT16(cmd.gpio_writes[0].value, decoded.gpio_writes[0].value);
+    // A single entry keeps the object form understood by older peers.
+    TEST_ASSERT_NOT_NULL(strstr((const char *)buffer, "\"set_pwm\":{"));
+}
+
+TEST_CASE("proto encode/decode batched command json", "[proto]")
+{
+    proto_command_t cmd = {
+        .sequence_id = 8,
+        .pwm_update_count = 3,
+        .pwm_updates = {
+            {.channel = 0, .duty_cycle = 1},
+            {.channel = 9, .duty_cycle = 4095},
+            {.channel = 15, .duty_cycle = 300},
+        },
+        .gpio_write_count = 2,
+        .gpio_writes = {
+            {.device_index = 0, .port = 0, .mask = 0x81, .value = 0x01},
+            {.device_index = 1, .port = 1, .mask = 0xFF, .value = 0xA5},
+        },
+    };
+    uint8_t buffer[PROTO_MAX_COMMAND_SIZE];
+    size_t len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_command_into(&cmd, false, buffer, &len, &crc));
+    proto_command_t decoded = {0};
+    TEST_ASSERT_TRUE(proto_decode_command(buffer, len, false, &decoded, crc));
+    TEST_ASSERT_EQUAL(3, decoded.pwm_update_count);
+    TEST_ASSERT_EQUAL_UINT8(9, decoded.pwm_updates[1].channel);
+    TEST_ASSERT_EQUAL_UINT16(300, decoded.pwm_updates[2].duty_cycle);
+    TEST_ASSERT_FALSE(decoded.has_pwm_frequency);
+    TEST_ASSERT_EQUAL(2, decoded.gpio_write_count);
+    TEST_ASSERT_EQUAL_UINT8(1, decoded.gpio_writes[1].device_index);
+    TEST_ASSERT_EQUAL_UINT8(1, decoded.gpio_writes[1].port);
+    TEST_ASSERT_EQUAL_UINT16(0xA5, decoded.gpio_writes[1].value);
+}
+
+TEST_CASE("proto encode/decode command ack json", "[proto]")
+{
+    proto_command_ack_t ack = {
+        .timestamp_ms = 99,
+        .sequence_id = 0xFFFFFFF0u,
+        .status = PROTO_ACK_BUSY,
+    };
+    uint8_t buffer[PROTO_MAX_ACK_SIZE];
+    size_t len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_command_ack_into(&ack, false, buffer, &len, &crc));
+    TEST_ASSERT_EQUAL(PROTO_MSG_COMMAND_ACK, proto_peek_type(buffer, len, false));
+
+    proto_command_ack_t decoded = {0};
+    TEST_ASSERT_TRUE(proto_decode_command_ack(buffer, len, false, &decoded, crc));
+    TEST_ASSERT_EQUAL_UINT32(ack.sequence_id, decoded.sequence_id);
+    TEST_ASSERT_EQUAL_UINT8(PROTO_ACK_BUSY, decoded.status);
+}
+
+TEST_CASE("proto encode/decode history request json", "[proto]")
+{
+    proto_history_request_t req = {
+        .sequence_id = 7,
+        .channel = PROTO_HISTORY_CH_DS18B20_2,
+        .tier = PROTO_HISTORY_TIER_MINUTE,
+        .from_s = 86400,
+        .max_points = PROTO_MAX_HISTORY_POINTS,
+    };
+    uint8_t buffer[PROTO_MAX_HISTORY_REQUEST_SIZE];
+    size_t len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_history_request_into(&req, false, buffer, &len, &crc));
+    TEST_ASSERT_EQUAL(PROTO_MSG_HISTORY_REQUEST, proto_peek_type(buffer, len, false));
+
+    proto_history_request_t decoded = {0};
+    TEST_ASSERT_TRUE(proto_decode_history_request(buffer, len, false, &decoded, crc));
+    TEST_ASSERT_EQUAL_UINT32(req.sequence_id, decoded.sequence_id);
+    TEST_ASSERT_EQUAL_UINT8(req.channel, decoded.channel);
+    TEST_ASSERT_EQUAL_UINT8(req.tier, decoded.tier);
+    TEST_ASSERT_EQUAL_UINT32(req.from_s, decoded.from_s);
+    TEST_ASSERT_EQUAL_UINT16(req.max_points, decoded.max_points);
+}
+
+static void fill_worst_case_history(proto_history_t *page)
+{
+    memset(page, 0, sizeof(*page));
+    page->sequence_id = 7;
+    page->channel = PROTO_HISTORY_CH_AMBIENT_PRESSURE_1;
+    page->tier = PROTO_HISTORY_TIER_HOUR;
+    page->now_s = 0xFFFFFFF0u;
+    page->period_s = 3600;
+    page->start_s = 0xFFFF0000u;
+    page->more = true;
+    page->count = PROTO_MAX_HISTORY_POINTS;
+    /* Full-scale swings between buckets are the codec's worst case. */
+    for (uint16_t i = 0; i < page->count; ++i) {
+        page->min[i] = i % 2 ? INT16_MAX : INT16_MIN + 1;
+        page->max[i] = i % 2 ? INT16_MIN + 1 : INT16_MAX;
+        page->mean[i] = (int16_t)(i % 2 ? i * 200 : -i * 200);
+    }
+    page->min[3] = page->max[3] = page->mean[3] = PROTO_HISTORY_NONE;
+}
+
+static void assert_history_equal(const proto_history_t *expected, const proto_history_t *actual)
+{
+    TEST_ASSERT_EQUAL_UINT32(expected->sequence_id, actual->sequence_id);
+    TEST_ASSERT_EQUAL_UINT8(expected->channel, actual->channel);
+    TEST_ASSERT_EQUAL_UINT8(expected->tier, actual->tier);
+    TEST_ASSERT_EQUAL_UINT32(expected->start_s, actual->start_s);
+    TEST_ASSERT_EQUAL_UINT32(expected->period_s, actual->period_s);
+    TEST_ASSERT_EQUAL_UINT32(expected->now_s, actual->now_s);
+    TEST_ASSERT_EQUAL(expected->more, actual->more);
+    TEST_ASSERT_EQUAL_UINT16(expected->count, actual->count);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected->min, actual->min, expected->count);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected->max, actual->max, expected->count);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected->mean, actual->mean, expected->count);
+}
+
+TEST_CASE("proto encode/decode a full history page json", "[proto]")
+{
+    static proto_history_t page;
+    fill_worst_case_history(&page);
+
+    uint8_t buffer[PROTO_MAX_HISTORY_SIZE];
+    size_t len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_history_into(&page, false, buffer, &len, &crc));
+    TEST_ASSERT_EQUAL(PROTO_MSG_HISTORY, proto_peek_type(buffer, len, false));
+
+    static proto_history_t decoded;
+    TEST_ASSERT_TRUE(proto_decode_history(buffer, len, false, &decoded, crc));
+    assert_history_equal(&page, &decoded);
+
+    proto_history_request_t not_a_request;
+    TEST_ASSERT_FALSE(proto_decode_history_request(buffer, len, false, &not_a_request, 0));
+
+    /* Columns holding fewer points than "n" announces are rejected. */
+    const char *short_page = "{\"v\":1,\"type\":\"hist\",\"n\":3,\"min\":\"Aw==\",\"max\":\"Aw==\",\"mean\":\"Aw==\"}";
+    TEST_ASSERT_FALSE(proto_decode_history((const uint8_t *)short_page, strlen(short_page), false, &decoded, 0));
+}
+
+#if CONFIG_USE_CBOR
+TEST_CASE("proto encode/decode a full history page cbor", "[proto]")
+{
+    static proto_history_t page;
+    static proto_history_t decoded;
+    fill_worst_case_history(&page);
+
+    static uint8_t buffer[PROTO_MAX_HISTORY_SIZE];
+    size_t len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_history_into(&page, true, buffer, &len, &crc));
+    TEST_ASSERT_EQUAL(PROTO_MSG_HISTORY, proto_peek_type(buffer, len, true));
+    TEST_ASSERT_TRUE(proto_decode_history(buffer, len, true, &decoded, crc));
+    assert_history_equal(&page, &decoded);
+
+    page.count = 0;
+    page.more = false;
+    len = sizeof(buffer);
+    TEST_ASSERT_TRUE(proto_encode_history_into(&page, true, buffer, &len, &crc));
+    TEST_ASSERT_TRUE(proto_decode_history(buffer, len, true, &decoded, crc));
+    assert_history_equal(&page, &decoded);
+}
+
+TEST_CASE("proto decodes cbor history whatever the key order", "[proto]")
+{
+    const int16_t min[] = {100, 90, PROTO_HISTORY_NONE};
+    const int16_t max[] = {300, 310, PROTO_HISTORY_NONE};
+    const int16_t mean[] = {200, 205, PROTO_HISTORY_NONE};
+    const int16_t *columns[] = {min, max, mean};
+    static const char *const keys[] = {"mean", "max", "min"};
+
+    /* Columns first, "n" last and the header keys shuffled: CBOR maps are unordered. */
+    static uint8_t buffer[PROTO_MAX_HISTORY_SIZE];
+    CborEncoder encoder;
+    CborEncoder map;
+    cbor_encoder_init(&encoder, buffer, sizeof(buffer), 0);
+    TEST_ASSERT_EQUAL(CborNoError, cbor_encoder_create_map(&encoder, &map, 11));
+    for (size_t i = 0; i < 3; ++i) {
+        uint8_t column[PROTO_HISTORY_COLUMN_MAX];
+        size_t column_len = sizeof(column);
+        TEST_ASSERT_TRUE(ts_codec_encode_fixed(columns[2 - i], 3, column, &column_len));
+        TEST_ASSERT_EQUAL(CborNoError, cbor_encode_text_stringz(&map, keys[i]));
+        TEST_ASSERT_EQUAL(CborNoError, cbor_encode_byte_string(&map, column, column_len));
+    }
+    cbor_encode_text_stringz(&map, "more");
+    cbor_encode_boolean(&map, false);
+    cbor_encode_text_stringz(&map, "start");
+    cbor_encode_uint(&map, 600);
+    cbor_encode_text_stringz(&map, "type");
+    cbor_encode_text_stringz(&map, "hist");
+    cbor_encode_text_stringz(&map, "period");
+    cbor_encode_uint(&map, 60);
+    cbor_encode_text_stringz(&map, "seq");
+    cbor_encode_uint(&map, 11);
+    cbor_encode_text_stringz(&map, "ch");
+    cbor_encode_uint(&map, PROTO_HISTORY_CH_DS18B20_2);
+    cbor_encode_text_stringz(&map, "v");
+    cbor_encode_uint(&map, 1);
+    cbor_encode_text_stringz(&map, "n");
+    cbor_encode_uint(&map, 3);
+    TEST_ASSERT_EQUAL(CborNoError, cbor_encoder_close_container(&encoder, &map));
+    size_t len = cbor_encoder_get_buffer_size(&encoder, buffer);
+
+    static proto_history_t decoded;
+    TEST_ASSERT_TRUE(proto_decode_history(buffer, len, true, &decoded, 0));
+    TEST_ASSERT_EQUAL_UINT32(11, decoded.sequence_id);
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_CH_DS18B20_2, decoded.channel);
+    TEST_ASSERT_EQUAL_UINT32(600, decoded.start_s);
+    TEST_ASSERT_EQUAL_UINT16(3, decoded.count);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(min, decoded.min, 3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(max, decoded.max, 3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(mean, decoded.mean, 3);
+
+    /* A count the columns cannot satisfy is still rejected. */
+    buffer[len - 1] = 4;
+    TEST_ASSERT_FALSE(proto_decode_history(buffer, len, true, &decoded, 0));
+}
+#endif
+
+TEST_CASE("proto peeks message types without decoding", "[proto]")
+{
+    proto_sensor_update_t update = {.sequence_id = 1};
+    uint8_t buffer[512];
+    size_t len = sizeof(buffer);
+    TEST_ASSERT_TRUE(proto_encode_sensor_update_into(&update, false, buffer, &len, NULL));
+    TEST_ASSERT_EQUAL(PROTO_MSG_SENSOR_UPDATE, proto_peek_type(buffer, len, false));
+
+    update.sequence_id = 9;
+    len = sizeof(buffer);
+    uint32_t crc = 0;
+    TEST_ASSERT_TRUE(proto_encode_sensor_replay_into(&update, false, buffer, &len, &crc));
+    TEST_ASSERT_EQUAL(PROTO_MSG_SENSOR_REPLAY, proto_peek_type(buffer, len, false));
+    proto_sensor_update_t replayed = {0};
+    TEST_ASSERT_TRUE(proto_decode_sensor_update(buffer, len, false, &replayed, crc));
+    TEST_ASSERT_EQUAL_UINT32(9, replayed.sequence_id);
+
+    proto_command_t cmd = {.sequence_id = 2};
+    len = sizeof(buffer);
+    TEST_ASSERT_TRUE(proto_encode_command_into(&cmd, false, buffer, &len, NULL));
+    TEST_ASSERT_EQUAL(PROTO_MSG_COMMAND, proto_peek_type(buffer, len, false));
+
+    proto_command_ack_t decoded = {0};
+    TEST_ASSERT_FALSE(proto_decode_command_ack(buffer, len, false, &decoded, 0));
+
+    const uint8_t garbage[] = "{\"v\":1}";
+    TEST_ASSERT_EQUAL(PROTO_MSG_UNKNOWN, proto_peek_type(garbage, sizeof(garbage) - 1, false));
+}
+
+TEST_CASE("proto peeks the type whatever the key order and spacing", "[proto]")
+{
+    static const struct {
+        const char *json;
+        proto_msg_type_t type;
+    } cases[] = {
+        {"{\"seq\":5,\"ch\":2,\"tier\":0,\"from\":0,\"max\":128,\"v\":1,\"type\":\"hist_req\"}",
+         PROTO_MSG_HISTORY_REQUEST},
+        {"{ \"v\" : 1 ,\n  \"type\" :\t\"sensor_replay\" }", PROTO_MSG_SENSOR_REPLAY},
+        {"{\"meta\":{\"type\":\"cmd\"},\"note\":\"type\",\"tags\":[\"type\",\"ack\"],\"type\":\"ack\"}",
+         PROTO_MSG_COMMAND_ACK},
+        {"{\"id\":\"say \\\"type\\\":\\\"cmd\\\"\",\"type\":\"hist\"}", PROTO_MSG_HISTORY},
+        {"{\"meta\":{\"type\":\"cmd\"}}", PROTO_MSG_UNKNOWN},
+        {"{\"type\":\"sensor_upd", PROTO_MSG_UNKNOWN},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        TEST_ASSERT_EQUAL(cases[i].type,
+                          proto_peek_type((const uint8_t *)cases[i].json, strlen(cases[i].json), false));
+    }
+
+#if CONFIG_USE_CBOR
+    /* A leading non-text key and a long key before "type" must not stop the scan. */
+    uint8_t buffer[64];
+    CborEncoder encoder;
+    CborEncoder map;
+    cbor_encoder_init(&encoder, buffer, sizeof(buffer), 0);
+    TEST_ASSERT_EQUAL(CborNoError, cbor_encoder_create_map(&encoder, &map, 4));
+    cbor_encode_uint(&map, 7);
+    cbor_encode_uint(&map, 1);
+    cbor_encode_text_stringz(&map, "sequence_number");
+    cbor_encode_uint(&map, 5);
+    cbor_encode_text_stringz(&map, "v");
+    cbor_encode_uint(&map, 1);
+    cbor_encode_text_stringz(&map, "type");
+    cbor_encode_text_stringz(&map, "hist_req");
+    TEST_ASSERT_EQUAL(CborNoError, cbor_encoder_close_container(&encoder, &map));
+    size_t len = cbor_encoder_get_buffer_size(&encoder, buffer);
+    TEST_ASSERT_EQUAL(PROTO_MSG_HISTORY_REQUEST, proto_peek_type(buffer, len, true));
+#endif
 }
@@ -0,0 +1,224 @@
+#include "ts_codec.h"
+
+#include "esp_timer.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_POINTS 4096U
+
+static uint32_t s_rng = 0x12345678u;
+
+static uint32_t next_random(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return s_rng >> 8;
+}
+
+/* A sensor-node-like trace: 1 s samples with scheduling jitter, a slow
+ * temperature drift with sensor noise, and a GPIO port that rarely toggles. */
+static uint32_t s_stamps[TRACE_POINTS];
+static float s_temps[TRACE_POINTS];
+static int16_t s_fixed[TRACE_POINTS];
+static uint16_t s_gpio[TRACE_POINTS];
+
+static void build_trace(void)
+{
+    uint32_t t = 0xFFFF0000u; /* wraps part way through */
+    uint16_t gpio = 0x00A5;
+    for (size_t i = 0; i < TRACE_POINTS; ++i) {
+        uint32_t r = next_random();
+        t += 1000U + (r % 8U == 0 ? r % 5U : 0U);
+        s_stamps[i] = t;
+        float temp = 21.0f + 3.0f * sinf((float)i / 600.0f) + (float)((int)(r >> 4) % 5 - 2) * 0.01f;
+        s_temps[i] = roundf(temp * 100.0f) / 100.0f;
+        s_fixed[i] = (int16_t)lroundf(temp * 100.0f);
+        if (r % 97U == 0) {
+            gpio ^= (uint16_t)(1U << (r % 16U));
+        }
+        s_gpio[i] = gpio;
+    }
+    s_fixed[100] = TS_CODEC_FIXED_NONE;
+}
+
+static uint8_t s_buffer[TS_CODEC_FLOATS_MAX_BYTES(TRACE_POINTS)];
+
+TEST_CASE("ts_codec round-trips timestamps, wraps and irregular steps included", "[ts_codec]")
+{
+    const uint32_t stamps[] = {UINT32_MAX - 2, UINT32_MAX, 1, 3, 5, 7, 7, 70000, 70001, 0, UINT32_MAX, 12};
+    const size_t count = sizeof(stamps) / sizeof(stamps[0]);
+    size_t len = TS_CODEC_TIMESTAMPS_MAX_BYTES(count);
+    TEST_ASSERT_TRUE(ts_codec_encode_timestamps(stamps, count, s_buffer, &len));
+    TEST_ASSERT_LESS_OR_EQUAL_size_t(TS_CODEC_TIMESTAMPS_MAX_BYTES(count), len);
+
+    uint32_t decoded[12];
+    size_t consumed = len;
+    TEST_ASSERT_TRUE(ts_codec_decode_timestamps(s_buffer, &consumed, decoded, count));
+    TEST_ASSERT_EQUAL_size_t(len, consumed);
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(stamps, decoded, count);
+
+    /* A steady period costs one bit per sample after the first two. */
+    uint32_t steady[65];
+    for (size_t i = 0; i < 65; ++i) {
+        steady[i] = 500U + (uint32_t)i * 5U;
+    }
+    len = sizeof(s_buffer);
+    TEST_ASSERT_TRUE(ts_codec_encode_timestamps(steady, 65, s_buffer, &len));
+    TEST_ASSERT_EQUAL_size_t((32U + 9U + 63U + 7U) / 8U, len);
+
+    consumed = len - 1U;
+    TEST_ASSERT_FALSE(ts_codec_decode_timestamps(s_buffer, &consumed, steady, 65));
+    len = 4;
+    TEST_ASSERT_FALSE(ts_codec_encode_timestamps(stamps, count, s_buffer, &len));
+}
+
+TEST_CASE("ts_codec round-trips float bit patterns exactly", "[ts_codec]")
+{
+    const float values[] = {21.5f, 21.5f, 21.51f, -0.0f, 0.0f, NAN, INFINITY, -INFINITY, 1e-38f, 3.4e38f, 21.5f};
+    const size_t count = sizeof(values) / sizeof(values[0]);
+    size_t len = TS_CODEC_FLOATS_MAX_BYTES(count);
+    TEST_ASSERT_TRUE(ts_codec_encode_floats(values, count, s_buffer, &len));
+
+    float decoded[11];
+    size_t consumed = len;
+    TEST_ASSERT_TRUE(ts_codec_decode_floats(s_buffer, &consumed, decoded, count));
+    TEST_ASSERT_EQUAL_size_t(len, consumed);
+    TEST_ASSERT_EQUAL_MEMORY(values, decoded, sizeof(values));
+
+    /* A reused window before any window was sent is malformed. */
+    const uint8_t bogus[] = {0x00, 0x00, 0x00, 0x00, 0x80, 0x00};
+    consumed = sizeof(bogus);
+    TEST_ASSERT_FALSE(ts_codec_decode_floats(bogus, &consumed, decoded, 2));
+}
+
+TEST_CASE("ts_codec round-trips fixed point with gaps and rejects out-of-range deltas", "[ts_codec]")
+{
+    const int16_t values[] = {TS_CODEC_FIXED_NONE, INT16_MAX, INT16_MIN + 1, TS_CODEC_FIXED_NONE, 0, -1, 1, 2153};
+    const size_t count = sizeof(values) / sizeof(values[0]);
+    size_t len = TS_CODEC_FIXED_MAX_BYTES(count);
+    TEST_ASSERT_TRUE(ts_codec_encode_fixed(values, count, s_buffer, &len));
+
+    int16_t decoded[8];
+    size_t consumed = len;
+    TEST_ASSERT_TRUE(ts_codec_decode_fixed(s_buffer, &consumed, decoded, count));
+    TEST_ASSERT_EQUAL_size_t(len, consumed);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(values, decoded, count);
+
+    consumed = len - 1U;
+    TEST_ASSERT_FALSE(ts_codec_decode_fixed(s_buffer, &consumed, decoded, count));
+
+    /* zigzag(+40000) + 1 would land past INT16_MAX. */
+    const uint8_t overflow[] = {0x81, 0xF1, 0x04};
+    consumed = sizeof(overflow);
+    TEST_ASSERT_FALSE(ts_codec_decode_fixed(overflow, &consumed, decoded, 1));
+    const uint8_t unterminated[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    consumed = sizeof(unterminated);
+    TEST_ASSERT_FALSE(ts_codec_decode_fixed(unterminated, &consumed, decoded, 1));
+}
+
+TEST_CASE("ts_codec run-length encodes bitfields and rejects bad runs", "[ts_codec]")
+{
+    static uint16_t values[1000];
+    for (size_t i = 0; i < 1000; ++i) {
+        values[i] = i < 600 ? 0x00A5 : 0x80A5;
+    }
+    values[999] = 0xFFFF;
+    size_t len = sizeof(s_buffer);
+    TEST_ASSERT_TRUE(ts_codec_encode_bitfield(values, 1000, s_buffer, &len));
+    TEST_ASSERT_EQUAL_size_t(4U + 5U + 4U, len);
+
+    static uint16_t decoded[1000];
+    size_t consumed = len;
+    TEST_ASSERT_TRUE(ts_codec_decode_bitfield(s_buffer, &consumed, decoded, 1000));
+    TEST_ASSERT_EQUAL_size_t(len, consumed);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(values, decoded, 1000);
+
+    consumed = len - 1U;
+    TEST_ASSERT_FALSE(ts_codec_decode_bitfield(s_buffer, &consumed, decoded, 1000));
+    const uint8_t long_run[] = {0x05, 0x01};
+    consumed = sizeof(long_run);
+    TEST_ASSERT_FALSE(ts_codec_decode_bitfield(long_run, &consumed, decoded, 4));
+    const uint8_t zero_run[] = {0x00, 0x01};
+    consumed = sizeof(zero_run);
+    TEST_ASSERT_FALSE(ts_codec_decode_bitfield(zero_run, &consumed, decoded, 1));
+    const uint8_t wide[] = {0x01, 0x80, 0x80, 0x04};
+    consumed = sizeof(wide);
+    TEST_ASSERT_FALSE(ts_codec_decode_bitfield(wide, &consumed, decoded, 1));
+}
+
+TEST_CASE("ts_codec streams concatenate", "[ts_codec]")
+{
+    const uint32_t stamps[] = {10, 20, 30};
+    const int16_t fixed[] = {5, 6, TS_CODEC_FIXED_NONE};
+    size_t first = sizeof(s_buffer);
+    TEST_ASSERT_TRUE(ts_codec_encode_timestamps(stamps, 3, s_buffer, &first));
+    size_t second = sizeof(s_buffer) - first;
+    TEST_ASSERT_TRUE(ts_codec_encode_fixed(fixed, 3, s_buffer + first, &second));
+
+    uint32_t stamps_out[3];
+    int16_t fixed_out[3];
+    size_t consumed = first + second;
+    TEST_ASSERT_TRUE(ts_codec_decode_timestamps(s_buffer, &consumed, stamps_out, 3));
+    TEST_ASSERT_EQUAL_size_t(first, consumed);
+    consumed = second;
+    TEST_ASSERT_TRUE(ts_codec_decode_fixed(s_buffer + first, &consumed, fixed_out, 3));
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(stamps, stamps_out, 3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(fixed, fixed_out, 3);
+}
+
+typedef bool (*encode_fn_t)(const void *values, size_t count, uint8_t *out, size_t *len);
+typedef bool (*decode_fn_t)(const uint8_t *in, size_t *len, void *values, size_t count);
+
+#define BENCH_ADAPTERS(kind, type)                                                                                     \
+    static bool encode_##kind(const void *values, size_t count, uint8_t *out, size_t *len)                         \
+    {                                                                                                                  \
+        return ts_codec_encode_##kind((const type *)values, count, out, len);                                          \
+    }                                                                                                                  \
+    static bool decode_##kind(const uint8_t *in, size_t *len, void *values, size_t count)                          \
+    {                                                                                                                  \
+        return ts_codec_decode_##kind(in, len, (type *)values, count);                                                 \
+    }
+
+BENCH_ADAPTERS(timestamps, uint32_t)
+BENCH_ADAPTERS(floats, float)
+BENCH_ADAPTERS(fixed, int16_t)
+BENCH_ADAPTERS(bitfield, uint16_t)
+
+static void bench(const char *name, encode_fn_t encode, decode_fn_t decode, const void *values, size_t value_size,
+                  void *scratch, float max_bits)
+{
+    const uint32_t rounds = 20;
+    size_t len = 0;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t r = 0; r < rounds; ++r) {
+        len = sizeof(s_buffer);
+        TEST_ASSERT_TRUE(encode(values, TRACE_POINTS, s_buffer, &len));
+    }
+    int64_t encode_us = esp_timer_get_time() - start;
+    start = esp_timer_get_time();
+    for (uint32_t r = 0; r < rounds; ++r) {
+        size_t consumed = len;
+        TEST_ASSERT_TRUE(decode(s_buffer, &consumed, scratch, TRACE_POINTS));
+    }
+    int64_t decode_us = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_MEMORY(values, scratch, TRACE_POINTS * value_size);
+
+    /* Throughput is measured against the raw (uncompressed) sample bytes. */
+    double raw_mb = (double)(rounds * TRACE_POINTS * value_size) / 1e6;
+    float bits = (float)(len * 8U) / (float)TRACE_POINTS;
+    printf("ts_codec %-10s %5.2f bits/sample (raw %2u), encode %7.1f MB/s, decode %7.1f MB/s\n", name, (double)bits,
+           (unsigned)(value_size * 8U), raw_mb / ((double)(encode_us > 0 ? encode_us : 1) / 1e6),
+           raw_mb / ((double)(decode_us > 0 ? decode_us : 1) / 1e6));
+    TEST_ASSERT_LESS_THAN_FLOAT(max_bits, bits);
+}
+
+TEST_CASE("ts_codec compression and throughput on a sensor trace", "[ts_codec][perf]")
+{
+    build_trace();
+    static uint8_t scratch[TRACE_POINTS * sizeof(float)];
+    bench("timestamps", encode_timestamps, decode_timestamps, s_stamps, sizeof(s_stamps[0]), scratch, 4.0f);
+    bench("floats", encode_floats, decode_floats, s_temps, sizeof(s_temps[0]), scratch, 28.0f);
+    bench("fixed", encode_fixed, decode_fixed, s_fixed, sizeof(s_fixed[0]), scratch, 9.0f);
+    bench("gpio", encode_bitfield, decode_bitfield, s_gpio, sizeof(s_gpio[0]), scratch, 1.0f);
+}
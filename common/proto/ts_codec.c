@@ -0,0 +1,347 @@
+#include "ts_codec.h"
+
+#include <string.h>
+
+/* MSB-first bit stream. At most 32 bits are put or taken at a time, so the
+ * accumulator never holds more than 39 bits. */
+typedef struct {
+    uint8_t *out;
+    size_t cap;
+    size_t len;
+    uint64_t acc;
+    unsigned bits;
+    bool overflow;
+} bit_writer_t;
+
+typedef struct {
+    const uint8_t *in;
+    size_t avail;
+    size_t pos;
+    uint64_t acc;
+    unsigned bits;
+    bool underflow;
+} bit_reader_t;
+
+static void put_bits(bit_writer_t *w, uint32_t value, unsigned n)
+{
+    uint64_t mask = n == 32 ? 0xFFFFFFFFULL : ((1ULL << n) - 1U);
+    w->acc = (w->acc << n) | (value & mask);
+    w->bits += n;
+    while (w->bits >= 8) {
+        w->bits -= 8;
+        if (w->len < w->cap) {
+            w->out[w->len++] = (uint8_t)(w->acc >> w->bits);
+        } else {
+            w->overflow = true;
+        }
+    }
+}
+
+static bool finish_bits(bit_writer_t *w, size_t *len)
+{
+    if (w->bits > 0) {
+        put_bits(w, 0, 8U - w->bits);
+    }
+    *len = w->len;
+    return !w->overflow;
+}
+
+static uint32_t get_bits(bit_reader_t *r, unsigned n)
+{
+    while (r->bits < n) {
+        uint8_t byte = 0;
+        if (r->pos < r->avail) {
+            byte = r->in[r->pos++];
+        } else {
+            r->underflow = true;
+        }
+        r->acc = (r->acc << 8) | byte;
+        r->bits += 8;
+    }
+    r->bits -= n;
+    uint64_t mask = n == 32 ? 0xFFFFFFFFULL : ((1ULL << n) - 1U);
+    return (uint32_t)((r->acc >> r->bits) & mask);
+}
+
+static uint32_t zigzag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1U);
+}
+
+static bool put_varint(uint8_t *out, size_t cap, size_t *len, uint32_t value)
+{
+    do {
+        if (*len >= cap) {
+            return false;
+        }
+        uint8_t byte = value & 0x7FU;
+        value >>= 7;
+        out[(*len)++] = (uint8_t)(byte | (value ? 0x80U : 0U));
+    } while (value);
+    return true;
+}
+
+static bool get_varint(const uint8_t *in, size_t avail, size_t *pos, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7) {
+        if (*pos >= avail) {
+            return false;
+        }
+        uint8_t byte = in[(*pos)++];
+        result |= (uint32_t)(byte & 0x7FU) << shift;
+        if (!(byte & 0x80U)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ts_codec_encode_timestamps(const uint32_t *values, size_t count, uint8_t *out, size_t *len)
+{
+    if (!len || (count && (!values || !out))) {
+        return false;
+    }
+    bit_writer_t w = {.out = out, .cap = *len};
+    uint32_t prev = 0;
+    uint32_t prev_delta = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0) {
+            put_bits(&w, values[0], 32);
+        } else {
+            /* Modular arithmetic: any uint32 sequence round-trips, wraps included. */
+            uint32_t delta = values[i] - prev;
+            uint32_t dod = zigzag((int32_t)(delta - prev_delta));
+            if (dod == 0) {
+                put_bits(&w, 0x0, 1);
+            } else if (dod < (1U << 7)) {
+                put_bits(&w, 0x2, 2);
+                put_bits(&w, dod, 7);
+            } else if (dod < (1U << 9)) {
+                put_bits(&w, 0x6, 3);
+                put_bits(&w, dod, 9);
+            } else if (dod < (1U << 12)) {
+                put_bits(&w, 0xE, 4);
+                put_bits(&w, dod, 12);
+            } else {
+                put_bits(&w, 0xF, 4);
+                put_bits(&w, dod, 32);
+            }
+            prev_delta = delta;
+        }
+        prev = values[i];
+    }
+    return finish_bits(&w, len);
+}
+
+bool ts_codec_decode_timestamps(const uint8_t *in, size_t *len, uint32_t *values, size_t count)
+{
+    if (!len || (count && (!in || !values))) {
+        return false;
+    }
+    bit_reader_t r = {.in = in, .avail = *len};
+    uint32_t prev = 0;
+    uint32_t prev_delta = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0) {
+            values[0] = get_bits(&r, 32);
+        } else {
+            uint32_t dod = 0;
+            if (get_bits(&r, 1)) {
+                if (!get_bits(&r, 1)) {
+                    dod = get_bits(&r, 7);
+                } else if (!get_bits(&r, 1)) {
+                    dod = get_bits(&r, 9);
+                } else if (!get_bits(&r, 1)) {
+                    dod = get_bits(&r, 12);
+                } else {
+                    dod = get_bits(&r, 32);
+                }
+            }
+            prev_delta += (uint32_t)unzigzag(dod);
+            values[i] = prev + prev_delta;
+        }
+        prev = values[i];
+    }
+    *len = r.pos;
+    return !r.underflow;
+}
+
+static uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+bool ts_codec_encode_floats(const float *values, size_t count, uint8_t *out, size_t *len)
+{
+    if (!len || (count && (!values || !out))) {
+        return false;
+    }
+    bit_writer_t w = {.out = out, .cap = *len};
+    uint32_t prev = 0;
+    unsigned lead = 0;
+    unsigned trail = 0;
+    bool window = false;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t bits = float_bits(values[i]);
+        if (i == 0) {
+            put_bits(&w, bits, 32);
+            prev = bits;
+            continue;
+        }
+        uint32_t x = bits ^ prev;
+        prev = bits;
+        if (x == 0) {
+            put_bits(&w, 0x0, 1);
+            continue;
+        }
+        unsigned l = (unsigned)__builtin_clz(x);
+        unsigned t = (unsigned)__builtin_ctz(x);
+        if (window && l >= lead && t >= trail) {
+            /* Meaningful bits fit the previous window: skip re-sending its bounds. */
+            put_bits(&w, 0x2, 2);
+            put_bits(&w, x >> trail, 32U - lead - trail);
+            continue;
+        }
+        unsigned n = 32U - l - t;
+        put_bits(&w, 0x3, 2);
+        put_bits(&w, l, 5);
+        put_bits(&w, n - 1U, 5);
+        put_bits(&w, x >> t, n);
+        lead = l;
+        trail = t;
+        window = true;
+    }
+    return finish_bits(&w, len);
+}
+
+bool ts_codec_decode_floats(const uint8_t *in, size_t *len, float *values, size_t count)
+{
+    if (!len || (count && (!in || !values))) {
+        return false;
+    }
+    bit_reader_t r = {.in = in, .avail = *len};
+    uint32_t prev = 0;
+    unsigned lead = 0;
+    unsigned trail = 0;
+    bool window = false;
+    for (size_t i = 0; i < count; ++i) {
+        if (i == 0) {
+            prev = get_bits(&r, 32);
+        } else if (get_bits(&r, 1)) {
+            if (get_bits(&r, 1)) {
+                lead = get_bits(&r, 5);
+                unsigned n = get_bits(&r, 5) + 1U;
+                if (lead + n > 32U) {
+                    return false;
+                }
+                trail = 32U - lead - n;
+                window = true;
+            } else if (!window) {
+                return false;
+            }
+            prev ^= get_bits(&r, 32U - lead - trail) << trail;
+        }
+        memcpy(&values[i], &prev, sizeof(prev));
+    }
+    *len = r.pos;
+    return !r.underflow;
+}
+
+bool ts_codec_encode_fixed(const int16_t *values, size_t count, uint8_t *out, size_t *len)
+{
+    if (!len || (count && (!values || !out))) {
+        return false;
+    }
+    size_t used = 0;
+    int32_t prev = 0;
+    for (size_t i = 0; i < count; ++i) {
+        /* 0 is reserved for a gap, so every real delta is shifted up by one. */
+        uint32_t code = 0;
+        if (values[i] != TS_CODEC_FIXED_NONE) {
+            code = zigzag(values[i] - prev) + 1U;
+            prev = values[i];
+        }
+        if (!put_varint(out, *len, &used, code)) {
+            return false;
+        }
+    }
+    *len = used;
+    return true;
+}
+
+bool ts_codec_decode_fixed(const uint8_t *in, size_t *len, int16_t *values, size_t count)
+{
+    if (!len || (count && (!in || !values))) {
+        return false;
+    }
+    size_t pos = 0;
+    int32_t prev = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t code = 0;
+        if (!get_varint(in, *len, &pos, &code)) {
+            return false;
+        }
+        if (code == 0) {
+            values[i] = TS_CODEC_FIXED_NONE;
+            continue;
+        }
+        int32_t value = prev + unzigzag(code - 1U);
+        if (value <= TS_CODEC_FIXED_NONE || value > INT16_MAX) {
+            return false;
+        }
+        values[i] = (int16_t)value;
+        prev = value;
+    }
+    *len = pos;
+    return true;
+}
+
+bool ts_codec_encode_bitfield(const uint16_t *values, size_t count, uint8_t *out, size_t *len)
+{
+    if (!len || (count && (!values || !out))) {
+        return false;
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < count;) {
+        size_t run = 1;
+        while (i + run < count && values[i + run] == values[i]) {
+            ++run;
+        }
+        if (!put_varint(out, *len, &used, (uint32_t)run) || !put_varint(out, *len, &used, values[i])) {
+            return false;
+        }
+        i += run;
+    }
+    *len = used;
+    return true;
+}
+
+bool ts_codec_decode_bitfield(const uint8_t *in, size_t *len, uint16_t *values, size_t count)
+{
+    if (!len || (count && (!in || !values))) {
+        return false;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < count;) {
+        uint32_t run = 0;
+        uint32_t value = 0;
+        if (!get_varint(in, *len, &pos, &run) || !get_varint(in, *len, &pos, &value) || run == 0 ||
+            run > count - i || value > UINT16_MAX) {
+            return false;
+        }
+        for (uint32_t k = 0; k < run; ++k) {
+            values[i++] = (uint16_t)value;
+        }
+    }
+    *len = pos;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Compact encodings for time series, in the style of Facebook's Gorilla:
+ *
+ * - timestamps: first value raw, then delta-of-delta in 1, 9, 12, 16 or 36 bits;
+ *   a steady sampling period costs one bit per sample.
+ * - floats: first value raw, then the XOR with the previous value, sending only
+ *   its meaningful bits (often none for a flat signal).
+ * - fixed point (int16): zig-zag varint of the delta to the previous value;
+ *   TS_CODEC_FIXED_NONE (a gap) costs one byte and does not disturb the deltas.
+ * - bitfields (uint16): run-length encoded, for GPIO ports that rarely change.
+ *
+ * Every stream stores no count of its own: the caller frames it. Encoders take the
+ * output capacity in *len and return the bytes written there; decoders take the
+ * bytes available in *len and return the bytes consumed, so streams can simply be
+ * concatenated. All functions return false on a short buffer or malformed input.
+ */
+
+#define TS_CODEC_FIXED_NONE INT16_MIN
+
+/* Worst-case encoded sizes. */
+#define TS_CODEC_TIMESTAMPS_MAX_BYTES(count) (((size_t)(count) * 36U + 7U) / 8U)
+#define TS_CODEC_FLOATS_MAX_BYTES(count) (((size_t)(count) * 44U + 7U) / 8U)
+#define TS_CODEC_FIXED_MAX_BYTES(count) ((size_t)(count) * 3U)
+#define TS_CODEC_BITFIELD_MAX_BYTES(count) ((size_t)(count) * 4U)
+
+bool ts_codec_encode_timestamps(const uint32_t *values, size_t count, uint8_t *out, size_t *len);
+bool ts_codec_decode_timestamps(const uint8_t *in, size_t *len, uint32_t *values, size_t count);
+
+bool ts_codec_encode_floats(const float *values, size_t count, uint8_t *out, size_t *len);
+bool ts_codec_decode_floats(const uint8_t *in, size_t *len, float *values, size_t count);
+
+bool ts_codec_encode_fixed(const int16_t *values, size_t count, uint8_t *out, size_t *len);
+bool ts_codec_decode_fixed(const uint8_t *in, size_t *len, int16_t *values, size_t count);
+
+bool ts_codec_encode_bitfield(const uint16_t *values, size_t count, uint8_t *out, size_t *len);
+bool ts_codec_decode_bitfield(const uint8_t *in, size_t *len, uint16_t *values, size_t count);
@@ -0,0 +1,130 @@
+#include "frame_ring.h"
+
+#include <string.h>
+
+typedef struct {
+    uint32_t len;
+    uint32_t tag;
+} frame_header_t;
+
+static uint32_t record_size(size_t len)
+{
+    return (uint32_t)(sizeof(frame_header_t) + ((len + 3U) & ~(size_t)3U));
+}
+
+static void copy_in(frame_ring_t *ring, uint32_t pos, const void *src, size_t len)
+{
+    uint32_t offset = pos & (ring->capacity - 1U);
+    size_t first = ring->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(ring->buffer + offset, src, first);
+    memcpy(ring->buffer, (const uint8_t *)src + first, len - first);
+}
+
+static void copy_out(const frame_ring_t *ring, uint32_t pos, void *dst, size_t len)
+{
+    uint32_t offset = pos & (ring->capacity - 1U);
+    size_t first = ring->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(dst, ring->buffer + offset, first);
+    memcpy((uint8_t *)dst + first, ring->buffer, len - first);
+}
+
+/**
+ * @brief Attach storage to a frame ring.
+ *
+ * @param ring Ring to initialise.
+ * @param buffer Backing storage, owned by the caller.
+ * @param capacity Size of @p buffer; must be a power of two of at least 16 bytes.
+ * @return true on success, false on invalid arguments.
+ */
+bool frame_ring_init(frame_ring_t *ring, uint8_t *buffer, size_t capacity)
+{
+    if (!ring || !buffer || capacity < 16U || capacity > UINT32_MAX / 2U || (capacity & (capacity - 1U)) != 0) {
+        return false;
+    }
+    ring->buffer = buffer;
+    ring->capacity = (uint32_t)capacity;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return true;
+}
+
+/**
+ * @brief Append a frame. Producer side only.
+ *
+ * @param tag Caller-defined value returned alongside the frame by frame_ring_pop().
+ * @return true when queued, false when the frame does not fit (it is counted as dropped).
+ */
+bool frame_ring_push(frame_ring_t *ring, uint32_t tag, const uint8_t *data, size_t len)
+{
+    if (!ring || (!data && len > 0)) {
+        return false;
+    }
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (len > ring->capacity || record_size(len) > ring->capacity - (head - tail)) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    frame_header_t header = {.len = (uint32_t)len, .tag = tag};
+    copy_in(ring, head, &header, sizeof(header));
+    if (len > 0) {
+        copy_in(ring, head + sizeof(header), data, len);
+    }
+    atomic_store_explicit(&ring->head, head + record_size(len), memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Remove the oldest frame. Consumer side only.
+ *
+ * A frame larger than @p out_cap is discarded and counted as dropped so it cannot
+ * wedge the ring.
+ *
+ * @return true when @p out holds a frame.
+ */
+bool frame_ring_pop(frame_ring_t *ring, uint8_t *out, size_t out_cap, size_t *out_len, uint32_t *tag)
+{
+    if (!ring || !out_len) {
+        return false;
+    }
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    frame_header_t header;
+    copy_out(ring, tail, &header, sizeof(header));
+    bool fits = out && header.len <= out_cap;
+    if (fits) {
+        copy_out(ring, tail + sizeof(header), out, header.len);
+        *out_len = header.len;
+        if (tag) {
+            *tag = header.tag;
+        }
+    } else {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&ring->tail, tail + record_size(header.len), memory_order_release);
+    return fits;
+}
+
+bool frame_ring_is_empty(frame_ring_t *ring)
+{
+    if (!ring) {
+        return true;
+    }
+    return atomic_load_explicit(&ring->head, memory_order_acquire) ==
+           atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+uint32_t frame_ring_dropped(frame_ring_t *ring)
+{
+    return ring ? atomic_load_explicit(&ring->dropped, memory_order_relaxed) : 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Lock-free single-producer/single-consumer ring of variable-length frames.
+ *
+ * Unlike ringbuf_t, head and tail are owned by one side each and published with
+ * release/acquire ordering, so a producer in one task and a consumer in another
+ * need no lock. Each frame is stored as a small header (length + caller tag)
+ * followed by its bytes, possibly wrapping. A push that does not fit is dropped
+ * and counted rather than overwriting frames the consumer may be reading.
+ */
+typedef struct {
+    uint8_t *buffer;
+    uint32_t capacity;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+    _Atomic uint32_t dropped;
+} frame_ring_t;
+
+bool frame_ring_init(frame_ring_t *ring, uint8_t *buffer, size_t capacity);
+bool frame_ring_push(frame_ring_t *ring, uint32_t tag, const uint8_t *data, size_t len);
+bool frame_ring_pop(frame_ring_t *ring, uint8_t *out, size_t out_cap, size_t *out_len, uint32_t *tag);
+bool frame_ring_is_empty(frame_ring_t *ring);
+uint32_t frame_ring_dropped(frame_ring_t *ring);
@@ -0,0 +1,180 @@
+#include "hmac_precomp.h"
+
+#include "mbedtls/platform_util.h"
+#include <string.h>
+
+#define HMAC_BLOCK_LEN 64U
+
+static void build_pads(const uint8_t *key, size_t key_len, uint8_t ipad[HMAC_BLOCK_LEN], uint8_t opad[HMAC_BLOCK_LEN])
+{
+    memset(ipad, 0x36, HMAC_BLOCK_LEN);
+    memset(opad, 0x5C, HMAC_BLOCK_LEN);
+    for (size_t i = 0; i < key_len; ++i) {
+        ipad[i] ^= key[i];
+        opad[i] ^= key[i];
+    }
+}
+
+/**
+ * @brief Precompute the HMAC-SHA256 pad states for @p secret.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a missing key, ESP_FAIL on hash errors.
+ */
+esp_err_t hmac_sha256_key_init(hmac_sha256_key_t *key, const uint8_t *secret, size_t secret_len)
+{
+    if (!key || !secret || secret_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t block_key[HMAC_SHA256_LEN];
+    int rc = 0;
+    if (secret_len > HMAC_BLOCK_LEN) {
+        rc = mbedtls_sha256(secret, secret_len, block_key, 0);
+        secret = block_key;
+        secret_len = sizeof(block_key);
+    }
+    uint8_t ipad[HMAC_BLOCK_LEN];
+    uint8_t opad[HMAC_BLOCK_LEN];
+    build_pads(secret, secret_len, ipad, opad);
+    mbedtls_sha256_init(&key->inner);
+    mbedtls_sha256_init(&key->outer);
+    if (rc == 0) {
+        rc = mbedtls_sha256_starts(&key->inner, 0);
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha256_update(&key->inner, ipad, sizeof(ipad));
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha256_starts(&key->outer, 0);
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha256_update(&key->outer, opad, sizeof(opad));
+    }
+    mbedtls_platform_zeroize(block_key, sizeof(block_key));
+    mbedtls_platform_zeroize(ipad, sizeof(ipad));
+    mbedtls_platform_zeroize(opad, sizeof(opad));
+    if (rc != 0) {
+        hmac_sha256_key_free(key);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void hmac_sha256_key_free(hmac_sha256_key_t *key)
+{
+    if (!key) {
+        return;
+    }
+    mbedtls_sha256_free(&key->inner);
+    mbedtls_sha256_free(&key->outer);
+}
+
+/**
+ * @brief HMAC-SHA256 over the concatenation of @p part1 and @p part2.
+ *
+ * @param part2 Optional second part; pass NULL/0 for a single buffer.
+ */
+esp_err_t hmac_sha256_compute(const hmac_sha256_key_t *key, const uint8_t *part1, size_t part1_len,
+                              const uint8_t *part2, size_t part2_len, uint8_t mac[HMAC_SHA256_LEN])
+{
+    if (!key || (!part1 && part1_len > 0) || (!part2 && part2_len > 0) || !mac) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t inner_digest[HMAC_SHA256_LEN];
+    mbedtls_sha256_context work;
+    mbedtls_sha256_init(&work);
+    mbedtls_sha256_clone(&work, &key->inner);
+    int rc = mbedtls_sha256_update(&work, part1, part1_len);
+    if (rc == 0 && part2_len > 0) {
+        rc = mbedtls_sha256_update(&work, part2, part2_len);
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha256_finish(&work, inner_digest);
+    }
+    if (rc == 0) {
+        mbedtls_sha256_clone(&work, &key->outer);
+        rc = mbedtls_sha256_update(&work, inner_digest, sizeof(inner_digest));
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha256_finish(&work, mac);
+    }
+    mbedtls_sha256_free(&work);
+    mbedtls_platform_zeroize(inner_digest, sizeof(inner_digest));
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+/**
+ * @brief Precompute the HMAC-SHA1 pad states for @p secret.
+ */
+esp_err_t hmac_sha1_key_init(hmac_sha1_key_t *key, const uint8_t *secret, size_t secret_len)
+{
+    if (!key || !secret || secret_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t block_key[HMAC_SHA1_LEN];
+    int rc = 0;
+    if (secret_len > HMAC_BLOCK_LEN) {
+        rc = mbedtls_sha1(secret, secret_len, block_key);
+        secret = block_key;
+        secret_len = sizeof(block_key);
+    }
+    uint8_t ipad[HMAC_BLOCK_LEN];
+    uint8_t opad[HMAC_BLOCK_LEN];
+    build_pads(secret, secret_len, ipad, opad);
+    mbedtls_sha1_init(&key->inner);
+    mbedtls_sha1_init(&key->outer);
+    if (rc == 0) {
+        rc = mbedtls_sha1_starts(&key->inner);
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha1_update(&key->inner, ipad, sizeof(ipad));
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha1_starts(&key->outer);
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha1_update(&key->outer, opad, sizeof(opad));
+    }
+    mbedtls_platform_zeroize(block_key, sizeof(block_key));
+    mbedtls_platform_zeroize(ipad, sizeof(ipad));
+    mbedtls_platform_zeroize(opad, sizeof(opad));
+    if (rc != 0) {
+        hmac_sha1_key_free(key);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void hmac_sha1_key_free(hmac_sha1_key_t *key)
+{
+    if (!key) {
+        return;
+    }
+    mbedtls_sha1_free(&key->inner);
+    mbedtls_sha1_free(&key->outer);
+}
+
+esp_err_t hmac_sha1_compute(const hmac_sha1_key_t *key, const uint8_t *data, size_t data_len,
+                            uint8_t mac[HMAC_SHA1_LEN])
+{
+    if (!key || (!data && data_len > 0) || !mac) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t inner_digest[HMAC_SHA1_LEN];
+    mbedtls_sha1_context work;
+    mbedtls_sha1_init(&work);
+    mbedtls_sha1_clone(&work, &key->inner);
+    int rc = mbedtls_sha1_update(&work, data, data_len);
+    if (rc == 0) {
+        rc = mbedtls_sha1_finish(&work, inner_digest);
+    }
+    if (rc == 0) {
+        mbedtls_sha1_clone(&work, &key->outer);
+        rc = mbedtls_sha1_update(&work, inner_digest, sizeof(inner_digest));
+    }
+    if (rc == 0) {
+        rc = mbedtls_sha1_finish(&work, mac);
+    }
+    mbedtls_sha1_free(&work);
+    mbedtls_platform_zeroize(inner_digest, sizeof(inner_digest));
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "esp_err.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define HMAC_SHA256_LEN 32U
+#define HMAC_SHA1_LEN 20U
+
+/**
+ * HMAC key with the inner (key ^ ipad) and outer (key ^ opad) hash states already
+ * absorbed. Each MAC then clones the two states instead of re-deriving the pads,
+ * which saves two compression rounds and the md context allocation per call.
+ * Contexts hold no heap memory; a key can be used concurrently for computing.
+ */
+typedef struct {
+    mbedtls_sha256_context inner;
+    mbedtls_sha256_context outer;
+} hmac_sha256_key_t;
+
+typedef struct {
+    mbedtls_sha1_context inner;
+    mbedtls_sha1_context outer;
+} hmac_sha1_key_t;
+
+esp_err_t hmac_sha256_key_init(hmac_sha256_key_t *key, const uint8_t *secret, size_t secret_len);
+void hmac_sha256_key_free(hmac_sha256_key_t *key);
+esp_err_t hmac_sha256_compute(const hmac_sha256_key_t *key, const uint8_t *part1, size_t part1_len,
+                              const uint8_t *part2, size_t part2_len, uint8_t mac[HMAC_SHA256_LEN]);
+
+esp_err_t hmac_sha1_key_init(hmac_sha1_key_t *key, const uint8_t *secret, size_t secret_len);
+void hmac_sha1_key_free(hmac_sha1_key_t *key);
+esp_err_t hmac_sha1_compute(const hmac_sha1_key_t *key, const uint8_t *data, size_t data_len,
+                            uint8_t mac[HMAC_SHA1_LEN]);
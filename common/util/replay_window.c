@@ -0,0 +1,90 @@
+#include "replay_window.h"
+
+#include <string.h>
+
+#define WORD_BITS 64U
+
+/**
+ * @brief Initialise an empty window.
+ *
+ * @param window Number of sequence numbers tracked behind the highest one; a multiple
+ *               of 64 between REPLAY_WINDOW_MIN_BITS and REPLAY_WINDOW_MAX_BITS.
+ */
+bool replay_window_init(replay_window_t *replay, uint32_t window)
+{
+    if (!replay || window < REPLAY_WINDOW_MIN_BITS || window > REPLAY_WINDOW_MAX_BITS || window % WORD_BITS != 0U) {
+        return false;
+    }
+    replay->window = window;
+    replay->words = (uint16_t)(window / WORD_BITS + 1U);
+    replay_window_reset(replay);
+    return true;
+}
+
+/**
+ * @brief Forget every sequence number seen, keeping the window size (e.g. on reconnect).
+ */
+void replay_window_reset(replay_window_t *replay)
+{
+    if (!replay) {
+        return;
+    }
+    replay->highest = 0;
+    replay->top = 0;
+    memset(replay->bitmap, 0, sizeof(replay->bitmap));
+}
+
+/**
+ * Ring slot holding @p seq, which must lie in the words currently covered.
+ */
+static uint32_t slot_of(const replay_window_t *replay, uint64_t seq)
+{
+    uint32_t back = (uint32_t)((replay->highest / WORD_BITS) - (seq / WORD_BITS));
+    uint32_t slot = replay->top + replay->words - back;
+    return slot >= replay->words ? slot - replay->words : slot;
+}
+
+/**
+ * @brief Tell whether @p seq is new and not too old. Does not modify the window.
+ *
+ * Call before the (expensive) authentication and commit with replay_window_update()
+ * only once the frame authenticated, so forged frames cannot move the window.
+ */
+bool replay_window_check(const replay_window_t *replay, uint64_t seq)
+{
+    if (!replay || seq == 0) {
+        return false;
+    }
+    if (seq > replay->highest) {
+        return true;
+    }
+    if (replay->highest - seq >= replay->window) {
+        return false;
+    }
+    uint64_t bit = 1ULL << (seq % WORD_BITS);
+    return (replay->bitmap[slot_of(replay, seq)] & bit) == 0;
+}
+
+/**
+ * @brief Record @p seq as received. @p seq must have passed replay_window_check().
+ */
+void replay_window_update(replay_window_t *replay, uint64_t seq)
+{
+    if (!replay || seq == 0) {
+        return;
+    }
+    if (seq > replay->highest) {
+        uint64_t advance = (seq / WORD_BITS) - (replay->highest / WORD_BITS);
+        if (advance > replay->words) {
+            advance = replay->words;
+        }
+        for (uint64_t i = 0; i < advance; ++i) {
+            replay->top = (uint16_t)(replay->top + 1U == replay->words ? 0U : replay->top + 1U);
+            replay->bitmap[replay->top] = 0;
+        }
+        replay->highest = seq;
+    } else if (replay->highest - seq >= replay->window) {
+        return;
+    }
+    replay->bitmap[slot_of(replay, seq)] |= 1ULL << (seq % WORD_BITS);
+}
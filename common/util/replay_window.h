@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define REPLAY_WINDOW_MIN_BITS 64U
+#define REPLAY_WINDOW_MAX_BITS 1024U
+
+/**
+ * IPsec-style anti-replay window over 64-bit sequence numbers.
+ *
+ * Any sequence number within @c window of the highest one accepted so far may
+ * arrive in any order, but only once. The bitmap is a ring of 64-bit words with
+ * one spare word (RFC 6479), so advancing the window only clears the words it
+ * skips instead of shifting the whole bitmap. Sequence number 0 is never valid.
+ */
+typedef struct {
+    uint64_t highest;
+    uint32_t window;
+    uint16_t words;
+    uint16_t top;
+    uint64_t bitmap[REPLAY_WINDOW_MAX_BITS / 64U + 1U];
+} replay_window_t;
+
+bool replay_window_init(replay_window_t *replay, uint32_t window);
+void replay_window_reset(replay_window_t *replay);
+bool replay_window_check(const replay_window_t *replay, uint64_t seq);
+void replay_window_update(replay_window_t *replay, uint64_t seq);
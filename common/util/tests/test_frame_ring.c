@@ -0,0 +1,51 @@
+#include "frame_ring.h"
+
+#include "unity.h"
+#include <string.h>
+
+TEST_CASE("frame ring preserves frames and tags across wrap", "[util][frame_ring]")
+{
+    static uint8_t storage[64];
+    frame_ring_t ring;
+    TEST_ASSERT_TRUE(frame_ring_init(&ring, storage, sizeof(storage)));
+    TEST_ASSERT_TRUE(frame_ring_is_empty(&ring));
+
+    uint8_t in[20];
+    uint8_t out[32];
+    for (uint32_t round = 0; round < 50; ++round) {
+        size_t len = 1 + (round % sizeof(in));
+        memset(in, (int)round, len);
+        TEST_ASSERT_TRUE(frame_ring_push(&ring, round, in, len));
+        size_t out_len = 0;
+        uint32_t tag = 0;
+        TEST_ASSERT_TRUE(frame_ring_pop(&ring, out, sizeof(out), &out_len, &tag));
+        TEST_ASSERT_EQUAL_UINT32(round, tag);
+        TEST_ASSERT_EQUAL(len, out_len);
+        TEST_ASSERT_EQUAL_MEMORY(in, out, len);
+    }
+    TEST_ASSERT_TRUE(frame_ring_is_empty(&ring));
+}
+
+TEST_CASE("frame ring drops frames that do not fit", "[util][frame_ring]")
+{
+    static uint8_t storage[64];
+    frame_ring_t ring;
+    TEST_ASSERT_FALSE(frame_ring_init(&ring, storage, 48));
+    TEST_ASSERT_TRUE(frame_ring_init(&ring, storage, sizeof(storage)));
+
+    const uint8_t frame[24] = {0};
+    TEST_ASSERT_TRUE(frame_ring_push(&ring, 1, frame, sizeof(frame)));
+    TEST_ASSERT_TRUE(frame_ring_push(&ring, 2, frame, sizeof(frame)));
+    TEST_ASSERT_FALSE(frame_ring_push(&ring, 3, frame, sizeof(frame)));
+    TEST_ASSERT_EQUAL_UINT32(1, frame_ring_dropped(&ring));
+
+    uint8_t small[8];
+    size_t out_len = 0;
+    uint32_t tag = 0;
+    TEST_ASSERT_FALSE(frame_ring_pop(&ring, small, sizeof(small), &out_len, &tag));
+    TEST_ASSERT_EQUAL_UINT32(2, frame_ring_dropped(&ring));
+    uint8_t out[32];
+    TEST_ASSERT_TRUE(frame_ring_pop(&ring, out, sizeof(out), &out_len, &tag));
+    TEST_ASSERT_EQUAL_UINT32(2, tag);
+    TEST_ASSERT_TRUE(frame_ring_is_empty(&ring));
+}
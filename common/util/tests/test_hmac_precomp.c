@@ -0,0 +1,55 @@
+#include "hmac_precomp.h"
+
+#include "unity.h"
+#include <string.h>
+
+TEST_CASE("hmac sha256 precomputed key matches RFC 4231", "[util][hmac]")
+{
+    static const uint8_t expected_short[HMAC_SHA256_LEN] = {
+        0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53, 0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+        0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7, 0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7,
+    };
+    static const uint8_t expected_long[HMAC_SHA256_LEN] = {
+        0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f, 0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+        0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14, 0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54,
+    };
+    uint8_t secret[131];
+    uint8_t mac[HMAC_SHA256_LEN];
+    hmac_sha256_key_t key;
+
+    memset(secret, 0x0b, 20);
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha256_key_init(&key, secret, 20));
+    // The message may be split across both parts.
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha256_compute(&key, (const uint8_t *)"Hi ", 3, (const uint8_t *)"There", 5, mac));
+    TEST_ASSERT_EQUAL_MEMORY(expected_short, mac, sizeof(mac));
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha256_compute(&key, (const uint8_t *)"Hi There", 8, NULL, 0, mac));
+    TEST_ASSERT_EQUAL_MEMORY(expected_short, mac, sizeof(mac));
+    hmac_sha256_key_free(&key);
+
+    static const char msg[] = "Test Using Larger Than Block-Size Key - Hash Key First";
+    memset(secret, 0xaa, sizeof(secret));
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha256_key_init(&key, secret, sizeof(secret)));
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha256_compute(&key, (const uint8_t *)msg, sizeof(msg) - 1U, NULL, 0, mac));
+    TEST_ASSERT_EQUAL_MEMORY(expected_long, mac, sizeof(mac));
+    hmac_sha256_key_free(&key);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, hmac_sha256_key_init(&key, secret, 0));
+}
+
+TEST_CASE("hmac sha1 precomputed key matches RFC 2202", "[util][hmac]")
+{
+    static const uint8_t expected[HMAC_SHA1_LEN] = {
+        0xb6, 0x17, 0x31, 0x86, 0x55, 0x05, 0x72, 0x64, 0xe2, 0x8b,
+        0xc0, 0xb6, 0xfb, 0x37, 0x8c, 0x8e, 0xf1, 0x46, 0xbe, 0x00,
+    };
+    uint8_t secret[20];
+    memset(secret, 0x0b, sizeof(secret));
+    hmac_sha1_key_t key;
+    TEST_ASSERT_EQUAL(ESP_OK, hmac_sha1_key_init(&key, secret, sizeof(secret)));
+    uint8_t mac[HMAC_SHA1_LEN];
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, hmac_sha1_compute(&key, (const uint8_t *)"Hi There", 8, mac));
+        TEST_ASSERT_EQUAL_MEMORY(expected, mac, sizeof(mac));
+    }
+    hmac_sha1_key_free(&key);
+}
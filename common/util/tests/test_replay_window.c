@@ -0,0 +1,144 @@
+#include "replay_window.h"
+
+#include "esp_timer.h"
+#include "unity.h"
+#include <stdio.h>
+
+TEST_CASE("replay window validates its size", "[util][replay]")
+{
+    replay_window_t replay;
+    TEST_ASSERT_FALSE(replay_window_init(&replay, 32));
+    TEST_ASSERT_FALSE(replay_window_init(&replay, 100));
+    TEST_ASSERT_FALSE(replay_window_init(&replay, REPLAY_WINDOW_MAX_BITS + 64U));
+    TEST_ASSERT_TRUE(replay_window_init(&replay, 64));
+    TEST_ASSERT_TRUE(replay_window_init(&replay, REPLAY_WINDOW_MAX_BITS));
+    TEST_ASSERT_FALSE(replay_window_check(&replay, 0));
+}
+
+TEST_CASE("replay window accepts reordered frames once", "[util][replay]")
+{
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, 128));
+
+    static const uint64_t arrivals[] = {3, 1, 2, 10, 7, 64, 5, 130, 129, 4, 128};
+    for (size_t i = 0; i < sizeof(arrivals) / sizeof(arrivals[0]); ++i) {
+        TEST_ASSERT_TRUE(replay_window_check(&replay, arrivals[i]));
+        replay_window_update(&replay, arrivals[i]);
+        TEST_ASSERT_FALSE(replay_window_check(&replay, arrivals[i]));
+    }
+    for (size_t i = 0; i < sizeof(arrivals) / sizeof(arrivals[0]); ++i) {
+        TEST_ASSERT_FALSE(replay_window_check(&replay, arrivals[i]));
+    }
+    // Never seen and still inside the window.
+    TEST_ASSERT_TRUE(replay_window_check(&replay, 6));
+    TEST_ASSERT_TRUE(replay_window_check(&replay, 127));
+    // Highest is 130: 3 is the oldest slot still tracked, 1 and 2 have left the window.
+    TEST_ASSERT_TRUE(replay_window_check(&replay, 8));
+    TEST_ASSERT_FALSE(replay_window_check(&replay, 1));
+}
+
+TEST_CASE("replay window clears skipped slots on large jumps", "[util][replay]")
+{
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, 256));
+    for (uint64_t seq = 1; seq <= 300; ++seq) {
+        replay_window_update(&replay, seq);
+    }
+    // Jump by exactly one ring revolution and by far more: stale bits must not alias.
+    const uint64_t jumps[] = {300 + 5 * 64, 100000, 100000 + 8 * 64};
+    for (size_t j = 0; j < sizeof(jumps) / sizeof(jumps[0]); ++j) {
+        uint64_t top = jumps[j];
+        TEST_ASSERT_TRUE(replay_window_check(&replay, top));
+        replay_window_update(&replay, top);
+        for (uint64_t seq = top - 255; seq < top; ++seq) {
+            TEST_ASSERT_TRUE(replay_window_check(&replay, seq));
+        }
+        TEST_ASSERT_FALSE(replay_window_check(&replay, top - 256));
+    }
+}
+
+TEST_CASE("replay window matches a reference model", "[util][replay]")
+{
+    replay_window_t replay;
+    TEST_ASSERT_TRUE(replay_window_init(&replay, 192));
+    static bool seen[4096];
+    uint64_t highest = 0;
+    uint32_t state = 0x12345678u;
+    for (int i = 0; i < 20000; ++i) {
+        state = state * 1664525u + 1013904223u;
+        uint64_t base = highest > 200 ? highest - 200 : 1;
+        uint64_t seq = base + (state >> 8) % 240U;
+        if (seq >= sizeof(seen) / sizeof(seen[0])) {
+            break;
+        }
+        bool expected = !seen[seq] && (seq > highest || highest - seq < 192);
+        TEST_ASSERT_EQUAL(expected, replay_window_check(&replay, seq));
+        if (expected) {
+            replay_window_update(&replay, seq);
+            seen[seq] = true;
+            if (seq > highest) {
+                highest = seq;
+            }
+        }
+    }
+}
+
+TEST_CASE("replay window check throughput", "[util][replay][perf]")
+{
+    static const uint32_t windows[] = {64, 256, 1024};
+    static uint64_t order[4096];
+    const int rounds = 64;
+    const size_t count = sizeof(order) / sizeof(order[0]);
+
+    // Baseline: the strictly increasing counter check it replaces (in-order traffic only).
+    uint64_t last = 0;
+    uint32_t accepted = 0;
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t seq = (uint64_t)r * count + i + 1U;
+            if (seq > last) {
+                last = seq;
+                ++accepted;
+            }
+        }
+    }
+    int64_t strict_us = esp_timer_get_time() - start;
+    TEST_ASSERT_EQUAL_UINT32(rounds * count, accepted);
+    printf("strict counter        : %6.2f ns/frame\n", strict_us * 1000.0 / (double)(rounds * count));
+
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); ++w) {
+        for (int shuffled = 0; shuffled <= 1; ++shuffled) {
+            // Reordered traffic: shuffle within blocks of a quarter window.
+            for (size_t i = 0; i < count; ++i) {
+                order[i] = i;
+            }
+            const size_t block = windows[w] / 4U;
+            uint32_t state = 42;
+            for (size_t i = 0; shuffled && i < count; ++i) {
+                state = state * 1664525u + 1013904223u;
+                size_t j = i - i % block + (state >> 8) % block;
+                uint64_t tmp = order[i];
+                order[i] = order[j];
+                order[j] = tmp;
+            }
+            replay_window_t replay;
+            TEST_ASSERT_TRUE(replay_window_init(&replay, windows[w]));
+            accepted = 0;
+            start = esp_timer_get_time();
+            for (int r = 0; r < rounds; ++r) {
+                for (size_t i = 0; i < count; ++i) {
+                    uint64_t seq = (uint64_t)r * count + order[i] + 1U;
+                    if (replay_window_check(&replay, seq)) {
+                        replay_window_update(&replay, seq);
+                        ++accepted;
+                    }
+                }
+            }
+            int64_t elapsed_us = esp_timer_get_time() - start;
+            TEST_ASSERT_EQUAL_UINT32(rounds * count, accepted);
+            printf("window %4u %-10s: %6.2f ns/frame\n", (unsigned)windows[w], shuffled ? "reordered" : "in-order",
+                   elapsed_us * 1000.0 / (double)(rounds * count));
+        }
+    }
+}
@@ -1,6 +1,5 @@
 #include "totp.h"
 
-#include "mbedtls/md.h"
 #include <string.h>
 
 static uint32_t pow10_u32(uint8_t digits)
@@ -12,39 +11,33 @@ static uint32_t pow10_u32(uint8_t digits)
     return value;
 }
 
-esp_err_t totp_compute(const totp_config_t *cfg, uint64_t unix_time, uint32_t *code)
+static void counter_to_bytes(uint64_t counter, unsigned char out[8])
 {
-    if (!cfg || !cfg->secret || cfg->secret_len == 0 || cfg->digits < 6 || cfg->digits > 8 || cfg->period_s == 0 || !code) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    uint64_t counter = unix_time / cfg->period_s;
-    unsigned char counter_bytes[8];
     for (int i = 7; i >= 0; --i) {
-        counter_bytes[i] = (unsigned char)(counter & 0xFFU);
+        out[i] = (unsigned char)(counter & 0xFFU);
         counter >>= 8U;
     }
+}
 
-    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA1);
-    if (!info) {
-        return ESP_FAIL;
-    }
-
-    unsigned char digest[20];
-    mbedtls_md_context_t ctx;
-    mbedtls_md_init(&ctx);
-    int rc = mbedtls_md_setup(&ctx, info, 1);
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_starts(&ctx, cfg->secret, cfg->secret_len);
-    }
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_update(&ctx, counter_bytes, sizeof(counter_bytes));
-    }
-    if (rc == 0) {
-        rc = mbedtls_md_hmac_finish(&ctx, digest);
+/**
+ * @brief Compute the code of one time step with a precomputed HMAC-SHA1 key.
+ *
+ * @param key Key prepared with hmac_sha1_key_init() from the TOTP secret.
+ * @param step Time step (unix time divided by the period).
+ * @param digits Code length, 6 to 8.
+ * @param code Receives the code.
+ */
+esp_err_t totp_compute_step(const hmac_sha1_key_t *key, uint64_t step, uint8_t digits, uint32_t *code)
+{
+    if (!key || digits < 6 || digits > 8 || !code) {
+        return ESP_ERR_INVALID_ARG;
     }
-    mbedtls_md_free(&ctx);
-    if (rc != 0) {
-        return ESP_FAIL;
+    unsigned char counter_bytes[8];
+    counter_to_bytes(step, counter_bytes);
+    unsigned char digest[HMAC_SHA1_LEN];
+    esp_err_t err = hmac_sha1_compute(key, counter_bytes, sizeof(counter_bytes), digest);
+    if (err != ESP_OK) {
+        return err;
     }
 
     uint8_t offset = digest[19] & 0x0FU;
@@ -53,11 +46,26 @@ esp_err_t totp_compute(const totp_config_t *cfg, uint64_t unix_time, uint32_t *c
     binary |= ((uint32_t)digest[offset + 2U] & 0xFFU) << 8U;
     binary |= (uint32_t)digest[offset + 3U] & 0xFFU;
 
-    uint32_t mod = pow10_u32(cfg->digits);
+    uint32_t mod = pow10_u32(digits);
     *code = binary % mod;
     return ESP_OK;
 }
 
+esp_err_t totp_compute(const totp_config_t *cfg, uint64_t unix_time, uint32_t *code)
+{
+    if (!cfg || !cfg->secret || cfg->secret_len == 0 || cfg->digits < 6 || cfg->digits > 8 || cfg->period_s == 0 || !code) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    hmac_sha1_key_t key;
+    esp_err_t err = hmac_sha1_key_init(&key, cfg->secret, cfg->secret_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = totp_compute_step(&key, unix_time / cfg->period_s, cfg->digits, code);
+    hmac_sha1_key_free(&key);
+    return err;
+}
+
 esp_err_t totp_verify(const totp_config_t *cfg, uint64_t unix_time, uint32_t window, uint32_t code, bool *match)
 {
     if (!match) {
@@ -67,30 +75,26 @@ esp_err_t totp_verify(const totp_config_t *cfg, uint64_t unix_time, uint32_t win
     if (!cfg) {
         return ESP_ERR_INVALID_ARG;
     }
-    if (!cfg->secret || cfg->secret_len == 0) {
+    if (!cfg->secret || cfg->secret_len == 0 || cfg->period_s == 0) {
         return ESP_ERR_INVALID_ARG;
     }
-    for (int32_t offset = -(int32_t)window; offset <= (int32_t)window; ++offset) {
-        uint64_t adjusted_time = unix_time;
-        int64_t delta = (int64_t)offset * (int64_t)cfg->period_s;
-        if (offset < 0) {
-            if ((uint64_t)(-delta) > adjusted_time) {
-                continue;
-            }
-            adjusted_time -= (uint64_t)(-delta);
-        } else {
-            adjusted_time += (uint64_t)delta;
+    hmac_sha1_key_t key;
+    esp_err_t err = hmac_sha1_key_init(&key, cfg->secret, cfg->secret_len);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint64_t step = unix_time / cfg->period_s;
+    for (int32_t offset = -(int32_t)window; offset <= (int32_t)window && !*match; ++offset) {
+        if (offset < 0 && (uint64_t)(-offset) > step) {
+            continue;
         }
         uint32_t expected = 0;
-        esp_err_t err = totp_compute(cfg, adjusted_time, &expected);
+        err = totp_compute_step(&key, step + (uint64_t)(int64_t)offset, cfg->digits, &expected);
         if (err != ESP_OK) {
-            return err;
-        }
-        if (expected == code) {
-            *match = true;
-            return ESP_OK;
+            break;
         }
+        *match = expected == code;
     }
-    return ESP_OK;
+    hmac_sha1_key_free(&key);
+    return err;
 }
-
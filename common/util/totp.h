@@ -1,6 +1,7 @@
 #pragma once
 
 #include "esp_err.h"
+#include "hmac_precomp.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -15,3 +16,4 @@ typedef struct {
 esp_err_t totp_compute(const totp_config_t *cfg, uint64_t unix_time, uint32_t *code);
 esp_err_t totp_verify(const totp_config_t *cfg, uint64_t unix_time, uint32_t window, uint32_t code, bool *match);
 
+esp_err_t totp_compute_step(const hmac_sha1_key_t *key, uint64_t step, uint8_t digits, uint32_t *code);
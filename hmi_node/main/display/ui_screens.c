@@ -12,6 +12,8 @@
 #define GPIO_DEVICE_COUNT 2
 #define GPIO_PINS_PER_DEVICE 16
 
+_Static_assert(UI_HISTORY_POINTS == HMI_HISTORY_POINTS, "backfill must fill the trace charts exactly");
+
 typedef struct {
     uint8_t device_index;
     uint8_t pin_index;
@@ -60,6 +62,8 @@ static lv_obj_t *s_chart_ds;
 static lv_chart_series_t *s_temp_series[2];
 static lv_chart_series_t *s_hum_series[2];
 static lv_chart_series_t *s_ds_series[4];
+static uint16_t s_live_points[HMI_HISTORY_SERIES]; /* charted since the last (re)connection */
+static lv_coord_t s_splice_buf[UI_HISTORY_POINTS];
 
 static lv_obj_t *s_ssid_ta;
 static lv_obj_t *s_password_ta;
@@ -93,6 +97,7 @@ static uint32_t s_last_sequence_id;
 static void refresh_localised_text(void);
 static void apply_touch_target_style(void);
 static void update_text_scale_label(void);
+static void apply_display_zoom(void);
 static const ui_locale_pack_t *get_locale(void);
 
 static void apply_theme(bool dark)
@@ -307,6 +312,13 @@ static void dispatch_pwm_frequency(uint16_t freq)
     }
 }
 
+static void dispatch_flush_commands(void)
+{
+    if (s_callbacks.flush_commands) {
+        s_callbacks.flush_commands(s_callback_ctx);
+    }
+}
+
 static void dispatch_apply_preferences(const char *ssid, const char *password, const char *mdns, bool dark,
                                        bool fahrenheit, bool high_contrast, bool large_touch_targets,
                                        uint8_t text_scale_percent, hmi_language_t language)
@@ -362,6 +374,7 @@ static void gpio_switch_event_cb(lv_event_t *e)
     lv_obj_t *target = lv_event_get_target(e);
     bool on = lv_obj_has_state(target, LV_STATE_CHECKED);
     dispatch_gpio_write(ctx, on);
+    dispatch_flush_commands();
 }
 
 static void pwm_slider_event_cb(lv_event_t *e)
@@ -380,6 +393,9 @@ static void pwm_slider_event_cb(lv_event_t *e)
     lv_obj_t *slider = lv_event_get_target(e);
     int16_t value = lv_slider_get_value(slider);
     dispatch_pwm_value(ctx, value);
+    if (code == LV_EVENT_RELEASED) {
+        dispatch_flush_commands();
+    }
 }
 
 static void pwm_freq_event_cb(lv_event_t *e)
@@ -387,7 +403,8 @@ static void pwm_freq_event_cb(lv_event_t *e)
     if (s_updating_ui) {
         return;
     }
-    if (lv_event_get_code(e) != LV_EVENT_VALUE_CHANGED && lv_event_get_code(e) != LV_EVENT_RELEASED) {
+    lv_event_code_t code = lv_event_get_code(e);
+    if (code != LV_EVENT_VALUE_CHANGED && code != LV_EVENT_RELEASED) {
         return;
     }
     if (!s_callbacks.set_pwm_frequency) {
@@ -396,6 +413,9 @@ static void pwm_freq_event_cb(lv_event_t *e)
     lv_obj_t *slider = lv_event_get_target(e);
     uint16_t freq = (uint16_t)lv_slider_get_value(slider);
     dispatch_pwm_frequency(freq);
+    if (code == LV_EVENT_RELEASED) {
+        dispatch_flush_commands();
+    }
 }
 
 static void text_scale_event_cb(lv_event_t *e)
@@ -920,6 +940,13 @@ static void update_pwm_state(const proto_sensor_update_t *update)
     s_updating_ui = false;
 }
 
+static void count_live_point(size_t series)
+{
+    if (s_live_points[series] < UI_HISTORY_POINTS) {
+        ++s_live_points[series];
+    }
+}
+
 static void update_charts(const proto_sensor_update_t *update, bool use_fahrenheit)
 {
     for (size_t i = 0; i < 2; ++i) {
@@ -937,16 +964,85 @@ static void update_charts(const proto_sensor_update_t *update, bool use_fahrenhe
         } else {
             lv_chart_set_next_value(s_chart_hum, s_hum_series[i], LV_CHART_POINT_NONE);
         }
+        count_live_point(i);
+        count_live_point(2 + i);
     }
     for (size_t i = 0; i < 4; ++i) {
         float temp = i < update->ds18b20_count ? update->ds18b20[i].temperature_c : NAN;
         if (!isnan(temp)) {
             float value = use_fahrenheit ? (temp * 9.0f / 5.0f + 32.0f) : temp;
             lv_chart_set_next_value(s_chart_ds, s_ds_series[i], (lv_coord_t)(value * 10.0f));
+            count_live_point(4 + i);
         }
     }
 }
 
+static lv_coord_t history_to_chart(int16_t value, bool temperature, bool use_fahrenheit)
+{
+    if (value == PROTO_HISTORY_NONE) {
+        return LV_CHART_POINT_NONE;
+    }
+    // History is in hundredths, the charts in tenths.
+    if (temperature && use_fahrenheit) {
+        return (lv_coord_t)((int32_t)value * 9 / 50 + 320);
+    }
+    return (lv_coord_t)(value / 10);
+}
+
+/*
+ * Rewrite one series as: the points charted before the link dropped, the
+ * backfilled gap, then the points received live since the reconnection, keeping
+ * the newest UI_HISTORY_POINTS. The ring is linearised so its start point is 0.
+ */
+static void splice_history(lv_obj_t *chart, lv_chart_series_t *ser, const hmi_history_snapshot_t *history,
+                           size_t series, bool temperature, bool use_fahrenheit)
+{
+    lv_coord_t *ring = lv_chart_get_y_array(chart, ser);
+    if (!ring) {
+        return;
+    }
+    size_t start = lv_chart_get_x_start_point(chart, ser);
+    size_t recent = s_live_points[series];
+    size_t backfill = history->count[series];
+    size_t older = UI_HISTORY_POINTS - recent;
+    if (backfill > older) {
+        backfill = older;
+    }
+    older -= backfill;
+
+    size_t out = 0;
+    for (size_t i = UI_HISTORY_POINTS - recent - older; i < UI_HISTORY_POINTS - recent; ++i) {
+        s_splice_buf[out++] = ring[(start + i) % UI_HISTORY_POINTS];
+    }
+    const int16_t *values = history->values[series] + (history->count[series] - backfill);
+    for (size_t i = 0; i < backfill; ++i) {
+        s_splice_buf[out++] = history_to_chart(values[i], temperature, use_fahrenheit);
+    }
+    for (size_t i = UI_HISTORY_POINTS - recent; i < UI_HISTORY_POINTS; ++i) {
+        s_splice_buf[out++] = ring[(start + i) % UI_HISTORY_POINTS];
+    }
+    memcpy(ring, s_splice_buf, sizeof(s_splice_buf));
+    lv_chart_set_x_start_point(chart, ser, 0);
+}
+
+void ui_load_history(const hmi_history_snapshot_t *history, bool use_fahrenheit)
+{
+    if (!history || !s_chart_temp || !s_chart_hum || !s_chart_ds) {
+        return;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        splice_history(s_chart_temp, s_temp_series[i], history, i, true, use_fahrenheit);
+        splice_history(s_chart_hum, s_hum_series[i], history, 2 + i, false, use_fahrenheit);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        splice_history(s_chart_ds, s_ds_series[i], history, 4 + i, true, use_fahrenheit);
+    }
+    // One redraw per chart instead of one per point.
+    lv_chart_refresh(s_chart_temp);
+    lv_chart_refresh(s_chart_hum);
+    lv_chart_refresh(s_chart_ds);
+}
+
 static void refresh_localised_text(void)
 {
     const ui_locale_pack_t *locale = get_locale();
@@ -1111,6 +1207,9 @@ void ui_update_connection_status(bool connected)
     if (!s_status_label) {
         return;
     }
+    if (connected && !s_last_connected) {
+        memset(s_live_points, 0, sizeof(s_live_points));
+    }
     s_last_connected = connected;
     const ui_locale_pack_t *locale = get_locale();
     if (connected) {
@@ -1228,6 +1327,12 @@ void ui_test_handle_pwm_slider(uint8_t channel, uint16_t value)
     dispatch_pwm_value(&ctx, (int16_t)value);
 }
 
+void ui_test_release_pwm_slider(uint8_t channel, uint16_t value)
+{
+    ui_test_handle_pwm_slider(channel, value);
+    dispatch_flush_commands();
+}
+
 void ui_test_handle_pwm_frequency(uint16_t freq)
 {
     dispatch_pwm_frequency(freq);
@@ -3,6 +3,7 @@
 #include "sdkconfig.h"
 #include "common/proto/messages.h"
 #include "data_model.h"
+#include "net/history_backfill.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -12,12 +13,14 @@ typedef struct {
     void (*write_gpio)(uint8_t device_index, uint8_t port, uint16_t mask, uint16_t value, void *ctx);
     void (*apply_preferences)(const hmi_user_preferences_t *prefs, void *ctx);
     void (*reset_preferences)(void *ctx);
+    void (*flush_commands)(void *ctx); /* gesture finished, send pending values now */
 } ui_callbacks_t;
 
 void ui_init(const ui_callbacks_t *callbacks, void *ctx);
 void ui_update_sensor_data(const proto_sensor_update_t *update, bool use_fahrenheit);
 void ui_update_connection_status(bool connected);
 void ui_update_crc_status(bool crc_ok);
+void ui_load_history(const hmi_history_snapshot_t *history, bool use_fahrenheit);
 void ui_apply_preferences(const hmi_user_preferences_t *prefs);
 void ui_process(void);
 
@@ -26,6 +29,7 @@ void ui_set_callbacks_for_test(const ui_callbacks_t *callbacks, void *ctx);
 void ui_set_active_prefs_for_test(const hmi_user_preferences_t *prefs);
 void ui_test_handle_gpio_switch(uint8_t device_index, uint8_t pin_index, bool on);
 void ui_test_handle_pwm_slider(uint8_t channel, uint16_t value);
+void ui_test_release_pwm_slider(uint8_t channel, uint16_t value);
 void ui_test_handle_pwm_frequency(uint16_t freq);
 void ui_test_apply_preferences_inputs(const char *ssid, const char *password, const char *mdns, bool dark,
                                       bool fahrenheit, bool high_contrast, bool large_touch_targets,
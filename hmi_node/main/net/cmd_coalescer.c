@@ -0,0 +1,161 @@
+#include "net/cmd_coalescer.h"
+
+#include <string.h>
+
+_Static_assert(HMI_COALESCER_PWM_CHANNELS <= PROTO_MAX_PWM_UPDATES, "PWM batch does not fit a command");
+_Static_assert(HMI_COALESCER_GPIO_DEVICES * HMI_COALESCER_GPIO_PORTS <= PROTO_MAX_GPIO_WRITES,
+               "GPIO batch does not fit a command");
+
+/**
+ * @brief Reset a coalescer.
+ *
+ * @param coalescer Instance to initialise.
+ * @param flush_interval_ms Minimum spacing between two rate-driven flushes.
+ */
+void hmi_cmd_coalescer_init(hmi_cmd_coalescer_t *coalescer, uint32_t flush_interval_ms)
+{
+    if (!coalescer) {
+        return;
+    }
+    memset(coalescer, 0, sizeof(*coalescer));
+    coalescer->flush_interval_ms = flush_interval_ms;
+}
+
+void hmi_cmd_coalescer_set_pwm(hmi_cmd_coalescer_t *coalescer, uint8_t channel, uint16_t duty)
+{
+    if (!coalescer || channel >= HMI_COALESCER_PWM_CHANNELS) {
+        return;
+    }
+    coalescer->pwm_duty[channel] = duty;
+    coalescer->pwm_pending_mask |= (uint16_t)(1U << channel);
+}
+
+void hmi_cmd_coalescer_set_pwm_frequency(hmi_cmd_coalescer_t *coalescer, uint16_t frequency_hz)
+{
+    if (!coalescer) {
+        return;
+    }
+    coalescer->freq = frequency_hz;
+    coalescer->freq_pending = true;
+}
+
+/**
+ * @brief Merge a masked GPIO write into the pending state of its port.
+ *
+ * Bits outside @p mask keep whatever value an earlier, still unsent write gave them.
+ */
+void hmi_cmd_coalescer_write_gpio(hmi_cmd_coalescer_t *coalescer, uint8_t device_index, uint8_t port, uint16_t mask,
+                                  uint16_t value)
+{
+    if (!coalescer || device_index >= HMI_COALESCER_GPIO_DEVICES || port >= HMI_COALESCER_GPIO_PORTS || mask == 0) {
+        return;
+    }
+    coalescer->gpio[device_index][port].value =
+        (uint16_t)((coalescer->gpio[device_index][port].value & ~mask) | (value & mask));
+    coalescer->gpio[device_index][port].mask |= mask;
+}
+
+/**
+ * @brief Flush on the next take regardless of the rate limit (e.g. slider released).
+ */
+void hmi_cmd_coalescer_request_flush(hmi_cmd_coalescer_t *coalescer)
+{
+    if (coalescer) {
+        coalescer->flush_requested = true;
+    }
+}
+
+bool hmi_cmd_coalescer_has_pending(const hmi_cmd_coalescer_t *coalescer)
+{
+    if (!coalescer) {
+        return false;
+    }
+    if (coalescer->pwm_pending_mask != 0 || coalescer->freq_pending) {
+        return true;
+    }
+    for (size_t dev = 0; dev < HMI_COALESCER_GPIO_DEVICES; ++dev) {
+        for (size_t port = 0; port < HMI_COALESCER_GPIO_PORTS; ++port) {
+            if (coalescer->gpio[dev][port].mask != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Drain all pending values into one batched command when a flush is due.
+ *
+ * @param coalescer Instance to drain.
+ * @param now_ms Current monotonic time.
+ * @param out Receives the batched command (timestamp and sequence left to the transport).
+ * @return true when @p out holds a command to send, false when nothing is due yet.
+ */
+bool hmi_cmd_coalescer_take(hmi_cmd_coalescer_t *coalescer, uint32_t now_ms, proto_command_t *out)
+{
+    if (!coalescer || !out || !hmi_cmd_coalescer_has_pending(coalescer)) {
+        return false;
+    }
+    if (!coalescer->flush_requested &&
+        (uint32_t)(now_ms - coalescer->last_flush_ms) < coalescer->flush_interval_ms) {
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    for (uint8_t ch = 0; ch < HMI_COALESCER_PWM_CHANNELS; ++ch) {
+        if (coalescer->pwm_pending_mask & (1U << ch)) {
+            proto_pwm_update_t *entry = &out->pwm_updates[out->pwm_update_count++];
+            entry->channel = ch;
+            entry->duty_cycle = coalescer->pwm_duty[ch];
+        }
+    }
+    out->has_pwm_frequency = coalescer->freq_pending;
+    out->pwm_frequency = coalescer->freq;
+    for (uint8_t dev = 0; dev < HMI_COALESCER_GPIO_DEVICES; ++dev) {
+        for (uint8_t port = 0; port < HMI_COALESCER_GPIO_PORTS; ++port) {
+            if (coalescer->gpio[dev][port].mask == 0) {
+                continue;
+            }
+            proto_gpio_write_t *entry = &out->gpio_writes[out->gpio_write_count++];
+            entry->device_index = dev;
+            entry->port = port;
+            entry->mask = coalescer->gpio[dev][port].mask;
+            entry->value = coalescer->gpio[dev][port].value;
+        }
+    }
+    coalescer->pwm_pending_mask = 0;
+    coalescer->freq_pending = false;
+    memset(coalescer->gpio, 0, sizeof(coalescer->gpio));
+    coalescer->flush_requested = false;
+    coalescer->last_flush_ms = now_ms;
+    return true;
+}
+
+/**
+ * @brief Put back a command the transport could not accept.
+ *
+ * Values set after the failed take win; the returned command only fills the gaps.
+ */
+void hmi_cmd_coalescer_requeue(hmi_cmd_coalescer_t *coalescer, const proto_command_t *cmd)
+{
+    if (!coalescer || !cmd) {
+        return;
+    }
+    for (size_t i = 0; i < cmd->pwm_update_count; ++i) {
+        uint8_t ch = cmd->pwm_updates[i].channel;
+        if (ch < HMI_COALESCER_PWM_CHANNELS && !(coalescer->pwm_pending_mask & (1U << ch))) {
+            hmi_cmd_coalescer_set_pwm(coalescer, ch, cmd->pwm_updates[i].duty_cycle);
+        }
+    }
+    if (cmd->has_pwm_frequency && !coalescer->freq_pending) {
+        hmi_cmd_coalescer_set_pwm_frequency(coalescer, cmd->pwm_frequency);
+    }
+    for (size_t i = 0; i < cmd->gpio_write_count; ++i) {
+        const proto_gpio_write_t *entry = &cmd->gpio_writes[i];
+        if (entry->device_index >= HMI_COALESCER_GPIO_DEVICES || entry->port >= HMI_COALESCER_GPIO_PORTS) {
+            continue;
+        }
+        uint16_t newer_mask = coalescer->gpio[entry->device_index][entry->port].mask;
+        hmi_cmd_coalescer_write_gpio(coalescer, entry->device_index, entry->port,
+                                     (uint16_t)(entry->mask & ~newer_mask), entry->value);
+    }
+}
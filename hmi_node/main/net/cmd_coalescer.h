@@ -0,0 +1,41 @@
+#pragma once
+
+#include "common/proto/messages.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HMI_COALESCER_PWM_CHANNELS 16U
+#define HMI_COALESCER_GPIO_DEVICES 2U
+#define HMI_COALESCER_GPIO_PORTS 2U
+
+/**
+ * Latest-value buffer between UI events and the command transport.
+ *
+ * Slider drags and toggle bursts overwrite pending entries in place; a flush folds
+ * everything still pending into one batched proto_command_t. Only the UI task
+ * touches the coalescer, so it carries no lock.
+ */
+typedef struct {
+    uint16_t pwm_pending_mask;
+    uint16_t pwm_duty[HMI_COALESCER_PWM_CHANNELS];
+    bool freq_pending;
+    uint16_t freq;
+    struct {
+        uint16_t mask;
+        uint16_t value;
+    } gpio[HMI_COALESCER_GPIO_DEVICES][HMI_COALESCER_GPIO_PORTS];
+    uint32_t flush_interval_ms;
+    uint32_t last_flush_ms;
+    bool flush_requested;
+} hmi_cmd_coalescer_t;
+
+void hmi_cmd_coalescer_init(hmi_cmd_coalescer_t *coalescer, uint32_t flush_interval_ms);
+void hmi_cmd_coalescer_set_pwm(hmi_cmd_coalescer_t *coalescer, uint8_t channel, uint16_t duty);
+void hmi_cmd_coalescer_set_pwm_frequency(hmi_cmd_coalescer_t *coalescer, uint16_t frequency_hz);
+void hmi_cmd_coalescer_write_gpio(hmi_cmd_coalescer_t *coalescer, uint8_t device_index, uint8_t port, uint16_t mask,
+                                  uint16_t value);
+void hmi_cmd_coalescer_request_flush(hmi_cmd_coalescer_t *coalescer);
+bool hmi_cmd_coalescer_has_pending(const hmi_cmd_coalescer_t *coalescer);
+bool hmi_cmd_coalescer_take(hmi_cmd_coalescer_t *coalescer, uint32_t now_ms, proto_command_t *out);
+void hmi_cmd_coalescer_requeue(hmi_cmd_coalescer_t *coalescer, const proto_command_t *cmd);
@@ -0,0 +1,182 @@
+#include "net/cmd_window.h"
+
+#include <string.h>
+
+static void release_slot(hmi_cmd_window_t *window, hmi_cmd_slot_t *slot)
+{
+    slot->in_use = false;
+    slot->frame_len = 0;
+    if (window->in_flight > 0) {
+        --window->in_flight;
+    }
+}
+
+static bool pwm_channel_covered(const proto_command_t *cmd, uint8_t channel)
+{
+    for (size_t i = 0; i < cmd->pwm_update_count; ++i) {
+        if (cmd->pwm_updates[i].channel == channel) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool gpio_bits_covered(const proto_command_t *cmd, const proto_gpio_write_t *write)
+{
+    uint16_t covered = 0;
+    for (size_t i = 0; i < cmd->gpio_write_count; ++i) {
+        const proto_gpio_write_t *entry = &cmd->gpio_writes[i];
+        if (entry->device_index == write->device_index && entry->port == write->port) {
+            covered |= entry->mask;
+        }
+    }
+    return (write->mask & ~covered) == 0;
+}
+
+/**
+ * @brief Check whether applying @p newer leaves nothing of @p older visible.
+ */
+static bool command_supersedes(const proto_command_t *newer, const proto_command_t *older)
+{
+    for (size_t i = 0; i < older->pwm_update_count; ++i) {
+        if (!pwm_channel_covered(newer, older->pwm_updates[i].channel)) {
+            return false;
+        }
+    }
+    if (older->has_pwm_frequency && !newer->has_pwm_frequency) {
+        return false;
+    }
+    for (size_t i = 0; i < older->gpio_write_count; ++i) {
+        if (!gpio_bits_covered(newer, &older->gpio_writes[i])) {
+            return false;
+        }
+    }
+    return older->pwm_update_count > 0 || older->has_pwm_frequency || older->gpio_write_count > 0;
+}
+
+/**
+ * @brief Reset a command window.
+ *
+ * @param window Window to initialise.
+ * @param retransmit_timeout_ms Time without ack before a command is resent.
+ * @param max_attempts Transmissions (including the first) before a command is abandoned.
+ */
+void hmi_cmd_window_init(hmi_cmd_window_t *window, uint32_t retransmit_timeout_ms, uint8_t max_attempts)
+{
+    if (!window) {
+        return;
+    }
+    memset(window, 0, sizeof(*window));
+    window->retransmit_timeout_ms = retransmit_timeout_ms;
+    window->max_attempts = max_attempts > 0 ? max_attempts : 1;
+}
+
+bool hmi_cmd_window_is_full(const hmi_cmd_window_t *window)
+{
+    return !window || window->in_flight >= HMI_CMD_WINDOW_SIZE;
+}
+
+/**
+ * @brief Track a freshly transmitted command until it is acknowledged.
+ *
+ * @param window Window instance.
+ * @param command Command carried by @p frame (used for supersession checks).
+ * @param frame CRC-prefixed frame exactly as handed to the transport.
+ * @param frame_len Length of @p frame.
+ * @param now_ms Monotonic timestamp of the transmission.
+ * @return true when the command now occupies a slot, false if the window is full.
+ */
+bool hmi_cmd_window_push(hmi_cmd_window_t *window, const proto_command_t *command, const uint8_t *frame,
+                         size_t frame_len, uint32_t now_ms)
+{
+    if (!window || !command || !frame || frame_len == 0 || frame_len > HMI_CMD_FRAME_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < HMI_CMD_WINDOW_SIZE; ++i) {
+        hmi_cmd_slot_t *slot = &window->slots[i];
+        if (slot->in_use && command_supersedes(command, &slot->command)) {
+            release_slot(window, slot);
+            ++window->superseded_count;
+        }
+    }
+    for (size_t i = 0; i < HMI_CMD_WINDOW_SIZE; ++i) {
+        hmi_cmd_slot_t *slot = &window->slots[i];
+        if (slot->in_use) {
+            continue;
+        }
+        slot->in_use = true;
+        slot->command = *command;
+        slot->sent_at_ms = now_ms;
+        slot->attempts = 1;
+        slot->frame_len = frame_len;
+        memcpy(slot->frame, frame, frame_len);
+        ++window->in_flight;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Apply an ack received from the sensor node.
+ *
+ * A busy ack keeps the command in flight so it is resent after the regular timeout.
+ *
+ * @return true when @p sequence_id matched an in-flight command.
+ */
+bool hmi_cmd_window_ack(hmi_cmd_window_t *window, uint32_t sequence_id, proto_ack_status_t status)
+{
+    if (!window) {
+        return false;
+    }
+    for (size_t i = 0; i < HMI_CMD_WINDOW_SIZE; ++i) {
+        hmi_cmd_slot_t *slot = &window->slots[i];
+        if (!slot->in_use || slot->command.sequence_id != sequence_id) {
+            continue;
+        }
+        if (status != PROTO_ACK_BUSY) {
+            release_slot(window, slot);
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Collect the commands whose ack is overdue, oldest sequence first.
+ *
+ * Returned slots are stamped as retransmitted at @p now_ms; the caller resends their
+ * frames. Commands that exhausted their attempts are dropped instead.
+ *
+ * @return Number of entries written to @p due.
+ */
+size_t hmi_cmd_window_collect_due(hmi_cmd_window_t *window, uint32_t now_ms, hmi_cmd_slot_t **due, size_t max_due)
+{
+    if (!window || !due || max_due == 0) {
+        return 0;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < HMI_CMD_WINDOW_SIZE; ++i) {
+        hmi_cmd_slot_t *slot = &window->slots[i];
+        if (!slot->in_use || (uint32_t)(now_ms - slot->sent_at_ms) < window->retransmit_timeout_ms) {
+            continue;
+        }
+        if (slot->attempts >= window->max_attempts) {
+            release_slot(window, slot);
+            ++window->expired_count;
+            continue;
+        }
+        if (count == max_due) {
+            continue;
+        }
+        slot->sent_at_ms = now_ms;
+        ++slot->attempts;
+        ++window->retransmit_count;
+        size_t pos = count++;
+        while (pos > 0 && (int32_t)(due[pos - 1]->command.sequence_id - slot->command.sequence_id) > 0) {
+            due[pos] = due[pos - 1];
+            --pos;
+        }
+        due[pos] = slot;
+    }
+    return count;
+}
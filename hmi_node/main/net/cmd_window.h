@@ -0,0 +1,43 @@
+#pragma once
+
+#include "common/proto/messages.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HMI_CMD_WINDOW_SIZE CONFIG_HMI_WS_CMD_WINDOW
+#define HMI_CMD_FRAME_MAX (PROTO_MAX_COMMAND_SIZE + sizeof(uint32_t))
+
+typedef struct {
+    bool in_use;
+    proto_command_t command;
+    uint32_t sent_at_ms;
+    uint8_t attempts;
+    size_t frame_len;
+    uint8_t frame[HMI_CMD_FRAME_MAX];
+} hmi_cmd_slot_t;
+
+/**
+ * Sliding window of commands awaiting an ack from the sensor node.
+ *
+ * A pushed command retires every older in-flight command whose targets it fully
+ * overwrites, so a selective retransmit can never roll an actuator back to a stale
+ * value. The window itself is not thread-safe; the owner serialises access.
+ */
+typedef struct {
+    hmi_cmd_slot_t slots[HMI_CMD_WINDOW_SIZE];
+    size_t in_flight;
+    uint32_t retransmit_timeout_ms;
+    uint8_t max_attempts;
+    uint32_t retransmit_count;
+    uint32_t expired_count;
+    uint32_t superseded_count;
+} hmi_cmd_window_t;
+
+void hmi_cmd_window_init(hmi_cmd_window_t *window, uint32_t retransmit_timeout_ms, uint8_t max_attempts);
+bool hmi_cmd_window_is_full(const hmi_cmd_window_t *window);
+bool hmi_cmd_window_push(hmi_cmd_window_t *window, const proto_command_t *command, const uint8_t *frame,
+                         size_t frame_len, uint32_t now_ms);
+bool hmi_cmd_window_ack(hmi_cmd_window_t *window, uint32_t sequence_id, proto_ack_status_t status);
+size_t hmi_cmd_window_collect_due(hmi_cmd_window_t *window, uint32_t now_ms, hmi_cmd_slot_t **due, size_t max_due);
@@ -0,0 +1,226 @@
+#include "net/history_backfill.h"
+
+#include <string.h>
+
+static const proto_history_channel_t k_series_channels[HMI_HISTORY_SERIES] = {
+    PROTO_HISTORY_CH_AMBIENT_TEMP_0,     PROTO_HISTORY_CH_AMBIENT_TEMP_1, PROTO_HISTORY_CH_AMBIENT_HUMIDITY_0,
+    PROTO_HISTORY_CH_AMBIENT_HUMIDITY_1, PROTO_HISTORY_CH_DS18B20_0,      PROTO_HISTORY_CH_DS18B20_1,
+    PROTO_HISTORY_CH_DS18B20_2,          PROTO_HISTORY_CH_DS18B20_3,
+};
+
+/**
+ * @brief Reset a backfill.
+ *
+ * @param backfill Backfill to initialise.
+ * @param timeout_ms Time to wait for a page before asking again.
+ * @param sequence_seed First request sequence id minus one.
+ */
+void hmi_history_backfill_init(hmi_history_backfill_t *backfill, uint32_t timeout_ms, uint32_t sequence_seed)
+{
+    if (!backfill) {
+        return;
+    }
+    memset(backfill, 0, sizeof(*backfill));
+    backfill->timeout_ms = timeout_ms;
+    backfill->sequence_id = sequence_seed;
+}
+
+/*
+ * Sample stamps are the sensor's 32-bit millisecond clock, which wraps every 49.7
+ * days while history pages count uptime in seconds. Place a stamp on the unwrapped
+ * clock nearest to reference_ms.
+ */
+static uint64_t unwrap_ms(uint64_t reference_ms, uint32_t stamp_ms)
+{
+    int64_t ms = (int64_t)reference_ms + (int32_t)(stamp_ms - (uint32_t)reference_ms);
+    return ms < 0 ? (uint64_t)ms + (1ULL << 32) : (uint64_t)ms;
+}
+
+/**
+ * @brief Remember the sensor timestamp of a live sample, so the next backfill
+ *        resumes after it.
+ *
+ * Each stamp is unwrapped against the previous one, or against the clock of the
+ * last history page before the first. Samples that arrive between a reconnection
+ * and hmi_history_backfill_set_connected() noticing it are ignored: they are newer
+ * than the gap still to be fetched.
+ */
+void hmi_history_backfill_note_sample(hmi_history_backfill_t *backfill, uint32_t sensor_time_ms)
+{
+    if (!backfill || !backfill->connected) {
+        return;
+    }
+    if (backfill->has_last_seen) {
+        backfill->last_seen_ms = unwrap_ms(backfill->last_seen_ms, sensor_time_ms);
+    } else {
+        backfill->last_seen_ms = backfill->has_clock ? unwrap_ms(backfill->clock_ms, sensor_time_ms) : sensor_time_ms;
+    }
+    backfill->has_last_seen = true;
+}
+
+static void begin(hmi_history_backfill_t *backfill)
+{
+    backfill->range_from_s = backfill->has_last_seen ? (uint32_t)(backfill->last_seen_ms / 1000U) + 1U : 0U;
+    backfill->from_s = backfill->range_from_s;
+    backfill->series = 0;
+    backfill->in_flight = false;
+    backfill->attempts = 0;
+    backfill->active = true;
+    backfill->ready = false;
+    memset(&backfill->snapshot, 0, sizeof(backfill->snapshot));
+}
+
+/**
+ * @brief Track the link state. Each new connection starts fetching the range
+ *        missed since the last live sample, discarding a snapshot not yet taken;
+ *        a drop abandons the fetch in progress.
+ */
+void hmi_history_backfill_set_connected(hmi_history_backfill_t *backfill, bool connected)
+{
+    if (!backfill || connected == backfill->connected) {
+        return;
+    }
+    backfill->connected = connected;
+    if (connected) {
+        begin(backfill);
+    } else {
+        backfill->active = false;
+        backfill->in_flight = false;
+    }
+}
+
+static void finish(hmi_history_backfill_t *backfill)
+{
+    backfill->active = false;
+    backfill->in_flight = false;
+    backfill->ready = true;
+}
+
+/**
+ * @brief Build the next page request, if one is due.
+ *
+ * A request is due when none is in flight, or when the one in flight has gone
+ * unanswered for the timeout; after HMI_HISTORY_MAX_ATTEMPTS unanswered requests
+ * the backfill stops and publishes what it has.
+ *
+ * @return true when @p out holds a request to send now.
+ */
+bool hmi_history_backfill_next_request(hmi_history_backfill_t *backfill, uint32_t now_ms,
+                                       proto_history_request_t *out)
+{
+    if (!backfill || !out || !backfill->active) {
+        return false;
+    }
+    if (backfill->in_flight) {
+        if (now_ms - backfill->sent_at_ms < backfill->timeout_ms) {
+            return false;
+        }
+        if (backfill->attempts >= HMI_HISTORY_MAX_ATTEMPTS) {
+            ++backfill->abandoned_count;
+            finish(backfill);
+            return false;
+        }
+    }
+    // A fresh sequence id per attempt, so a late answer to a timed-out request is ignored.
+    *out = (proto_history_request_t){
+        .sequence_id = ++backfill->sequence_id,
+        .channel = (uint8_t)k_series_channels[backfill->series],
+        .tier = PROTO_HISTORY_TIER_RAW,
+        .from_s = backfill->from_s,
+        .max_points = PROTO_MAX_HISTORY_POINTS,
+    };
+    backfill->in_flight = true;
+    backfill->sent_at_ms = now_ms;
+    ++backfill->attempts;
+    return true;
+}
+
+static void append_means(hmi_history_snapshot_t *snapshot, uint8_t series, const int16_t *src, size_t count)
+{
+    int16_t *values = snapshot->values[series];
+    size_t have = snapshot->count[series];
+    if (count > HMI_HISTORY_POINTS) {
+        src += count - HMI_HISTORY_POINTS;
+        count = HMI_HISTORY_POINTS;
+    }
+    if (have + count > HMI_HISTORY_POINTS) {
+        size_t drop = have + count - HMI_HISTORY_POINTS;
+        memmove(values, values + drop, (have - drop) * sizeof(values[0]));
+        have -= drop;
+    }
+    memcpy(values + have, src, count * sizeof(values[0]));
+    snapshot->count[series] = (uint16_t)(have + count);
+}
+
+/**
+ * @brief Stage a received history page.
+ *
+ * @return true when the page answered the outstanding request, false when it
+ *         belongs to another client or to a request already given up on.
+ */
+bool hmi_history_backfill_on_page(hmi_history_backfill_t *backfill, const proto_history_t *page)
+{
+    if (!backfill || !page || !backfill->active || !backfill->in_flight ||
+        page->sequence_id != backfill->sequence_id || page->channel != k_series_channels[backfill->series] ||
+        page->tier != PROTO_HISTORY_TIER_RAW) {
+        return false;
+    }
+    backfill->in_flight = false;
+    backfill->attempts = 0;
+    ++backfill->pages;
+    backfill->clock_ms = (uint64_t)page->now_s * 1000U;
+    backfill->has_clock = true;
+
+    if (page->now_s + 1U < backfill->range_from_s) {
+        // The sensor clock is behind our last sample: it rebooted, and all of its history is new to us.
+        backfill->has_last_seen = false;
+        backfill->range_from_s = 0;
+        backfill->from_s = 0;
+        backfill->series = 0;
+        memset(&backfill->snapshot, 0, sizeof(backfill->snapshot));
+        return true;
+    }
+    if (backfill->has_last_seen) {
+        // Stamps seen before the sensor's clock was known may sit a wrap too early.
+        backfill->last_seen_ms = unwrap_ms(backfill->clock_ms, (uint32_t)backfill->last_seen_ms);
+    }
+    if (page->period_s == 0) {
+        finish(backfill);
+        return true;
+    }
+
+    // Only the newest HMI_HISTORY_POINTS buckets fit the charts.
+    uint64_t span = (uint64_t)HMI_HISTORY_POINTS * page->period_s;
+    uint32_t floor_s = page->now_s > span ? (uint32_t)(page->now_s - span) : 0U;
+    size_t first = 0;
+    while (first < page->count && page->start_s + first * page->period_s < floor_s) {
+        ++first;
+    }
+    append_means(&backfill->snapshot, backfill->series, page->mean + first, page->count - first);
+    backfill->snapshot.period_s = page->period_s;
+
+    uint32_t next_s = page->start_s + (uint32_t)page->count * page->period_s;
+    if (page->more) {
+        backfill->from_s = next_s > floor_s ? next_s : floor_s;
+        return true;
+    }
+    if (++backfill->series == HMI_HISTORY_SERIES) {
+        finish(backfill);
+        return true;
+    }
+    backfill->from_s = backfill->range_from_s > floor_s ? backfill->range_from_s : floor_s;
+    return true;
+}
+
+/**
+ * @brief Hand over a finished backfill, once.
+ */
+bool hmi_history_backfill_take(hmi_history_backfill_t *backfill, hmi_history_snapshot_t *out)
+{
+    if (!backfill || !out || !backfill->ready) {
+        return false;
+    }
+    *out = backfill->snapshot;
+    backfill->ready = false;
+    return true;
+}
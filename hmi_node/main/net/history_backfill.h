@@ -0,0 +1,61 @@
+#pragma once
+
+#include "common/proto/messages.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HMI_HISTORY_POINTS 512U /* matches the Traces tab chart length */
+#define HMI_HISTORY_SERIES 8U
+#define HMI_HISTORY_MAX_ATTEMPTS 3U
+
+/*
+ * Raw-tier history of the channels charted on the Traces tab, oldest bucket
+ * first, in the history wire units (0.01 °C, 0.01 %RH). Series order: SHT20
+ * temperature 0-1, SHT20 humidity 0-1, DS18B20 0-3.
+ */
+typedef struct {
+    uint32_t period_s;
+    uint16_t count[HMI_HISTORY_SERIES];
+    int16_t values[HMI_HISTORY_SERIES][HMI_HISTORY_POINTS];
+} hmi_history_snapshot_t;
+
+/**
+ * Fetches, after each (re)connection, the history the charts missed while the
+ * link was down, one page request in flight at a time.
+ *
+ * The range starts after the newest live sample seen before the drop (or at the
+ * oldest bucket kept on first connect) and is clipped to the last
+ * HMI_HISTORY_POINTS buckets once the first page reveals the sensor's clock and
+ * bucket period. Pages are accepted only when they answer the outstanding
+ * request, since the sensor broadcasts them to every client. Not thread-safe;
+ * the owner serialises access.
+ */
+typedef struct {
+    bool connected;
+    bool has_last_seen;
+    uint64_t last_seen_ms; /* sensor uptime of the newest live sample, unwrapped */
+    bool has_clock;
+    uint64_t clock_ms; /* sensor uptime reported by the newest accepted page */
+    bool active;
+    bool ready;
+    uint8_t series;
+    uint32_t range_from_s;
+    uint32_t from_s;
+    uint32_t sequence_id;
+    bool in_flight;
+    uint32_t sent_at_ms;
+    uint8_t attempts;
+    uint32_t timeout_ms;
+    uint32_t pages;
+    uint32_t abandoned_count;
+    hmi_history_snapshot_t snapshot;
+} hmi_history_backfill_t;
+
+void hmi_history_backfill_init(hmi_history_backfill_t *backfill, uint32_t timeout_ms, uint32_t sequence_seed);
+void hmi_history_backfill_note_sample(hmi_history_backfill_t *backfill, uint32_t sensor_time_ms);
+void hmi_history_backfill_set_connected(hmi_history_backfill_t *backfill, bool connected);
+bool hmi_history_backfill_next_request(hmi_history_backfill_t *backfill, uint32_t now_ms,
+                                       proto_history_request_t *out);
+bool hmi_history_backfill_on_page(hmi_history_backfill_t *backfill, const proto_history_t *page);
+bool hmi_history_backfill_take(hmi_history_backfill_t *backfill, hmi_history_snapshot_t *out);
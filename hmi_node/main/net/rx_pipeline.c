@@ -0,0 +1,94 @@
+#include "net/rx_pipeline.h"
+
+_Static_assert((HMI_RX_RING_SIZE & (HMI_RX_RING_SIZE - 1)) == 0, "CONFIG_HMI_WS_RX_RING_SIZE must be a power of two");
+_Static_assert(HMI_RX_RING_SIZE >= 2 * HMI_RX_FRAME_MAX, "receive ring must hold two full frames");
+
+/**
+ * @brief Reset a receive pipeline.
+ *
+ * @param pipeline Pipeline to initialise; must not be in use by either task.
+ * @param is_cbor Payload encoding, used to classify frames on the decoder side.
+ */
+bool hmi_rx_pipeline_init(hmi_rx_pipeline_t *pipeline, bool is_cbor)
+{
+    if (!pipeline) {
+        return false;
+    }
+    pipeline->is_cbor = is_cbor;
+    pipeline->superseded_count = 0;
+    return frame_ring_init(&pipeline->ring, pipeline->storage, sizeof(pipeline->storage));
+}
+
+/**
+ * @brief Queue a received frame for the decoder. Call from the WebSocket event task only.
+ *
+ * The frame is not parsed here; the CRC travels as the ring tag so the payload is
+ * copied exactly once.
+ *
+ * @return true when queued, false when the ring is full and the frame was dropped.
+ */
+bool hmi_rx_pipeline_push(hmi_rx_pipeline_t *pipeline, const uint8_t *payload, size_t len, uint32_t crc)
+{
+    if (!pipeline || !payload || len == 0 || len > HMI_RX_FRAME_MAX) {
+        return false;
+    }
+    if (proto_peek_type(payload, len, pipeline->is_cbor) == PROTO_MSG_SENSOR_REPLAY) {
+        // Journal backlog: past state the charts get from the history backfill instead.
+        ++pipeline->replay_skipped;
+        return true;
+    }
+    return frame_ring_push(&pipeline->ring, crc, payload, len);
+}
+
+/**
+ * @brief Decode everything queued so far. Call from the decoder task only.
+ *
+ * Non-update frames reach @p handler in arrival order; of the queued sensor updates
+ * only the newest is delivered, once the ring is empty.
+ *
+ * @return Number of frames handed to @p handler.
+ */
+size_t hmi_rx_pipeline_drain(hmi_rx_pipeline_t *pipeline, hmi_rx_frame_handler_t handler, void *ctx)
+{
+    if (!pipeline || !handler) {
+        return 0;
+    }
+    uint8_t *work = pipeline->frames[0];
+    uint8_t *latest = pipeline->frames[1];
+    size_t latest_len = 0;
+    uint32_t latest_crc = 0;
+    bool have_latest = false;
+    size_t delivered = 0;
+    while (!frame_ring_is_empty(&pipeline->ring)) {
+        size_t len = 0;
+        uint32_t crc = 0;
+        if (!frame_ring_pop(&pipeline->ring, work, HMI_RX_FRAME_MAX, &len, &crc)) {
+            continue;
+        }
+        proto_msg_type_t type = proto_peek_type(work, len, pipeline->is_cbor);
+        if (type == PROTO_MSG_SENSOR_UPDATE) {
+            if (have_latest) {
+                ++pipeline->superseded_count;
+            }
+            uint8_t *swap = latest;
+            latest = work;
+            work = swap;
+            latest_len = len;
+            latest_crc = crc;
+            have_latest = true;
+            continue;
+        }
+        handler(type, work, len, crc, ctx);
+        ++delivered;
+    }
+    if (have_latest) {
+        handler(PROTO_MSG_SENSOR_UPDATE, latest, latest_len, latest_crc, ctx);
+        ++delivered;
+    }
+    return delivered;
+}
+
+uint32_t hmi_rx_pipeline_dropped(hmi_rx_pipeline_t *pipeline)
+{
+    return pipeline ? frame_ring_dropped(&pipeline->ring) : 0;
+}
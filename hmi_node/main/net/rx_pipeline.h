@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common/proto/messages.h"
+#include "common/util/frame_ring.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HMI_RX_RING_SIZE CONFIG_HMI_WS_RX_RING_SIZE
+#define HMI_RX_FRAME_MAX (2048U + sizeof(uint32_t))
+
+typedef void (*hmi_rx_frame_handler_t)(proto_msg_type_t type, const uint8_t *payload, size_t len, uint32_t crc,
+                                       void *ctx);
+
+/**
+ * Hand-off of received frames from the WebSocket event task to a decoder task.
+ *
+ * The event task only copies each raw frame into a lock-free SPSC ring. The
+ * decoder task drains the ring, delivering every ack in arrival order but only
+ * the newest sensor update, since older snapshots would be overwritten immediately.
+ * Sensor replays are never queued: they are past state, not live state.
+ */
+typedef struct {
+    frame_ring_t ring;
+    bool is_cbor;
+    uint8_t storage[HMI_RX_RING_SIZE];
+    uint8_t frames[2][HMI_RX_FRAME_MAX];
+    uint32_t superseded_count;
+    uint32_t replay_skipped; /* journal replays discarded before queueing; event task only */
+} hmi_rx_pipeline_t;
+
+bool hmi_rx_pipeline_init(hmi_rx_pipeline_t *pipeline, bool is_cbor);
+bool hmi_rx_pipeline_push(hmi_rx_pipeline_t *pipeline, const uint8_t *payload, size_t len, uint32_t crc);
+size_t hmi_rx_pipeline_drain(hmi_rx_pipeline_t *pipeline, hmi_rx_frame_handler_t handler, void *ctx);
+uint32_t hmi_rx_pipeline_dropped(hmi_rx_pipeline_t *pipeline);
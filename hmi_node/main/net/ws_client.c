@@ -1,5 +1,8 @@
 #include "net/ws_client.h"
 
+#include "net/cmd_window.h"
+#include "net/history_backfill.h"
+#include "net/rx_pipeline.h"
 #include "common/net/mdns_helper.h"
 #include "common/net/wifi_manager.h"
 #include "common/net/ws_client.h"
@@ -10,8 +13,10 @@
 #include "prefs_store.h"
 #include "cert_store.h"
 #include "esp_log.h"
+#include "esp_random.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "lwip/inet.h"
 #include "lwip/ip6_addr.h"
@@ -27,6 +32,11 @@ static const char *TAG = "hmi_ws";
 static hmi_data_model_t *s_model;
 static bool s_use_cbor;
 static uint32_t s_next_command_seq;
+static hmi_cmd_window_t s_cmd_window;
+static SemaphoreHandle_t s_cmd_lock;
+static StaticSemaphore_t s_cmd_lock_storage;
+static hmi_rx_pipeline_t s_rx_pipeline;
+static TaskHandle_t s_rx_task;
 static char s_discovered_server_name[64];
 static uint8_t s_sec2_salt[32];
 static uint8_t s_sec2_verifier[384];
@@ -40,11 +50,20 @@ static uint8_t s_ws_secret[64];
 static size_t s_ws_secret_len;
 static uint8_t s_totp_secret[64];
 static size_t s_totp_secret_len;
+#if CONFIG_HMI_HISTORY_BACKFILL
+static hmi_history_backfill_t s_backfill;
+static SemaphoreHandle_t s_history_lock;
+static StaticSemaphore_t s_history_lock_storage;
+#endif
 
 #define DISCOVERY_CACHE_NAMESPACE "hmi_net"
 #define DISCOVERY_CACHE_URI_KEY "last_uri"
 #define DISCOVERY_CACHE_SNI_KEY "last_sni"
 #define DISCOVERY_CACHE_TS_KEY "last_ts"
+#define CMD_ACK_LOCK_TIMEOUT pdMS_TO_TICKS(20)
+#define HISTORY_LOCK_TIMEOUT pdMS_TO_TICKS(20)
+#define RX_TASK_STACK 6144
+#define RX_TASK_PRIORITY 5
 
 typedef struct {
     char proto[8];
@@ -397,12 +416,102 @@ static void handle_sensor_update(const uint8_t *data, size_t len, uint32_t crc)
     }
     hmi_data_model_set_update(s_model, &update);
     hmi_data_model_set_crc_status(s_model, true);
+#if CONFIG_HMI_HISTORY_BACKFILL
+    if (s_history_lock && xSemaphoreTake(s_history_lock, HISTORY_LOCK_TIMEOUT) == pdTRUE) {
+        hmi_history_backfill_note_sample(&s_backfill, update.timestamp_ms);
+        xSemaphoreGive(s_history_lock);
+    }
+#endif
+}
+
+#if CONFIG_HMI_HISTORY_BACKFILL
+static void handle_history_page(const uint8_t *data, size_t len, uint32_t crc)
+{
+    /* Only touched from the decoder task. */
+    static proto_history_t page;
+    if (!proto_decode_history(data, len, s_use_cbor, &page, crc)) {
+        ESP_LOGW(TAG, "Failed to decode history page");
+        return;
+    }
+    if (!s_history_lock || xSemaphoreTake(s_history_lock, HISTORY_LOCK_TIMEOUT) != pdTRUE) {
+        return;
+    }
+    bool accepted = hmi_history_backfill_on_page(&s_backfill, &page);
+    bool done = accepted && !s_backfill.active;
+    uint32_t pages = s_backfill.pages;
+    xSemaphoreGive(s_history_lock);
+    if (done) {
+        ESP_LOGI(TAG, "History backfill complete after %" PRIu32 " page(s)", pages);
+    }
+}
+#endif
+
+static void handle_command_ack(const uint8_t *data, size_t len, uint32_t crc)
+{
+    proto_command_ack_t ack;
+    if (!proto_decode_command_ack(data, len, s_use_cbor, &ack, crc)) {
+        ESP_LOGW(TAG, "Failed to decode command ack");
+        return;
+    }
+    // Sensor updates must not stall behind a sender blocked in the transport; a
+    // dropped ack only costs a retransmit that the sensor answers as a duplicate.
+    if (!s_cmd_lock || xSemaphoreTake(s_cmd_lock, CMD_ACK_LOCK_TIMEOUT) != pdTRUE) {
+        return;
+    }
+    bool matched = hmi_cmd_window_ack(&s_cmd_window, ack.sequence_id, (proto_ack_status_t)ack.status);
+    xSemaphoreGive(s_cmd_lock);
+    if (ack.status == PROTO_ACK_BUSY) {
+        ESP_LOGD(TAG, "Sensor busy for command %" PRIu32 ", will retransmit", ack.sequence_id);
+    } else if (!matched) {
+        ESP_LOGD(TAG, "Ack for retired command %" PRIu32, ack.sequence_id);
+    }
+}
+
+static void dispatch_frame(proto_msg_type_t type, const uint8_t *data, size_t len, uint32_t crc, void *ctx)
+{
+    (void)ctx;
+    if (type == PROTO_MSG_COMMAND_ACK) {
+        handle_command_ack(data, len, crc);
+        return;
+    }
+    if (type == PROTO_MSG_HISTORY) {
+        // Pages are broadcast to every client; the backfill keeps only answers to its own requests.
+#if CONFIG_HMI_HISTORY_BACKFILL
+        handle_history_page(data, len, crc);
+#endif
+        return;
+    }
+    if (type == PROTO_MSG_SENSOR_UPDATE) {
+        handle_sensor_update(data, len, crc);
+    }
+}
+
+/**
+ * @brief Decoder task: parses frames queued by ws_rx() outside the WebSocket event task.
+ */
+static void rx_task(void *arg)
+{
+    (void)arg;
+    uint32_t reported_drops = 0;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        hmi_rx_pipeline_drain(&s_rx_pipeline, dispatch_frame, NULL);
+        uint32_t drops = hmi_rx_pipeline_dropped(&s_rx_pipeline);
+        if (drops != reported_drops) {
+            ESP_LOGW(TAG, "Receive ring overflow, %" PRIu32 " frame(s) dropped so far", drops);
+            reported_drops = drops;
+        }
+    }
 }
 
 static void ws_rx(const uint8_t *data, size_t len, uint32_t crc, void *ctx)
 {
     (void)ctx;
-    handle_sensor_update(data, len, crc);
+    // Runs in the esp_websocket_client event task: copy and wake the decoder only,
+    // so socket reads and pings never wait on cJSON/tinycbor.
+    if (hmi_rx_pipeline_push(&s_rx_pipeline, data, len, crc)) {
+        xTaskNotifyGive(s_rx_task);
+    }
 }
 
 static void ws_error_cb(const esp_websocket_event_data_t *event, void *ctx)
@@ -464,7 +573,29 @@ esp_err_t hmi_ws_client_start(hmi_data_model_t *model)
 #else
     s_use_cbor = false;
 #endif
-    s_next_command_seq = 0;
+    if (!s_cmd_lock) {
+        s_cmd_lock = xSemaphoreCreateMutexStatic(&s_cmd_lock_storage);
+    }
+    xSemaphoreTake(s_cmd_lock, portMAX_DELAY);
+    hmi_cmd_window_init(&s_cmd_window, CONFIG_HMI_WS_CMD_RETRANSMIT_MS, CONFIG_HMI_WS_CMD_MAX_ATTEMPTS);
+    // Start from a random sequence so the sensor's duplicate filter never mistakes a
+    // rebooted HMI for a retransmitting one.
+    s_next_command_seq = esp_random();
+    xSemaphoreGive(s_cmd_lock);
+#if CONFIG_HMI_HISTORY_BACKFILL
+    if (!s_history_lock) {
+        hmi_history_backfill_init(&s_backfill, CONFIG_HMI_HISTORY_REQUEST_TIMEOUT_MS, esp_random());
+        s_history_lock = xSemaphoreCreateMutexStatic(&s_history_lock_storage);
+    }
+#endif
+    if (!s_rx_task) {
+        hmi_rx_pipeline_init(&s_rx_pipeline, s_use_cbor);
+        if (xTaskCreatePinnedToCore(rx_task, "t_ws_rx", RX_TASK_STACK, NULL, RX_TASK_PRIORITY, &s_rx_task, 0) !=
+            pdPASS) {
+            s_rx_task = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
 
     esp_err_t err = ensure_wifi_ready();
     if (err != ESP_OK) {
@@ -523,6 +654,11 @@ esp_err_t hmi_ws_client_start(hmi_data_model_t *model)
         .crypto_secret = s_ws_secret_len > 0 ? s_ws_secret : NULL,
         .crypto_secret_len = s_ws_secret_len,
         .enable_frame_encryption = enable_encryption,
+#if CONFIG_HMI_WS_CIPHER_CHACHA20_POLY1305
+        .cipher_suite = WS_SECURITY_SUITE_CHACHA20_POLY1305,
+#else
+        .cipher_suite = WS_SECURITY_SUITE_AES256_GCM,
+#endif
         .enable_handshake_token = enable_handshake,
         .enable_totp = enable_totp,
         .totp_secret = s_totp_secret_len > 0 ? s_totp_secret : NULL,
@@ -552,29 +688,135 @@ bool hmi_ws_client_is_connected(void)
     return ws_client_is_connected();
 }
 
-esp_err_t hmi_ws_client_send_command(const proto_command_t *cmd)
+esp_err_t hmi_ws_client_send_command(const proto_command_t *cmd, bool *queued)
 {
+    if (queued) {
+        *queued = false;
+    }
     if (!cmd) {
         return ESP_ERR_INVALID_ARG;
     }
-    if (!hmi_ws_client_is_connected()) {
+    if (!hmi_ws_client_is_connected() || !s_cmd_lock) {
         return ESP_ERR_INVALID_STATE;
     }
+    xSemaphoreTake(s_cmd_lock, portMAX_DELAY);
     proto_command_t local = *cmd;
     local.timestamp_ms = monotonic_time_ms();
     local.sequence_id = ++s_next_command_seq;
 
-    uint8_t payload[PROTO_MAX_COMMAND_SIZE];
-    size_t payload_len = sizeof(payload);
+    uint8_t frame[HMI_CMD_FRAME_MAX];
+    size_t payload_len = PROTO_MAX_COMMAND_SIZE;
     uint32_t crc = 0;
-    if (!proto_encode_command_into(&local, s_use_cbor, payload, &payload_len, &crc)) {
+    if (!proto_encode_command_into(&local, s_use_cbor, frame + sizeof(uint32_t), &payload_len, &crc)) {
+        xSemaphoreGive(s_cmd_lock);
         return ESP_ERR_INVALID_RESPONSE;
     }
-    if (payload_len + sizeof(uint32_t) > sizeof(payload) + sizeof(uint32_t)) {
-        return ESP_ERR_INVALID_SIZE;
+    memcpy(frame, &crc, sizeof(uint32_t));
+    size_t frame_len = payload_len + sizeof(uint32_t);
+    if (!hmi_cmd_window_push(&s_cmd_window, &local, frame, frame_len, local.timestamp_ms)) {
+        xSemaphoreGive(s_cmd_lock);
+        ESP_LOGW(TAG, "Command window full (%u in flight)", (unsigned)s_cmd_window.in_flight);
+        return ESP_ERR_NO_MEM;
+    }
+    if (queued) {
+        *queued = true;
+    }
+    // Sending under the lock keeps frames in sequence order on the wire, which the
+    // receiver's replay counter depends on when encryption is enabled. A failed send
+    // stays in the window and is retried by hmi_ws_client_service().
+    esp_err_t err = ws_client_send(frame, frame_len);
+    xSemaphoreGive(s_cmd_lock);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Command %" PRIu32 " send failed (%s), will retransmit", local.sequence_id,
+                 esp_err_to_name(err));
+    }
+    return err;
+}
+
+#if CONFIG_HMI_HISTORY_BACKFILL
+/**
+ * @brief Start a backfill on each new connection and send its next page request.
+ *
+ * Requests go out one at a time from the network task, so history pages trickle
+ * in between live updates instead of arriving as one burst.
+ */
+static void service_history_backfill(bool connected)
+{
+    if (!s_history_lock || !s_cmd_lock) {
+        return;
+    }
+    proto_history_request_t req;
+    xSemaphoreTake(s_history_lock, portMAX_DELAY);
+    hmi_history_backfill_set_connected(&s_backfill, connected);
+    bool due = connected && hmi_history_backfill_next_request(&s_backfill, monotonic_time_ms(), &req);
+    xSemaphoreGive(s_history_lock);
+    if (!due) {
+        return;
+    }
+
+    uint8_t frame[PROTO_MAX_HISTORY_REQUEST_SIZE + sizeof(uint32_t)];
+    size_t payload_len = PROTO_MAX_HISTORY_REQUEST_SIZE;
+    uint32_t crc = 0;
+    if (!proto_encode_history_request_into(&req, s_use_cbor, frame + sizeof(uint32_t), &payload_len, &crc)) {
+        return;
     }
-    uint8_t frame[PROTO_MAX_COMMAND_SIZE + sizeof(uint32_t)];
     memcpy(frame, &crc, sizeof(uint32_t));
-    memcpy(frame + sizeof(uint32_t), payload, payload_len);
-    return ws_client_send(frame, payload_len + sizeof(uint32_t));
+    // Same lock as commands: frames must reach the wire in replay-counter order.
+    xSemaphoreTake(s_cmd_lock, portMAX_DELAY);
+    esp_err_t err = ws_client_send(frame, payload_len + sizeof(uint32_t));
+    xSemaphoreGive(s_cmd_lock);
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "History request %" PRIu32 " send failed (%s), will retry", req.sequence_id,
+                 esp_err_to_name(err));
+    }
+}
+#endif
+
+/**
+ * @brief Take the history fetched after the last (re)connection, once it is complete.
+ */
+bool hmi_ws_client_take_history(hmi_history_snapshot_t *out)
+{
+#if CONFIG_HMI_HISTORY_BACKFILL
+    if (!out || !s_history_lock || xSemaphoreTake(s_history_lock, HISTORY_LOCK_TIMEOUT) != pdTRUE) {
+        return false;
+    }
+    bool taken = hmi_history_backfill_take(&s_backfill, out);
+    xSemaphoreGive(s_history_lock);
+    return taken;
+#else
+    (void)out;
+    return false;
+#endif
+}
+
+/**
+ * @brief Retransmit commands whose ack is overdue and drive the history backfill.
+ *
+ * Only the unacknowledged commands are resent, oldest first. Call periodically from
+ * the network task at a fraction of CONFIG_HMI_WS_CMD_RETRANSMIT_MS.
+ */
+void hmi_ws_client_service(void)
+{
+    bool connected = hmi_ws_client_is_connected();
+#if CONFIG_HMI_HISTORY_BACKFILL
+    service_history_backfill(connected);
+#endif
+    if (!s_cmd_lock || !connected) {
+        return;
+    }
+    hmi_cmd_slot_t *due[HMI_CMD_WINDOW_SIZE];
+    xSemaphoreTake(s_cmd_lock, portMAX_DELAY);
+    uint32_t expired_before = s_cmd_window.expired_count;
+    size_t count = hmi_cmd_window_collect_due(&s_cmd_window, monotonic_time_ms(), due, HMI_CMD_WINDOW_SIZE);
+    for (size_t i = 0; i < count; ++i) {
+        if (ws_client_send(due[i]->frame, due[i]->frame_len) != ESP_OK) {
+            break;
+        }
+    }
+    uint32_t expired = s_cmd_window.expired_count - expired_before;
+    xSemaphoreGive(s_cmd_lock);
+    if (expired > 0) {
+        ESP_LOGW(TAG, "Abandoned %" PRIu32 " unacknowledged command(s)", expired);
+    }
 }
@@ -2,9 +2,17 @@
 
 #include "common/proto/messages.h"
 #include "data_model.h"
+#include "net/history_backfill.h"
 #include "esp_err.h"
 
 esp_err_t hmi_ws_client_start(hmi_data_model_t *model);
 void hmi_ws_client_stop(void);
 bool hmi_ws_client_is_connected(void);
-esp_err_t hmi_ws_client_send_command(const proto_command_t *cmd);
+/**
+ * Send a command through the retransmit window. @p queued (optional) is set once the
+ * command is in the window: a failed send is then retransmitted and the command must
+ * not be resubmitted. ESP_ERR_NO_MEM with nothing queued means the window is full.
+ */
+esp_err_t hmi_ws_client_send_command(const proto_command_t *cmd, bool *queued);
+void hmi_ws_client_service(void);
+bool hmi_ws_client_take_history(hmi_history_snapshot_t *out);
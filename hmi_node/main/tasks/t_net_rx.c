@@ -5,6 +5,8 @@
 #include "net/ws_client.h"
 #include "esp_log.h"
 
+#define NET_TASK_PERIOD_MS 50
+
 static hmi_data_model_t *s_model;
 static const char *TAG = "t_net";
 
@@ -25,7 +27,8 @@ static void net_task(void *arg)
         }
         bool connected = hmi_ws_client_is_connected();
         hmi_data_model_set_connected(s_model, connected);
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        hmi_ws_client_service();
+        vTaskDelay(pdMS_TO_TICKS(NET_TASK_PERIOD_MS));
     }
 }
 
@@ -3,52 +3,63 @@
 #include "display/lvgl_port.h"
 #include "display/ui_screens.h"
 #include "common/proto/messages.h"
+#include "common/util/monotonic.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "net/cmd_coalescer.h"
 #include "net/ws_client.h"
 #include "prefs_store.h"
+#include "sdkconfig.h"
 
 static hmi_data_model_t *s_model;
 static hmi_user_preferences_t s_prefs;
+static hmi_cmd_coalescer_t s_coalescer;
+static hmi_history_snapshot_t s_history;
 static const char *TAG = "ui_task";
 
 static void ui_cb_set_pwm(uint8_t channel, uint16_t duty, void *ctx)
 {
     (void)ctx;
-    proto_command_t cmd = {
-        .has_pwm_update = true,
-        .pwm_update = {
-            .channel = channel,
-            .duty_cycle = duty,
-        },
-    };
-    hmi_ws_client_send_command(&cmd);
+    hmi_cmd_coalescer_set_pwm(&s_coalescer, channel, duty);
 }
 
 static void ui_cb_set_pwm_freq(uint16_t freq, void *ctx)
 {
     (void)ctx;
-    proto_command_t cmd = {
-        .has_pwm_frequency = true,
-        .pwm_frequency = freq,
-    };
-    hmi_ws_client_send_command(&cmd);
+    hmi_cmd_coalescer_set_pwm_frequency(&s_coalescer, freq);
 }
 
 static void ui_cb_write_gpio(uint8_t device_index, uint8_t port, uint16_t mask, uint16_t value, void *ctx)
 {
     (void)ctx;
-    proto_command_t cmd = {
-        .has_gpio_write = true,
-        .gpio_write = {
-            .device_index = device_index,
-            .port = port,
-            .mask = mask,
-            .value = value,
-        },
-    };
-    hmi_ws_client_send_command(&cmd);
+    hmi_cmd_coalescer_write_gpio(&s_coalescer, device_index, port, mask, value);
+}
+
+static void ui_cb_flush_commands(void *ctx)
+{
+    (void)ctx;
+    hmi_cmd_coalescer_request_flush(&s_coalescer);
+}
+
+static void flush_pending_commands(void)
+{
+    proto_command_t cmd;
+    if (!hmi_cmd_coalescer_take(&s_coalescer, monotonic_time_ms(), &cmd)) {
+        return;
+    }
+    bool queued = false;
+    esp_err_t err = hmi_ws_client_send_command(&cmd, &queued);
+    if (queued || err == ESP_OK) {
+        // A failed first send is retransmitted from the command window.
+        return;
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        // Command window full: keep the values and retry on the next flush.
+        hmi_cmd_coalescer_requeue(&s_coalescer, &cmd);
+    } else {
+        ESP_LOGD(TAG, "Dropping command batch: %s", esp_err_to_name(err));
+    }
 }
 
 static void ui_cb_apply_prefs(const hmi_user_preferences_t *prefs, void *ctx)
@@ -89,7 +100,9 @@ static void ui_task(void *arg)
         .write_gpio = ui_cb_write_gpio,
         .apply_preferences = ui_cb_apply_prefs,
         .reset_preferences = ui_cb_reset_prefs,
+        .flush_commands = ui_cb_flush_commands,
     };
+    hmi_cmd_coalescer_init(&s_coalescer, CONFIG_HMI_CMD_FLUSH_INTERVAL_MS);
 
     lvgl_port_init();
     ui_init(&callbacks, NULL);
@@ -102,12 +115,18 @@ static void ui_task(void *arg)
     }
 
     while (true) {
+        /* Connection first: a reconnect resets the live point count, so the
+         * first update after it must be charted against the fresh count. */
+        ui_update_connection_status(hmi_data_model_is_connected(s_model));
         if (hmi_data_model_get_update(s_model, &update)) {
             ui_update_sensor_data(&update, s_prefs.use_fahrenheit);
         }
-        ui_update_connection_status(hmi_data_model_is_connected(s_model));
+        if (hmi_ws_client_take_history(&s_history)) {
+            ui_load_history(&s_history, s_prefs.use_fahrenheit);
+        }
         ui_update_crc_status(hmi_data_model_get_crc_status(s_model));
         ui_process();
+        flush_pending_commands();
         vTaskDelay(pdMS_TO_TICKS(33));
     }
 }
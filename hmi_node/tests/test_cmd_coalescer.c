@@ -0,0 +1,115 @@
+#include "net/cmd_coalescer.h"
+
+#include "unity.h"
+#include <string.h>
+
+TEST_CASE("coalescer keeps the latest value per channel", "[hmi][cmd]")
+{
+    hmi_cmd_coalescer_t coalescer;
+    hmi_cmd_coalescer_init(&coalescer, 100);
+    for (uint16_t duty = 0; duty <= 4000; duty += 100) {
+        hmi_cmd_coalescer_set_pwm(&coalescer, 3, duty);
+        hmi_cmd_coalescer_set_pwm(&coalescer, 7, (uint16_t)(4000 - duty));
+    }
+    hmi_cmd_coalescer_set_pwm_frequency(&coalescer, 500);
+    hmi_cmd_coalescer_set_pwm_frequency(&coalescer, 1200);
+
+    proto_command_t cmd;
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 100, &cmd));
+    TEST_ASSERT_EQUAL(2, cmd.pwm_update_count);
+    TEST_ASSERT_EQUAL_UINT8(3, cmd.pwm_updates[0].channel);
+    TEST_ASSERT_EQUAL_UINT16(4000, cmd.pwm_updates[0].duty_cycle);
+    TEST_ASSERT_EQUAL_UINT8(7, cmd.pwm_updates[1].channel);
+    TEST_ASSERT_EQUAL_UINT16(0, cmd.pwm_updates[1].duty_cycle);
+    TEST_ASSERT_TRUE(cmd.has_pwm_frequency);
+    TEST_ASSERT_EQUAL_UINT16(1200, cmd.pwm_frequency);
+    TEST_ASSERT_EQUAL(0, cmd.gpio_write_count);
+    TEST_ASSERT_FALSE(hmi_cmd_coalescer_has_pending(&coalescer));
+}
+
+TEST_CASE("coalescer rate limits flushes unless released", "[hmi][cmd]")
+{
+    hmi_cmd_coalescer_t coalescer;
+    hmi_cmd_coalescer_init(&coalescer, 100);
+    proto_command_t cmd;
+    hmi_cmd_coalescer_set_pwm(&coalescer, 0, 10);
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 1000, &cmd));
+
+    hmi_cmd_coalescer_set_pwm(&coalescer, 0, 20);
+    TEST_ASSERT_FALSE(hmi_cmd_coalescer_take(&coalescer, 1050, &cmd));
+    hmi_cmd_coalescer_request_flush(&coalescer);
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 1051, &cmd));
+    TEST_ASSERT_EQUAL_UINT16(20, cmd.pwm_updates[0].duty_cycle);
+
+    hmi_cmd_coalescer_set_pwm(&coalescer, 0, 30);
+    TEST_ASSERT_FALSE(hmi_cmd_coalescer_take(&coalescer, 1150, &cmd));
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 1151, &cmd));
+    TEST_ASSERT_FALSE(hmi_cmd_coalescer_take(&coalescer, 5000, &cmd));
+}
+
+TEST_CASE("coalescer merges masked gpio writes per port", "[hmi][cmd]")
+{
+    hmi_cmd_coalescer_t coalescer;
+    hmi_cmd_coalescer_init(&coalescer, 0);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 1, 0, 0x01, 0x01);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 1, 0, 0x02, 0x02);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 1, 0, 0x01, 0x00);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 0, 1, 0x80, 0x80);
+
+    proto_command_t cmd;
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 0, &cmd));
+    TEST_ASSERT_EQUAL(2, cmd.gpio_write_count);
+    TEST_ASSERT_EQUAL_UINT8(0, cmd.gpio_writes[0].device_index);
+    TEST_ASSERT_EQUAL_UINT8(1, cmd.gpio_writes[0].port);
+    TEST_ASSERT_EQUAL_UINT16(0x80, cmd.gpio_writes[0].mask);
+    TEST_ASSERT_EQUAL_UINT8(1, cmd.gpio_writes[1].device_index);
+    TEST_ASSERT_EQUAL_UINT16(0x03, cmd.gpio_writes[1].mask);
+    TEST_ASSERT_EQUAL_UINT16(0x02, cmd.gpio_writes[1].value);
+}
+
+TEST_CASE("coalescer requeue never overrides newer values", "[hmi][cmd]")
+{
+    hmi_cmd_coalescer_t coalescer;
+    hmi_cmd_coalescer_init(&coalescer, 0);
+    hmi_cmd_coalescer_set_pwm(&coalescer, 1, 100);
+    hmi_cmd_coalescer_set_pwm(&coalescer, 2, 200);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 0, 0, 0x0F, 0x0F);
+    proto_command_t failed;
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 0, &failed));
+
+    hmi_cmd_coalescer_set_pwm(&coalescer, 2, 222);
+    hmi_cmd_coalescer_write_gpio(&coalescer, 0, 0, 0x03, 0x00);
+    hmi_cmd_coalescer_requeue(&coalescer, &failed);
+
+    proto_command_t cmd;
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 1, &cmd));
+    TEST_ASSERT_EQUAL(2, cmd.pwm_update_count);
+    TEST_ASSERT_EQUAL_UINT16(100, cmd.pwm_updates[0].duty_cycle);
+    TEST_ASSERT_EQUAL_UINT16(222, cmd.pwm_updates[1].duty_cycle);
+    TEST_ASSERT_EQUAL(1, cmd.gpio_write_count);
+    TEST_ASSERT_EQUAL_UINT16(0x0F, cmd.gpio_writes[0].mask);
+    TEST_ASSERT_EQUAL_UINT16(0x0C, cmd.gpio_writes[0].value);
+}
+
+TEST_CASE("coalesced batch fits a single command frame", "[hmi][cmd]")
+{
+    hmi_cmd_coalescer_t coalescer;
+    hmi_cmd_coalescer_init(&coalescer, 0);
+    for (uint8_t ch = 0; ch < HMI_COALESCER_PWM_CHANNELS; ++ch) {
+        hmi_cmd_coalescer_set_pwm(&coalescer, ch, 4095);
+    }
+    hmi_cmd_coalescer_set_pwm_frequency(&coalescer, 1526);
+    for (uint8_t dev = 0; dev < HMI_COALESCER_GPIO_DEVICES; ++dev) {
+        for (uint8_t port = 0; port < HMI_COALESCER_GPIO_PORTS; ++port) {
+            hmi_cmd_coalescer_write_gpio(&coalescer, dev, port, 0xFF, 0xFF);
+        }
+    }
+    proto_command_t cmd;
+    TEST_ASSERT_TRUE(hmi_cmd_coalescer_take(&coalescer, 0, &cmd));
+    cmd.timestamp_ms = UINT32_MAX;
+    cmd.sequence_id = UINT32_MAX;
+
+    uint8_t buffer[PROTO_MAX_COMMAND_SIZE];
+    size_t len = sizeof(buffer);
+    TEST_ASSERT_TRUE(proto_encode_command_into(&cmd, false, buffer, &len, NULL));
+}
@@ -0,0 +1,127 @@
+#include "net/cmd_window.h"
+
+#include "unity.h"
+#include <string.h>
+
+static proto_command_t make_pwm_command(uint32_t seq, uint8_t channel, uint16_t duty)
+{
+    proto_command_t cmd = {
+        .sequence_id = seq,
+        .pwm_update_count = 1,
+        .pwm_updates = {
+            {.channel = channel, .duty_cycle = duty},
+        },
+    };
+    return cmd;
+}
+
+TEST_CASE("command window releases slots on ack", "[hmi][cmd]")
+{
+    hmi_cmd_window_t window;
+    hmi_cmd_window_init(&window, 100, 3);
+    const uint8_t frame[] = {1, 2, 3, 4, 5};
+
+    for (uint32_t i = 0; i < HMI_CMD_WINDOW_SIZE; ++i) {
+        proto_command_t cmd = make_pwm_command(10 + i, (uint8_t)i, 100);
+        TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &cmd, frame, sizeof(frame), 0));
+    }
+    TEST_ASSERT_TRUE(hmi_cmd_window_is_full(&window));
+    proto_command_t overflow = make_pwm_command(99, 15, 1);
+    if (HMI_CMD_WINDOW_SIZE < 15) {
+        TEST_ASSERT_FALSE(hmi_cmd_window_push(&window, &overflow, frame, sizeof(frame), 0));
+    }
+
+    TEST_ASSERT_TRUE(hmi_cmd_window_ack(&window, 10, PROTO_ACK_OK));
+    TEST_ASSERT_FALSE(hmi_cmd_window_ack(&window, 10, PROTO_ACK_DUPLICATE));
+    TEST_ASSERT_EQUAL(HMI_CMD_WINDOW_SIZE - 1, window.in_flight);
+    TEST_ASSERT_FALSE(hmi_cmd_window_is_full(&window));
+}
+
+TEST_CASE("command window retransmits only overdue commands", "[hmi][cmd]")
+{
+    hmi_cmd_window_t window;
+    hmi_cmd_window_init(&window, 100, 3);
+    const uint8_t frame[] = {0xAA};
+    proto_command_t a = make_pwm_command(5, 0, 10);
+    proto_command_t b = make_pwm_command(6, 1, 20);
+    proto_command_t c = make_pwm_command(7, 2, 30);
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &c, frame, sizeof(frame), 0));
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &a, frame, sizeof(frame), 0));
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &b, frame, sizeof(frame), 50));
+    TEST_ASSERT_TRUE(hmi_cmd_window_ack(&window, 7, PROTO_ACK_OK));
+
+    hmi_cmd_slot_t *due[HMI_CMD_WINDOW_SIZE];
+    TEST_ASSERT_EQUAL(0, hmi_cmd_window_collect_due(&window, 99, due, HMI_CMD_WINDOW_SIZE));
+    TEST_ASSERT_EQUAL(1, hmi_cmd_window_collect_due(&window, 100, due, HMI_CMD_WINDOW_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(5, due[0]->command.sequence_id);
+    TEST_ASSERT_EQUAL(2, due[0]->attempts);
+
+    size_t count = hmi_cmd_window_collect_due(&window, 200, due, HMI_CMD_WINDOW_SIZE);
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_UINT32(5, due[0]->command.sequence_id);
+    TEST_ASSERT_EQUAL_UINT32(6, due[1]->command.sequence_id);
+    TEST_ASSERT_EQUAL_UINT32(3, window.retransmit_count);
+}
+
+TEST_CASE("command window keeps busy commands and expires exhausted ones", "[hmi][cmd]")
+{
+    hmi_cmd_window_t window;
+    hmi_cmd_window_init(&window, 100, 2);
+    const uint8_t frame[] = {0x01};
+    proto_command_t cmd = make_pwm_command(1, 3, 40);
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &cmd, frame, sizeof(frame), 0));
+
+    TEST_ASSERT_TRUE(hmi_cmd_window_ack(&window, 1, PROTO_ACK_BUSY));
+    TEST_ASSERT_EQUAL(1, window.in_flight);
+
+    hmi_cmd_slot_t *due[HMI_CMD_WINDOW_SIZE];
+    TEST_ASSERT_EQUAL(1, hmi_cmd_window_collect_due(&window, 100, due, HMI_CMD_WINDOW_SIZE));
+    TEST_ASSERT_EQUAL(0, hmi_cmd_window_collect_due(&window, 200, due, HMI_CMD_WINDOW_SIZE));
+    TEST_ASSERT_EQUAL(0, window.in_flight);
+    TEST_ASSERT_EQUAL_UINT32(1, window.expired_count);
+}
+
+TEST_CASE("command window retires superseded commands", "[hmi][cmd]")
+{
+    hmi_cmd_window_t window;
+    hmi_cmd_window_init(&window, 100, 3);
+    const uint8_t frame[] = {0x01};
+    proto_command_t first = make_pwm_command(1, 4, 100);
+    proto_command_t other = make_pwm_command(2, 5, 100);
+    proto_command_t latest = make_pwm_command(3, 4, 900);
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &first, frame, sizeof(frame), 0));
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &other, frame, sizeof(frame), 0));
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &latest, frame, sizeof(frame), 0));
+    TEST_ASSERT_EQUAL(2, window.in_flight);
+    TEST_ASSERT_EQUAL_UINT32(1, window.superseded_count);
+
+    proto_command_t gpio_narrow = {
+        .sequence_id = 4,
+        .gpio_write_count = 1,
+        .gpio_writes = {
+            {.device_index = 1, .port = 0, .mask = 0x0F, .value = 0x05},
+        },
+    };
+    proto_command_t gpio_other_bits = {
+        .sequence_id = 5,
+        .gpio_write_count = 1,
+        .gpio_writes = {
+            {.device_index = 1, .port = 0, .mask = 0xF0, .value = 0x10},
+        },
+    };
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &gpio_narrow, frame, sizeof(frame), 0));
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &gpio_other_bits, frame, sizeof(frame), 0));
+    TEST_ASSERT_EQUAL(4, window.in_flight);
+
+    proto_command_t gpio_batch = {
+        .sequence_id = 6,
+        .gpio_write_count = 2,
+        .gpio_writes = {
+            {.device_index = 1, .port = 0, .mask = 0x3F, .value = 0x00},
+            {.device_index = 1, .port = 0, .mask = 0xC0, .value = 0xC0},
+        },
+    };
+    TEST_ASSERT_TRUE(hmi_cmd_window_push(&window, &gpio_batch, frame, sizeof(frame), 0));
+    TEST_ASSERT_EQUAL(3, window.in_flight);
+    TEST_ASSERT_EQUAL_UINT32(3, window.superseded_count);
+}
@@ -0,0 +1,246 @@
+#include "net/history_backfill.h"
+
+#include "unity.h"
+#include <string.h>
+
+static proto_history_t s_page;
+
+/* Answer the outstanding request with count buckets valued base, base + 1, ... */
+static const proto_history_t *make_page(const proto_history_request_t *req, uint32_t now_s, uint32_t period_s,
+                                        uint32_t start_s, uint16_t count, bool more, int16_t base)
+{
+    memset(&s_page, 0, sizeof(s_page));
+    s_page.sequence_id = req->sequence_id;
+    s_page.channel = req->channel;
+    s_page.tier = req->tier;
+    s_page.now_s = now_s;
+    s_page.period_s = period_s;
+    s_page.start_s = start_s;
+    s_page.more = more;
+    s_page.count = count;
+    for (uint16_t i = 0; i < count; ++i) {
+        s_page.mean[i] = (int16_t)(base + i);
+    }
+    return &s_page;
+}
+
+/* Answer the request in flight, if any, and every remaining series with an empty last page. */
+static void finish_remaining(hmi_history_backfill_t *bf, uint32_t now_s, const proto_history_request_t *pending)
+{
+    proto_history_request_t req;
+    if (pending) {
+        TEST_ASSERT_TRUE(
+            hmi_history_backfill_on_page(bf, make_page(pending, now_s, 5, pending->from_s, 0, false, 0)));
+    }
+    while (hmi_history_backfill_next_request(bf, 0, &req)) {
+        TEST_ASSERT_TRUE(hmi_history_backfill_on_page(bf, make_page(&req, now_s, 5, req.from_s, 0, false, 0)));
+    }
+}
+
+TEST_CASE("history backfill starts from the oldest bucket on first connect", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    hmi_history_backfill_init(&bf, 1000, 41);
+    TEST_ASSERT_FALSE(hmi_history_backfill_next_request(&bf, 0, &req));
+
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(42, req.sequence_id);
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_CH_AMBIENT_TEMP_0, req.channel);
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_TIER_RAW, req.tier);
+    TEST_ASSERT_EQUAL_UINT32(0, req.from_s);
+    TEST_ASSERT_EQUAL_UINT16(PROTO_MAX_HISTORY_POINTS, req.max_points);
+    // One request in flight at a time.
+    TEST_ASSERT_FALSE(hmi_history_backfill_next_request(&bf, 10, &req));
+}
+
+TEST_CASE("history backfill resumes after the last live sample", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    hmi_history_backfill_note_sample(&bf, 100500);
+    hmi_history_backfill_set_connected(&bf, false);
+    // Arrives before the reconnection is noticed: newer than the gap, not the end of it.
+    hmi_history_backfill_note_sample(&bf, 160000);
+    hmi_history_backfill_set_connected(&bf, true);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(101, req.from_s);
+}
+
+TEST_CASE("history backfill resumes after a sample stamped past the millisecond wrap", "[hmi][history]")
+{
+    /* Sample stamps wrap after 2^32 ms (4294967.296 s of sensor uptime). */
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    finish_remaining(&bf, 4294960, &req);
+    hmi_history_backfill_note_sample(&bf, 4294960000U);
+    hmi_history_backfill_note_sample(&bf, 2704); /* 4294970.000 s */
+    hmi_history_backfill_set_connected(&bf, false);
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(4294971, req.from_s);
+
+    /* First connection after the wrap: the first page tells which wrap the stamps belong to. */
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    hmi_history_backfill_note_sample(&bf, 2704);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    finish_remaining(&bf, 4294975, &req);
+    hmi_history_backfill_note_sample(&bf, 7704);
+    hmi_history_backfill_set_connected(&bf, false);
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(4294976, req.from_s);
+}
+
+TEST_CASE("history backfill pages through each series and publishes once", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    static hmi_history_snapshot_t snapshot;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 2000, 5, 0, 128, true, 0)));
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_CH_AMBIENT_TEMP_0, req.channel);
+    TEST_ASSERT_EQUAL_UINT32(640, req.from_s);
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 2000, 5, 640, 10, false, 128)));
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_CH_AMBIENT_TEMP_1, req.channel);
+    TEST_ASSERT_EQUAL_UINT32(0, req.from_s);
+    TEST_ASSERT_FALSE(hmi_history_backfill_take(&bf, &snapshot));
+
+    finish_remaining(&bf, 2000, &req);
+    TEST_ASSERT_EQUAL_UINT32(HMI_HISTORY_SERIES + 1, bf.pages);
+    TEST_ASSERT_TRUE(hmi_history_backfill_take(&bf, &snapshot));
+    TEST_ASSERT_FALSE(hmi_history_backfill_take(&bf, &snapshot));
+    TEST_ASSERT_EQUAL_UINT32(5, snapshot.period_s);
+    TEST_ASSERT_EQUAL_UINT16(138, snapshot.count[0]);
+    TEST_ASSERT_EQUAL_INT16(0, snapshot.values[0][0]);
+    TEST_ASSERT_EQUAL_INT16(137, snapshot.values[0][137]);
+    TEST_ASSERT_EQUAL_UINT16(0, snapshot.count[1]);
+}
+
+TEST_CASE("history backfill keeps only the buckets the charts can show", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    static hmi_history_snapshot_t snapshot;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+
+    // 512 buckets of 5 s reach back to 10000 - 2560 = 7440 s.
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 10000, 5, 7000, 128, true, 0)));
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(7640, req.from_s);
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 10000, 5, 7640, 10, false, 1000)));
+
+    // Later series skip straight to the floor.
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(7440, req.from_s);
+    finish_remaining(&bf, 10000, &req);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_take(&bf, &snapshot));
+    TEST_ASSERT_EQUAL_UINT16(40 + 10, snapshot.count[0]);
+    TEST_ASSERT_EQUAL_INT16(88, snapshot.values[0][0]);
+    TEST_ASSERT_EQUAL_INT16(1009, snapshot.values[0][49]);
+}
+
+TEST_CASE("history backfill ignores pages meant for other requests", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+
+    proto_history_request_t other = req;
+    other.sequence_id = req.sequence_id + 7;
+    TEST_ASSERT_FALSE(hmi_history_backfill_on_page(&bf, make_page(&other, 100, 5, 0, 4, false, 0)));
+    other = req;
+    other.channel = PROTO_HISTORY_CH_DS18B20_2;
+    TEST_ASSERT_FALSE(hmi_history_backfill_on_page(&bf, make_page(&other, 100, 5, 0, 4, false, 0)));
+    other = req;
+    other.tier = PROTO_HISTORY_TIER_MINUTE;
+    TEST_ASSERT_FALSE(hmi_history_backfill_on_page(&bf, make_page(&other, 100, 5, 0, 4, false, 0)));
+    TEST_ASSERT_EQUAL_UINT32(0, bf.pages);
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 100, 5, 0, 4, false, 0)));
+}
+
+TEST_CASE("history backfill retries then gives up on a silent sensor", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    static hmi_history_snapshot_t snapshot;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    uint32_t first_seq = req.sequence_id;
+    TEST_ASSERT_FALSE(hmi_history_backfill_next_request(&bf, 999, &req));
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 1000, &req));
+    TEST_ASSERT_EQUAL_UINT32(first_seq + 1, req.sequence_id);
+    TEST_ASSERT_EQUAL_UINT32(0, req.from_s);
+
+    // A late answer to the first attempt no longer counts.
+    proto_history_request_t late = req;
+    late.sequence_id = first_seq;
+    TEST_ASSERT_FALSE(hmi_history_backfill_on_page(&bf, make_page(&late, 100, 5, 0, 4, false, 0)));
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 2000, &req));
+    TEST_ASSERT_FALSE(hmi_history_backfill_next_request(&bf, 3000, &req));
+    TEST_ASSERT_EQUAL_UINT32(1, bf.abandoned_count);
+    TEST_ASSERT_TRUE(hmi_history_backfill_take(&bf, &snapshot));
+    TEST_ASSERT_EQUAL_UINT16(0, snapshot.count[0]);
+}
+
+TEST_CASE("history backfill restarts from scratch after a sensor reboot", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    static hmi_history_snapshot_t snapshot;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    hmi_history_backfill_note_sample(&bf, 5000000);
+    hmi_history_backfill_set_connected(&bf, false);
+    hmi_history_backfill_set_connected(&bf, true);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT32(5001, req.from_s);
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 60, 5, 0, 0, false, 0)));
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    TEST_ASSERT_EQUAL_UINT8(PROTO_HISTORY_CH_AMBIENT_TEMP_0, req.channel);
+    TEST_ASSERT_EQUAL_UINT32(0, req.from_s);
+    TEST_ASSERT_TRUE(hmi_history_backfill_on_page(&bf, make_page(&req, 60, 5, 0, 12, false, 300)));
+    finish_remaining(&bf, 60, NULL);
+
+    TEST_ASSERT_TRUE(hmi_history_backfill_take(&bf, &snapshot));
+    TEST_ASSERT_EQUAL_UINT16(12, snapshot.count[0]);
+    TEST_ASSERT_EQUAL_INT16(300, snapshot.values[0][0]);
+}
+
+TEST_CASE("history backfill drops a fetch cut short by a disconnect", "[hmi][history]")
+{
+    static hmi_history_backfill_t bf;
+    proto_history_request_t req;
+    static hmi_history_snapshot_t snapshot;
+    hmi_history_backfill_init(&bf, 1000, 0);
+    hmi_history_backfill_set_connected(&bf, true);
+    TEST_ASSERT_TRUE(hmi_history_backfill_next_request(&bf, 0, &req));
+    hmi_history_backfill_set_connected(&bf, false);
+
+    TEST_ASSERT_FALSE(hmi_history_backfill_on_page(&bf, make_page(&req, 100, 5, 0, 4, false, 0)));
+    TEST_ASSERT_FALSE(hmi_history_backfill_next_request(&bf, 5000, &req));
+    TEST_ASSERT_FALSE(hmi_history_backfill_take(&bf, &snapshot));
+}
@@ -0,0 +1,147 @@
+#include "net/rx_pipeline.h"
+
+#include "esp_timer.h"
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    size_t count;
+    proto_msg_type_t types[8];
+    uint32_t crcs[8];
+} rx_capture_t;
+
+static void capture_frame(proto_msg_type_t type, const uint8_t *payload, size_t len, uint32_t crc, void *ctx)
+{
+    (void)payload;
+    (void)len;
+    rx_capture_t *capture = (rx_capture_t *)ctx;
+    if (capture->count < 8) {
+        capture->types[capture->count] = type;
+        capture->crcs[capture->count] = crc;
+    }
+    ++capture->count;
+}
+
+static size_t encode_update(uint32_t seq, uint8_t *buffer, size_t capacity, uint32_t *crc)
+{
+    proto_sensor_update_t update = {
+        .timestamp_ms = seq * 100U,
+        .sequence_id = seq,
+        .sht20_count = 1,
+        .pwm = {.frequency_hz = 500},
+    };
+    strcpy(update.sht20[0].id, "SHT20_1");
+    update.sht20[0].temperature_c = 21.5f;
+    update.sht20[0].valid = true;
+    size_t len = capacity;
+    TEST_ASSERT_TRUE(proto_encode_sensor_update_into(&update, false, buffer, &len, crc));
+    return len;
+}
+
+static size_t encode_ack(uint32_t seq, uint8_t *buffer, size_t capacity, uint32_t *crc)
+{
+    proto_command_ack_t ack = {.timestamp_ms = 1, .sequence_id = seq, .status = PROTO_ACK_OK};
+    size_t len = capacity;
+    TEST_ASSERT_TRUE(proto_encode_command_ack_into(&ack, false, buffer, &len, crc));
+    return len;
+}
+
+TEST_CASE("rx pipeline delivers acks in order and only the newest update", "[hmi][rx]")
+{
+    static hmi_rx_pipeline_t pipeline;
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_init(&pipeline, false));
+    uint8_t buffer[512];
+    uint32_t crc = 0;
+    size_t len = 0;
+
+    for (uint32_t seq = 1; seq <= 3; ++seq) {
+        len = encode_update(seq, buffer, sizeof(buffer), &crc);
+        TEST_ASSERT_TRUE(hmi_rx_pipeline_push(&pipeline, buffer, len, 100 + seq));
+    }
+    len = encode_ack(7, buffer, sizeof(buffer), &crc);
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_push(&pipeline, buffer, len, 200));
+
+    rx_capture_t capture = {0};
+    TEST_ASSERT_EQUAL(2, hmi_rx_pipeline_drain(&pipeline, capture_frame, &capture));
+    TEST_ASSERT_EQUAL(PROTO_MSG_COMMAND_ACK, capture.types[0]);
+    TEST_ASSERT_EQUAL_UINT32(200, capture.crcs[0]);
+    TEST_ASSERT_EQUAL(PROTO_MSG_SENSOR_UPDATE, capture.types[1]);
+    TEST_ASSERT_EQUAL_UINT32(103, capture.crcs[1]);
+    TEST_ASSERT_EQUAL_UINT32(2, pipeline.superseded_count);
+
+    capture.count = 0;
+    TEST_ASSERT_EQUAL(0, hmi_rx_pipeline_drain(&pipeline, capture_frame, &capture));
+}
+
+TEST_CASE("rx pipeline keeps journal replays out of live state", "[hmi][rx]")
+{
+    static hmi_rx_pipeline_t pipeline;
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_init(&pipeline, false));
+    uint8_t buffer[512];
+    uint32_t crc = 0;
+    size_t len = encode_update(5, buffer, sizeof(buffer), &crc);
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_push(&pipeline, buffer, len, 105));
+
+    proto_sensor_update_t replay = {.sequence_id = 2};
+    for (int i = 0; i < 3; ++i) {
+        len = sizeof(buffer);
+        TEST_ASSERT_TRUE(proto_encode_sensor_replay_into(&replay, false, buffer, &len, &crc));
+        TEST_ASSERT_TRUE(hmi_rx_pipeline_push(&pipeline, buffer, len, crc));
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, pipeline.replay_skipped);
+
+    // The live update queued before the backlog is still the one delivered.
+    rx_capture_t capture = {0};
+    TEST_ASSERT_EQUAL(1, hmi_rx_pipeline_drain(&pipeline, capture_frame, &capture));
+    TEST_ASSERT_EQUAL(PROTO_MSG_SENSOR_UPDATE, capture.types[0]);
+    TEST_ASSERT_EQUAL_UINT32(105, capture.crcs[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, pipeline.superseded_count);
+}
+
+TEST_CASE("rx pipeline counts frames dropped on overflow", "[hmi][rx]")
+{
+    static hmi_rx_pipeline_t pipeline;
+    static uint8_t frame[HMI_RX_FRAME_MAX];
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_init(&pipeline, false));
+    TEST_ASSERT_FALSE(hmi_rx_pipeline_push(&pipeline, frame, HMI_RX_FRAME_MAX + 1, 0));
+
+    size_t pushed = 0;
+    while (hmi_rx_pipeline_push(&pipeline, frame, sizeof(frame), 0)) {
+        ++pushed;
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(2, pushed);
+    TEST_ASSERT_EQUAL_UINT32(1, hmi_rx_pipeline_dropped(&pipeline));
+}
+
+TEST_CASE("rx pipeline keeps decode cost out of the event task", "[hmi][rx][perf]")
+{
+    static hmi_rx_pipeline_t pipeline;
+    TEST_ASSERT_TRUE(hmi_rx_pipeline_init(&pipeline, false));
+    uint8_t buffer[1024];
+    uint32_t crc = 0;
+    size_t len = encode_update(1, buffer, sizeof(buffer), &crc);
+    const int iterations = 200;
+
+    // Before: the event task decoded every update inline.
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; ++i) {
+        proto_sensor_update_t update;
+        proto_decode_sensor_update(buffer, len, false, &update, crc);
+    }
+    int64_t inline_us = esp_timer_get_time() - start;
+
+    // After: the event task only copies the frame into the ring.
+    int64_t push_us = 0;
+    rx_capture_t capture = {0};
+    for (int i = 0; i < iterations; ++i) {
+        start = esp_timer_get_time();
+        TEST_ASSERT_TRUE(hmi_rx_pipeline_push(&pipeline, buffer, len, crc));
+        push_us += esp_timer_get_time() - start;
+        hmi_rx_pipeline_drain(&pipeline, capture_frame, &capture);
+    }
+    printf("event task per %u-byte update: inline decode %.2f us, queued %.2f us\n", (unsigned)len,
+           (double)inline_us / iterations, (double)push_us / iterations);
+    TEST_ASSERT_EQUAL(iterations, capture.count);
+    TEST_ASSERT_LESS_OR_EQUAL(inline_us, push_us);
+}
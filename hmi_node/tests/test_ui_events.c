@@ -31,6 +31,10 @@ static struct {
     int calls;
 } s_reset_invocation;
 
+static struct {
+    int calls;
+} s_flush_invocation;
+
 static void reset_state(void)
 {
     memset(&s_gpio_invocation, 0, sizeof(s_gpio_invocation));
@@ -38,6 +42,7 @@ static void reset_state(void)
     memset(&s_pwm_freq_invocation, 0, sizeof(s_pwm_freq_invocation));
     memset(&s_prefs_invocation, 0, sizeof(s_prefs_invocation));
     memset(&s_reset_invocation, 0, sizeof(s_reset_invocation));
+    memset(&s_flush_invocation, 0, sizeof(s_flush_invocation));
 }
 
 static void fake_write_gpio(uint8_t device_index, uint8_t port, uint16_t mask, uint16_t value, void *ctx)
@@ -78,6 +83,12 @@ static void fake_reset_prefs(void *ctx)
     ++s_reset_invocation.calls;
 }
 
+static void fake_flush_commands(void *ctx)
+{
+    (void)ctx;
+    ++s_flush_invocation.calls;
+}
+
 void setUp(void)
 {
     reset_state();
@@ -87,6 +98,7 @@ void setUp(void)
         .write_gpio = fake_write_gpio,
         .apply_preferences = fake_apply_prefs,
         .reset_preferences = fake_reset_prefs,
+        .flush_commands = fake_flush_commands,
     };
     ui_set_callbacks_for_test(&callbacks, NULL);
     hmi_user_preferences_t defaults = {
@@ -134,6 +146,18 @@ TEST_CASE("ui pwm handlers forward slider and frequency changes", "[hmi][ui]")
     TEST_ASSERT_EQUAL_UINT16(789, s_pwm_freq_invocation.freq);
 }
 
+TEST_CASE("ui pwm slider release requests a command flush", "[hmi][ui]")
+{
+    ui_test_handle_pwm_slider(2, 100);
+    ui_test_handle_pwm_slider(2, 200);
+    TEST_ASSERT_EQUAL(0, s_flush_invocation.calls);
+
+    ui_test_release_pwm_slider(2, 300);
+    TEST_ASSERT_EQUAL(3, s_pwm_invocation.calls);
+    TEST_ASSERT_EQUAL_UINT16(300, s_pwm_invocation.duty);
+    TEST_ASSERT_EQUAL(1, s_flush_invocation.calls);
+}
+
 TEST_CASE("ui preferences dispatcher merges and forwards", "[hmi][ui]")
 {
     ui_test_apply_preferences_inputs("new-ssid", "secret", "target", true, true, true, true, 120, HMI_LANGUAGE_FR);
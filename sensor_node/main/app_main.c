@@ -1,6 +1,7 @@
 #include "app_main.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "board_pins.h"
@@ -10,20 +11,29 @@
 #include "common/util/monotonic.h"
 #include "common/util/memory_profile.h"
 #include "data_model.h"
+#include "history_store.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "i2c_bus.h"
+#include "journal_partition.h"
 #include "net/ws_server.h"
 #include "onewire_bus_manager.h"
+#include "publish_pacer.h"
 #include "tasks/t_heartbeat.h"
 #include "tasks/t_io.h"
 #include "tasks/t_sensors.h"
+#include "telemetry_journal.h"
 #include "sdkconfig.h"
 
 static const char *TAG = "sensor_main";
 
+#define PUBLISH_STATS_PERIOD_US (60LL * 1000000LL)
+
+static TaskHandle_t s_publisher;
+
 #if !CONFIG_SENSOR_ALLOW_PLACEHOLDER_SECRETS
 #define SENSOR_STATIC_ASSERT_NOT_PLACEHOLDER(value, literal, message) _Static_assert(__builtin_strcmp(value, literal) != 0, message)
 
@@ -45,6 +55,166 @@ static inline void sensor_validate_runtime_secrets(void)
 #endif
 }
 
+#if CONFIG_SENSOR_JOURNAL_ENABLE
+static telemetry_journal_t s_journal;
+static uint8_t s_journal_batch[CONFIG_SENSOR_JOURNAL_BATCH_BYTES];
+static bool s_journal_ready;
+static int64_t s_journal_batch_since_us;
+
+_Static_assert(CONFIG_SENSOR_JOURNAL_BATCH_BYTES >= TELEMETRY_JOURNAL_RECORD_HEADER + SENSOR_DATA_MODEL_MAX_FRAME_SIZE,
+               "journal batch must hold a full frame");
+
+static void journal_init(void)
+{
+    telemetry_journal_flash_t flash;
+    esp_err_t err = journal_partition_bind(CONFIG_SENSOR_JOURNAL_PARTITION, &flash);
+    if (err == ESP_OK) {
+        int64_t start = esp_timer_get_time();
+        err = telemetry_journal_mount(&s_journal, &flash, s_journal_batch, sizeof(s_journal_batch));
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "Journal: %u KiB, %u unread frames recovered in %u ms", (unsigned)(flash.size / 1024),
+                     (unsigned)s_journal.stats.records_recovered,
+                     (unsigned)((esp_timer_get_time() - start) / 1000));
+            s_journal_ready = true;
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Journal disabled (%s): frames published without a client are dropped", esp_err_to_name(err));
+}
+
+/**
+ * @brief Keep a new frame for later when nobody is listening.
+ *
+ * @return true when the frame went to the journal instead of the network.
+ */
+static bool journal_capture(sensor_data_model_t *model, bool use_cbor, bool new_sequence, int64_t now)
+{
+    if (!s_journal_ready || sensor_ws_server_has_clients()) {
+        return false;
+    }
+    if (!new_sequence) {
+        return true; /* A heartbeat carries nothing worth keeping. */
+    }
+    /* Claims the dirty bits as a live publish would; journaled as a replay so clients
+     * never take it for the current state. */
+    const proto_sensor_update_t *snapshot = data_model_freeze(model);
+    static uint8_t record[SENSOR_DATA_MODEL_MAX_FRAME_SIZE];
+    size_t len = SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE;
+    uint32_t crc = 0;
+    if (!snapshot || !proto_encode_sensor_replay_into(snapshot, use_cbor, record + sizeof(uint32_t), &len, &crc)) {
+        ESP_LOGW(TAG, "Failed to encode journal record");
+        return true;
+    }
+    memcpy(record, &crc, sizeof(crc));
+    if (telemetry_journal_pending(&s_journal) == 0) {
+        s_journal_batch_since_us = now;
+    }
+    esp_err_t err = telemetry_journal_append(&s_journal, record, len + sizeof(uint32_t));
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Journal append failed: %s", esp_err_to_name(err));
+    }
+    return true;
+}
+
+/** @brief Write out a batch older than SENSOR_JOURNAL_FLUSH_MS; returns the time until the next one is due. */
+static int64_t journal_service(int64_t now)
+{
+    if (!s_journal_ready || telemetry_journal_pending(&s_journal) == 0) {
+        return INT64_MAX;
+    }
+    int64_t due = s_journal_batch_since_us + (int64_t)CONFIG_SENSOR_JOURNAL_FLUSH_MS * 1000;
+    if (now < due) {
+        return due - now;
+    }
+    esp_err_t err = telemetry_journal_flush(&s_journal);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Journal flush failed: %s", esp_err_to_name(err));
+    }
+    return INT64_MAX;
+}
+
+/**
+ * @brief Stream one burst of journaled replay frames to a newly connected client.
+ *
+ * The publisher keeps sending live frames between bursts.
+ *
+ * @return true while frames remain.
+ */
+static bool journal_replay(void)
+{
+    static uint8_t frame[SENSOR_DATA_MODEL_MAX_FRAME_SIZE];
+    if (!s_journal_ready || !sensor_ws_server_has_clients()) {
+        return false;
+    }
+    if (telemetry_journal_pending(&s_journal) > 0) {
+        telemetry_journal_flush(&s_journal);
+    }
+    if (!telemetry_journal_has_unread(&s_journal)) {
+        return false;
+    }
+    for (int i = 0; i < CONFIG_SENSOR_JOURNAL_REPLAY_BURST; ++i) {
+        size_t len = 0;
+        esp_err_t err = telemetry_journal_read_next(&s_journal, frame, sizeof(frame), &len);
+        if (err != ESP_OK) {
+            if (err != ESP_ERR_NOT_FOUND) {
+                ESP_LOGW(TAG, "Journal replay stopped: %s", esp_err_to_name(err));
+            }
+            break;
+        }
+        sensor_ws_server_send_frame(frame, len);
+    }
+    if (telemetry_journal_has_unread(&s_journal)) {
+        return true;
+    }
+    telemetry_journal_stats_t stats;
+    telemetry_journal_get_stats(&s_journal, &stats);
+    ESP_LOGI(TAG, "Journal replayed (%u total, %u dropped, %u corrupt)", (unsigned)stats.records_replayed,
+             (unsigned)stats.records_dropped, (unsigned)stats.records_corrupt);
+    return false;
+}
+#else
+static void journal_init(void)
+{
+}
+
+static bool journal_capture(sensor_data_model_t *model, bool use_cbor, bool new_sequence, int64_t now)
+{
+    (void)model;
+    (void)use_cbor;
+    (void)new_sequence;
+    (void)now;
+    return false;
+}
+
+static int64_t journal_service(int64_t now)
+{
+    (void)now;
+    return INT64_MAX;
+}
+
+static bool journal_replay(void)
+{
+    return false;
+}
+#endif
+
+static void publish_wake(void *ctx)
+{
+    (void)ctx;
+    if (s_publisher) {
+        xTaskNotifyGive(s_publisher);
+    }
+}
+
+static void publish_log_stats(const publish_pacer_t *pacer)
+{
+    const publish_pacer_stats_t *stats = &pacer->stats;
+    uint32_t changes = stats->frames - stats->heartbeats;
+    ESP_LOGI(TAG, "publish: %u frames (%u heartbeats, %u rate-limited), detect-to-send mean %u us max %u us",
+             (unsigned)stats->frames, (unsigned)stats->heartbeats, (unsigned)stats->rate_limited,
+             (unsigned)(changes ? stats->total_latency_us / changes : 0), (unsigned)stats->max_latency_us);
+}
+
 static bool wait_for_wifi(uint32_t timeout_ms)
 {
     uint32_t elapsed = 0;
@@ -71,8 +241,36 @@ void app_main(void)
     onewire_bus_handle_t ow_bus;
     ESP_ERROR_CHECK(onewire_bus_manager_init(SENSOR_NODE_ONEWIRE_PIN, &ow_bus));
 
-    sensor_data_model_t model;
+    /* Static: the cached frame and snapshots are several KiB, more than the main task stack. */
+    static sensor_data_model_t model;
     data_model_init(&model);
+    data_model_deadbands_t deadbands;
+    for (size_t i = 0; i < 2; ++i) {
+        deadbands.ambient_temp_c[i] = CONFIG_SENSOR_DEADBAND_AMBIENT_TEMP_MC / 1000.0f;
+        deadbands.ambient_humidity_pct[i] = CONFIG_SENSOR_DEADBAND_AMBIENT_HUMIDITY_MPCT / 1000.0f;
+        deadbands.ambient_pressure_pa[i] = (float)CONFIG_SENSOR_DEADBAND_AMBIENT_PRESSURE_PA;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        deadbands.ds18b20_temp_c[i] = CONFIG_SENSOR_DEADBAND_DS18B20_MC / 1000.0f;
+    }
+    data_model_set_deadbands(&model, &deadbands);
+    static history_store_t history;
+    const history_tier_config_t tiers[PROTO_HISTORY_TIER_COUNT] = {
+        [PROTO_HISTORY_TIER_RAW] = {CONFIG_SENSOR_HISTORY_RAW_PERIOD_S, CONFIG_SENSOR_HISTORY_RAW_POINTS},
+        [PROTO_HISTORY_TIER_MINUTE] = {60, CONFIG_SENSOR_HISTORY_MINUTE_POINTS},
+        [PROTO_HISTORY_TIER_HOUR] = {3600, CONFIG_SENSOR_HISTORY_HOUR_POINTS},
+    };
+    esp_err_t history_err = history_store_init(&history, tiers);
+    if (history_err == ESP_OK) {
+        data_model_set_history(&model, &history);
+        ESP_LOGI(TAG, "History store: %u bytes", (unsigned)history_store_size(tiers));
+    } else {
+        ESP_LOGW(TAG, "History store disabled: %s", esp_err_to_name(history_err));
+    }
+    s_publisher = xTaskGetCurrentTaskHandle();
+    data_model_set_listener(&model, publish_wake, NULL);
+
+    journal_init();
 
     sensors_task_start(&model, ow_bus);
     io_task_start(&model);
@@ -98,12 +296,46 @@ void app_main(void)
         false;
 #endif
 
+    /* Sleep until a setter reports a change worth sending, the rate limit lifts or a
+     * heartbeat is due. */
+    publish_pacer_t pacer;
+    publish_pacer_init(&pacer, CONFIG_SENSOR_PUBLISH_MIN_INTERVAL_MS, CONFIG_SENSOR_PUBLISH_HEARTBEAT_MS);
+    int64_t next_stats_us = esp_timer_get_time() + PUBLISH_STATS_PERIOD_US;
     while (true) {
-        data_model_set_timestamp(&model, monotonic_time_ms());
-        if (data_model_should_publish(&model, 0.3f, 1.0f)) {
-            data_model_increment_seq(&model);
-            sensor_ws_server_send_update(&model, use_cbor);
+        bool replaying = journal_replay();
+        int64_t now = esp_timer_get_time();
+        uint32_t dirty_since_us = 0;
+        bool dirty = data_model_should_publish(&model, &dirty_since_us);
+        bool heartbeat = false;
+        int64_t wait_us = 0;
+        if (publish_pacer_poll(&pacer, now, dirty, &heartbeat, &wait_us)) {
+            /* A heartbeat without changes resends the cached frame of the current sequence. */
+            if (dirty) {
+                data_model_set_timestamp(&model, monotonic_time_ms());
+                data_model_increment_seq(&model);
+            }
+            if (!journal_capture(&model, use_cbor, dirty, now)) {
+                sensor_ws_server_send_update(&model, use_cbor);
+            }
+            int64_t sent_us = esp_timer_get_time();
+            publish_pacer_sent(&pacer, sent_us, heartbeat, dirty ? (uint32_t)sent_us - dirty_since_us : 0U);
+            continue;
+        }
+        if (now >= next_stats_us) {
+            publish_log_stats(&pacer);
+            next_stats_us = now + PUBLISH_STATS_PERIOD_US;
+        }
+        if (next_stats_us - now < wait_us) {
+            wait_us = next_stats_us - now;
+        }
+        int64_t flush_in_us = journal_service(now);
+        if (flush_in_us < wait_us) {
+            wait_us = flush_in_us;
+        }
+        if (replaying) {
+            wait_us = 0; /* Next burst after one tick. */
         }
-        vTaskDelay(pdMS_TO_TICKS(200));
+        TickType_t ticks = pdMS_TO_TICKS((uint32_t)((wait_us + 999) / 1000));
+        ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1);
     }
 }
@@ -6,5 +6,7 @@
 #define SENSOR_NODE_I2C_SCL GPIO_NUM_18
 #define SENSOR_NODE_I2C_SDA GPIO_NUM_17
 #define SENSOR_NODE_ONEWIRE_PIN ((gpio_num_t)CONFIG_SENSOR_ONEWIRE_GPIO)
+#define SENSOR_NODE_MCP23017_INT0 CONFIG_SENSOR_MCP23017_0_INT_GPIO
+#define SENSOR_NODE_MCP23017_INT1 CONFIG_SENSOR_MCP23017_1_INT_GPIO
 
 #define SENSOR_NODE_STATUS_LED GPIO_NUM_2
@@ -1,71 +1,212 @@
 #include "data_model.h"
 
 #include "common/proto/messages.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include <math.h>
 #include <string.h>
 
-#define DATA_MODEL_LOCK_TIMEOUT pdMS_TO_TICKS(1000)
+/* Spins before a reader gives a preempted lower-priority writer a tick to finish. */
+#define DATA_MODEL_READ_SPINS 64U
 
-static inline bool data_model_lock(sensor_data_model_t *model)
+/**
+ * @brief Enter a section for writing: its counter turns odd until section_write_end().
+ *
+ * With one writer per section the exchange succeeds first time. A second writer
+ * is a bug; it is counted and made to wait for the first, never torn.
+ */
+static uint32_t section_write_begin(sensor_data_model_t *model, data_model_section_t section)
 {
-    return model->mutex && xSemaphoreTake(model->mutex, DATA_MODEL_LOCK_TIMEOUT) == pdTRUE;
+    _Atomic uint32_t *seq = &model->section_seq[section];
+    uint32_t value = atomic_load_explicit(seq, memory_order_relaxed);
+    while (true) {
+        if ((value & 1U) == 0U &&
+            atomic_compare_exchange_weak_explicit(seq, &value, value + 1U, memory_order_acquire,
+                                                  memory_order_relaxed)) {
+            return value + 1U;
+        }
+        if (value & 1U) {
+            atomic_fetch_add_explicit(&model->write_collisions, 1U, memory_order_relaxed);
+            vTaskDelay(1);
+            value = atomic_load_explicit(seq, memory_order_relaxed);
+        }
+    }
+}
+
+static void section_write_end(sensor_data_model_t *model, data_model_section_t section, uint32_t odd)
+{
+    atomic_store_explicit(&model->section_seq[section], odd + 1U, memory_order_release);
+}
+
+static void section_copy(const proto_sensor_update_t *src, proto_sensor_update_t *dst, data_model_section_t section)
+{
+    switch (section) {
+    case DATA_MODEL_SECTION_AMBIENT:
+        dst->sht20_count = src->sht20_count;
+        memcpy(dst->sht20, src->sht20, sizeof(dst->sht20));
+        break;
+    case DATA_MODEL_SECTION_DS18B20:
+        dst->ds18b20_count = src->ds18b20_count;
+        memcpy(dst->ds18b20, src->ds18b20, sizeof(dst->ds18b20));
+        break;
+    case DATA_MODEL_SECTION_GPIO:
+        memcpy(dst->mcp, src->mcp, sizeof(dst->mcp));
+        break;
+    case DATA_MODEL_SECTION_PWM:
+        dst->pwm = src->pwm;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Copy one section, retrying until no write overlapped the copy.
+ */
+static void section_read(sensor_data_model_t *model, data_model_section_t section, proto_sensor_update_t *out)
+{
+    _Atomic uint32_t *seq = &model->section_seq[section];
+    uint32_t spins = 0;
+    while (true) {
+        uint32_t before = atomic_load_explicit(seq, memory_order_acquire);
+        if ((before & 1U) == 0U) {
+            section_copy(&model->current, out, section);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(seq, memory_order_relaxed) == before) {
+                return;
+            }
+        }
+        ++model->stats.read_retries;
+        if (++spins % DATA_MODEL_READ_SPINS == 0U) {
+            ++model->stats.reader_sleeps;
+            vTaskDelay(1);
+        }
+    }
 }
 
-static inline void data_model_unlock(sensor_data_model_t *model)
+static bool value_changed(float a, float b, float deadband)
 {
-    if (model->mutex) {
-        xSemaphoreGive(model->mutex);
+    return fabsf(a - b) > deadband;
+}
+
+/**
+ * @brief Record that @p bits need publishing and wake the publisher if any are new.
+ *
+ * Writers compare against last_published, which the publisher replaces while they
+ * run; a write racing a publish can at worst be judged against the previous frame,
+ * and the next sample of that entry corrects it.
+ */
+static void mark_dirty(sensor_data_model_t *model, uint32_t bits)
+{
+    uint32_t prev = atomic_fetch_or_explicit(&model->dirty, bits, memory_order_acq_rel);
+    if (prev == 0U) {
+        atomic_store_explicit(&model->dirty_since_us, (uint32_t)esp_timer_get_time(), memory_order_relaxed);
+    }
+    if ((prev & bits) != bits && model->listener) {
+        model->listener(model->listener_ctx);
     }
 }
 
+static void history_record(sensor_data_model_t *model, proto_history_channel_t channel, uint32_t sample_ms,
+                           float value)
+{
+    if (!model->history) {
+        return;
+    }
+    int64_t now_us = esp_timer_get_time();
+    uint32_t time_s = sample_ms ? history_store_sample_time_s(sample_ms, now_us) : (uint32_t)(now_us / 1000000);
+    history_store_record(model->history, channel, time_s, value);
+}
+
 void data_model_init(sensor_data_model_t *model)
 {
     memset(model, 0, sizeof(*model));
-    model->mutex = xSemaphoreCreateMutexStatic(&model->mutex_storage);
-    configASSERT(model->mutex != NULL);
+    for (size_t i = 0; i < DATA_MODEL_SECTION_COUNT; ++i) {
+        atomic_init(&model->section_seq[i], 0U);
+    }
+    atomic_init(&model->write_collisions, 0U);
+    atomic_init(&model->dirty, 0U);
+    atomic_init(&model->dirty_since_us, 0U);
+    data_model_default_deadbands(&model->deadbands);
     model->current.pwm.frequency_hz = 500;
     model->initialized = true;
 }
 
 void data_model_set_sht20(sensor_data_model_t *model, size_t index, const char *id, float temp,
-                          float humidity, bool valid)
+                          float humidity, bool valid, uint32_t sample_ms)
 {
     if (!model || !model->initialized || index >= 2) {
         return;
     }
-    if (!data_model_lock(model)) {
-        return;
-    }
+    uint32_t seq = section_write_begin(model, DATA_MODEL_SECTION_AMBIENT);
     proto_sht20_reading_t *entry = &model->current.sht20[index];
     strncpy(entry->id, id, sizeof(entry->id) - 1);
     entry->id[sizeof(entry->id) - 1] = '\0';
     entry->temperature_c = temp;
     entry->humidity_percent = humidity;
     entry->valid = valid;
+    entry->sample_ms = sample_ms;
     if (index + 1 > model->current.sht20_count) {
         model->current.sht20_count = index + 1;
     }
-    data_model_unlock(model);
+    section_write_end(model, DATA_MODEL_SECTION_AMBIENT, seq);
+
+    if (valid) {
+        history_record(model, (proto_history_channel_t)(PROTO_HISTORY_CH_AMBIENT_TEMP_0 + index), sample_ms, temp);
+        history_record(model, (proto_history_channel_t)(PROTO_HISTORY_CH_AMBIENT_HUMIDITY_0 + index), sample_ms, humidity);
+    }
+    const proto_sht20_reading_t *published = &model->last_published.sht20[index];
+    if (index >= model->last_published.sht20_count || valid != published->valid ||
+        value_changed(temp, published->temperature_c, model->deadbands.ambient_temp_c[index]) ||
+        value_changed(humidity, published->humidity_percent, model->deadbands.ambient_humidity_pct[index])) {
+        mark_dirty(model, DATA_MODEL_DIRTY_SHT20(index));
+    }
 }
 
-void data_model_set_ds18b20(sensor_data_model_t *model, size_t index, const onewire_device_t *device,
-                            float temp)
+void data_model_set_pressure(sensor_data_model_t *model, size_t index, float pressure_pa)
 {
-    if (!model || !model->initialized || index >= 4 || !device) {
+    if (!model || !model->initialized || index >= 2) {
         return;
     }
-    if (!data_model_lock(model)) {
+    uint32_t seq = section_write_begin(model, DATA_MODEL_SECTION_AMBIENT);
+    model->current.sht20[index].pressure_pa = pressure_pa;
+    section_write_end(model, DATA_MODEL_SECTION_AMBIENT, seq);
+
+    if (pressure_pa > 0.0f) {
+        history_record(model, (proto_history_channel_t)(PROTO_HISTORY_CH_AMBIENT_PRESSURE_0 + index),
+                       model->current.sht20[index].sample_ms, pressure_pa);
+    }
+
+    if (value_changed(pressure_pa, model->last_published.sht20[index].pressure_pa,
+                      model->deadbands.ambient_pressure_pa[index])) {
+        mark_dirty(model, DATA_MODEL_DIRTY_SHT20(index));
+    }
+}
+
+void data_model_set_ds18b20(sensor_data_model_t *model, size_t index, const onewire_device_t *device,
+                            float temp, uint32_t sample_ms)
+{
+    if (!model || !model->initialized || index >= 4 || !device) {
         return;
     }
+    uint32_t seq = section_write_begin(model, DATA_MODEL_SECTION_DS18B20);
     proto_ds18b20_reading_t *entry = &model->current.ds18b20[index];
     memcpy(entry->rom_code, device->rom_code, sizeof(entry->rom_code));
     entry->temperature_c = temp;
+    entry->sample_ms = sample_ms;
     if (index + 1 > model->current.ds18b20_count) {
         model->current.ds18b20_count = index + 1;
     }
-    data_model_unlock(model);
+    section_write_end(model, DATA_MODEL_SECTION_DS18B20, seq);
+
+    history_record(model, (proto_history_channel_t)(PROTO_HISTORY_CH_DS18B20_0 + index), sample_ms, temp);
+
+    if (index >= model->last_published.ds18b20_count ||
+        value_changed(temp, model->last_published.ds18b20[index].temperature_c,
+                      model->deadbands.ds18b20_temp_c[index])) {
+        mark_dirty(model, DATA_MODEL_DIRTY_DS18B20(index));
+    }
 }
 
 void data_model_set_gpio(sensor_data_model_t *model, size_t dev_index, uint16_t porta, uint16_t portb)
@@ -73,12 +214,15 @@ void data_model_set_gpio(sensor_data_model_t *model, size_t dev_index, uint16_t
     if (!model || !model->initialized || dev_index >= 2) {
         return;
     }
-    if (!data_model_lock(model)) {
-        return;
-    }
+    uint32_t seq = section_write_begin(model, DATA_MODEL_SECTION_GPIO);
     model->current.mcp[dev_index].port_a = porta;
     model->current.mcp[dev_index].port_b = portb;
-    data_model_unlock(model);
+    section_write_end(model, DATA_MODEL_SECTION_GPIO, seq);
+
+    const proto_mcp23017_state_t *published = &model->last_published.mcp[dev_index];
+    if (porta != published->port_a || portb != published->port_b) {
+        mark_dirty(model, DATA_MODEL_DIRTY_GPIO(dev_index));
+    }
 }
 
 void data_model_set_pwm(sensor_data_model_t *model, const uint16_t *duty, size_t count,
@@ -87,15 +231,22 @@ void data_model_set_pwm(sensor_data_model_t *model, const uint16_t *duty, size_t
     if (!model || !model->initialized || !duty) {
         return;
     }
-    if (!data_model_lock(model)) {
-        return;
-    }
+    uint32_t seq = section_write_begin(model, DATA_MODEL_SECTION_PWM);
     size_t max = count < 16 ? count : 16;
     for (size_t i = 0; i < max; ++i) {
         model->current.pwm.duty_cycle[i] = duty[i];
     }
     model->current.pwm.frequency_hz = frequency_hz;
-    data_model_unlock(model);
+    section_write_end(model, DATA_MODEL_SECTION_PWM, seq);
+
+    const proto_pca9685_state_t *published = &model->last_published.pwm;
+    bool changed = frequency_hz != published->frequency_hz;
+    for (size_t i = 0; i < max && !changed; ++i) {
+        changed = duty[i] != published->duty_cycle[i];
+    }
+    if (changed) {
+        mark_dirty(model, DATA_MODEL_DIRTY_PWM);
+    }
 }
 
 void data_model_set_timestamp(sensor_data_model_t *model, uint32_t timestamp_ms)
@@ -103,11 +254,7 @@ void data_model_set_timestamp(sensor_data_model_t *model, uint32_t timestamp_ms)
     if (!model || !model->initialized) {
         return;
     }
-    if (!data_model_lock(model)) {
-        return;
-    }
     model->current.timestamp_ms = timestamp_ms;
-    data_model_unlock(model);
 }
 
 void data_model_increment_seq(sensor_data_model_t *model)
@@ -115,87 +262,140 @@ void data_model_increment_seq(sensor_data_model_t *model)
     if (!model || !model->initialized) {
         return;
     }
-    if (!data_model_lock(model)) {
+    model->current.sequence_id++;
+}
+
+void data_model_snapshot(sensor_data_model_t *model, proto_sensor_update_t *out)
+{
+    if (!model || !out || !model->initialized) {
         return;
     }
-    model->current.sequence_id++;
-    data_model_unlock(model);
+    out->timestamp_ms = model->current.timestamp_ms;
+    out->sequence_id = model->current.sequence_id;
+    for (size_t i = 0; i < DATA_MODEL_SECTION_COUNT; ++i) {
+        section_read(model, (data_model_section_t)i, out);
+    }
+    ++model->stats.snapshots;
 }
 
-static bool value_changed(float a, float b, float threshold)
+void data_model_get_stats(sensor_data_model_t *model, sensor_data_model_stats_t *out)
 {
-    return fabsf(a - b) > threshold;
+    if (!model || !out) {
+        return;
+    }
+    *out = model->stats;
+    out->write_collisions = atomic_load_explicit(&model->write_collisions, memory_order_relaxed);
 }
 
-bool data_model_should_publish(sensor_data_model_t *model, float temp_threshold, float humidity_threshold)
+void data_model_default_deadbands(data_model_deadbands_t *out)
 {
-    if (!model || !model->initialized) {
-        return false;
+    if (!out) {
+        return;
     }
-    if (!data_model_lock(model)) {
-        return false;
+    for (size_t i = 0; i < 2; ++i) {
+        out->ambient_temp_c[i] = 0.3f;
+        out->ambient_humidity_pct[i] = 1.0f;
+        out->ambient_pressure_pa[i] = 50.0f;
     }
-    if (model->last_published.sequence_id == 0) {
-        data_model_unlock(model);
-        return true;
-    }
-    for (size_t i = 0; i < model->current.sht20_count; ++i) {
-        if (value_changed(model->current.sht20[i].temperature_c, model->last_published.sht20[i].temperature_c,
-                          temp_threshold) ||
-            value_changed(model->current.sht20[i].humidity_percent,
-                          model->last_published.sht20[i].humidity_percent, humidity_threshold)) {
-            data_model_unlock(model);
-            return true;
-        }
+    for (size_t i = 0; i < 4; ++i) {
+        out->ds18b20_temp_c[i] = 0.3f;
     }
-    for (size_t i = 0; i < model->current.ds18b20_count; ++i) {
-        if (value_changed(model->current.ds18b20[i].temperature_c,
-                          model->last_published.ds18b20[i].temperature_c, temp_threshold)) {
-            data_model_unlock(model);
-            return true;
-        }
+}
+
+void data_model_set_deadbands(sensor_data_model_t *model, const data_model_deadbands_t *deadbands)
+{
+    if (!model || !deadbands) {
+        return;
     }
-    if (memcmp(model->current.mcp, model->last_published.mcp, sizeof(model->current.mcp)) != 0) {
-        data_model_unlock(model);
-        return true;
+    model->deadbands = *deadbands;
+}
+
+void data_model_set_listener(sensor_data_model_t *model, data_model_listener_t listener, void *ctx)
+{
+    if (!model) {
+        return;
     }
-    if (memcmp(model->current.pwm.duty_cycle, model->last_published.pwm.duty_cycle,
-               sizeof(model->current.pwm.duty_cycle)) != 0 ||
-        model->current.pwm.frequency_hz != model->last_published.pwm.frequency_hz) {
-        data_model_unlock(model);
-        return true;
+    model->listener_ctx = ctx;
+    model->listener = listener;
+}
+
+void data_model_set_history(sensor_data_model_t *model, history_store_t *history)
+{
+    if (!model) {
+        return;
     }
-    data_model_unlock(model);
-    return false;
+    model->history = history;
 }
 
-bool data_model_build(sensor_data_model_t *model, bool use_cbor, uint8_t **out_buf, size_t *out_len,
-                      uint32_t *crc32)
+bool data_model_should_publish(sensor_data_model_t *model, uint32_t *dirty_since_us)
 {
-    if (!model || !out_buf || !out_len || !model->initialized) {
+    if (!model || !model->initialized) {
         return false;
     }
-    if (!data_model_lock(model)) {
-        return false;
+    uint32_t dirty = atomic_load_explicit(&model->dirty, memory_order_acquire);
+    if (dirty_since_us) {
+        *dirty_since_us = atomic_load_explicit(&model->dirty_since_us, memory_order_relaxed);
+    }
+    return dirty != 0U || model->last_published.sequence_id == 0;
+}
+
+const data_model_frame_t *data_model_build(sensor_data_model_t *model, bool use_cbor)
+{
+    if (!model || !model->initialized) {
+        return NULL;
+    }
+    uint32_t sequence_id = model->current.sequence_id;
+    bool fresh = !model->snapshot_valid || model->snapshot_seq != sequence_id;
+    data_model_frame_t *frame = &model->frame;
+    if (!fresh && frame->len > 0 && frame->sequence_id == sequence_id && frame->cbor == use_cbor) {
+        ++model->stats.frame_cache_hits;
+        return frame;
+    }
+
+    uint32_t dirty = 0;
+    if (fresh) {
+        /* Taken before the snapshot: a change landing during the encode re-marks itself. */
+        dirty = atomic_exchange_explicit(&model->dirty, 0U, memory_order_acq_rel);
+        data_model_snapshot(model, &model->snapshot);
     }
-    size_t index = model->next_encode_index % SENSOR_DATA_MODEL_BUFFER_COUNT;
-    uint8_t *buffer = model->encode_buffers[index];
     size_t capacity = SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE;
-    uint32_t local_crc = 0;
-    bool ok = proto_encode_sensor_update_into(&model->current, use_cbor, buffer, &capacity, &local_crc);
-    if (ok) {
-        model->last_published = model->current;
-        model->encode_lengths[index] = capacity;
-        model->next_encode_index = (index + 1) % SENSOR_DATA_MODEL_BUFFER_COUNT;
-    }
-    data_model_unlock(model);
-    if (!ok) {
-        return false;
+    uint32_t crc = 0;
+    frame->len = 0;
+    ++model->stats.frames_encoded;
+    if (!proto_encode_sensor_update_into(&model->snapshot, use_cbor, frame->data + sizeof(uint32_t), &capacity,
+                                         &crc)) {
+        if (dirty) {
+            atomic_fetch_or_explicit(&model->dirty, dirty, memory_order_acq_rel);
+        }
+        if (fresh) {
+            model->snapshot_valid = false;
+        }
+        return NULL;
+    }
+    memcpy(frame->data, &crc, sizeof(crc));
+    frame->len = capacity + sizeof(uint32_t);
+    frame->sequence_id = sequence_id;
+    frame->cbor = use_cbor;
+    if (fresh) {
+        model->snapshot_seq = sequence_id;
+        model->snapshot_valid = true;
+        model->last_published = model->snapshot;
+    }
+    return frame;
+}
+
+const proto_sensor_update_t *data_model_freeze(sensor_data_model_t *model)
+{
+    if (!model || !model->initialized) {
+        return NULL;
     }
-    *out_buf = buffer;
-    *out_len = capacity;
-    if (crc32) {
-        *crc32 = local_crc;
+    uint32_t sequence_id = model->current.sequence_id;
+    if (!model->snapshot_valid || model->snapshot_seq != sequence_id) {
+        atomic_exchange_explicit(&model->dirty, 0U, memory_order_acq_rel);
+        data_model_snapshot(model, &model->snapshot);
+        model->snapshot_seq = sequence_id;
+        model->snapshot_valid = true;
+        model->last_published = model->snapshot;
     }
-    return true;
+    return &model->snapshot;
 }
@@ -1,37 +1,110 @@
 #pragma once
 
 #include "common/proto/messages.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "history_store.h"
 #include "onewire_bus.h"
+#include "sdkconfig.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #define SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE 2048U
-#define SENSOR_DATA_MODEL_BUFFER_COUNT 2U
+/** Encoded payload plus the leading CRC32, as sent on the wire. */
+#define SENSOR_DATA_MODEL_MAX_FRAME_SIZE (SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE + sizeof(uint32_t))
+
+/**
+ * Independently versioned parts of the payload. Each section has one writer task:
+ * t_sensors owns AMBIENT and DS18B20, t_io owns GPIO and PWM. The frame header
+ * (timestamp, sequence) and everything below `current` belong to the publisher.
+ */
+typedef enum {
+    DATA_MODEL_SECTION_AMBIENT = 0,
+    DATA_MODEL_SECTION_DS18B20,
+    DATA_MODEL_SECTION_GPIO,
+    DATA_MODEL_SECTION_PWM,
+    DATA_MODEL_SECTION_COUNT,
+} data_model_section_t;
+
+/** Dirty bits: one per payload entry, set by the setters when a change is worth sending. */
+#define DATA_MODEL_DIRTY_SHT20(i) (1UL << (i))
+#define DATA_MODEL_DIRTY_DS18B20(i) (1UL << (2U + (i)))
+#define DATA_MODEL_DIRTY_GPIO(i) (1UL << (6U + (i)))
+#define DATA_MODEL_DIRTY_PWM (1UL << 8)
+#define DATA_MODEL_DIRTY_ALL 0x1FFUL
+
+/**
+ * @brief Per-channel deadbands: a reading marks its entry dirty once it has moved
+ *        strictly more than this from the last published value.
+ */
+typedef struct {
+    float ambient_temp_c[2];       /**< SHT20/BME280 temperature, °C. */
+    float ambient_humidity_pct[2]; /**< SHT20/BME280 relative humidity, %RH. */
+    float ambient_pressure_pa[2];  /**< BME280 pressure, Pa. */
+    float ds18b20_temp_c[4];       /**< DS18B20 probe temperature, °C. */
+} data_model_deadbands_t;
+
+/**
+ * @brief Called from the writer task whenever a dirty bit goes from clear to set.
+ *        Must not block; typically a task notification to the publisher.
+ */
+typedef void (*data_model_listener_t)(void *ctx);
+
+/**
+ * @brief Contention and frame cache counters; writers never wait, so only reader
+ *        retries are expected.
+ */
+typedef struct {
+    uint32_t snapshots;        /**< Consistent snapshots taken by the publisher. */
+    uint32_t read_retries;     /**< Section copies repeated because a writer was active. */
+    uint32_t reader_sleeps;    /**< Retries that had to yield a tick to a preempted writer. */
+    uint32_t write_collisions; /**< Two tasks writing one section at once (a usage bug). */
+    uint32_t frames_encoded;   /**< Builds that ran the encoder. */
+    uint32_t frame_cache_hits; /**< Builds served from the already encoded frame. */
+} sensor_data_model_stats_t;
+
+/**
+ * @brief One finished frame: CRC32 (little endian) followed by the encoded payload.
+ *
+ * Identified by the sequence it was built for and its encoding; it stays valid
+ * until the next encode.
+ */
+typedef struct {
+    uint32_t sequence_id;
+    bool cbor;
+    size_t len; /**< Bytes used in #data, CRC included; 0 when nothing is cached. */
+    uint8_t data[SENSOR_DATA_MODEL_MAX_FRAME_SIZE];
+} data_model_frame_t;
 
 /**
  * @brief In-memory representation of the sensor node payload state.
  *
- * The model stores the most recent telemetry frame (`current`), the last
- * published frame (`last_published`) and a pair of double-buffered encoding
- * arenas used to stage serialized payloads for transmission.
+ * Setters never block: each section is guarded by a sequence counter that is odd
+ * while its writer is updating it, and the publisher copies a section again when
+ * the counter moved under it. The model also keeps the last published frame, encoded,
+ * so a heartbeat resends it without running the encoder again.
  */
 typedef struct {
-    proto_sensor_update_t current; /**< Current working snapshot populated by tasks. */
+    proto_sensor_update_t current; /**< Working state, written section by section. */
+    _Atomic uint32_t section_seq[DATA_MODEL_SECTION_COUNT]; /**< Per-section seqlock counters. */
+    _Atomic uint32_t write_collisions;
+    _Atomic uint32_t dirty; /**< DATA_MODEL_DIRTY_* bits not yet published. */
+    _Atomic uint32_t dirty_since_us; /**< Low 32 bits of esp_timer time when #dirty became non-zero. */
+    data_model_deadbands_t deadbands;
+    data_model_listener_t listener;
+    void *listener_ctx;
+    history_store_t *history; /**< Optional; fed by the ambient and DS18B20 setters. */
+    proto_sensor_update_t snapshot; /**< State frozen for sequence #snapshot_seq. */
     proto_sensor_update_t last_published; /**< Snapshot most recently acknowledged as published. */
+    uint32_t snapshot_seq; /**< Sequence #snapshot belongs to, once #snapshot_valid. */
+    bool snapshot_valid;
+    sensor_data_model_stats_t stats; /**< Reader-side counters, publisher only. */
     bool initialized; /**< Tracks whether ::data_model_init completed successfully. */
-    SemaphoreHandle_t mutex; /**< Lightweight mutex guarding access to the structure. */
-    StaticSemaphore_t mutex_storage; /**< Backing storage for #mutex. */
-    uint8_t encode_buffers[SENSOR_DATA_MODEL_BUFFER_COUNT][SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE];
-    size_t encode_lengths[SENSOR_DATA_MODEL_BUFFER_COUNT]; /**< Length of each staged payload. */
-    size_t next_encode_index; /**< Index of the staging buffer to fill on the next build. */
+    data_model_frame_t frame; /**< Most recently encoded frame. */
 } sensor_data_model_t;
 
 /**
- * @brief Initialise a ::sensor_data_model_t instance and allocate its mutex.
+ * @brief Initialise a ::sensor_data_model_t instance.
  *
- * The structure is zeroed, an internal FreeRTOS mutex is created, and default
- * PWM configuration values are seeded.
+ * The structure is zeroed and default PWM configuration values are seeded.
  */
 void data_model_init(sensor_data_model_t *model);
 
@@ -44,9 +117,19 @@ void data_model_init(sensor_data_model_t *model);
  * @param temp Temperature in degrees Celsius.
  * @param humidity Relative humidity in percent.
  * @param valid True when the measurement is fresh and valid.
+ * @param sample_ms Monotonic time the measurement was taken.
  */
 void data_model_set_sht20(sensor_data_model_t *model, size_t index, const char *id, float temp,
-                          float humidity, bool valid);
+                          float humidity, bool valid, uint32_t sample_ms);
+
+/**
+ * @brief Attach a barometric pressure reading to an ambient sensor entry.
+ *
+ * @param model Target data model, must be initialised.
+ * @param index Index of the logical ambient sensor (0..1).
+ * @param pressure_pa Pressure in pascals; 0 marks the sensor as having no barometer.
+ */
+void data_model_set_pressure(sensor_data_model_t *model, size_t index, float pressure_pa);
 
 /**
  * @brief Store a DS18B20 reading inside the model.
@@ -55,9 +138,10 @@ void data_model_set_sht20(sensor_data_model_t *model, size_t index, const char *
  * @param index Index of the logical DS18B20 sensor (0..3).
  * @param device Pointer to the 1-Wire device descriptor supplying the ROM code.
  * @param temp Temperature in degrees Celsius.
+ * @param sample_ms Monotonic time the conversion started.
  */
 void data_model_set_ds18b20(sensor_data_model_t *model, size_t index, const onewire_device_t *device,
-                            float temp);
+                            float temp, uint32_t sample_ms);
 
 /**
  * @brief Update the cached GPIO port states from the MCP23017 expanders.
@@ -71,37 +155,91 @@ void data_model_set_pwm(sensor_data_model_t *model, const uint16_t *duty, size_t
                         uint16_t frequency_hz);
 
 /**
- * @brief Record the monotonic timestamp attached to the frame.
+ * @brief Record the monotonic timestamp attached to the frame. Publisher only.
  */
 void data_model_set_timestamp(sensor_data_model_t *model, uint32_t timestamp_ms);
 
 /**
- * @brief Determine whether the current model state differs sufficiently to publish.
+ * @brief Fill @p out with the built-in deadbands: 0.3 °C, 1.0 %RH and 50 Pa on every channel.
+ */
+void data_model_default_deadbands(data_model_deadbands_t *out);
+
+/**
+ * @brief Replace the deadbands the setters use to mark readings dirty.
+ *
+ * Call before the writer tasks start. A deadband of 0 publishes every change.
+ */
+void data_model_set_deadbands(sensor_data_model_t *model, const data_model_deadbands_t *deadbands);
+
+/**
+ * @brief Register the callback raised when the model gains something to publish.
+ *
+ * Call before the writer tasks start.
+ */
+void data_model_set_listener(sensor_data_model_t *model, data_model_listener_t listener, void *ctx);
+
+/**
+ * @brief Record every ambient and DS18B20 reading into @p history as well.
+ *
+ * Call before the writer tasks start; the setters become the history's only writer.
+ */
+void data_model_set_history(sensor_data_model_t *model, history_store_t *history);
+
+/**
+ * @brief Whether the model holds changes that have not been published yet.
+ *
+ * Setters compare each write against the last published value, so this is a
+ * single load. Always true before the first frame.
  *
  * @param model Target data model.
- * @param temp_threshold Minimum delta (°C) for temperature-triggered publication.
- * @param humidity_threshold Minimum delta (%) for humidity-triggered publication.
+ * @param dirty_since_us Optional; receives the low 32 bits of esp_timer time at
+ *        which the oldest pending change was detected.
  *
  * @return true if the frame should be transmitted, false otherwise.
  */
-bool data_model_should_publish(sensor_data_model_t *model, float temp_threshold, float humidity_threshold);
+bool data_model_should_publish(sensor_data_model_t *model, uint32_t *dirty_since_us);
 
 /**
- * @brief Serialise the current snapshot into the double-buffered staging arenas.
+ * @brief Return the finished frame for the current sequence, encoding it only once.
+ *
+ * The first build of a sequence claims the dirty bits (restored if encoding fails)
+ * and freezes a snapshot; a later build of the same sequence in the same format is
+ * served from the cached frame, and one in the other format is encoded from that
+ * snapshot. Publisher only; the frame is valid until the next encode.
  *
  * @param model Target data model.
  * @param use_cbor Encode as CBOR when true, otherwise JSON.
- * @param out_buf Output pointer to the staged payload buffer.
- * @param out_len Output payload length in bytes.
- * @param crc32 Optional pointer receiving the computed CRC32.
  *
- * @return true when encoding succeeds and the staging buffer has been updated.
+ * @return The cached frame, or NULL when encoding failed.
  */
-bool data_model_build(sensor_data_model_t *model, bool use_cbor, uint8_t **out_buf, size_t *out_len,
-                      uint32_t *crc32);
+const data_model_frame_t *data_model_build(sensor_data_model_t *model, bool use_cbor);
 
 /**
- * @brief Increment the monotonic sequence counter embedded in the payload.
+ * @brief Freeze the current sequence and claim its dirty bits without encoding it.
+ *
+ * For callers that encode the state themselves in another message type. A later
+ * data_model_build() of the same sequence encodes from the same snapshot.
+ * Publisher only.
+ *
+ * @return The frozen snapshot, or NULL when the model is not initialised.
+ */
+const proto_sensor_update_t *data_model_freeze(sensor_data_model_t *model);
+
+/**
+ * @brief Increment the monotonic sequence counter embedded in the payload. Publisher only.
  */
 void data_model_increment_seq(sensor_data_model_t *model);
 
+/**
+ * @brief Copy the current state into @p out without blocking any writer.
+ *
+ * Every section is internally consistent; sections may come from slightly
+ * different instants. Publisher only.
+ */
+void data_model_snapshot(sensor_data_model_t *model, proto_sensor_update_t *out);
+
+/**
+ * @brief Read the contention counters.
+ */
+void data_model_get_stats(sensor_data_model_t *model, sensor_data_model_stats_t *out);
+
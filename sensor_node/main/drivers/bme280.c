@@ -24,18 +24,20 @@
 #define BME280_RESET_CMD 0xB6
 
 #define BME280_OSRS_X1 0x01
-#define BME280_MODE_FORCED 0x01
+#define BME280_MODE_NORMAL 0x03
 #define BME280_FILTER_COEFF_4 0x02
-#define BME280_STANDBY_62_5_MS 0x03
 
-#define BME280_STATUS_MEASURING 0x08
-
-#define BME280_MEASUREMENT_TIMEOUT_MS 40
+/* Datasheet 9.1: max measurement time with x1 oversampling on all three channels. */
+#define BME280_MEASUREMENT_MAX_US 9300U
+/* Data registers hold this value until the first conversion completes. */
+#define BME280_ADC_SKIPPED 0x80000
 
 typedef struct {
     bool in_use;
     bool calibrated;
+    bool configured;
     uint8_t address;
+    uint32_t sample_period_ms;
     struct {
         uint16_t dig_T1;
         int16_t dig_T2;
@@ -83,6 +85,7 @@ static bme280_device_t *bme280_get_device(uint8_t address)
             s_devices[i].in_use = true;
             s_devices[i].address = address;
             s_devices[i].calibrated = false;
+            s_devices[i].configured = false;
             memset(&s_devices[i].calib, 0, sizeof(s_devices[i].calib));
             return &s_devices[i];
         }
@@ -95,21 +98,6 @@ static esp_err_t bme280_reset(uint8_t address)
     return bme280_write_reg(address, BME280_REG_RESET, BME280_RESET_CMD);
 }
 
-static esp_err_t bme280_wait_measuring(uint8_t address)
-{
-    uint32_t elapsed = 0;
-    uint8_t status = 0;
-    do {
-        ESP_RETURN_ON_ERROR(bme280_read_reg(address, BME280_REG_STATUS, &status, 1), TAG, "read status");
-        if ((status & BME280_STATUS_MEASURING) == 0) {
-            return ESP_OK;
-        }
-        vTaskDelay(pdMS_TO_TICKS(4));
-        elapsed += 4;
-    } while (elapsed < BME280_MEASUREMENT_TIMEOUT_MS);
-    return ESP_ERR_TIMEOUT;
-}
-
 static esp_err_t bme280_load_calibration(bme280_device_t *dev)
 {
     if (!dev || dev->calibrated) {
@@ -149,25 +137,56 @@ static esp_err_t bme280_load_calibration(bme280_device_t *dev)
     return ESP_OK;
 }
 
-static esp_err_t bme280_configure(bme280_device_t *dev)
+/**
+ * @brief Largest standby time that still yields a fresh sample every @p period_ms.
+ *
+ * In normal mode the sensor cycles measurement + t_standby on its own; matching the
+ * cycle to the reader's period means each read picks up a new, IIR-filtered sample
+ * without triggering or polling the status register.
+ */
+static uint8_t bme280_standby_for_period(uint32_t period_ms)
 {
+    static const struct {
+        uint32_t standby_us;
+        uint8_t code;
+    } table[] = {
+        {1000000, 0x05}, {500000, 0x04}, {250000, 0x03}, {125000, 0x02},
+        {62500, 0x01},   {20000, 0x07},  {10000, 0x06},  {500, 0x00},
+    };
+    uint64_t period_us = (uint64_t)period_ms * 1000U;
+    for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); ++i) {
+        if (table[i].standby_us + BME280_MEASUREMENT_MAX_US <= period_us) {
+            return table[i].code;
+        }
+    }
+    return 0x00;
+}
+
+static esp_err_t bme280_configure(bme280_device_t *dev, uint32_t sample_period_ms)
+{
+    /* ctrl_hum only takes effect after the following ctrl_meas write. */
     ESP_RETURN_ON_ERROR(bme280_write_reg(dev->address, BME280_REG_CTRL_HUM, BME280_OSRS_X1), TAG, "ctrl hum");
-    uint8_t config = (uint8_t)((BME280_STANDBY_62_5_MS << 5) | (BME280_FILTER_COEFF_4 << 2));
+    uint8_t config =
+        (uint8_t)((bme280_standby_for_period(sample_period_ms) << 5) | (BME280_FILTER_COEFF_4 << 2));
     ESP_RETURN_ON_ERROR(bme280_write_reg(dev->address, BME280_REG_CONFIG, config), TAG, "config");
+    uint8_t ctrl_meas = (uint8_t)((BME280_OSRS_X1 << 5) | (BME280_OSRS_X1 << 2) | BME280_MODE_NORMAL);
+    ESP_RETURN_ON_ERROR(bme280_write_reg(dev->address, BME280_REG_CTRL_MEAS, ctrl_meas), TAG, "ctrl meas");
+    dev->configured = true;
     return ESP_OK;
 }
 
-static float bme280_compensate_temperature(const bme280_device_t *dev, int32_t adc_T, int32_t *t_fine)
+/* Datasheet 4.2.3 fixed-point compensation: 0.01 degC. */
+static int32_t bme280_compensate_temperature(const bme280_device_t *dev, int32_t adc_T, int32_t *t_fine)
 {
     int32_t var1 = ((((adc_T >> 3) - ((int32_t)dev->calib.dig_T1 << 1))) * ((int32_t)dev->calib.dig_T2)) >> 11;
     int32_t var2 = (((((adc_T >> 4) - ((int32_t)dev->calib.dig_T1)) * ((adc_T >> 4) - ((int32_t)dev->calib.dig_T1))) >> 12) *
                     ((int32_t)dev->calib.dig_T3)) >> 14;
     *t_fine = var1 + var2;
-    int32_t temp = (*t_fine * 5 + 128) >> 8;
-    return temp / 100.0f;
+    return (*t_fine * 5 + 128) >> 8;
 }
 
-static float bme280_compensate_pressure(const bme280_device_t *dev, int32_t adc_P, int32_t t_fine)
+/* Pa in Q24.8. */
+static uint32_t bme280_compensate_pressure(const bme280_device_t *dev, int32_t adc_P, int32_t t_fine)
 {
     int64_t var1 = (int64_t)t_fine - 128000;
     int64_t var2 = var1 * var1 * (int64_t)dev->calib.dig_P6;
@@ -176,17 +195,18 @@ static float bme280_compensate_pressure(const bme280_device_t *dev, int32_t adc_
     var1 = ((var1 * var1 * (int64_t)dev->calib.dig_P3) >> 8) + ((var1 * (int64_t)dev->calib.dig_P2) << 12);
     var1 = (((((int64_t)1) << 47) + var1)) * (int64_t)dev->calib.dig_P1 >> 33;
     if (var1 == 0) {
-        return 0.0f;
+        return 0;
     }
     int64_t p = 1048576 - adc_P;
     p = (((p << 31) - var2) * 3125) / var1;
     var1 = ((int64_t)dev->calib.dig_P9 * (p >> 13) * (p >> 13)) >> 25;
     var2 = ((int64_t)dev->calib.dig_P8 * p) >> 19;
     p = ((p + var1 + var2) >> 8) + (((int64_t)dev->calib.dig_P7) << 4);
-    return (float)p / 256.0f;
+    return (uint32_t)p;
 }
 
-static float bme280_compensate_humidity(const bme280_device_t *dev, int32_t adc_H, int32_t t_fine)
+/* %RH in Q22.10. */
+static uint32_t bme280_compensate_humidity(const bme280_device_t *dev, int32_t adc_H, int32_t t_fine)
 {
     int32_t v_x1_u32r = t_fine - 76800;
     v_x1_u32r = (((((adc_H << 14) - (((int32_t)dev->calib.dig_H4) << 20) - (((int32_t)dev->calib.dig_H5) * v_x1_u32r)) + 16384) >> 15) *
@@ -195,59 +215,76 @@ static float bme280_compensate_humidity(const bme280_device_t *dev, int32_t adc_
     v_x1_u32r = v_x1_u32r - (((((v_x1_u32r >> 15) * (v_x1_u32r >> 15)) >> 7) * (int32_t)dev->calib.dig_H1) >> 4);
     v_x1_u32r = v_x1_u32r < 0 ? 0 : v_x1_u32r;
     v_x1_u32r = v_x1_u32r > 419430400 ? 419430400 : v_x1_u32r;
-    return (float)(v_x1_u32r >> 12) / 1024.0f;
-}
-
-static esp_err_t bme280_perform_measurement(bme280_device_t *dev, float *temp, float *humidity, float *pressure)
-{
-    ESP_RETURN_ON_ERROR(bme280_write_reg(dev->address, BME280_REG_CTRL_HUM, BME280_OSRS_X1), TAG, "ctrl hum");
-    uint8_t ctrl_meas = (uint8_t)((BME280_OSRS_X1 << 5) | (BME280_OSRS_X1 << 2) | BME280_MODE_FORCED);
-    ESP_RETURN_ON_ERROR(bme280_write_reg(dev->address, BME280_REG_CTRL_MEAS, ctrl_meas), TAG, "ctrl meas");
-    ESP_RETURN_ON_ERROR(bme280_wait_measuring(dev->address), TAG, "wait measure");
-
-    uint8_t raw[8] = {0};
-    ESP_RETURN_ON_ERROR(bme280_read_reg(dev->address, BME280_REG_DATA, raw, sizeof(raw)), TAG, "read data");
-
-    int32_t adc_P = (int32_t)(((uint32_t)raw[0] << 12) | ((uint32_t)raw[1] << 4) | ((uint32_t)raw[2] >> 4));
-    int32_t adc_T = (int32_t)(((uint32_t)raw[3] << 12) | ((uint32_t)raw[4] << 4) | ((uint32_t)raw[5] >> 4));
-    int32_t adc_H = (int32_t)(((uint32_t)raw[6] << 8) | (uint32_t)raw[7]);
-
-    int32_t t_fine = 0;
-    float temperature = bme280_compensate_temperature(dev, adc_T, &t_fine);
-    float humidity_local = bme280_compensate_humidity(dev, adc_H, t_fine);
-    float pressure_local = bme280_compensate_pressure(dev, adc_P, t_fine);
-
-    if (temp) {
-        *temp = temperature;
-    }
-    if (humidity) {
-        *humidity = humidity_local;
-    }
-    if (pressure) {
-        *pressure = pressure_local;
-    }
-    return ESP_OK;
+    return (uint32_t)(v_x1_u32r >> 12);
 }
 
-esp_err_t bme280_init(uint8_t address)
+esp_err_t bme280_init(uint8_t address, uint32_t sample_period_ms)
 {
     bme280_device_t *dev = bme280_get_device(address);
     if (!dev) {
         return ESP_ERR_NO_MEM;
     }
+    dev->calibrated = false;
+    dev->configured = false;
+    dev->sample_period_ms = sample_period_ms;
     ESP_RETURN_ON_ERROR(bme280_reset(address), TAG, "reset");
     vTaskDelay(pdMS_TO_TICKS(2));
     ESP_RETURN_ON_ERROR(bme280_load_calibration(dev), TAG, "load calib");
-    return bme280_configure(dev);
+    return bme280_configure(dev, sample_period_ms);
 }
 
-esp_err_t bme280_read(uint8_t address, float *temperature_c, float *humidity_percent, float *pressure_pa)
+/**
+ * @brief Fetch the latest normal-mode sample with a single 8-byte burst read.
+ *
+ * Reading press/temp/hum in one transaction guarantees the three values come from
+ * the same conversion (the sensor shadows the data registers during a burst).
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FINISHED before the first conversion has completed,
+ *         or an I2C error code.
+ */
+esp_err_t bme280_read_sample(uint8_t address, bme280_sample_t *sample)
 {
+    if (!sample) {
+        return ESP_ERR_INVALID_ARG;
+    }
     bme280_device_t *dev = bme280_get_device(address);
     if (!dev) {
         return ESP_ERR_NO_MEM;
     }
     ESP_RETURN_ON_ERROR(bme280_load_calibration(dev), TAG, "load calib");
-    ESP_RETURN_ON_ERROR(bme280_configure(dev), TAG, "configure");
-    return bme280_perform_measurement(dev, temperature_c, humidity_percent, pressure_pa);
+    if (!dev->configured) {
+        ESP_RETURN_ON_ERROR(bme280_configure(dev, dev->sample_period_ms), TAG, "configure");
+    }
+
+    uint8_t raw[8] = {0};
+    ESP_RETURN_ON_ERROR(bme280_read_reg(dev->address, BME280_REG_DATA, raw, sizeof(raw)), TAG, "read data");
+
+    int32_t adc_P = (int32_t)(((uint32_t)raw[0] << 12) | ((uint32_t)raw[1] << 4) | ((uint32_t)raw[2] >> 4));
+    int32_t adc_T = (int32_t)(((uint32_t)raw[3] << 12) | ((uint32_t)raw[4] << 4) | ((uint32_t)raw[5] >> 4));
+    int32_t adc_H = (int32_t)(((uint32_t)raw[6] << 8) | (uint32_t)raw[7]);
+    if (adc_T == BME280_ADC_SKIPPED) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    int32_t t_fine = 0;
+    sample->temperature_centi_c = bme280_compensate_temperature(dev, adc_T, &t_fine);
+    sample->pressure_pa_q8 = bme280_compensate_pressure(dev, adc_P, t_fine);
+    sample->humidity_q10 = bme280_compensate_humidity(dev, adc_H, t_fine);
+    return ESP_OK;
+}
+
+esp_err_t bme280_read(uint8_t address, float *temperature_c, float *humidity_percent, float *pressure_pa)
+{
+    bme280_sample_t sample;
+    ESP_RETURN_ON_ERROR(bme280_read_sample(address, &sample), TAG, "sample");
+    if (temperature_c) {
+        *temperature_c = (float)sample.temperature_centi_c / 100.0f;
+    }
+    if (humidity_percent) {
+        *humidity_percent = (float)sample.humidity_q10 / 1024.0f;
+    }
+    if (pressure_pa) {
+        *pressure_pa = (float)sample.pressure_pa_q8 / 256.0f;
+    }
+    return ESP_OK;
 }
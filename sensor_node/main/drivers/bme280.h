@@ -7,15 +7,30 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Compensated sample in the datasheet's fixed-point formats.
+ */
+typedef struct {
+    int32_t temperature_centi_c; /**< Temperature in 0.01 \u00b0C. */
+    uint32_t pressure_pa_q8;     /**< Pressure in Pa, Q24.8. */
+    uint32_t humidity_q10;       /**< Relative humidity in %RH, Q22.10. */
+} bme280_sample_t;
+
 /**
  * @brief Initialise the BME280 device at the specified I\u00b2C address.
  *
- * Loads factory calibration coefficients and configures baseline oversampling.
+ * Loads factory calibration coefficients and starts normal-mode sampling with the
+ * standby time chosen so a new sample is ready every @p sample_period_ms.
+ */
+esp_err_t bme280_init(uint8_t address, uint32_t sample_period_ms);
+
+/**
+ * @brief Read the latest sample with one burst read; compensation is integer-only.
  */
-esp_err_t bme280_init(uint8_t address);
+esp_err_t bme280_read_sample(uint8_t address, bme280_sample_t *sample);
 
 /**
- * @brief Perform a forced measurement and return compensated readings.
+ * @brief Read the latest sample and convert it to floating-point units.
  *
  * @param address I\u00b2C address of the target BME280.
  * @param temperature_c Optional pointer receiving the ambient temperature in \u00b0C.
@@ -3,6 +3,7 @@
 #include "esp_check.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "onewire_bus.h"
 #include <string.h>
 
@@ -11,6 +12,13 @@
 #define DS18B20_CMD_CONVERT_T 0x44
 #define DS18B20_CMD_WRITE_SCRATCH 0x4E
 #define DS18B20_CMD_READ_SCRATCH 0xBE
+#define DS18B20_CMD_COPY_SCRATCH 0x48
+
+#define DS18B20_SCRATCH_LEN 9U
+#define DS18B20_SCRATCH_CONFIG 4U
+#define DS18B20_CONFIG_RESERVED_MASK 0x9FU
+#define DS18B20_CONFIG_RESERVED_BITS 0x1FU
+#define DS18B20_EEPROM_WRITE_MS 10U
 
 static const char *TAG = "ds18b20";
 
@@ -54,47 +62,119 @@ uint32_t ds18b20_conversion_time_ms(uint8_t resolution_bits)
     }
 }
 
-/**
- * @brief Configure DS18B20 scratchpad and start a temperature conversion.
- *
- * @param bus OneWire bus handle.
- * @param devices Array of device descriptors to address.
- * @param count Number of devices in the array.
- * @param resolution_bits Requested conversion resolution.
- * @return ESP_OK on success, otherwise an error from the transport.
- */
-esp_err_t ds18b20_start_conversion(onewire_bus_handle_t bus, const onewire_device_t *devices,
-                                   size_t count, uint8_t resolution_bits)
+static uint8_t ds18b20_config_for_resolution(uint8_t resolution_bits)
 {
-    if (!bus || !devices || count == 0) {
-        return ESP_ERR_INVALID_ARG;
-    }
-    uint8_t config = 0x7F;
     switch (resolution_bits) {
     case 9:
-        config = 0x1F;
-        break;
+        return 0x1F;
     case 10:
-        config = 0x3F;
-        break;
+        return 0x3F;
     case 11:
-        config = 0x5F;
-        break;
+        return 0x5F;
     case 12:
     default:
-        config = 0x7F;
-        break;
+        return 0x7F;
     }
+}
 
-    for (size_t i = 0; i < count; ++i) {
-        ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, &devices[i]), TAG, "select");
-        uint8_t cmd = DS18B20_CMD_WRITE_SCRATCH;
-        uint8_t payload[3] = {0x00, 0x00, config};
-        ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, &cmd, 1), TAG, "write_cmd");
-        ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, payload, sizeof(payload)), TAG, "write");
+/**
+ * @brief Dallas/Maxim CRC-8 (polynomial x^8 + x^5 + x^4 + 1, reflected).
+ */
+uint8_t ds18b20_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t byte = data[i];
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            uint8_t mix = (uint8_t)((crc ^ byte) & 0x01U);
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8CU;
+            }
+            byte >>= 1;
+        }
     }
+    return crc;
+}
 
-    ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, NULL), TAG, "skip");
+/**
+ * @brief Read and validate the 9-byte scratchpad of one device.
+ *
+ * Besides the CRC, the reserved configuration bits must read back as ones; this
+ * rejects the all-zero frame of a shorted bus, which carries a valid CRC.
+ */
+static esp_err_t ds18b20_read_scratchpad(onewire_bus_handle_t bus, const onewire_device_t *device,
+                                         uint8_t scratch[DS18B20_SCRATCH_LEN])
+{
+    ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, device), TAG, "select");
+    uint8_t cmd = DS18B20_CMD_READ_SCRATCH;
+    ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, &cmd, 1), TAG, "read_cmd");
+    ESP_RETURN_ON_ERROR(onewire_bus_read_bytes(bus, scratch, DS18B20_SCRATCH_LEN), TAG, "read");
+    if (ds18b20_crc8(scratch, DS18B20_SCRATCH_LEN - 1U) != scratch[DS18B20_SCRATCH_LEN - 1U] ||
+        (scratch[DS18B20_SCRATCH_CONFIG] & DS18B20_CONFIG_RESERVED_MASK) != DS18B20_CONFIG_RESERVED_BITS) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Make sure @p device converts at @p resolution_bits, persisting the setting.
+ *
+ * The scratchpad is read first; when the configuration already matches nothing is
+ * written, so the EEPROM only sees a write when a probe is new or was reconfigured.
+ * Otherwise the configuration is written (alarm bytes preserved) and read back to
+ * verify, then copied to EEPROM when @p persist is set so it survives power loss.
+ *
+ * @return ESP_OK when the device is configured, ESP_ERR_INVALID_CRC on corrupted
+ *         reads, ESP_ERR_INVALID_RESPONSE when the read-back does not match.
+ */
+esp_err_t ds18b20_configure(onewire_bus_handle_t bus, const onewire_device_t *device, uint8_t resolution_bits,
+                            bool persist)
+{
+    if (!bus || !device) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t config = ds18b20_config_for_resolution(resolution_bits);
+    uint8_t scratch[DS18B20_SCRATCH_LEN] = {0};
+    ESP_RETURN_ON_ERROR(ds18b20_read_scratchpad(bus, device, scratch), TAG, "scratch");
+    if (scratch[DS18B20_SCRATCH_CONFIG] == config) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, device), TAG, "select");
+    uint8_t write[4] = {DS18B20_CMD_WRITE_SCRATCH, scratch[2], scratch[3], config};
+    ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, write, sizeof(write)), TAG, "write");
+    ESP_RETURN_ON_ERROR(ds18b20_read_scratchpad(bus, device, scratch), TAG, "verify");
+    if (scratch[DS18B20_SCRATCH_CONFIG] != config) {
+        ESP_LOGW(TAG, "Configuration read-back mismatch (0x%02X != 0x%02X)", scratch[DS18B20_SCRATCH_CONFIG],
+                 config);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (persist) {
+        ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, device), TAG, "select");
+        uint8_t cmd = DS18B20_CMD_COPY_SCRATCH;
+        ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, &cmd, 1), TAG, "copy");
+        vTaskDelay(pdMS_TO_TICKS(DS18B20_EEPROM_WRITE_MS));
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Start a temperature conversion.
+ *
+ * Devices convert at the resolution held in their configuration register; see
+ * ds18b20_configure().
+ *
+ * @param bus OneWire bus handle.
+ * @param device Device to convert, or NULL to start every device at once (skip ROM).
+ * @return ESP_OK on success, otherwise an error from the transport.
+ */
+esp_err_t ds18b20_start_conversion(onewire_bus_handle_t bus, const onewire_device_t *device)
+{
+    if (!bus) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, device), TAG, "select");
     uint8_t cmd = DS18B20_CMD_CONVERT_T;
     return onewire_bus_write_bytes(bus, &cmd, 1);
 }
@@ -133,13 +213,16 @@ esp_err_t ds18b20_read_temperature(onewire_bus_handle_t bus, const onewire_devic
     if (!bus || !device || !temperature_c) {
         return ESP_ERR_INVALID_ARG;
     }
-    ESP_RETURN_ON_ERROR(ds18b20_select_device(bus, device), TAG, "select");
-    uint8_t cmd = DS18B20_CMD_READ_SCRATCH;
-    ESP_RETURN_ON_ERROR(onewire_bus_write_bytes(bus, &cmd, 1), TAG, "read_cmd");
-    uint8_t scratch[9] = {0};
-    ESP_RETURN_ON_ERROR(onewire_bus_read_bytes(bus, scratch, sizeof(scratch)), TAG, "read");
+    uint8_t scratch[DS18B20_SCRATCH_LEN] = {0};
+    esp_err_t err = ds18b20_read_scratchpad(bus, device, scratch);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    uint16_t raw = ((uint16_t)scratch[1] << 8) | scratch[0];
+    /* Undefined low bits at reduced resolution are masked off (datasheet table 1). */
+    uint8_t resolution = (uint8_t)(9U + ((scratch[DS18B20_SCRATCH_CONFIG] >> 5) & 0x03U));
+    int16_t raw = (int16_t)(((uint16_t)scratch[1] << 8) | scratch[0]);
+    raw = (int16_t)(raw & ~((1 << (12U - resolution)) - 1));
     *temperature_c = (float)raw / 16.0f;
     return ESP_OK;
 }
@@ -3,17 +3,64 @@
 #include "esp_check.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_log.h"
 #include "i2c_bus.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 
 #define MCP23017_IODIRA 0x00
 #define MCP23017_IODIRB 0x01
+#define MCP23017_GPINTENA 0x04
+#define MCP23017_INTCONA 0x08
+#define MCP23017_IOCON 0x0A
 #define MCP23017_GPPUA 0x0C
 #define MCP23017_GPPUB 0x0D
+#define MCP23017_INTFA 0x0E
 #define MCP23017_GPIOA 0x12
 #define MCP23017_GPIOB 0x13
 #define MCP23017_OLATA 0x14
 #define MCP23017_OLATB 0x15
 
+#define MCP23017_IOCON_MIRROR 0x40
+#define MCP23017_REG_SPAN (MCP23017_OLATB + 1)
+
+typedef struct {
+    uint8_t addr;
+    bool in_use;
+    bool valid;
+    uint16_t iodir;
+    uint16_t gppu;
+    uint16_t gpinten;
+    uint16_t olat;
+} mcp23017_shadow_t;
+
+static mcp23017_shadow_t s_shadow[MCP23017_MAX_DEVICES];
+
+/**
+ * @brief Find the register shadow for @p addr, claiming a free slot when needed.
+ *
+ * @return NULL when every slot belongs to another device.
+ */
+static mcp23017_shadow_t *shadow_get(uint8_t addr)
+{
+    mcp23017_shadow_t *free_slot = NULL;
+    for (size_t i = 0; i < MCP23017_MAX_DEVICES; ++i) {
+        if (s_shadow[i].in_use && s_shadow[i].addr == addr) {
+            return &s_shadow[i];
+        }
+        if (!s_shadow[i].in_use && !free_slot) {
+            free_slot = &s_shadow[i];
+        }
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->addr = addr;
+        free_slot->in_use = true;
+    }
+    return free_slot;
+}
+
 /**
  * @brief Write a 16-bit value to consecutive MCP23017 registers.
  *
@@ -48,6 +95,9 @@ static esp_err_t mcp23017_read16(uint8_t addr, uint8_t reg, uint16_t *value)
 /**
  * @brief Initialize MCP23017 direction and pull-up configuration.
  *
+ * Seeds the driver shadow with the written IODIR/GPPU and the current OLAT, so
+ * later masked writes need no read-back.
+ *
  * @param addr I2C slave address.
  * @param direction_mask Bit mask selecting input (1) or output (0) pins.
  * @param pullup_mask Pull-up enable mask for input pins.
@@ -55,12 +105,66 @@ static esp_err_t mcp23017_read16(uint8_t addr, uint8_t reg, uint16_t *value)
  */
 esp_err_t mcp23017_init(uint8_t addr, uint16_t direction_mask, uint16_t pullup_mask)
 {
+    mcp23017_shadow_t *shadow = shadow_get(addr);
+    if (!shadow) {
+        return ESP_ERR_NO_MEM;
+    }
+    shadow->valid = false;
     ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_IODIRA, direction_mask), "mcp23017", "iodir");
     ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_GPPUA, pullup_mask), "mcp23017", "gppu");
+    ESP_RETURN_ON_ERROR(mcp23017_read16(addr, MCP23017_OLATA, &shadow->olat), "mcp23017", "olat");
+    shadow->iodir = direction_mask;
+    shadow->gppu = pullup_mask;
+    shadow->valid = true;
     vTaskDelay(pdMS_TO_TICKS(10));
     return ESP_OK;
 }
 
+/**
+ * @brief Bring the shadow back in line with the device, e.g. after a bus recovery.
+ *
+ * Reads IODIR through OLATB in one sequential transaction. When IODIR, GPPU or
+ * GPINTEN no longer match what was configured the expander has been reset, so the
+ * shadowed configuration and output latches are written back; otherwise the device
+ * OLAT is adopted, since an interrupted write may or may not have landed.
+ *
+ * @param addr I2C slave address of a device previously passed to mcp23017_init().
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE for an unknown device, or a bus error.
+ */
+esp_err_t mcp23017_resync(uint8_t addr)
+{
+    mcp23017_shadow_t *shadow = NULL;
+    for (size_t i = 0; i < MCP23017_MAX_DEVICES; ++i) {
+        if (s_shadow[i].in_use && s_shadow[i].addr == addr) {
+            shadow = &s_shadow[i];
+        }
+    }
+    if (!shadow) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    shadow->valid = false;
+    uint8_t reg = MCP23017_IODIRA;
+    uint8_t regs[MCP23017_REG_SPAN] = {0};
+    ESP_RETURN_ON_ERROR(i2c_bus_write_read(addr, &reg, 1, regs, sizeof(regs)), "mcp23017", "resync");
+    uint16_t iodir = ((uint16_t)regs[MCP23017_IODIRB] << 8) | regs[MCP23017_IODIRA];
+    uint16_t gppu = ((uint16_t)regs[MCP23017_GPPUB] << 8) | regs[MCP23017_GPPUA];
+    uint16_t gpinten = ((uint16_t)regs[MCP23017_GPINTENA + 1] << 8) | regs[MCP23017_GPINTENA];
+    uint16_t olat = ((uint16_t)regs[MCP23017_OLATB] << 8) | regs[MCP23017_OLATA];
+    if (iodir != shadow->iodir || gppu != shadow->gppu || gpinten != shadow->gpinten) {
+        ESP_LOGW("mcp23017", "0x%02X lost its configuration, restoring", addr);
+        ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_OLATA, shadow->olat), "mcp23017", "olat");
+        ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_IODIRA, shadow->iodir), "mcp23017", "iodir");
+        ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_GPPUA, shadow->gppu), "mcp23017", "gppu");
+        if (shadow->gpinten) {
+            ESP_RETURN_ON_ERROR(mcp23017_enable_interrupts(addr, shadow->gpinten), "mcp23017", "gpinten");
+        }
+    } else {
+        shadow->olat = olat;
+    }
+    shadow->valid = true;
+    return ESP_OK;
+}
+
 /**
  * @brief Read GPIO input states from both MCP23017 ports.
  *
@@ -79,6 +183,10 @@ esp_err_t mcp23017_read_gpio(uint8_t addr, uint16_t *value)
 /**
  * @brief Update GPIO output latches on the MCP23017 using a mask.
  *
+ * The new latch value comes from the driver shadow, so this is a single write: one
+ * OLAT byte when only one port changes, both when both do, nothing when neither
+ * does. A failed write leaves the shadow unknown and the next call resyncs first.
+ *
  * @param addr I2C slave address.
  * @param mask Bit mask indicating which pins to update.
  * @param value Output value applied to masked pins.
@@ -86,8 +194,87 @@ esp_err_t mcp23017_read_gpio(uint8_t addr, uint16_t *value)
  */
 esp_err_t mcp23017_write_gpio(uint8_t addr, uint16_t mask, uint16_t value)
 {
+    mcp23017_shadow_t *shadow = shadow_get(addr);
+    if (!shadow) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (!shadow->valid) {
+        /* Never initialised here (or lost track): fall back to reading the latches. */
+        ESP_RETURN_ON_ERROR(mcp23017_read16(addr, MCP23017_OLATA, &shadow->olat), "mcp23017", "olat");
+        shadow->valid = true;
+    }
+    uint16_t next = (uint16_t)((shadow->olat & ~mask) | (value & mask));
+    uint16_t changed = next ^ shadow->olat;
+    if (changed == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err;
+    if ((changed & 0xFF00U) == 0) {
+        uint8_t data[2] = {MCP23017_OLATA, (uint8_t)(next & 0xFF)};
+        err = i2c_bus_write(addr, data, sizeof(data));
+    } else if ((changed & 0x00FFU) == 0) {
+        uint8_t data[2] = {MCP23017_OLATB, (uint8_t)(next >> 8)};
+        err = i2c_bus_write(addr, data, sizeof(data));
+    } else {
+        err = mcp23017_write16(addr, MCP23017_OLATA, next);
+    }
+    if (err == ESP_OK) {
+        shadow->olat = next;
+    } else {
+        shadow->valid = false;
+    }
+    return err;
+}
+
+/**
+ * @brief Enable interrupt-on-change for the pins in @p mask.
+ *
+ * INTCON is cleared so pins are compared against their previous value, and IOCON
+ * MIRROR ties INTA and INTB together so either output reports both ports. Any
+ * stale capture is cleared before returning.
+ *
+ * @param addr I2C slave address.
+ * @param mask Pins that raise INTA/INTB when they change.
+ * @return ESP_OK on success or an ESP-IDF error code.
+ */
+esp_err_t mcp23017_enable_interrupts(uint8_t addr, uint16_t mask)
+{
+    uint8_t iocon[2] = {MCP23017_IOCON, MCP23017_IOCON_MIRROR};
+    ESP_RETURN_ON_ERROR(i2c_bus_write(addr, iocon, sizeof(iocon)), "mcp23017", "iocon");
+    ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_INTCONA, 0x0000), "mcp23017", "intcon");
+    ESP_RETURN_ON_ERROR(mcp23017_write16(addr, MCP23017_GPINTENA, mask), "mcp23017", "gpinten");
+    mcp23017_shadow_t *shadow = shadow_get(addr);
+    if (shadow) {
+        shadow->gpinten = mask;
+    }
+    uint16_t flags;
+    uint16_t captured;
     uint16_t current;
-    ESP_RETURN_ON_ERROR(mcp23017_read16(addr, MCP23017_OLATA, &current), "mcp23017", "olat");
-    current = (current & ~mask) | (value & mask);
-    return mcp23017_write16(addr, MCP23017_OLATA, current);
+    return mcp23017_read_interrupt(addr, &flags, &captured, &current);
+}
+
+/**
+ * @brief Read INTF, INTCAP and GPIO in one sequential transaction.
+ *
+ * Reading INTCAP/GPIO clears the interrupt, so this both acknowledges the change
+ * and returns the port state; @p current reflects edges that arrived after capture.
+ *
+ * @param addr I2C slave address.
+ * @param flags Output pins that caused the interrupt.
+ * @param captured Output port state latched when the interrupt fired.
+ * @param current Output port state at the time of the read.
+ * @return ESP_OK on success or an ESP-IDF error code.
+ */
+esp_err_t mcp23017_read_interrupt(uint8_t addr, uint16_t *flags, uint16_t *captured, uint16_t *current)
+{
+    if (!flags || !captured || !current) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t reg = MCP23017_INTFA;
+    uint8_t buf[6] = {0};
+    ESP_RETURN_ON_ERROR(i2c_bus_write_read(addr, &reg, 1, buf, sizeof(buf)), "mcp23017", "intf");
+    *flags = ((uint16_t)buf[1] << 8) | buf[0];
+    *captured = ((uint16_t)buf[3] << 8) | buf[2];
+    *current = ((uint16_t)buf[5] << 8) | buf[4];
+    return ESP_OK;
 }
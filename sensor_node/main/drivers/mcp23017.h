@@ -3,11 +3,22 @@
 #include "esp_err.h"
 #include <stdint.h>
 
+#define MCP23017_MAX_DEVICES 8U
+
 typedef enum {
     MCP23017_PORTA = 0,
     MCP23017_PORTB = 1,
 } mcp23017_port_t;
 
+/*
+ * IODIR, GPPU, GPINTEN and OLAT are shadowed per device address so masked output
+ * writes need no read-back. The shadow is not locked; drive each device from one
+ * task (t_io) and call mcp23017_resync() after a bus recovery.
+ */
+
 esp_err_t mcp23017_init(uint8_t addr, uint16_t direction_mask, uint16_t pullup_mask);
+esp_err_t mcp23017_resync(uint8_t addr);
 esp_err_t mcp23017_read_gpio(uint8_t addr, uint16_t *value);
 esp_err_t mcp23017_write_gpio(uint8_t addr, uint16_t mask, uint16_t value);
+esp_err_t mcp23017_enable_interrupts(uint8_t addr, uint16_t mask);
+esp_err_t mcp23017_read_interrupt(uint8_t addr, uint16_t *flags, uint16_t *captured, uint16_t *current);
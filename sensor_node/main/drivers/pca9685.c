@@ -1,10 +1,13 @@
 #include "pca9685.h"
 
 #include "esp_check.h"
+#include "esp_rom/ets_sys.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "i2c_bus.h"
 #include <math.h>
+#include <stdbool.h>
+#include <string.h>
 
 #define PCA9685_MODE1 0x00
 #define PCA9685_MODE2 0x01
@@ -12,6 +15,56 @@
 #define PCA9685_ALL_LED_ON_L 0xFA
 #define PCA9685_PRESCALE 0xFE
 
+#define PCA9685_MODE1_RESTART 0x80
+#define PCA9685_MODE1_AI 0x20
+#define PCA9685_MODE1_SLEEP 0x10
+#define PCA9685_MODE1_ALLCALL 0x01
+
+#define PCA9685_FULL_BIT 0x10
+#define PCA9685_OSC_STARTUP_US 500U
+
+/*
+ * Unchanged channels between two changed runs are rewritten rather than splitting the
+ * burst when the gap is this short: one channel is 4 bytes (~90 us at 400 kHz), about
+ * what another start/address/register/stop plus the driver setup costs.
+ */
+#define PCA9685_BURST_MERGE_GAP 1U
+
+typedef struct {
+    uint8_t addr;
+    bool in_use;
+    bool prescale_valid;
+    uint8_t prescale;
+    uint16_t valid_mask;
+    uint16_t duty[PCA9685_CHANNELS];
+} pca9685_shadow_t;
+
+static pca9685_shadow_t s_shadow[PCA9685_MAX_DEVICES];
+
+/**
+ * @brief Find the register shadow for @p addr, claiming a free slot when needed.
+ *
+ * @return NULL when every slot belongs to another device; callers then write through.
+ */
+static pca9685_shadow_t *shadow_get(uint8_t addr)
+{
+    pca9685_shadow_t *free_slot = NULL;
+    for (size_t i = 0; i < PCA9685_MAX_DEVICES; ++i) {
+        if (s_shadow[i].in_use && s_shadow[i].addr == addr) {
+            return &s_shadow[i];
+        }
+        if (!s_shadow[i].in_use && !free_slot) {
+            free_slot = &s_shadow[i];
+        }
+    }
+    if (free_slot) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->addr = addr;
+        free_slot->in_use = true;
+    }
+    return free_slot;
+}
+
 /**
  * @brief Write a single PCA9685 register.
  *
@@ -27,43 +80,123 @@ static esp_err_t pca9685_write8(uint8_t addr, uint8_t reg, uint8_t value)
 }
 
 /**
- * @brief Write the PCA9685 channel timing registers.
+ * @brief Encode a duty cycle into the ON_L/ON_H/OFF_L/OFF_H register quad.
+ *
+ * Duty values of PCA9685_DUTY_FULL_ON and above use the full-on bit so the output
+ * stays high for the whole period.
+ */
+static void pca9685_encode(uint16_t duty, uint8_t out[4])
+{
+    if (duty >= PCA9685_DUTY_FULL_ON) {
+        out[0] = 0x00;
+        out[1] = PCA9685_FULL_BIT;
+        out[2] = 0x00;
+        out[3] = 0x00;
+        return;
+    }
+    out[0] = 0x00;
+    out[1] = 0x00;
+    out[2] = (uint8_t)(duty & 0xFF);
+    out[3] = (uint8_t)((duty >> 8) & 0x0F);
+}
+
+static uint16_t pca9685_clamp(uint16_t duty)
+{
+    return duty >= PCA9685_DUTY_FULL_ON ? PCA9685_DUTY_FULL_ON : duty;
+}
+
+/**
+ * @brief Write channels [first, first + count) in one auto-increment burst.
  *
- * @param addr I2C address of the device.
- * @param reg Base register for the channel.
- * @param on Tick value where the PWM signal turns on.
- * @param off Tick value where the PWM signal turns off.
  * @return ESP_OK when the transfer succeeds, otherwise an error code.
  */
-static esp_err_t pca9685_write16(uint8_t addr, uint8_t reg, uint16_t on, uint16_t off)
+static esp_err_t pca9685_write_span(uint8_t addr, size_t first, size_t count, const uint16_t *duty)
 {
-    uint8_t data[5] = {
-        reg,
-        (uint8_t)(on & 0xFF),
-        (uint8_t)((on >> 8) & 0x0F),
-        (uint8_t)(off & 0xFF),
-        (uint8_t)((off >> 8) & 0x0F),
-    };
-    return i2c_bus_write(addr, data, sizeof(data));
+    uint8_t data[1 + 4 * PCA9685_CHANNELS];
+    data[0] = (uint8_t)(PCA9685_LED0_ON_L + 4 * first);
+    for (size_t i = 0; i < count; ++i) {
+        pca9685_encode(duty[first + i], &data[1 + 4 * i]);
+    }
+    return i2c_bus_write(addr, data, 1 + 4 * count);
+}
+
+static uint8_t pca9685_prescale(uint16_t frequency_hz)
+{
+    float prescale = (25000000.0f / (4096.0f * (float)frequency_hz)) - 1.0f;
+    if (prescale < 3.0f) {
+        prescale = 3.0f;
+    } else if (prescale > 255.0f) {
+        prescale = 255.0f;
+    }
+    return (uint8_t)(prescale + 0.5f);
 }
 
 /**
  * @brief Initialize the PCA9685 PWM controller.
  *
+ * Leaves MODE1 auto-increment enabled, which the burst writes rely on, and forgets
+ * any cached channel values.
+ *
  * @param addr I2C address of the device.
  * @param frequency_hz Desired PWM frequency in hertz.
  * @return ESP_OK on success or an ESP-IDF error code.
  */
 esp_err_t pca9685_init(uint8_t addr, uint16_t frequency_hz)
 {
-    float prescale = (25000000.0f / (4096.0f * (float)frequency_hz)) - 1.0f;
-    uint8_t prescale_val = (uint8_t)(prescale + 0.5f);
+    if (frequency_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t prescale_val = pca9685_prescale(frequency_hz);
+    pca9685_invalidate(addr);
 
-    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, 0x10), "pca9685", "sleep");
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, PCA9685_MODE1_SLEEP), "pca9685", "sleep");
     ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_PRESCALE, prescale_val), "pca9685", "prescale");
-    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, 0xA1), "pca9685", "mode1");
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1,
+                                       PCA9685_MODE1_RESTART | PCA9685_MODE1_AI | PCA9685_MODE1_ALLCALL),
+                        "pca9685", "mode1");
     ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE2, 0x04), "pca9685", "mode2");
     vTaskDelay(pdMS_TO_TICKS(5));
+
+    pca9685_shadow_t *shadow = shadow_get(addr);
+    if (shadow) {
+        shadow->prescale = prescale_val;
+        shadow->prescale_valid = true;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Change the PWM frequency without touching the channel registers.
+ *
+ * PRESCALE is only writable in sleep. Setting RESTART after the oscillator has
+ * settled resumes every channel with its previous ON/OFF values, so nothing has to
+ * be rewritten. A no-op when the prescaler already matches.
+ */
+esp_err_t pca9685_set_frequency(uint8_t addr, uint16_t frequency_hz)
+{
+    if (frequency_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t prescale_val = pca9685_prescale(frequency_hz);
+    pca9685_shadow_t *shadow = shadow_get(addr);
+    if (shadow && shadow->prescale_valid && shadow->prescale == prescale_val) {
+        return ESP_OK;
+    }
+    if (shadow) {
+        shadow->prescale_valid = false;
+    }
+
+    const uint8_t awake = PCA9685_MODE1_AI | PCA9685_MODE1_ALLCALL;
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, awake | PCA9685_MODE1_SLEEP), "pca9685", "sleep");
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_PRESCALE, prescale_val), "pca9685", "prescale");
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, awake), "pca9685", "wake");
+    ets_delay_us(PCA9685_OSC_STARTUP_US);
+    ESP_RETURN_ON_ERROR(pca9685_write8(addr, PCA9685_MODE1, awake | PCA9685_MODE1_RESTART), "pca9685", "restart");
+
+    if (shadow) {
+        shadow->prescale = prescale_val;
+        shadow->prescale_valid = true;
+    }
     return ESP_OK;
 }
 
@@ -72,39 +205,124 @@ esp_err_t pca9685_init(uint8_t addr, uint16_t frequency_hz)
  *
  * @param addr I2C address of the device.
  * @param channel Channel index (0-15).
- * @param duty 12-bit duty cycle value.
+ * @param duty 12-bit duty cycle value, or PCA9685_DUTY_FULL_ON.
  * @return ESP_OK when the channel update succeeds, otherwise an error code.
  */
 esp_err_t pca9685_set_pwm(uint8_t addr, uint8_t channel, uint16_t duty)
 {
-    if (channel >= 16) {
+    if (channel >= PCA9685_CHANNELS) {
         return ESP_ERR_INVALID_ARG;
     }
-    uint16_t on = 0;
-    uint16_t off = duty;
-    if (duty >= 4096) {
-        on = 0;
-        off = 0x1000;
+    duty = pca9685_clamp(duty);
+    pca9685_shadow_t *shadow = shadow_get(addr);
+    uint16_t bit = (uint16_t)(1U << channel);
+    if (shadow && (shadow->valid_mask & bit) && shadow->duty[channel] == duty) {
+        return ESP_OK;
+    }
+    uint16_t values[PCA9685_CHANNELS];
+    values[channel] = duty;
+    esp_err_t err = pca9685_write_span(addr, channel, 1, values);
+    if (shadow) {
+        if (err == ESP_OK) {
+            shadow->duty[channel] = duty;
+            shadow->valid_mask |= bit;
+        } else {
+            shadow->valid_mask &= (uint16_t)~bit;
+        }
     }
-    uint8_t reg = PCA9685_LED0_ON_L + 4 * channel;
-    return pca9685_write16(addr, reg, on, off);
+    return err;
 }
 
 /**
- * @brief Apply duty cycle values to a contiguous set of channels.
+ * @brief Apply duty cycle values to channels 0..count-1.
+ *
+ * Only channels that differ from the shadow are sent. A full set of identical values
+ * goes out as one ALL_LED write; otherwise each run of changed channels (bridging
+ * gaps of up to PCA9685_BURST_MERGE_GAP) is one auto-increment burst, so a complete
+ * refresh is a single 65-byte transaction instead of sixteen.
  *
  * @param addr I2C address of the device.
  * @param duty Array of duty cycle values.
- * @param count Number of entries in the duty array.
+ * @param count Number of entries in the duty array (at most 16).
  * @return ESP_OK on success or an ESP-IDF error code.
  */
 esp_err_t pca9685_set_all(uint8_t addr, const uint16_t *duty, size_t count)
 {
-    if (!duty || count == 0) {
+    if (!duty || count == 0 || count > PCA9685_CHANNELS) {
         return ESP_ERR_INVALID_ARG;
     }
+    uint16_t values[PCA9685_CHANNELS];
+    uint16_t dirty = 0;
+    bool uniform = true;
+    pca9685_shadow_t *shadow = shadow_get(addr);
     for (size_t i = 0; i < count; ++i) {
-        ESP_RETURN_ON_ERROR(pca9685_set_pwm(addr, i, duty[i]), "pca9685", "set");
+        values[i] = pca9685_clamp(duty[i]);
+        uniform &= values[i] == values[0];
+        uint16_t bit = (uint16_t)(1U << i);
+        if (!shadow || !(shadow->valid_mask & bit) || shadow->duty[i] != values[i]) {
+            dirty |= bit;
+        }
+    }
+    if (dirty == 0) {
+        return ESP_OK;
+    }
+
+    if (uniform && count == PCA9685_CHANNELS) {
+        uint8_t data[5] = {PCA9685_ALL_LED_ON_L};
+        pca9685_encode(values[0], &data[1]);
+        esp_err_t err = i2c_bus_write(addr, data, sizeof(data));
+        if (shadow) {
+            shadow->valid_mask = 0;
+            if (err == ESP_OK) {
+                memcpy(shadow->duty, values, sizeof(values));
+                shadow->valid_mask = 0xFFFF;
+            }
+        }
+        return err;
+    }
+
+    size_t channel = 0;
+    while (channel < count) {
+        if (!(dirty & (1U << channel))) {
+            ++channel;
+            continue;
+        }
+        size_t first = channel;
+        size_t last = channel;
+        for (size_t next = channel + 1; next < count; ++next) {
+            if (dirty & (1U << next)) {
+                if (next - last - 1 > PCA9685_BURST_MERGE_GAP) {
+                    break;
+                }
+                last = next;
+            }
+        }
+        size_t span = last - first + 1;
+        uint16_t span_mask = (uint16_t)(((1U << span) - 1U) << first);
+        esp_err_t err = pca9685_write_span(addr, first, span, values);
+        if (shadow) {
+            if (err == ESP_OK) {
+                memcpy(&shadow->duty[first], &values[first], span * sizeof(values[0]));
+                shadow->valid_mask |= span_mask;
+            } else {
+                shadow->valid_mask &= (uint16_t)~span_mask;
+            }
+        }
+        ESP_RETURN_ON_ERROR(err, "pca9685", "burst");
+        channel = last + 1;
     }
     return ESP_OK;
 }
+
+/**
+ * @brief Forget the cached registers of @p addr so the next update rewrites them.
+ */
+void pca9685_invalidate(uint8_t addr)
+{
+    for (size_t i = 0; i < PCA9685_MAX_DEVICES; ++i) {
+        if (s_shadow[i].in_use && s_shadow[i].addr == addr) {
+            s_shadow[i].valid_mask = 0;
+            s_shadow[i].prescale_valid = false;
+        }
+    }
+}
@@ -4,6 +4,18 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define PCA9685_CHANNELS 16U
+#define PCA9685_MAX_DEVICES 4U
+#define PCA9685_DUTY_FULL_ON 4096U
+
+/*
+ * The driver keeps a shadow of the LED and PRESCALE registers per device address so
+ * repeated values never reach the bus. The shadow is not locked: a device must be
+ * driven from a single task (t_io). After a bus recovery or an external reset call
+ * pca9685_invalidate() so the next update rewrites everything.
+ */
 esp_err_t pca9685_init(uint8_t addr, uint16_t frequency_hz);
+esp_err_t pca9685_set_frequency(uint8_t addr, uint16_t frequency_hz);
 esp_err_t pca9685_set_pwm(uint8_t addr, uint8_t channel, uint16_t duty);
 esp_err_t pca9685_set_all(uint8_t addr, const uint16_t *duty, size_t count);
+void pca9685_invalidate(uint8_t addr);
@@ -1,6 +1,8 @@
 #include "sht20.h"
 
+#include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "i2c_bus.h"
@@ -13,6 +15,9 @@
 
 #define SHT20_MAX_RETRIES 5
 #define SHT20_BASE_BACKOFF_MS 10
+#define SHT20_TEMP_CONVERSION_US 85000
+#define SHT20_HUM_CONVERSION_US 29000
+#define SHT20_RESET_SETTLE_US 20000
 
 static const char *TAG = "sht20";
 
@@ -40,65 +45,138 @@ static uint8_t sht20_crc8(const uint8_t *data, size_t len)
 }
 
 /**
- * @brief Trigger a single SHT20 measurement and read the raw response bytes.
+ * @brief Validate a raw measurement frame and convert it to engineering units.
  *
- * @param addr I2C address of the sensor.
- * @param command Measurement command opcode.
- * @param raw Output buffer receiving three bytes (MSB, LSB, CRC).
- * @return ESP_OK on success or an I2C driver error code.
+ * @param raw Three bytes read from the sensor (MSB, LSB, CRC).
+ * @param is_temp True when the frame holds a temperature, false for humidity.
+ * @param out_value Output pointer receiving the converted value.
+ * @return ESP_OK on success or ESP_ERR_INVALID_CRC.
  */
-static esp_err_t sht20_measure_once(uint8_t addr, uint8_t command, uint8_t *raw)
+static esp_err_t sht20_convert(const uint8_t *raw, bool is_temp, float *out_value)
 {
-    ESP_RETURN_ON_ERROR(i2c_bus_write(addr, &command, 1), TAG, "command");
-    const TickType_t wait_time = pdMS_TO_TICKS(command == SHT20_CMD_TRIGGER_TEMP ? 85 : 29);
-    vTaskDelay(wait_time);
-    return i2c_bus_read(addr, raw, 3);
+    if (sht20_crc8(raw, 2) != raw[2]) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    uint16_t value = ((uint16_t)raw[0] << 8) | raw[1];
+    value &= ~0x0003U;
+    if (is_temp) {
+        *out_value = -46.85f + 175.72f * (float)value / 65536.0f;
+    } else {
+        float humidity = -6.0f + 125.0f * (float)value / 65536.0f;
+        *out_value = fminf(fmaxf(humidity, 0.0f), 100.0f);
+    }
+    return ESP_OK;
 }
 
 /**
- * @brief Convert an SHT20 measurement into engineering units with retries.
+ * @brief Record a failed trigger or read and schedule the retry of that quantity.
  *
- * @param addr I2C address of the sensor.
- * @param command Measurement command opcode.
- * @param out_value Output pointer receiving the temperature or humidity value.
- * @param is_temp True when the measurement represents temperature, false for humidity.
- * @return ESP_OK on success or an ESP-IDF error code.
+ * Retries back off exponentially and soft reset the sensor after repeated failures,
+ * matching the previous blocking implementation but without sleeping on the caller.
  */
-static esp_err_t sht20_read_measurement(uint8_t addr, uint8_t command, float *out_value, bool is_temp)
+static esp_err_t sht20_measurement_fail(sht20_measurement_t *m, esp_err_t err, int64_t now_us)
 {
-    uint8_t buffer[3] = {0};
-    esp_err_t last_err = ESP_FAIL;
-    for (int attempt = 0; attempt < SHT20_MAX_RETRIES; ++attempt) {
-        last_err = sht20_measure_once(addr, command, buffer);
-        if (last_err != ESP_OK) {
-            ESP_LOGW(TAG, "I2C error reading 0x%02X (attempt %d/%d): %s", command, attempt + 1,
-                     SHT20_MAX_RETRIES, esp_err_to_name(last_err));
-        } else if (sht20_crc8(buffer, 2) != buffer[2]) {
-            last_err = ESP_ERR_INVALID_CRC;
-            ESP_LOGW(TAG, "CRC mismatch from sensor 0x%02X (attempt %d/%d)", addr, attempt + 1,
-                     SHT20_MAX_RETRIES);
-        } else {
-            uint16_t raw = ((uint16_t)buffer[0] << 8) | buffer[1];
-            raw &= ~0x0003U;
-            if (is_temp) {
-                *out_value = -46.85f + 175.72f * (float)raw / 65536.0f;
-            } else {
-                float humidity = -6.0f + 125.0f * (float)raw / 65536.0f;
-                *out_value = fminf(fmaxf(humidity, 0.0f), 100.0f);
+    bool is_temp = m->step <= SHT20_STEP_WAIT_TEMP;
+    m->last_err = err;
+    ++m->attempts;
+    if (err == ESP_ERR_INVALID_CRC) {
+        ESP_LOGW(TAG, "CRC mismatch from sensor 0x%02X (attempt %u/%d)", m->addr, (unsigned)m->attempts,
+                 SHT20_MAX_RETRIES);
+    } else {
+        ESP_LOGW(TAG, "I2C error reading 0x%02X (attempt %u/%d): %s",
+                 is_temp ? SHT20_CMD_TRIGGER_TEMP : SHT20_CMD_TRIGGER_HUM, (unsigned)m->attempts,
+                 SHT20_MAX_RETRIES, esp_err_to_name(err));
+    }
+    if (m->attempts >= SHT20_MAX_RETRIES) {
+        m->step = SHT20_STEP_FAILED;
+        return err;
+    }
+    m->step = is_temp ? SHT20_STEP_TRIGGER_TEMP : SHT20_STEP_TRIGGER_HUM;
+    m->ready_us = now_us + ((int64_t)SHT20_BASE_BACKOFF_MS * 1000 << (m->attempts - 1U));
+    if (m->attempts >= 3) {
+        ESP_LOGI(TAG, "Soft resetting SHT20 at 0x%02X after repeated failures", m->addr);
+        uint8_t cmd = SHT20_CMD_SOFT_RESET;
+        if (i2c_bus_write(m->addr, &cmd, 1) == ESP_OK) {
+            m->ready_us += SHT20_RESET_SETTLE_US;
+        }
+    }
+    return ESP_ERR_NOT_FINISHED;
+}
+
+/**
+ * @brief Start a temperature + humidity measurement; the first trigger is sent by
+ *        the next sht20_measurement_step() call.
+ */
+void sht20_measurement_begin(sht20_measurement_t *m, uint8_t addr, int64_t now_us)
+{
+    if (!m) {
+        return;
+    }
+    m->addr = addr;
+    m->step = SHT20_STEP_TRIGGER_TEMP;
+    m->attempts = 0;
+    m->ready_us = now_us;
+    m->temperature_c = NAN;
+    m->humidity = NAN;
+    m->last_err = ESP_OK;
+}
+
+/**
+ * @brief Advance the measurement as far as possible without waiting.
+ *
+ * @param now_us Current time in microseconds (esp_timer clock).
+ * @return ESP_ERR_NOT_FINISHED while the sensor is converting or backing off (see
+ *         @c ready_us), ESP_OK once both values are available, or the last error
+ *         after SHT20_MAX_RETRIES failed attempts.
+ */
+esp_err_t sht20_measurement_step(sht20_measurement_t *m, int64_t now_us)
+{
+    if (!m) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (!sht20_measurement_finished(m) && now_us >= m->ready_us) {
+        uint8_t raw[3] = {0};
+        esp_err_t err = ESP_OK;
+        switch (m->step) {
+        case SHT20_STEP_TRIGGER_TEMP:
+        case SHT20_STEP_TRIGGER_HUM: {
+            bool is_temp = m->step == SHT20_STEP_TRIGGER_TEMP;
+            uint8_t command = is_temp ? SHT20_CMD_TRIGGER_TEMP : SHT20_CMD_TRIGGER_HUM;
+            err = i2c_bus_write(m->addr, &command, 1);
+            if (err != ESP_OK) {
+                return sht20_measurement_fail(m, err, now_us);
             }
-            return ESP_OK;
+            m->step = is_temp ? SHT20_STEP_WAIT_TEMP : SHT20_STEP_WAIT_HUM;
+            m->ready_us = now_us + (is_temp ? SHT20_TEMP_CONVERSION_US : SHT20_HUM_CONVERSION_US);
+            break;
         }
-        if (attempt >= 2) {
-            ESP_LOGI(TAG, "Soft resetting SHT20 at 0x%02X after repeated failures", addr);
-            uint8_t cmd = SHT20_CMD_SOFT_RESET;
-            if (i2c_bus_write(addr, &cmd, 1) == ESP_OK) {
-                vTaskDelay(pdMS_TO_TICKS(20));
+        case SHT20_STEP_WAIT_TEMP:
+        case SHT20_STEP_WAIT_HUM: {
+            bool is_temp = m->step == SHT20_STEP_WAIT_TEMP;
+            err = i2c_bus_read(m->addr, raw, sizeof(raw));
+            if (err == ESP_OK) {
+                err = sht20_convert(raw, is_temp, is_temp ? &m->temperature_c : &m->humidity);
             }
+            if (err != ESP_OK) {
+                return sht20_measurement_fail(m, err, now_us);
+            }
+            m->attempts = 0;
+            m->step = is_temp ? SHT20_STEP_TRIGGER_HUM : SHT20_STEP_DONE;
+            break;
+        }
+        default:
+            break;
         }
-        uint32_t backoff = SHT20_BASE_BACKOFF_MS << attempt;
-        vTaskDelay(pdMS_TO_TICKS(backoff));
     }
-    return last_err;
+    if (m->step == SHT20_STEP_DONE) {
+        return ESP_OK;
+    }
+    return m->step == SHT20_STEP_FAILED ? m->last_err : ESP_ERR_NOT_FINISHED;
+}
+
+bool sht20_measurement_finished(const sht20_measurement_t *m)
+{
+    return m->step == SHT20_STEP_DONE || m->step == SHT20_STEP_FAILED;
 }
 
 /**
@@ -125,7 +203,21 @@ esp_err_t sht20_soft_reset(uint8_t addr)
  */
 esp_err_t sht20_read_temperature_humidity(uint8_t addr, float *temperature_c, float *humidity)
 {
-    ESP_RETURN_ON_ERROR(
-        sht20_read_measurement(addr, SHT20_CMD_TRIGGER_TEMP, temperature_c, true), TAG, "temp");
-    return sht20_read_measurement(addr, SHT20_CMD_TRIGGER_HUM, humidity, false);
+    if (!temperature_c || !humidity) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sht20_measurement_t m;
+    sht20_measurement_begin(&m, addr, esp_timer_get_time());
+    esp_err_t err;
+    while ((err = sht20_measurement_step(&m, esp_timer_get_time())) == ESP_ERR_NOT_FINISHED) {
+        int64_t wait_us = m.ready_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay(pdMS_TO_TICKS((uint32_t)((wait_us + 999) / 1000)) + 1);
+        }
+    }
+    if (err == ESP_OK) {
+        *temperature_c = m.temperature_c;
+        *humidity = m.humidity;
+    }
+    return err;
 }
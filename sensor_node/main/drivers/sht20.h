@@ -1,7 +1,38 @@
 #pragma once
 
 #include "esp_err.h"
+#include <stdbool.h>
 #include <stdint.h>
 
+typedef enum {
+    SHT20_STEP_TRIGGER_TEMP = 0,
+    SHT20_STEP_WAIT_TEMP,
+    SHT20_STEP_TRIGGER_HUM,
+    SHT20_STEP_WAIT_HUM,
+    SHT20_STEP_DONE,
+    SHT20_STEP_FAILED,
+} sht20_step_t;
+
+/**
+ * Triggered (no-hold master) measurement in progress on one sensor.
+ *
+ * The bus is only used to send a trigger or to collect a result; between those the
+ * sensor converts on its own, so callers can start every sensor first and then
+ * collect each one once its @c ready_us has passed.
+ */
+typedef struct {
+    uint8_t addr;
+    sht20_step_t step;
+    uint8_t attempts;
+    int64_t ready_us;
+    float temperature_c;
+    float humidity;
+    esp_err_t last_err;
+} sht20_measurement_t;
+
 esp_err_t sht20_soft_reset(uint8_t addr);
 esp_err_t sht20_read_temperature_humidity(uint8_t addr, float *temperature_c, float *humidity);
+
+void sht20_measurement_begin(sht20_measurement_t *m, uint8_t addr, int64_t now_us);
+esp_err_t sht20_measurement_step(sht20_measurement_t *m, int64_t now_us);
+bool sht20_measurement_finished(const sht20_measurement_t *m);
@@ -6,8 +6,8 @@
 /**
  * @brief Select the active downstream channel on a TCA9548A I2C multiplexer.
  *
- * Writing the same selection multiple times is avoided to reduce bus chatter.
- * Passing ::IO_MUX_CHANNEL_NONE disables all downstream channels.
+ * Always writes the control register; use i2c_mux_select() to route through the
+ * cached mux tree instead. Passing ::IO_MUX_CHANNEL_NONE disables all channels.
  *
  * @param addr 7-bit I2C address of the multiplexer (0x70-0x77).
  * @param channel Channel index 0-7 to enable, or ::IO_MUX_CHANNEL_NONE to disable all.
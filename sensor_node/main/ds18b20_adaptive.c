@@ -0,0 +1,92 @@
+#include "ds18b20_adaptive.h"
+
+#include <math.h>
+#include <string.h>
+
+#define DS18B20_RATE_EMA_ALPHA 0.5f
+#define DS18B20_RATE_WINDOW_US 1000000
+#define DS18B20_RATE_STEP_LSBS 4.0f
+#define DS18B20_RATE_CLIMB_MARGIN 2.0f
+
+void ds18b20_adaptive_init(ds18b20_adaptive_t *probe)
+{
+    if (!probe) {
+        return;
+    }
+    memset(probe, 0, sizeof(*probe));
+    probe->resolution_bits = DS18B20_ADAPTIVE_MAX_BITS;
+}
+
+static float lsb_c(uint8_t resolution_bits)
+{
+    return 0.0625f * (float)(1U << (DS18B20_ADAPTIVE_MAX_BITS - resolution_bits));
+}
+
+static uint8_t target_resolution(const ds18b20_adaptive_config_t *config, float rate_mc_per_s)
+{
+    if (rate_mc_per_s >= (float)config->fast_mc_per_s) {
+        return 9U;
+    }
+    if (rate_mc_per_s >= (float)config->moderate_mc_per_s) {
+        return 10U;
+    }
+    return DS18B20_ADAPTIVE_MAX_BITS;
+}
+
+uint8_t ds18b20_adaptive_update(ds18b20_adaptive_t *probe, const ds18b20_adaptive_config_t *config,
+                                float temperature_c, int64_t now_us)
+{
+    if (!probe || !config) {
+        return DS18B20_ADAPTIVE_MAX_BITS;
+    }
+    if (!probe->has_sample || now_us <= probe->anchor_us) {
+        probe->has_sample = true;
+        probe->anchor_c = temperature_c;
+        probe->anchor_us = now_us;
+        probe->moved_c = temperature_c;
+        probe->moved_us = now_us;
+        return probe->resolution_bits;
+    }
+
+    /* Fast probes sample every 94 ms, far below one 9-bit LSB of drift, so the rate is
+     * measured against an anchor at least a window old, or sooner on a large step. */
+    float lsb = lsb_c(probe->resolution_bits);
+    float change = fabsf(temperature_c - probe->anchor_c);
+    int64_t elapsed_us = now_us - probe->anchor_us;
+    if (elapsed_us < DS18B20_RATE_WINDOW_US && change < DS18B20_RATE_STEP_LSBS * lsb) {
+        return probe->resolution_bits;
+    }
+    float delta = change - lsb;
+    if (delta < 0.0f) {
+        delta = 0.0f;
+    }
+    float rate = delta * 1000.0f * 1e6f / (float)elapsed_us;
+    probe->rate_mc_per_s += DS18B20_RATE_EMA_ALPHA * (rate - probe->rate_mc_per_s);
+    probe->anchor_c = temperature_c;
+    probe->anchor_us = now_us;
+    if (delta > 0.0f) {
+        probe->moved_c = temperature_c;
+        probe->moved_us = now_us;
+    }
+
+    /* After a drop the coarser LSB hides a ramp near the threshold from the windowed
+     * rate, so climbing also needs the drift since the last real move to be calm. */
+    float drift = fabsf(temperature_c - probe->moved_c) - 0.5f * lsb;
+    float drift_rate = drift > 0.0f ? drift * 1000.0f * 1e6f / (float)(now_us - probe->moved_us) : 0.0f;
+    uint8_t target = target_resolution(config, probe->rate_mc_per_s);
+    uint8_t climb = target_resolution(config, fmaxf(probe->rate_mc_per_s, drift_rate) * DS18B20_RATE_CLIMB_MARGIN);
+    if (target < probe->resolution_bits) {
+        probe->resolution_bits = target;
+        probe->calm_samples = 0;
+    } else if (climb > probe->resolution_bits) {
+        if (++probe->calm_samples >= config->settle_samples) {
+            ++probe->resolution_bits;
+            probe->calm_samples = 0;
+            probe->moved_c = temperature_c;
+            probe->moved_us = now_us;
+        }
+    } else {
+        probe->calm_samples = 0;
+    }
+    return probe->resolution_bits;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DS18B20_ADAPTIVE_MIN_BITS 9U
+#define DS18B20_ADAPTIVE_MAX_BITS 12U
+
+/**
+ * Rate thresholds in milli-degrees per second. Probes moving faster than
+ * @c fast_mc_per_s drop to 9 bit, faster than @c moderate_mc_per_s to 10 bit;
+ * @c fast_mc_per_s must be the larger. A probe climbs back towards 12 bit after
+ * @c settle_samples rate updates below half the threshold of the next finer
+ * resolution.
+ */
+typedef struct {
+    uint32_t fast_mc_per_s;
+    uint32_t moderate_mc_per_s;
+    uint8_t settle_samples;
+} ds18b20_adaptive_config_t;
+
+/**
+ * Per-probe resolution state. The rate is taken against an anchor reading and
+ * ignores one LSB of the current resolution, so quantisation noise at 9 bit does
+ * not keep a probe fast. @c moved_c and @c moved_us record the last reading that
+ * moved by more than that LSB, or the last climb; the drift since then gates a climb.
+ */
+typedef struct {
+    uint8_t resolution_bits;
+    bool has_sample;
+    float anchor_c;
+    int64_t anchor_us;
+    float rate_mc_per_s;
+    float moved_c;
+    int64_t moved_us;
+    uint8_t calm_samples;
+} ds18b20_adaptive_t;
+
+void ds18b20_adaptive_init(ds18b20_adaptive_t *probe);
+
+/**
+ * @brief Feed a reading and return the resolution for the next conversion.
+ *
+ * Resolution drops as soon as the rate crosses a threshold and climbs back one
+ * step at a time once the probe has been calm for @c settle_samples rate updates.
+ * A steady ramp near a threshold holds one resolution rather than alternating.
+ */
+uint8_t ds18b20_adaptive_update(ds18b20_adaptive_t *probe, const ds18b20_adaptive_config_t *config,
+                                float temperature_c, int64_t now_us);
@@ -0,0 +1,268 @@
+#include "history_store.h"
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <math.h>
+#include <string.h>
+
+/* Spins before a reader yields a tick to a preempted writer, as in data_model. */
+#define HISTORY_READ_SPINS 64U
+
+/* Wire unit per channel: reading * scale. */
+static const float s_scale[PROTO_HISTORY_CHANNEL_COUNT] = {
+    [PROTO_HISTORY_CH_AMBIENT_TEMP_0] = 100.0f,
+    [PROTO_HISTORY_CH_AMBIENT_TEMP_1] = 100.0f,
+    [PROTO_HISTORY_CH_AMBIENT_HUMIDITY_0] = 100.0f,
+    [PROTO_HISTORY_CH_AMBIENT_HUMIDITY_1] = 100.0f,
+    [PROTO_HISTORY_CH_AMBIENT_PRESSURE_0] = 0.1f,
+    [PROTO_HISTORY_CH_AMBIENT_PRESSURE_1] = 0.1f,
+    [PROTO_HISTORY_CH_DS18B20_0] = 100.0f,
+    [PROTO_HISTORY_CH_DS18B20_1] = 100.0f,
+    [PROTO_HISTORY_CH_DS18B20_2] = 100.0f,
+    [PROTO_HISTORY_CH_DS18B20_3] = 100.0f,
+};
+
+size_t history_store_size(const history_tier_config_t config[PROTO_HISTORY_TIER_COUNT])
+{
+    size_t buckets = 0;
+    for (size_t t = 0; t < PROTO_HISTORY_TIER_COUNT; ++t) {
+        buckets += config[t].capacity;
+    }
+    return buckets * PROTO_HISTORY_CHANNEL_COUNT * 3U * sizeof(int16_t);
+}
+
+esp_err_t history_store_init(history_store_t *store, const history_tier_config_t config[PROTO_HISTORY_TIER_COUNT])
+{
+    if (!store || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t t = 0; t < PROTO_HISTORY_TIER_COUNT; ++t) {
+        if (config[t].period_s == 0 || config[t].capacity < 2) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    memset(store, 0, sizeof(*store));
+    size_t bytes = history_store_size(config);
+    store->columns = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!store->columns) {
+        store->columns = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    }
+    if (!store->columns) {
+        return ESP_ERR_NO_MEM;
+    }
+    int16_t *cursor = store->columns;
+    for (size_t t = 0; t < PROTO_HISTORY_TIER_COUNT; ++t) {
+        history_tier_t *tier = &store->tiers[t];
+        size_t column = (size_t)config[t].capacity * PROTO_HISTORY_CHANNEL_COUNT;
+        tier->period_s = config[t].period_s;
+        tier->capacity = config[t].capacity;
+        tier->min = cursor;
+        tier->max = cursor + column;
+        tier->mean = cursor + 2U * column;
+        cursor += 3U * column;
+        atomic_init(&tier->seq, 0U);
+    }
+    return ESP_OK;
+}
+
+void history_store_deinit(history_store_t *store)
+{
+    if (!store) {
+        return;
+    }
+    heap_caps_free(store->columns);
+    memset(store, 0, sizeof(*store));
+}
+
+uint32_t history_store_sample_time_s(uint32_t sample_ms, int64_t now_us)
+{
+    uint64_t now_ms = (uint64_t)(now_us / 1000);
+    uint32_t age_ms = (uint32_t)now_ms - sample_ms;
+    uint64_t sample_ms64 = now_ms >= age_ms ? now_ms - age_ms : 0U;
+    return (uint32_t)(sample_ms64 / 1000U);
+}
+
+int16_t history_store_to_fixed(proto_history_channel_t channel, float value)
+{
+    if (channel >= PROTO_HISTORY_CHANNEL_COUNT || isnan(value)) {
+        return PROTO_HISTORY_NONE;
+    }
+    float scaled = roundf(value * s_scale[channel]);
+    if (scaled > (float)INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (scaled < (float)(INT16_MIN + 1)) {
+        return INT16_MIN + 1;
+    }
+    return (int16_t)scaled;
+}
+
+float history_store_from_fixed(proto_history_channel_t channel, int16_t value)
+{
+    if (channel >= PROTO_HISTORY_CHANNEL_COUNT || value == PROTO_HISTORY_NONE) {
+        return NAN;
+    }
+    return (float)value / s_scale[channel];
+}
+
+static void accumulator_reset(history_tier_t *tier)
+{
+    for (size_t ch = 0; ch < PROTO_HISTORY_CHANNEL_COUNT; ++ch) {
+        tier->acc[ch] = (history_accumulator_t){0};
+    }
+}
+
+static void bucket_store(history_tier_t *tier, uint32_t bucket, size_t ch, int16_t min, int16_t max, int16_t mean)
+{
+    size_t at = ch * tier->capacity + bucket % tier->capacity;
+    tier->min[at] = min;
+    tier->max[at] = max;
+    tier->mean[at] = mean;
+}
+
+static void tier_close(history_tier_t *tier, uint32_t bucket)
+{
+    for (size_t ch = 0; ch < PROTO_HISTORY_CHANNEL_COUNT; ++ch) {
+        const history_accumulator_t *acc = &tier->acc[ch];
+        if (acc->count == 0) {
+            bucket_store(tier, tier->open, ch, PROTO_HISTORY_NONE, PROTO_HISTORY_NONE, PROTO_HISTORY_NONE);
+        } else {
+            int64_t half = acc->count / 2;
+            int64_t mean = (acc->sum >= 0 ? acc->sum + half : acc->sum - half) / (int64_t)acc->count;
+            bucket_store(tier, tier->open, ch, acc->min, acc->max, (int16_t)mean);
+        }
+    }
+    /* Past a full ring every slot is overwritten once; earlier gap buckets would be too. */
+    uint32_t gap_start = tier->open + 1U;
+    if (bucket - gap_start > tier->capacity) {
+        gap_start = bucket - tier->capacity;
+    }
+    for (uint32_t b = gap_start; b != bucket; ++b) {
+        for (size_t ch = 0; ch < PROTO_HISTORY_CHANNEL_COUNT; ++ch) {
+            bucket_store(tier, b, ch, PROTO_HISTORY_NONE, PROTO_HISTORY_NONE, PROTO_HISTORY_NONE);
+        }
+    }
+}
+
+/**
+ * @brief Write out the open bucket, mark skipped ones empty and open @p bucket.
+ */
+static void tier_advance(history_tier_t *tier, uint32_t bucket)
+{
+    uint32_t seq = atomic_load_explicit(&tier->seq, memory_order_relaxed);
+    atomic_store_explicit(&tier->seq, seq + 1U, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    if (tier->started) {
+        tier_close(tier, bucket);
+    } else {
+        tier->first = bucket;
+        tier->started = true;
+    }
+    tier->open = bucket;
+    accumulator_reset(tier);
+
+    atomic_store_explicit(&tier->seq, seq + 2U, memory_order_release);
+}
+
+void history_store_record(history_store_t *store, proto_history_channel_t channel, uint32_t time_s, float value)
+{
+    if (!store || !store->columns || channel >= PROTO_HISTORY_CHANNEL_COUNT) {
+        return;
+    }
+    int16_t fixed = history_store_to_fixed(channel, value);
+    if (fixed == PROTO_HISTORY_NONE) {
+        return;
+    }
+    bool late = false;
+    for (size_t t = 0; t < PROTO_HISTORY_TIER_COUNT; ++t) {
+        history_tier_t *tier = &store->tiers[t];
+        uint32_t bucket = time_s / tier->period_s;
+        if (!tier->started || bucket > tier->open) {
+            tier_advance(tier, bucket);
+        } else if (bucket < tier->open) {
+            late = true;
+        }
+        history_accumulator_t *acc = &tier->acc[channel];
+        if (acc->count == 0 || fixed < acc->min) {
+            acc->min = fixed;
+        }
+        if (acc->count == 0 || fixed > acc->max) {
+            acc->max = fixed;
+        }
+        acc->sum += fixed;
+        ++acc->count;
+    }
+    if (late) {
+        ++store->stats.late_samples;
+    }
+}
+
+static void column_copy(const int16_t *column, const history_tier_t *tier, size_t ch, uint32_t bucket,
+                        uint16_t count, int16_t *out)
+{
+    const int16_t *row = column + ch * tier->capacity;
+    uint32_t slot = bucket % tier->capacity;
+    uint32_t head = tier->capacity - slot < count ? tier->capacity - slot : count;
+    memcpy(out, row + slot, head * sizeof(int16_t));
+    memcpy(out + head, row, (count - head) * sizeof(int16_t));
+}
+
+bool history_store_read(history_store_t *store, const proto_history_request_t *request, proto_history_t *out)
+{
+    if (!store || !request || !out || request->channel >= PROTO_HISTORY_CHANNEL_COUNT ||
+        request->tier >= PROTO_HISTORY_TIER_COUNT) {
+        return false;
+    }
+    history_tier_t *tier = &store->tiers[request->tier];
+    uint16_t max_points = request->max_points;
+    if (max_points == 0 || max_points > PROTO_MAX_HISTORY_POINTS) {
+        max_points = PROTO_MAX_HISTORY_POINTS;
+    }
+    out->sequence_id = request->sequence_id;
+    out->channel = request->channel;
+    out->tier = request->tier;
+    out->period_s = tier->period_s;
+
+    uint32_t spins = 0;
+    while (true) {
+        uint32_t before = atomic_load_explicit(&tier->seq, memory_order_acquire);
+        if ((before & 1U) == 0U) {
+            uint32_t bucket = request->from_s / tier->period_s;
+            uint32_t end = bucket;
+            uint16_t count = 0;
+            if (store->columns && tier->started) {
+                uint32_t open = tier->open;
+                uint32_t oldest = open - tier->first >= tier->capacity ? open - tier->capacity + 1U : tier->first;
+                if (bucket < oldest) {
+                    bucket = oldest;
+                }
+                end = open > bucket ? open : bucket;
+                count = end - bucket < max_points ? (uint16_t)(end - bucket) : max_points;
+                column_copy(tier->min, tier, request->channel, bucket, count, out->min);
+                column_copy(tier->max, tier, request->channel, bucket, count, out->max);
+                column_copy(tier->mean, tier, request->channel, bucket, count, out->mean);
+            }
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&tier->seq, memory_order_relaxed) == before) {
+                out->start_s = bucket * tier->period_s;
+                out->count = count;
+                out->more = bucket + count < end;
+                return true;
+            }
+        }
+        ++store->stats.read_retries;
+        if (++spins % HISTORY_READ_SPINS == 0U) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+void history_store_get_stats(history_store_t *store, history_store_stats_t *out)
+{
+    if (!store || !out) {
+        return;
+    }
+    *out = store->stats;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "common/proto/messages.h"
+#include "esp_err.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t period_s; /**< Bucket width. */
+    uint32_t capacity; /**< Buckets kept, the open one included. */
+} history_tier_config_t;
+
+/** Running aggregate of the bucket a channel is currently filling. */
+typedef struct {
+    int64_t sum;
+    uint32_t count;
+    int16_t min;
+    int16_t max;
+} history_accumulator_t;
+
+/**
+ * One resolution of the history.
+ *
+ * Buckets are addressed by their absolute index (time_s / period_s) and stored in
+ * slot index % capacity, so locating a time is one division and closing a bucket
+ * never moves data. Each column is channel-major: min[channel * capacity + slot].
+ * Only closed buckets are readable; the open one lives in #acc until time moves on.
+ */
+typedef struct {
+    uint32_t period_s;
+    uint32_t capacity;
+    int16_t *min;
+    int16_t *max;
+    int16_t *mean;
+    _Atomic uint32_t seq; /**< Odd while the writer closes buckets. */
+    uint32_t first;       /**< Absolute index of the first bucket ever opened. */
+    uint32_t open;        /**< Absolute index of the bucket being filled. */
+    bool started;
+    history_accumulator_t acc[PROTO_HISTORY_CHANNEL_COUNT];
+} history_tier_t;
+
+typedef struct {
+    uint32_t late_samples; /**< Samples older than the open bucket, folded into it. */
+    uint32_t read_retries; /**< Page copies repeated because a bucket closed under them. */
+} history_store_stats_t;
+
+/**
+ * @brief Tiered min/max/mean history of the analog channels, fixed point and columnar.
+ *
+ * Every sample feeds the open bucket of every tier in O(1); a bucket is written
+ * out when the first sample of a later bucket arrives. One task records; any task
+ * may read, retrying a page if a bucket closed while it was being copied.
+ */
+typedef struct {
+    history_tier_t tiers[PROTO_HISTORY_TIER_COUNT];
+    int16_t *columns; /**< One allocation backing every tier. */
+    history_store_stats_t stats;
+} history_store_t;
+
+/**
+ * @brief Allocate the tiers, from PSRAM when available.
+ *
+ * @return ESP_ERR_INVALID_ARG for a zero period or a capacity below 2,
+ *         ESP_ERR_NO_MEM when the columns do not fit.
+ */
+esp_err_t history_store_init(history_store_t *store, const history_tier_config_t config[PROTO_HISTORY_TIER_COUNT]);
+void history_store_deinit(history_store_t *store);
+
+/** @brief Bytes of column storage @p config needs. */
+size_t history_store_size(const history_tier_config_t config[PROTO_HISTORY_TIER_COUNT]);
+
+/**
+ * @brief Convert a reading to the channel's wire unit (see proto_history_channel_t).
+ *
+ * @return The clamped value, or PROTO_HISTORY_NONE for NaN.
+ */
+int16_t history_store_to_fixed(proto_history_channel_t channel, float value);
+float history_store_from_fixed(proto_history_channel_t channel, int16_t value);
+
+/**
+ * @brief Seconds on the 64-bit esp_timer clock of a sample stamped with a 32-bit
+ *        millisecond uptime, which wraps every 49.7 days.
+ *
+ * The stamp is unwrapped against @p now_us, so it must be less than one wrap old.
+ * Bucket times and the now_s of served pages then share one clock.
+ */
+uint32_t history_store_sample_time_s(uint32_t sample_ms, int64_t now_us);
+
+/**
+ * @brief Add one reading taken at @p time_s (esp_timer seconds). Recording task only.
+ */
+void history_store_record(history_store_t *store, proto_history_channel_t channel, uint32_t time_s, float value);
+
+/**
+ * @brief Fill one page of closed buckets for @p request.
+ *
+ * Starts at the bucket containing request->from_s, or at the oldest bucket kept
+ * when that one has been overwritten. now_s is left to the caller.
+ *
+ * @return false for an unknown channel or tier.
+ */
+bool history_store_read(history_store_t *store, const proto_history_request_t *request, proto_history_t *out);
+
+void history_store_get_stats(history_store_t *store, history_store_stats_t *out);
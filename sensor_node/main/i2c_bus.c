@@ -6,14 +6,15 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
+#include "i2c_mux.h"
 #include "io/io_map.h"
 #include "esp_rom/ets_sys.h"
+#include <string.h>
 
 #define I2C_MASTER_PORT I2C_NUM_0
 #define I2C_CMD_TIMEOUT_MS 100
-#define I2C_RECOVER_THRESHOLD 3
-#define I2C_BACKOFF_BASE_MS 5
 #define I2C_SCAN_ADDR_MIN 0x08
 #define I2C_SCAN_ADDR_MAX 0x77
 
@@ -23,7 +24,14 @@ static i2c_config_t s_i2c_config;
 static bool s_initialized;
 static SemaphoreHandle_t s_mutex;
 static StaticSemaphore_t s_mutex_buffer;
-static uint8_t s_consecutive_failures;
+static i2c_engine_t s_engine;
+static TaskHandle_t s_worker;
+static uint8_t s_device_class[128];
+
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t err;
+} i2c_bus_waiter_t;
 
 static void i2c_bus_lock(void)
 {
@@ -67,7 +75,7 @@ static void i2c_bus_force_idle(void)
     gpio_reset_pin(SENSOR_NODE_I2C_SCL);
 }
 
-static esp_err_t i2c_bus_recover_locked(void)
+static esp_err_t i2c_bus_recover(void)
 {
     ESP_LOGW(TAG, "Re-initialising I2C bus after persistent failures");
     i2c_driver_delete(I2C_MASTER_PORT);
@@ -75,78 +83,130 @@ static esp_err_t i2c_bus_recover_locked(void)
     return i2c_bus_apply_config();
 }
 
-static esp_err_t i2c_bus_cmd_begin(i2c_cmd_handle_t cmd)
+/**
+ * @brief Execute one write/read transaction on the bus. Only the engine worker
+ *        (and the init-time scan, before the worker exists) touches the driver.
+ */
+static esp_err_t i2c_bus_transfer(uint8_t addr, const uint8_t *wr_data, size_t wr_len, uint8_t *rd_data,
+                                  size_t rd_len, uint32_t timeout_ms)
 {
-    esp_err_t err = i2c_master_cmd_begin(I2C_MASTER_PORT, cmd, pdMS_TO_TICKS(I2C_CMD_TIMEOUT_MS));
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (!cmd) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = i2c_master_start(cmd);
+    if (err == ESP_OK && (wr_len > 0 || rd_len == 0)) {
+        err = i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
+        if (err == ESP_OK && wr_data && wr_len) {
+            err = i2c_master_write(cmd, (uint8_t *)wr_data, wr_len, true);
+        }
+    }
+    if (err == ESP_OK && rd_len > 0) {
+        if (wr_len > 0) {
+            err = i2c_master_start(cmd);
+        }
+        if (err == ESP_OK) {
+            err = i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_READ, true);
+        }
+        if (err == ESP_OK) {
+            if (rd_len > 1) {
+                err = i2c_master_read(cmd, rd_data, rd_len - 1, I2C_MASTER_ACK);
+            }
+            if (err == ESP_OK) {
+                err = i2c_master_read_byte(cmd, rd_data + rd_len - 1, I2C_MASTER_NACK);
+            }
+        }
+    }
     if (err == ESP_OK) {
-        s_consecutive_failures = 0;
-        return ESP_OK;
+        err = i2c_master_stop(cmd);
     }
-    ++s_consecutive_failures;
-    ESP_LOGW(TAG, "I2C transaction failed (%s), failure count=%u", esp_err_to_name(err),
-             (unsigned)s_consecutive_failures);
-    if (s_consecutive_failures >= I2C_RECOVER_THRESHOLD) {
-        if (i2c_bus_recover_locked() == ESP_OK) {
-            s_consecutive_failures = 0;
+    if (err == ESP_OK) {
+        if (timeout_ms == 0 || timeout_ms > I2C_CMD_TIMEOUT_MS) {
+            timeout_ms = I2C_CMD_TIMEOUT_MS;
         }
+        TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+        err = i2c_master_cmd_begin(I2C_MASTER_PORT, cmd, ticks ? ticks : 1);
     }
+    i2c_cmd_link_delete(cmd);
     return err;
 }
 
-static esp_err_t i2c_master_cmd(uint8_t addr, const uint8_t *wr_data, size_t wr_len, uint8_t *rd_data,
-                                size_t rd_len)
+static int64_t i2c_bus_now_us(void)
 {
-    if (!s_initialized) {
-        return ESP_ERR_INVALID_STATE;
+    return esp_timer_get_time();
+}
+
+static void i2c_bus_notify(void)
+{
+    if (s_worker) {
+        xTaskNotifyGive(s_worker);
     }
+}
 
-    esp_err_t err = ESP_FAIL;
-    i2c_bus_lock();
-    for (int attempt = 0; attempt < 3; ++attempt) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        if (!cmd) {
-            i2c_bus_unlock();
-            return ESP_ERR_NO_MEM;
-        }
-        esp_err_t cmd_err = i2c_master_start(cmd);
-        if (cmd_err == ESP_OK && wr_len > 0) {
-            cmd_err = i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
-            if (cmd_err == ESP_OK && wr_data && wr_len) {
-                cmd_err = i2c_master_write(cmd, (uint8_t *)wr_data, wr_len, true);
-            }
+/**
+ * @brief Bus worker: runs due transactions in priority order and sleeps through
+ *        retry backoffs until the next request is due or a new one is submitted.
+ */
+static void i2c_bus_worker(void *arg)
+{
+    (void)arg;
+    while (true) {
+        while (i2c_engine_process(&s_engine)) {
         }
-        if (cmd_err == ESP_OK && rd_len > 0) {
-            if (wr_len > 0) {
-                cmd_err = i2c_master_start(cmd);
-            }
-            if (cmd_err == ESP_OK) {
-                cmd_err = i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_READ, true);
-            }
-            if (cmd_err == ESP_OK) {
-                if (rd_len > 1) {
-                    cmd_err = i2c_master_read(cmd, rd_data, rd_len - 1, I2C_MASTER_ACK);
-                }
-                if (cmd_err == ESP_OK) {
-                    cmd_err = i2c_master_read_byte(cmd, rd_data + rd_len - 1, I2C_MASTER_NACK);
-                }
+        int64_t wake_us = i2c_engine_next_wake_us(&s_engine);
+        TickType_t wait = portMAX_DELAY;
+        if (wake_us >= 0) {
+            int64_t delta_us = wake_us - esp_timer_get_time();
+            wait = delta_us > 0 ? pdMS_TO_TICKS((uint32_t)((delta_us + 999) / 1000)) : 0;
+            if (wait == 0 && delta_us > 0) {
+                wait = 1;
             }
         }
-        if (cmd_err == ESP_OK) {
-            cmd_err = i2c_master_stop(cmd);
-        }
-        if (cmd_err == ESP_OK) {
-            err = i2c_bus_cmd_begin(cmd);
-        } else {
-            err = cmd_err;
-        }
-        i2c_cmd_link_delete(cmd);
-        if (err == ESP_OK) {
-            break;
+        if (wait != 0) {
+            ulTaskNotifyTake(pdTRUE, wait);
         }
-        uint32_t backoff = I2C_BACKOFF_BASE_MS << attempt;
-        vTaskDelay(pdMS_TO_TICKS(backoff));
     }
-    i2c_bus_unlock();
+}
+
+static void i2c_bus_waiter_done(esp_err_t err, void *ctx)
+{
+    i2c_bus_waiter_t *waiter = ctx;
+    waiter->err = err;
+    xSemaphoreGive(waiter->done);
+}
+
+/**
+ * @brief Submit a transaction with the device's class and block until it completes.
+ *
+ * Must not be called from a completion callback, which runs on the bus worker.
+ */
+static esp_err_t i2c_master_cmd(uint8_t addr, const uint8_t *wr_data, size_t wr_len, uint8_t *rd_data,
+                                size_t rd_len)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    StaticSemaphore_t done_buffer;
+    i2c_bus_waiter_t waiter = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .err = ESP_FAIL,
+    };
+    i2c_engine_request_t request = {
+        .addr = addr,
+        .cls = (i2c_class_t)s_device_class[addr & 0x7F],
+        .write_data = wr_data,
+        .write_len = wr_len,
+        .read_data = rd_data,
+        .read_len = rd_len,
+        .done = i2c_bus_waiter_done,
+        .ctx = &waiter,
+    };
+    esp_err_t err = i2c_engine_submit(&s_engine, &request);
+    if (err == ESP_OK) {
+        xSemaphoreTake(waiter.done, portMAX_DELAY);
+        err = waiter.err;
+    }
+    vSemaphoreDelete(waiter.done);
     return err;
 }
 
@@ -158,27 +218,7 @@ static esp_err_t i2c_bus_probe(uint8_t addr, bool *present)
     if (addr < I2C_SCAN_ADDR_MIN || addr > I2C_SCAN_ADDR_MAX) {
         return ESP_ERR_INVALID_ARG;
     }
-    esp_err_t err = ESP_FAIL;
-    i2c_bus_lock();
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    if (!cmd) {
-        i2c_bus_unlock();
-        return ESP_ERR_NO_MEM;
-    }
-    esp_err_t cmd_err = i2c_master_start(cmd);
-    if (cmd_err == ESP_OK) {
-        cmd_err = i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, true);
-    }
-    if (cmd_err == ESP_OK) {
-        cmd_err = i2c_master_stop(cmd);
-    }
-    if (cmd_err == ESP_OK) {
-        err = i2c_bus_cmd_begin(cmd);
-    } else {
-        err = cmd_err;
-    }
-    i2c_cmd_link_delete(cmd);
-    i2c_bus_unlock();
+    esp_err_t err = i2c_bus_transfer(addr, NULL, 0, NULL, 0, I2C_CMD_TIMEOUT_MS);
     if (err == ESP_OK && present) {
         *present = true;
     }
@@ -196,8 +236,10 @@ static void i2c_bus_scan(void)
             expected[saddr] = true;
             logical_instances[saddr]++;
         }
-        if (map->ambient[i].mux_channel != IO_MUX_CHANNEL_NONE && map->ambient[i].mux_address) {
-            expected[map->ambient[i].mux_address & 0x7F] = true;
+    }
+    for (size_t i = 0; i < map->mux_count && i < IO_MAX_MUXES; ++i) {
+        if (map->muxes[i].parent_address == 0) {
+            expected[map->muxes[i].address & 0x7F] = true;
         }
     }
     for (size_t i = 0; i < 2; ++i) {
@@ -265,12 +307,77 @@ esp_err_t i2c_bus_init(void)
             return ESP_ERR_NO_MEM;
         }
     }
-    s_consecutive_failures = 0;
-    s_initialized = true;
+    const i2c_engine_platform_t platform = {
+        .transfer = i2c_bus_transfer,
+        .recover = i2c_bus_recover,
+        .now_us = i2c_bus_now_us,
+        .lock = i2c_bus_lock,
+        .unlock = i2c_bus_unlock,
+        .notify = i2c_bus_notify,
+    };
+    ESP_RETURN_ON_ERROR(i2c_engine_init(&s_engine, &platform), TAG, "engine init");
+
+    const io_map_t *map = io_map_get();
+    memset(s_device_class, I2C_CLASS_AMBIENT, sizeof(s_device_class));
+    for (size_t i = 0; i < 2; ++i) {
+        s_device_class[map->mcp23017_addresses[i] & 0x7F] = I2C_CLASS_GPIO_INPUT;
+    }
+    if (map->pwm_backend == IO_PWM_BACKEND_PCA9685 && map->pca9685_address) {
+        s_device_class[map->pca9685_address & 0x7F] = I2C_CLASS_ACTUATION;
+    }
+
+    i2c_mux_reset();
+    for (size_t i = 0; i < map->mux_count && i < IO_MAX_MUXES; ++i) {
+        esp_err_t err = i2c_mux_register(map->muxes[i].address, map->muxes[i].parent_address,
+                                         map->muxes[i].parent_channel);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid mux 0x%02X in io_map: %s", map->muxes[i].address, esp_err_to_name(err));
+        }
+    }
+
     i2c_bus_scan();
+    if (xTaskCreatePinnedToCore(i2c_bus_worker, "t_i2c", 3072, NULL, 6, &s_worker, 1) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_initialized = true;
     return ESP_OK;
 }
 
+esp_err_t i2c_bus_submit(const i2c_engine_request_t *request)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return i2c_engine_submit(&s_engine, request);
+}
+
+i2c_class_t i2c_bus_device_class(uint8_t addr)
+{
+    return (i2c_class_t)s_device_class[addr & 0x7F];
+}
+
+void i2c_bus_set_device_class(uint8_t addr, i2c_class_t cls)
+{
+    if (cls < I2C_CLASS_COUNT) {
+        s_device_class[addr & 0x7F] = (uint8_t)cls;
+    }
+}
+
+void i2c_bus_set_device_timeout(uint8_t addr, uint32_t timeout_ms)
+{
+    i2c_engine_set_device_timeout(&s_engine, addr, timeout_ms);
+}
+
+esp_err_t i2c_bus_get_stats(i2c_class_t cls, i2c_engine_stats_t *out)
+{
+    return i2c_engine_get_stats(&s_engine, cls, out);
+}
+
+uint32_t i2c_bus_recovery_count(void)
+{
+    return i2c_engine_recoveries(&s_engine);
+}
+
 esp_err_t i2c_bus_read(uint8_t addr, uint8_t *data, size_t len)
 {
     return i2c_master_cmd(addr, NULL, 0, data, len);
@@ -2,9 +2,25 @@
 
 #include "driver/i2c.h"
 #include "esp_err.h"
+#include "i2c_engine.h"
 
 esp_err_t i2c_bus_init(void);
 esp_err_t i2c_bus_read(uint8_t addr, uint8_t *data, size_t len);
 esp_err_t i2c_bus_write(uint8_t addr, const uint8_t *data, size_t len);
 esp_err_t i2c_bus_write_read(uint8_t addr, const uint8_t *wr_data, size_t wr_len, uint8_t *rd_data,
                              size_t rd_len);
+
+/**
+ * @brief Queue a transaction without blocking; @c request->done runs on the bus worker.
+ */
+esp_err_t i2c_bus_submit(const i2c_engine_request_t *request);
+i2c_class_t i2c_bus_device_class(uint8_t addr);
+void i2c_bus_set_device_class(uint8_t addr, i2c_class_t cls);
+void i2c_bus_set_device_timeout(uint8_t addr, uint32_t timeout_ms);
+esp_err_t i2c_bus_get_stats(i2c_class_t cls, i2c_engine_stats_t *out);
+
+/**
+ * @brief Number of bus recoveries so far; drivers holding register shadows compare
+ *        it against their last value to know when to resync.
+ */
+uint32_t i2c_bus_recovery_count(void);
@@ -0,0 +1,313 @@
+#include "i2c_engine.h"
+
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "i2c_engine";
+
+static void engine_lock(i2c_engine_t *engine)
+{
+    if (engine->platform.lock) {
+        engine->platform.lock();
+    }
+}
+
+static void engine_unlock(i2c_engine_t *engine)
+{
+    if (engine->platform.unlock) {
+        engine->platform.unlock();
+    }
+}
+
+/**
+ * @brief Reset the queue and bind the bus hooks.
+ *
+ * @param platform Hooks; @c transfer and @c now_us are mandatory, the rest optional.
+ */
+esp_err_t i2c_engine_init(i2c_engine_t *engine, const i2c_engine_platform_t *platform)
+{
+    if (!engine || !platform || !platform->transfer || !platform->now_us) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(engine, 0, sizeof(*engine));
+    engine->platform = *platform;
+    for (int i = 0; i < I2C_ENGINE_QUEUE_DEPTH; ++i) {
+        engine->slots[i].next = (int8_t)(i + 1 < I2C_ENGINE_QUEUE_DEPTH ? i + 1 : -1);
+    }
+    engine->free_head = 0;
+    for (int cls = 0; cls < I2C_CLASS_COUNT; ++cls) {
+        engine->head[cls] = -1;
+        engine->tail[cls] = -1;
+    }
+    for (size_t addr = 0; addr < sizeof(engine->device_timeout_ms) / sizeof(engine->device_timeout_ms[0]); ++addr) {
+        engine->device_timeout_ms[addr] = I2C_ENGINE_DEFAULT_TIMEOUT_MS;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Override the completion budget used for requests to @p addr that pass timeout_ms = 0.
+ */
+void i2c_engine_set_device_timeout(i2c_engine_t *engine, uint8_t addr, uint32_t timeout_ms)
+{
+    if (!engine || timeout_ms == 0) {
+        return;
+    }
+    engine_lock(engine);
+    engine->device_timeout_ms[addr & 0x7FU] = (uint16_t)(timeout_ms > UINT16_MAX ? UINT16_MAX : timeout_ms);
+    engine_unlock(engine);
+}
+
+static void push_back_locked(i2c_engine_t *engine, int8_t index)
+{
+    i2c_class_t cls = engine->slots[index].req.cls;
+    engine->slots[index].next = -1;
+    if (engine->tail[cls] < 0) {
+        engine->head[cls] = index;
+    } else {
+        engine->slots[engine->tail[cls]].next = index;
+    }
+    engine->tail[cls] = index;
+}
+
+static void push_front_locked(i2c_engine_t *engine, int8_t index)
+{
+    i2c_class_t cls = engine->slots[index].req.cls;
+    engine->slots[index].next = engine->head[cls];
+    engine->head[cls] = index;
+    if (engine->tail[cls] < 0) {
+        engine->tail[cls] = index;
+    }
+}
+
+/**
+ * @brief Queue a transaction. Safe from any task; never blocks on the bus.
+ *
+ * @return ESP_OK when queued, ESP_ERR_NO_MEM when the queue is full,
+ *         ESP_ERR_INVALID_SIZE when the write exceeds I2C_ENGINE_MAX_WRITE.
+ */
+esp_err_t i2c_engine_submit(i2c_engine_t *engine, const i2c_engine_request_t *request)
+{
+    if (!engine || !request || request->cls >= I2C_CLASS_COUNT || (request->write_len > 0 && !request->write_data) ||
+        (request->read_len > 0 && !request->read_data)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (request->write_len > I2C_ENGINE_MAX_WRITE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    engine_lock(engine);
+    int8_t index = engine->free_head;
+    if (index < 0) {
+        engine_unlock(engine);
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_engine_slot_t *slot = &engine->slots[index];
+    engine->free_head = slot->next;
+    slot->req = *request;
+    slot->req.addr &= 0x7FU;
+    if (request->write_len > 0) {
+        memcpy(slot->write_buf, request->write_data, request->write_len);
+    }
+    slot->req.write_data = slot->write_buf;
+    uint32_t timeout_ms = request->timeout_ms ? request->timeout_ms : engine->device_timeout_ms[slot->req.addr];
+    slot->submitted_us = engine->platform.now_us();
+    slot->deadline_us = slot->submitted_us + (int64_t)timeout_ms * 1000;
+    slot->not_before_us = slot->submitted_us;
+    slot->attempts = 0;
+    push_back_locked(engine, index);
+    ++engine->pending;
+    engine_unlock(engine);
+    if (engine->platform.notify) {
+        engine->platform.notify();
+    }
+    return ESP_OK;
+}
+
+/**
+ * Unlink the first request of the highest class that is due: either out of backoff
+ * or past its deadline (so it can be failed without touching the bus).
+ */
+static int8_t pick_locked(i2c_engine_t *engine, int64_t now)
+{
+    for (int cls = 0; cls < I2C_CLASS_COUNT; ++cls) {
+        int8_t prev = -1;
+        for (int8_t index = engine->head[cls]; index >= 0; index = engine->slots[index].next) {
+            const i2c_engine_slot_t *slot = &engine->slots[index];
+            if (slot->not_before_us <= now || slot->deadline_us <= now) {
+                if (prev < 0) {
+                    engine->head[cls] = slot->next;
+                } else {
+                    engine->slots[prev].next = slot->next;
+                }
+                if (engine->tail[cls] == index) {
+                    engine->tail[cls] = prev;
+                }
+                return index;
+            }
+            prev = index;
+        }
+    }
+    return -1;
+}
+
+static uint32_t histogram_bucket(int64_t latency_us)
+{
+    uint32_t bucket = 0;
+    int64_t limit = I2C_ENGINE_HIST_BASE_US;
+    while (bucket + 1U < I2C_ENGINE_HIST_BUCKETS && latency_us >= limit) {
+        ++bucket;
+        limit <<= 1;
+    }
+    return bucket;
+}
+
+static void finish(i2c_engine_t *engine, int8_t index, esp_err_t err)
+{
+    i2c_engine_slot_t *slot = &engine->slots[index];
+    int64_t latency_us = engine->platform.now_us() - slot->submitted_us;
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+    i2c_engine_done_cb_t done = slot->req.done;
+    void *ctx = slot->req.ctx;
+
+    engine_lock(engine);
+    i2c_engine_stats_t *stats = &engine->stats[slot->req.cls];
+    if (err == ESP_OK) {
+        ++stats->completed;
+    } else if (err == ESP_ERR_TIMEOUT) {
+        ++stats->timed_out;
+    } else {
+        ++stats->failed;
+    }
+    if ((uint64_t)latency_us > stats->max_latency_us) {
+        stats->max_latency_us = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    }
+    ++stats->histogram[histogram_bucket(latency_us)];
+    slot->next = engine->free_head;
+    engine->free_head = index;
+    --engine->pending;
+    engine_unlock(engine);
+
+    if (done) {
+        done(err, ctx);
+    }
+}
+
+/**
+ * @brief Run at most one transaction. Call from the single bus worker only.
+ *
+ * Completion callbacks run here, on the worker, after the slot has been released.
+ *
+ * @return true when a request was executed, retried or expired; false when nothing is due.
+ */
+bool i2c_engine_process(i2c_engine_t *engine)
+{
+    if (!engine) {
+        return false;
+    }
+    engine_lock(engine);
+    int64_t now = engine->platform.now_us();
+    int8_t index = pick_locked(engine, now);
+    engine_unlock(engine);
+    if (index < 0) {
+        return false;
+    }
+    i2c_engine_slot_t *slot = &engine->slots[index];
+    if (slot->deadline_us <= now) {
+        ESP_LOGW(TAG, "Transaction to 0x%02X expired after %u attempt(s)", slot->req.addr, (unsigned)slot->attempts);
+        finish(engine, index, ESP_ERR_TIMEOUT);
+        return true;
+    }
+
+    uint32_t remaining_ms = (uint32_t)((slot->deadline_us - now + 999) / 1000);
+    esp_err_t err = engine->platform.transfer(slot->req.addr, slot->req.write_data, slot->req.write_len,
+                                              slot->req.read_data, slot->req.read_len, remaining_ms);
+    ++slot->attempts;
+    if (err == ESP_OK) {
+        engine->consecutive_failures = 0;
+        finish(engine, index, ESP_OK);
+        return true;
+    }
+
+    ++engine->consecutive_failures;
+    ESP_LOGW(TAG, "I2C transaction to 0x%02X failed (%s), failure count=%u", slot->req.addr, esp_err_to_name(err),
+             (unsigned)engine->consecutive_failures);
+    if (engine->consecutive_failures >= I2C_ENGINE_RECOVER_THRESHOLD && engine->platform.recover) {
+        ++engine->recoveries;
+        if (engine->platform.recover() == ESP_OK) {
+            engine->consecutive_failures = 0;
+        }
+    }
+    now = engine->platform.now_us();
+    int64_t retry_at = now + ((int64_t)I2C_ENGINE_BACKOFF_BASE_US << (slot->attempts - 1U));
+    if (slot->attempts < I2C_ENGINE_MAX_ATTEMPTS && retry_at < slot->deadline_us) {
+        slot->not_before_us = retry_at;
+        engine_lock(engine);
+        ++engine->stats[slot->req.cls].retries;
+        push_front_locked(engine, index);
+        engine_unlock(engine);
+        return true;
+    }
+    finish(engine, index, err);
+    return true;
+}
+
+/**
+ * @brief Earliest time a queued request becomes due.
+ *
+ * @return -1 when the queue is empty, otherwise a timestamp in the platform clock
+ *         (possibly in the past) so the worker can sleep through retry backoffs.
+ */
+int64_t i2c_engine_next_wake_us(i2c_engine_t *engine)
+{
+    if (!engine) {
+        return -1;
+    }
+    int64_t wake = -1;
+    engine_lock(engine);
+    for (int cls = 0; cls < I2C_CLASS_COUNT; ++cls) {
+        for (int8_t index = engine->head[cls]; index >= 0; index = engine->slots[index].next) {
+            const i2c_engine_slot_t *slot = &engine->slots[index];
+            int64_t due = slot->not_before_us < slot->deadline_us ? slot->not_before_us : slot->deadline_us;
+            if (wake < 0 || due < wake) {
+                wake = due;
+            }
+        }
+    }
+    engine_unlock(engine);
+    return wake;
+}
+
+size_t i2c_engine_pending(i2c_engine_t *engine)
+{
+    if (!engine) {
+        return 0;
+    }
+    engine_lock(engine);
+    size_t pending = engine->pending;
+    engine_unlock(engine);
+    return pending;
+}
+
+esp_err_t i2c_engine_get_stats(i2c_engine_t *engine, i2c_class_t cls, i2c_engine_stats_t *out)
+{
+    if (!engine || !out || cls >= I2C_CLASS_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    engine_lock(engine);
+    *out = engine->stats[cls];
+    engine_unlock(engine);
+    return ESP_OK;
+}
+
+uint32_t i2c_engine_recoveries(i2c_engine_t *engine)
+{
+    if (!engine) {
+        return 0;
+    }
+    engine_lock(engine);
+    uint32_t recoveries = engine->recoveries;
+    engine_unlock(engine);
+    return recoveries;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define I2C_ENGINE_QUEUE_DEPTH 16
+#define I2C_ENGINE_MAX_WRITE 72U
+#define I2C_ENGINE_MAX_ATTEMPTS 3U
+#define I2C_ENGINE_RECOVER_THRESHOLD 3U
+#define I2C_ENGINE_BACKOFF_BASE_US 5000
+#define I2C_ENGINE_DEFAULT_TIMEOUT_MS 200U
+#define I2C_ENGINE_HIST_BUCKETS 12U
+#define I2C_ENGINE_HIST_BASE_US 128U
+
+/**
+ * Transaction priority classes, highest first. Within a class requests are served
+ * in submission order.
+ */
+typedef enum {
+    I2C_CLASS_ACTUATION = 0,
+    I2C_CLASS_GPIO_INPUT,
+    I2C_CLASS_AMBIENT,
+    I2C_CLASS_COUNT,
+} i2c_class_t;
+
+typedef void (*i2c_engine_done_cb_t)(esp_err_t err, void *ctx);
+
+/**
+ * One bus transaction: an optional write followed by an optional repeated-start read.
+ * Write data is copied on submission; @c read_data must stay valid until @c done runs.
+ */
+typedef struct {
+    uint8_t addr;
+    i2c_class_t cls;
+    const uint8_t *write_data;
+    size_t write_len;
+    uint8_t *read_data;
+    size_t read_len;
+    uint32_t timeout_ms; /**< Budget from submission to completion; 0 = device default. */
+    i2c_engine_done_cb_t done;
+    void *ctx;
+} i2c_engine_request_t;
+
+typedef struct {
+    esp_err_t (*transfer)(uint8_t addr, const uint8_t *write_data, size_t write_len, uint8_t *read_data,
+                          size_t read_len, uint32_t timeout_ms);
+    esp_err_t (*recover)(void);
+    int64_t (*now_us)(void);
+    void (*lock)(void);
+    void (*unlock)(void);
+    void (*notify)(void);
+} i2c_engine_platform_t;
+
+/**
+ * Per-class counters. Latency runs from submission to completion, so it includes
+ * queueing behind other transactions; bucket i counts latencies below
+ * I2C_ENGINE_HIST_BASE_US << i, the last bucket everything slower.
+ */
+typedef struct {
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t timed_out;
+    uint32_t retries;
+    uint32_t max_latency_us;
+    uint32_t histogram[I2C_ENGINE_HIST_BUCKETS];
+} i2c_engine_stats_t;
+
+typedef struct {
+    i2c_engine_request_t req;
+    uint8_t write_buf[I2C_ENGINE_MAX_WRITE];
+    int64_t submitted_us;
+    int64_t deadline_us;
+    int64_t not_before_us;
+    uint8_t attempts;
+    int8_t next;
+} i2c_engine_slot_t;
+
+/**
+ * Prioritised I2C transaction queue.
+ *
+ * Any task may submit; a single worker calls i2c_engine_process() to run the most
+ * urgent eligible transaction. Failed attempts are re-queued with exponential
+ * backoff instead of sleeping on the bus, so higher classes keep flowing while a
+ * device misbehaves, and consecutive failures trigger the platform bus recovery.
+ */
+typedef struct {
+    i2c_engine_platform_t platform;
+    i2c_engine_slot_t slots[I2C_ENGINE_QUEUE_DEPTH];
+    int8_t head[I2C_CLASS_COUNT];
+    int8_t tail[I2C_CLASS_COUNT];
+    int8_t free_head;
+    size_t pending;
+    uint16_t device_timeout_ms[128];
+    uint8_t consecutive_failures;
+    uint32_t recoveries;
+    i2c_engine_stats_t stats[I2C_CLASS_COUNT];
+} i2c_engine_t;
+
+esp_err_t i2c_engine_init(i2c_engine_t *engine, const i2c_engine_platform_t *platform);
+void i2c_engine_set_device_timeout(i2c_engine_t *engine, uint8_t addr, uint32_t timeout_ms);
+esp_err_t i2c_engine_submit(i2c_engine_t *engine, const i2c_engine_request_t *request);
+bool i2c_engine_process(i2c_engine_t *engine);
+int64_t i2c_engine_next_wake_us(i2c_engine_t *engine);
+size_t i2c_engine_pending(i2c_engine_t *engine);
+esp_err_t i2c_engine_get_stats(i2c_engine_t *engine, i2c_class_t cls, i2c_engine_stats_t *out);
+uint32_t i2c_engine_recoveries(i2c_engine_t *engine);
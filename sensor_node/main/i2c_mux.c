@@ -0,0 +1,220 @@
+#include "i2c_mux.h"
+
+#include "drivers/tca9548a.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define I2C_MUX_CHANNEL_UNKNOWN (-2)
+
+typedef struct {
+    uint8_t address;
+    int8_t parent; /* index into s_muxes, -1 on the root bus */
+    int8_t parent_channel;
+    int8_t channel; /* cached selection: NONE, 0..7 or UNKNOWN */
+    uint8_t depth;
+} i2c_mux_node_t;
+
+static const char *TAG = "i2c_mux";
+
+static i2c_mux_node_t s_muxes[I2C_MUX_MAX_DEVICES];
+static size_t s_mux_count;
+static i2c_mux_route_t s_active;
+static bool s_active_valid;
+static i2c_mux_stats_t s_stats;
+
+static int find_mux(uint8_t address)
+{
+    for (size_t i = 0; i < s_mux_count; ++i) {
+        if (s_muxes[i].address == address) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void i2c_mux_reset(void)
+{
+    memset(s_muxes, 0, sizeof(s_muxes));
+    s_mux_count = 0;
+    s_active_valid = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+esp_err_t i2c_mux_register(uint8_t address, uint8_t parent_address, int8_t parent_channel)
+{
+    if (address < 0x70 || address > 0x77 || address == parent_address) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int parent = -1;
+    if (parent_address != 0) {
+        parent = find_mux(parent_address);
+        if (parent < 0 || parent_channel < 0 || parent_channel > 7) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (s_muxes[parent].depth + 1U >= I2C_MUX_MAX_DEPTH) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+    int index = find_mux(address);
+    if (index < 0) {
+        if (s_mux_count >= I2C_MUX_MAX_DEVICES) {
+            return ESP_ERR_NO_MEM;
+        }
+        index = (int)s_mux_count++;
+    }
+    s_muxes[index] = (i2c_mux_node_t){
+        .address = address,
+        .parent = (int8_t)parent,
+        .parent_channel = parent < 0 ? I2C_MUX_CHANNEL_NONE : parent_channel,
+        .channel = I2C_MUX_CHANNEL_UNKNOWN,
+        .depth = parent < 0 ? 0 : (uint8_t)(s_muxes[parent].depth + 1U),
+    };
+    return ESP_OK;
+}
+
+void i2c_mux_invalidate(void)
+{
+    for (size_t i = 0; i < s_mux_count; ++i) {
+        s_muxes[i].channel = I2C_MUX_CHANNEL_UNKNOWN;
+    }
+    s_active_valid = false;
+}
+
+void i2c_mux_route_failed(const i2c_mux_route_t *route)
+{
+    if (!route || route->mux_address == 0) {
+        return;
+    }
+    for (int index = find_mux(route->mux_address); index >= 0; index = s_muxes[index].parent) {
+        s_muxes[index].channel = I2C_MUX_CHANNEL_UNKNOWN;
+    }
+    s_active_valid = false;
+}
+
+static esp_err_t set_channel(i2c_mux_node_t *mux, int8_t channel)
+{
+    if (mux->channel == channel) {
+        return ESP_OK;
+    }
+    ++s_stats.channel_writes;
+    esp_err_t err = tca9548a_select(mux->address, channel);
+    mux->channel = err == ESP_OK ? channel : I2C_MUX_CHANNEL_UNKNOWN;
+    return err;
+}
+
+/* A mux is visible when every mux above it has the right channel selected. */
+static bool mux_visible(const i2c_mux_node_t *mux)
+{
+    while (mux->parent >= 0) {
+        const i2c_mux_node_t *parent = &s_muxes[mux->parent];
+        if (parent->channel != mux->parent_channel && parent->channel != I2C_MUX_CHANNEL_UNKNOWN) {
+            return false;
+        }
+        mux = parent;
+    }
+    return true;
+}
+
+static bool same_route(const i2c_mux_route_t *a, const i2c_mux_route_t *b)
+{
+    if (a->mux_address == 0 || b->mux_address == 0) {
+        return a->mux_address == b->mux_address;
+    }
+    return a->mux_address == b->mux_address && a->channel == b->channel;
+}
+
+esp_err_t i2c_mux_select(const i2c_mux_route_t *route)
+{
+    if (!route) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ++s_stats.selects;
+    bool on_path[I2C_MUX_MAX_DEVICES] = {false};
+    int path[I2C_MUX_MAX_DEPTH];
+    int8_t channels[I2C_MUX_MAX_DEPTH];
+    size_t depth = 0;
+    if (route->mux_address != 0) {
+        int index = find_mux(route->mux_address);
+        if (index < 0 || route->channel < 0 || route->channel > 7) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        int8_t channel = route->channel;
+        while (index >= 0) {
+            path[depth] = index;
+            channels[depth] = channel;
+            on_path[index] = true;
+            ++depth;
+            channel = s_muxes[index].parent_channel;
+            index = s_muxes[index].parent;
+        }
+    }
+
+    s_active_valid = false;
+    for (size_t i = depth; i-- > 0;) {
+        esp_err_t err = set_channel(&s_muxes[path[i]], channels[i]);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to route to 0x%02X ch%d: %s", s_muxes[path[i]].address, channels[i],
+                     esp_err_to_name(err));
+            return err;
+        }
+    }
+    /* Parents first, so disconnecting one hides its whole subtree. */
+    for (uint8_t level = 0; level < I2C_MUX_MAX_DEPTH; ++level) {
+        for (size_t i = 0; i < s_mux_count; ++i) {
+            i2c_mux_node_t *mux = &s_muxes[i];
+            if (on_path[i] || mux->depth != level || mux->channel == I2C_MUX_CHANNEL_NONE || !mux_visible(mux)) {
+                continue;
+            }
+            esp_err_t err = set_channel(mux, I2C_MUX_CHANNEL_NONE);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    s_active = *route;
+    s_active_valid = true;
+    return ESP_OK;
+}
+
+void i2c_mux_order(const i2c_mux_route_t *routes, size_t count, size_t *order)
+{
+    if (!routes || !order) {
+        return;
+    }
+    bool taken[32] = {false};
+    size_t placed = 0;
+    if (count > sizeof(taken) / sizeof(taken[0])) {
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        return;
+    }
+    i2c_mux_route_t current = s_active;
+    bool have_current = s_active_valid;
+    while (placed < count) {
+        if (!have_current) {
+            for (size_t i = 0; i < count; ++i) {
+                if (!taken[i]) {
+                    current = routes[i];
+                    have_current = true;
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!taken[i] && same_route(&routes[i], &current)) {
+                taken[i] = true;
+                order[placed++] = i;
+            }
+        }
+        have_current = false;
+    }
+}
+
+void i2c_mux_get_stats(i2c_mux_stats_t *out)
+{
+    if (out) {
+        *out = s_stats;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define I2C_MUX_MAX_DEVICES 8U
+#define I2C_MUX_MAX_DEPTH 3U
+#define I2C_MUX_CHANNEL_NONE (-1)
+
+/**
+ * Where a device sits in the multiplexer tree: the mux directly upstream of it and
+ * the channel it hangs off. @c mux_address = 0 means the device is on the root bus.
+ */
+typedef struct {
+    uint8_t mux_address;
+    int8_t channel;
+} i2c_mux_route_t;
+
+typedef struct {
+    uint32_t selects;       /**< Route selections requested. */
+    uint32_t channel_writes; /**< Control-register writes actually sent. */
+} i2c_mux_stats_t;
+
+/**
+ * @brief Forget all registered multiplexers and cached channel state.
+ */
+void i2c_mux_reset(void);
+
+/**
+ * @brief Declare a TCA9548A, optionally cascaded behind a channel of another mux.
+ *
+ * @param address 7-bit address of the multiplexer (0x70-0x77).
+ * @param parent_address Upstream mux, or 0 when the mux is on the root bus.
+ * @param parent_channel Channel of @p parent_address the mux is wired to.
+ */
+esp_err_t i2c_mux_register(uint8_t address, uint8_t parent_address, int8_t parent_channel);
+
+/**
+ * @brief Make the device behind @p route reachable, writing only the mux control
+ *        registers whose cached state differs.
+ *
+ * Every mux on the path gets its channel selected, and any other mux still visible
+ * once the path is up is disconnected so same-address devices never collide.
+ */
+esp_err_t i2c_mux_select(const i2c_mux_route_t *route);
+
+/**
+ * @brief Mark every cached channel as unknown, e.g. after a bus recovery.
+ */
+void i2c_mux_invalidate(void);
+
+/**
+ * @brief Mark the channels on @p route as unknown after a transaction with the
+ *        device behind it failed, so the next select rewrites them.
+ *
+ * A multiplexer that reset or glitched reports no error of its own; the failing
+ * device behind it is the only sign. Root-bus routes leave the cache untouched.
+ */
+void i2c_mux_route_failed(const i2c_mux_route_t *route);
+
+/**
+ * @brief Order @p count routes so that work on the currently selected channel runs
+ *        first and the rest is grouped per channel, minimising switches.
+ *
+ * @param order Output permutation of indices into @p routes.
+ */
+void i2c_mux_order(const i2c_mux_route_t *routes, size_t count, size_t *order);
+
+void i2c_mux_get_stats(i2c_mux_stats_t *out);
@@ -0,0 +1,120 @@
+#include "io_batch.h"
+
+#include <string.h>
+
+void io_batch_init(io_batch_t *batch)
+{
+    if (batch) {
+        memset(batch, 0, sizeof(*batch));
+    }
+}
+
+/**
+ * Account one command on @p lane. Latency is summed as pending * now - sum(enqueue),
+ * so every surviving command contributes exactly without storing its timestamp.
+ */
+static void track(io_batch_t *batch, io_lane_t lane, bool superseded, int64_t enqueued_us)
+{
+    io_lane_stats_t *stats = &batch->stats[lane];
+    ++stats->commands;
+    if (superseded) {
+        /* The slot keeps the timestamp of its first request, so latency still
+         * measures how long that output waited for the bus. */
+        ++stats->superseded;
+        return;
+    }
+    if (batch->pending[lane] == 0 || enqueued_us < batch->oldest_us[lane]) {
+        batch->oldest_us[lane] = enqueued_us;
+    }
+    ++batch->pending[lane];
+    batch->enqueued_sum_us[lane] += enqueued_us;
+}
+
+/**
+ * @brief Merge a masked GPIO write; later commands win per pin.
+ *
+ * A command is counted as superseding when every pin it touches was already pending.
+ */
+void io_batch_add_gpio(io_batch_t *batch, size_t device, uint16_t mask, uint16_t value, int64_t enqueued_us)
+{
+    if (!batch || device >= IO_BATCH_GPIO_DEVICES || mask == 0) {
+        return;
+    }
+    bool superseded = (batch->gpio_mask[device] & mask) == mask;
+    batch->gpio_value[device] = (uint16_t)((batch->gpio_value[device] & ~mask) | (value & mask));
+    batch->gpio_mask[device] |= mask;
+    track(batch, IO_LANE_GPIO, superseded, enqueued_us);
+}
+
+void io_batch_add_pwm(io_batch_t *batch, uint8_t channel, uint16_t duty, int64_t enqueued_us)
+{
+    if (!batch || channel >= IO_BATCH_PWM_CHANNELS) {
+        return;
+    }
+    uint16_t bit = (uint16_t)(1U << channel);
+    bool superseded = (batch->pwm_mask & bit) != 0;
+    batch->pwm[channel] = duty;
+    batch->pwm_mask |= bit;
+    track(batch, IO_LANE_PWM, superseded, enqueued_us);
+}
+
+void io_batch_add_pwm_freq(io_batch_t *batch, uint16_t frequency_hz, int64_t enqueued_us)
+{
+    if (!batch) {
+        return;
+    }
+    bool superseded = batch->freq_pending;
+    batch->freq = frequency_hz;
+    batch->freq_pending = true;
+    track(batch, IO_LANE_PWM_FREQ, superseded, enqueued_us);
+}
+
+bool io_batch_pending(const io_batch_t *batch, io_lane_t lane)
+{
+    return batch && lane < IO_LANE_COUNT && batch->pending[lane] > 0;
+}
+
+/**
+ * @brief Mark @p lane as applied at @p now_us: record its latency and clear its values.
+ */
+void io_batch_complete(io_batch_t *batch, io_lane_t lane, int64_t now_us)
+{
+    if (!batch || lane >= IO_LANE_COUNT || batch->pending[lane] == 0) {
+        return;
+    }
+    io_lane_stats_t *stats = &batch->stats[lane];
+    int64_t total = (int64_t)batch->pending[lane] * now_us - batch->enqueued_sum_us[lane];
+    int64_t worst = now_us - batch->oldest_us[lane];
+    stats->total_latency_us += total > 0 ? (uint64_t)total : 0U;
+    if (worst > 0 && (uint64_t)worst > stats->max_latency_us) {
+        stats->max_latency_us = worst > UINT32_MAX ? UINT32_MAX : (uint32_t)worst;
+    }
+    ++stats->flushes;
+    batch->pending[lane] = 0;
+    batch->enqueued_sum_us[lane] = 0;
+    switch (lane) {
+    case IO_LANE_GPIO:
+        memset(batch->gpio_mask, 0, sizeof(batch->gpio_mask));
+        memset(batch->gpio_value, 0, sizeof(batch->gpio_value));
+        break;
+    case IO_LANE_PWM_FREQ:
+        batch->freq_pending = false;
+        break;
+    case IO_LANE_PWM:
+        batch->pwm_mask = 0;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Record a failed flush of @p lane; its values stay pending and keep their timestamps.
+ */
+void io_batch_fail(io_batch_t *batch, io_lane_t lane)
+{
+    if (!batch || lane >= IO_LANE_COUNT || batch->pending[lane] == 0) {
+        return;
+    }
+    ++batch->stats[lane].errors;
+}
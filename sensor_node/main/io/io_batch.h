@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IO_BATCH_PWM_CHANNELS 16U
+#define IO_BATCH_GPIO_DEVICES 2U
+
+/** Flush lanes in the order t_io applies them: GPIO first, PWM burst last. */
+typedef enum {
+    IO_LANE_GPIO = 0,
+    IO_LANE_PWM_FREQ,
+    IO_LANE_PWM,
+    IO_LANE_COUNT,
+} io_lane_t;
+
+/**
+ * Per-lane counters. Latency runs from io_task_* enqueue to the end of the flush
+ * that put the value on the bus. Superseded commands never reach hardware and are
+ * not timed, so the mean is total_latency_us / (commands - superseded). Failed
+ * flushes count in @c errors and leave the lane pending for the next one.
+ */
+typedef struct {
+    uint32_t commands;
+    uint32_t superseded;
+    uint32_t flushes;
+    uint32_t errors;
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} io_lane_stats_t;
+
+/**
+ * Working set of IO commands drained from the t_io queue within one tick. Later
+ * values replace earlier ones per PWM channel and per GPIO pin, so each lane costs
+ * at most one hardware update per tick however many commands arrived.
+ */
+typedef struct {
+    uint16_t gpio_mask[IO_BATCH_GPIO_DEVICES];
+    uint16_t gpio_value[IO_BATCH_GPIO_DEVICES];
+    uint16_t pwm_mask;
+    uint16_t pwm[IO_BATCH_PWM_CHANNELS];
+    bool freq_pending;
+    uint16_t freq;
+    uint32_t pending[IO_LANE_COUNT];
+    int64_t enqueued_sum_us[IO_LANE_COUNT];
+    int64_t oldest_us[IO_LANE_COUNT];
+    io_lane_stats_t stats[IO_LANE_COUNT];
+} io_batch_t;
+
+void io_batch_init(io_batch_t *batch);
+void io_batch_add_gpio(io_batch_t *batch, size_t device, uint16_t mask, uint16_t value, int64_t enqueued_us);
+void io_batch_add_pwm(io_batch_t *batch, uint8_t channel, uint16_t duty, int64_t enqueued_us);
+void io_batch_add_pwm_freq(io_batch_t *batch, uint16_t frequency_hz, int64_t enqueued_us);
+bool io_batch_pending(const io_batch_t *batch, io_lane_t lane);
+void io_batch_complete(io_batch_t *batch, io_lane_t lane, int64_t now_us);
+void io_batch_fail(io_batch_t *batch, io_lane_t lane);
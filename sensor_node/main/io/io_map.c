@@ -21,6 +21,12 @@ static const io_map_t io_map = {
 #else
         1,
 #endif
+#if CONFIG_SENSOR_AMBIENT_TCA9548A_ENABLE
+    .muxes = {
+        {.address = CONFIG_SENSOR_TCA9548A_ADDRESS, .parent_address = 0, .parent_channel = IO_MUX_CHANNEL_NONE},
+    },
+    .mux_count = 1,
+#endif
 #elif CONFIG_SENSOR_AMBIENT_SENSOR_BME280
     .ambient = {
         {.type = IO_AMBIENT_SENSOR_BME280, .address = 0x76, .mux_address = 0, .mux_channel = IO_MUX_CHANNEL_NONE},
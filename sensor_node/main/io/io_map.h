@@ -4,6 +4,7 @@
 
 #define IO_MAX_AMBIENT_SENSORS 2U
 #define IO_MUX_CHANNEL_NONE (-1)
+#define IO_MAX_MUXES 4U
 
 typedef enum {
     IO_AMBIENT_SENSOR_NONE = 0,
@@ -24,9 +25,18 @@ typedef struct {
     int8_t mux_channel;
 } io_ambient_sensor_t;
 
+/* A TCA9548A; parent_address = 0 for a mux on the root bus. */
+typedef struct {
+    uint8_t address;
+    uint8_t parent_address;
+    int8_t parent_channel;
+} io_mux_t;
+
 typedef struct {
     io_ambient_sensor_t ambient[IO_MAX_AMBIENT_SENSORS];
     uint8_t ambient_count;
+    io_mux_t muxes[IO_MAX_MUXES];
+    uint8_t mux_count;
     io_pwm_backend_t pwm_backend;
     uint8_t pca9685_address;
     uint8_t mcp23017_addresses[2];
@@ -0,0 +1,112 @@
+#include "mcp_inputs.h"
+
+#include "drivers/mcp23017.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "mcp_inputs";
+
+static void update(mcp_inputs_t *inputs, size_t index, uint16_t value)
+{
+    if (inputs->known[index] && inputs->last[index] == value) {
+        return;
+    }
+    inputs->known[index] = true;
+    inputs->last[index] = value;
+    ++inputs->stats.changes;
+    if (inputs->publish) {
+        inputs->publish(index, value, inputs->ctx);
+    }
+}
+
+/**
+ * @brief Bind the expanders and publish their initial state.
+ *
+ * Devices that fail the first read are published as soon as a later read succeeds.
+ */
+esp_err_t mcp_inputs_init(mcp_inputs_t *inputs, const uint8_t *addresses, size_t count,
+                          mcp_inputs_publish_fn publish, void *ctx)
+{
+    if (!inputs || !addresses || count == 0 || count > MCP_INPUTS_MAX_DEVICES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(inputs, 0, sizeof(*inputs));
+    memcpy(inputs->addresses, addresses, count);
+    inputs->count = count;
+    inputs->publish = publish;
+    inputs->ctx = ctx;
+    mcp_inputs_poll(inputs, true);
+    return ESP_OK;
+}
+
+/**
+ * @brief Switch device @p index to interrupt-driven reads for the pins in @p mask.
+ *
+ * The caller wires the device's INT output to an ESP GPIO and forwards edges to
+ * mcp_inputs_on_interrupt().
+ */
+esp_err_t mcp_inputs_enable_irq(mcp_inputs_t *inputs, size_t index, uint16_t mask)
+{
+    if (!inputs || index >= inputs->count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = mcp23017_enable_interrupts(inputs->addresses[index], mask);
+    inputs->irq[index] = (err == ESP_OK);
+    return err;
+}
+
+bool mcp_inputs_has_irq(const mcp_inputs_t *inputs, size_t index)
+{
+    return inputs && index < inputs->count && inputs->irq[index];
+}
+
+/**
+ * @brief Service the devices whose bit is set in @p device_bits.
+ *
+ * One six-byte read returns INTF, INTCAP and GPIO and clears the interrupt.
+ */
+void mcp_inputs_on_interrupt(mcp_inputs_t *inputs, uint32_t device_bits)
+{
+    if (!inputs) {
+        return;
+    }
+    for (size_t i = 0; i < inputs->count; ++i) {
+        if (!(device_bits & (1UL << i))) {
+            continue;
+        }
+        uint16_t flags = 0;
+        uint16_t captured = 0;
+        uint16_t current = 0;
+        ++inputs->stats.reads;
+        esp_err_t err = mcp23017_read_interrupt(inputs->addresses[i], &flags, &captured, &current);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "MCP23017 0x%02X interrupt read failed: %s", inputs->addresses[i], esp_err_to_name(err));
+            continue;
+        }
+        if (flags && inputs->known[i] && current == inputs->last[i]) {
+            ++inputs->stats.pulses;
+        }
+        update(inputs, i, current);
+    }
+}
+
+/**
+ * @brief Read GPIO directly on polled devices, or on every device when
+ *        @p include_irq_devices is set (fallback against lost edges).
+ */
+void mcp_inputs_poll(mcp_inputs_t *inputs, bool include_irq_devices)
+{
+    if (!inputs) {
+        return;
+    }
+    for (size_t i = 0; i < inputs->count; ++i) {
+        if (inputs->irq[i] && !include_irq_devices) {
+            continue;
+        }
+        uint16_t value = 0;
+        ++inputs->stats.reads;
+        if (mcp23017_read_gpio(inputs->addresses[i], &value) == ESP_OK) {
+            update(inputs, i, value);
+        }
+    }
+}
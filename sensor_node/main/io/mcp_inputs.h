@@ -0,0 +1,39 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MCP_INPUTS_MAX_DEVICES 2U
+
+typedef void (*mcp_inputs_publish_fn)(size_t index, uint16_t value, void *ctx);
+
+typedef struct {
+    uint32_t reads;    /**< I2C transactions spent reading inputs. */
+    uint32_t changes;  /**< Reads that found a new port value and published it. */
+    uint32_t pulses;   /**< Interrupts whose pins were back at their old value by the read. */
+} mcp_inputs_stats_t;
+
+/**
+ * Input state of the MCP23017 expanders. Devices with interrupt-on-change are
+ * only read when their INT line fires; the rest, and a slow fallback poll of
+ * all devices, read GPIO directly. Either way only changes are published.
+ */
+typedef struct {
+    uint8_t addresses[MCP_INPUTS_MAX_DEVICES];
+    size_t count;
+    uint16_t last[MCP_INPUTS_MAX_DEVICES];
+    bool known[MCP_INPUTS_MAX_DEVICES];
+    bool irq[MCP_INPUTS_MAX_DEVICES];
+    mcp_inputs_publish_fn publish;
+    void *ctx;
+    mcp_inputs_stats_t stats;
+} mcp_inputs_t;
+
+esp_err_t mcp_inputs_init(mcp_inputs_t *inputs, const uint8_t *addresses, size_t count,
+                          mcp_inputs_publish_fn publish, void *ctx);
+esp_err_t mcp_inputs_enable_irq(mcp_inputs_t *inputs, size_t index, uint16_t mask);
+bool mcp_inputs_has_irq(const mcp_inputs_t *inputs, size_t index);
+void mcp_inputs_on_interrupt(mcp_inputs_t *inputs, uint32_t device_bits);
+void mcp_inputs_poll(mcp_inputs_t *inputs, bool include_irq_devices);
@@ -0,0 +1,42 @@
+#include "journal_partition.h"
+
+#include "esp_partition.h"
+
+static esp_err_t partition_read(void *ctx, size_t offset, void *dst, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, dst, len);
+}
+
+static esp_err_t partition_write(void *ctx, size_t offset, const void *src, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, src, len);
+}
+
+static esp_err_t partition_erase(void *ctx, size_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len);
+}
+
+esp_err_t journal_partition_bind(const char *label, telemetry_journal_flash_t *out)
+{
+    if (!label || !out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!partition) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (partition->encrypted) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    *out = (telemetry_journal_flash_t){
+        .read = partition_read,
+        .write = partition_write,
+        .erase = partition_erase,
+        .ctx = (void *)partition,
+        .size = partition->size,
+        .sector_size = partition->erase_size,
+    };
+    return ESP_OK;
+}
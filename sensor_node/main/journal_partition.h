@@ -0,0 +1,14 @@
+#pragma once
+
+#include "telemetry_journal.h"
+
+/**
+ * @brief Bind the journal to the data partition labelled @p label.
+ *
+ * The partition must not be flagged encrypted: replay marks records by clearing bits
+ * in place, which encrypted writes cannot do.
+ *
+ * @return ESP_ERR_NOT_FOUND when the partition table has no such partition,
+ *         ESP_ERR_NOT_SUPPORTED when it is encrypted.
+ */
+esp_err_t journal_partition_bind(const char *label, telemetry_journal_flash_t *out);
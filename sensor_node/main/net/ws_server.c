@@ -10,16 +10,17 @@
 #include "common/util/monotonic.h"
 #include "cert_store.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "io/io_map.h"
 #include "tasks/t_io.h"
 #include "sdkconfig.h"
+#include <inttypes.h>
 #include <string.h>
 
 static const char *TAG = "sensor_ws";
 
 static sensor_data_model_t *s_model;
 static bool s_use_cbor;
-static uint8_t s_tx_frame[SENSOR_DATA_MODEL_MAX_MESSAGE_SIZE + sizeof(uint32_t)];
 static uint8_t s_sec2_salt[32];
 static uint8_t s_sec2_verifier[384];
 static uint8_t s_ws_secret[64];
@@ -31,24 +32,128 @@ static wifi_manager_sec2_params_t s_sec2_params = {
     .verifier = s_sec2_verifier,
 };
 
-static void ws_rx(const uint8_t *data, size_t len, uint32_t crc, void *ctx)
+/* Recently applied commands, used to absorb HMI retransmits. Sequence ids restart
+ * when an HMI reboots, so entries are only matched on the connection that sent them. */
+static struct {
+    uint32_t session[CONFIG_SENSOR_WS_CMD_HISTORY];
+    uint32_t seq[CONFIG_SENSOR_WS_CMD_HISTORY];
+    size_t count;
+    size_t next;
+} s_cmd_history;
+
+static bool command_history_contains(uint32_t session_id, uint32_t seq)
+{
+    for (size_t i = 0; i < s_cmd_history.count; ++i) {
+        if (s_cmd_history.seq[i] == seq && s_cmd_history.session[i] == session_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void command_history_record(uint32_t session_id, uint32_t seq)
+{
+    s_cmd_history.session[s_cmd_history.next] = session_id;
+    s_cmd_history.seq[s_cmd_history.next] = seq;
+    s_cmd_history.next = (s_cmd_history.next + 1) % CONFIG_SENSOR_WS_CMD_HISTORY;
+    if (s_cmd_history.count < CONFIG_SENSOR_WS_CMD_HISTORY) {
+        ++s_cmd_history.count;
+    }
+}
+
+static proto_ack_status_t apply_command(const proto_command_t *cmd)
+{
+    // Setters are idempotent, so a command partially applied before the queue
+    // filled up is safe to replay in full when the HMI retransmits it.
+    for (size_t i = 0; i < cmd->pwm_update_count; ++i) {
+        if (!io_task_set_pwm(cmd->pwm_updates[i].channel, cmd->pwm_updates[i].duty_cycle)) {
+            return PROTO_ACK_BUSY;
+        }
+    }
+    if (cmd->has_pwm_frequency && !io_task_set_pwm_frequency(cmd->pwm_frequency)) {
+        return PROTO_ACK_BUSY;
+    }
+    for (size_t i = 0; i < cmd->gpio_write_count; ++i) {
+        const proto_gpio_write_t *gpio = &cmd->gpio_writes[i];
+        if (!io_task_write_gpio(gpio->device_index, gpio->port, gpio->mask, gpio->value)) {
+            return PROTO_ACK_BUSY;
+        }
+    }
+    return PROTO_ACK_OK;
+}
+
+static void send_command_ack(uint32_t seq, proto_ack_status_t status)
+{
+    proto_command_ack_t ack = {
+        .timestamp_ms = monotonic_time_ms(),
+        .sequence_id = seq,
+        .status = (uint8_t)status,
+    };
+    uint8_t frame[PROTO_MAX_ACK_SIZE + sizeof(uint32_t)];
+    size_t payload_len = PROTO_MAX_ACK_SIZE;
+    uint32_t crc = 0;
+    if (!proto_encode_command_ack_into(&ack, s_use_cbor, frame + sizeof(uint32_t), &payload_len, &crc)) {
+        ESP_LOGW(TAG, "Failed to encode ack for command %" PRIu32, seq);
+        return;
+    }
+    memcpy(frame, &crc, sizeof(uint32_t));
+    ws_server_send(frame, payload_len + sizeof(uint32_t));
+}
+
+/**
+ * @brief Answer one history page. Replies are broadcast like every other frame;
+ *        clients match them to their request by sequence id.
+ */
+static void handle_history_request(const uint8_t *data, size_t len, uint32_t crc)
+{
+    /* Only touched from the WebSocket receive callback. */
+    static proto_history_t page;
+    static uint8_t frame[PROTO_MAX_HISTORY_SIZE + sizeof(uint32_t)];
+
+    proto_history_request_t req;
+    if (!proto_decode_history_request(data, len, s_use_cbor, &req, crc)) {
+        ESP_LOGW(TAG, "Failed to decode history request");
+        return;
+    }
+    if (!history_store_read(s_model->history, &req, &page)) {
+        ESP_LOGW(TAG, "History request %" PRIu32 " not served (ch=%u tier=%u)", req.sequence_id, req.channel,
+                 req.tier);
+        return;
+    }
+    page.now_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    size_t payload_len = PROTO_MAX_HISTORY_SIZE;
+    uint32_t page_crc = 0;
+    if (!proto_encode_history_into(&page, s_use_cbor, frame + sizeof(uint32_t), &payload_len, &page_crc)) {
+        ESP_LOGW(TAG, "Failed to encode history page %" PRIu32, req.sequence_id);
+        return;
+    }
+    memcpy(frame, &page_crc, sizeof(uint32_t));
+    ws_server_send(frame, payload_len + sizeof(uint32_t));
+}
+
+static void ws_rx(const uint8_t *data, size_t len, uint32_t crc, uint32_t session_id, void *ctx)
 {
     (void)ctx;
+    if (proto_peek_type(data, len, s_use_cbor) == PROTO_MSG_HISTORY_REQUEST) {
+        handle_history_request(data, len, crc);
+        return;
+    }
     proto_command_t cmd;
     if (!proto_decode_command(data, len, s_use_cbor, &cmd, crc)) {
         ESP_LOGW(TAG, "Failed to decode command");
         return;
     }
-    if (cmd.has_pwm_update) {
-        io_task_set_pwm(cmd.pwm_update.channel, cmd.pwm_update.duty_cycle);
-    }
-    if (cmd.has_pwm_frequency) {
-        io_task_set_pwm_frequency(cmd.pwm_frequency);
+    if (command_history_contains(session_id, cmd.sequence_id)) {
+        send_command_ack(cmd.sequence_id, PROTO_ACK_DUPLICATE);
+        return;
     }
-    if (cmd.has_gpio_write) {
-        io_task_write_gpio(cmd.gpio_write.device_index, cmd.gpio_write.port, cmd.gpio_write.mask,
-                           cmd.gpio_write.value);
+    proto_ack_status_t status = apply_command(&cmd);
+    if (status == PROTO_ACK_OK) {
+        command_history_record(session_id, cmd.sequence_id);
+    } else {
+        ESP_LOGW(TAG, "IO queue full, deferring command %" PRIu32, cmd.sequence_id);
     }
+    send_command_ack(cmd.sequence_id, status);
 }
 
 void sensor_ws_server_start(sensor_data_model_t *model)
@@ -133,6 +238,10 @@ void sensor_ws_server_start(sensor_data_model_t *model)
         .crypto_secret = s_ws_secret_len > 0 ? s_ws_secret : NULL,
         .crypto_secret_len = s_ws_secret_len,
         .enable_frame_encryption = enable_encryption,
+#if CONFIG_SENSOR_WS_ACCEPT_CHACHA20_POLY1305
+        .cipher_suites = WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_AES256_GCM) |
+                         WS_SECURITY_SUITE_BIT(WS_SECURITY_SUITE_CHACHA20_POLY1305),
+#endif
         .enable_handshake_token = enable_handshake,
         .handshake_replay_window_ms = CONFIG_SENSOR_WS_HANDSHAKE_TTL_MS,
         .handshake_cache_size = CONFIG_SENSOR_WS_HANDSHAKE_CACHE_SIZE,
@@ -148,18 +257,20 @@ void sensor_ws_server_start(sensor_data_model_t *model)
 
 void sensor_ws_server_send_update(sensor_data_model_t *model, bool use_cbor)
 {
-    uint8_t *payload = NULL;
-    size_t payload_len = 0;
-    uint32_t crc = 0;
-    if (!data_model_build(model, use_cbor, &payload, &payload_len, &crc)) {
+    const data_model_frame_t *frame = data_model_build(model, use_cbor);
+    if (!frame) {
+        ESP_LOGE(TAG, "Failed to encode sensor update");
         return;
     }
-    size_t frame_len = payload_len + sizeof(uint32_t);
-    if (frame_len > sizeof(s_tx_frame)) {
-        ESP_LOGE(TAG, "Frame too large (%zu)", frame_len);
-        return;
-    }
-    memcpy(s_tx_frame, &crc, sizeof(uint32_t));
-    memcpy(s_tx_frame + sizeof(uint32_t), payload, payload_len);
-    ws_server_send(s_tx_frame, frame_len);
+    ws_server_send(frame->data, frame->len);
+}
+
+bool sensor_ws_server_has_clients(void)
+{
+    return ws_server_active_client_count() > 0;
+}
+
+void sensor_ws_server_send_frame(const uint8_t *frame, size_t len)
+{
+    ws_server_send(frame, len);
 }
@@ -4,3 +4,9 @@
 
 void sensor_ws_server_start(sensor_data_model_t *model);
 void sensor_ws_server_send_update(sensor_data_model_t *model, bool use_cbor);
+
+/** @brief True while at least one WebSocket client is connected. */
+bool sensor_ws_server_has_clients(void);
+
+/** @brief Send an already framed (CRC + payload) message to every client. */
+void sensor_ws_server_send_frame(const uint8_t *frame, size_t len);
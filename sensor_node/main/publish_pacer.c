@@ -0,0 +1,65 @@
+#include "publish_pacer.h"
+
+#include <string.h>
+
+void publish_pacer_init(publish_pacer_t *pacer, uint32_t min_interval_ms, uint32_t max_interval_ms)
+{
+    if (!pacer) {
+        return;
+    }
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->min_interval_us = min_interval_ms * 1000U;
+    pacer->max_interval_us = max_interval_ms * 1000U;
+    if (pacer->max_interval_us < pacer->min_interval_us) {
+        pacer->max_interval_us = pacer->min_interval_us;
+    }
+}
+
+bool publish_pacer_poll(publish_pacer_t *pacer, int64_t now_us, bool dirty, bool *heartbeat, int64_t *wait_us)
+{
+    if (!pacer || !heartbeat || !wait_us) {
+        return false;
+    }
+    *heartbeat = false;
+    *wait_us = 0;
+    if (!pacer->sent_once) {
+        return true;
+    }
+    int64_t elapsed = now_us - pacer->last_sent_us;
+    if (dirty) {
+        if (elapsed >= (int64_t)pacer->min_interval_us) {
+            return true;
+        }
+        if (!pacer->waiting) {
+            pacer->waiting = true;
+            ++pacer->stats.rate_limited;
+        }
+        *wait_us = (int64_t)pacer->min_interval_us - elapsed;
+        return false;
+    }
+    if (elapsed >= (int64_t)pacer->max_interval_us) {
+        *heartbeat = true;
+        return true;
+    }
+    *wait_us = (int64_t)pacer->max_interval_us - elapsed;
+    return false;
+}
+
+void publish_pacer_sent(publish_pacer_t *pacer, int64_t now_us, bool heartbeat, uint32_t latency_us)
+{
+    if (!pacer) {
+        return;
+    }
+    pacer->sent_once = true;
+    pacer->waiting = false;
+    pacer->last_sent_us = now_us;
+    ++pacer->stats.frames;
+    if (heartbeat) {
+        ++pacer->stats.heartbeats;
+        return;
+    }
+    pacer->stats.total_latency_us += latency_us;
+    if (latency_us > pacer->stats.max_latency_us) {
+        pacer->stats.max_latency_us = latency_us;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Latency runs from the moment a setter marked the model dirty to the moment the
+ * frame was handed to the transport. Heartbeats carry no change and are not timed.
+ */
+typedef struct {
+    uint32_t frames;
+    uint32_t heartbeats;
+    uint32_t rate_limited; /**< Changes that had to wait for the minimum interval. */
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+} publish_pacer_stats_t;
+
+/**
+ * Decides when the publisher sends a frame: immediately on a change, but no more
+ * often than every min interval, and at least every max interval as a heartbeat
+ * so receivers can tell a quiet node from a dead one.
+ */
+typedef struct {
+    uint32_t min_interval_us;
+    uint32_t max_interval_us;
+    int64_t last_sent_us;
+    bool sent_once;
+    bool waiting; /**< A change is held back by the minimum interval. */
+    publish_pacer_stats_t stats;
+} publish_pacer_t;
+
+void publish_pacer_init(publish_pacer_t *pacer, uint32_t min_interval_ms, uint32_t max_interval_ms);
+
+/**
+ * @brief Decide whether to send at @p now_us.
+ *
+ * @param dirty The model holds unpublished changes.
+ * @param heartbeat Set when the frame is due only because of the max interval.
+ * @param wait_us When returning false, how long the publisher may sleep unless woken.
+ * @return true when a frame should be sent now.
+ */
+bool publish_pacer_poll(publish_pacer_t *pacer, int64_t now_us, bool dirty, bool *heartbeat, int64_t *wait_us);
+
+/**
+ * @brief Record a frame sent at @p now_us; @p latency_us is ignored for heartbeats.
+ */
+void publish_pacer_sent(publish_pacer_t *pacer, int64_t now_us, bool heartbeat, uint32_t latency_us);
@@ -0,0 +1,134 @@
+#include "sensor_scheduler.h"
+
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "sensor_sched";
+
+void sensor_scheduler_init(sensor_scheduler_t *sched)
+{
+    if (sched) {
+        memset(sched, 0, sizeof(*sched));
+    }
+}
+
+/**
+ * @brief Register a channel whose first deadline is @p first_us.
+ *
+ * @return ESP_ERR_NO_MEM when all SENSOR_SCHEDULER_MAX_CHANNELS slots are in use.
+ */
+esp_err_t sensor_scheduler_add(sensor_scheduler_t *sched, const sensor_channel_t *channel, int64_t first_us,
+                               size_t *out_index)
+{
+    if (!sched || !channel || !channel->collect || channel->period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sched->count >= SENSOR_SCHEDULER_MAX_CHANNELS) {
+        return ESP_ERR_NO_MEM;
+    }
+    sensor_scheduler_slot_t *slot = &sched->slots[sched->count];
+    memset(slot, 0, sizeof(*slot));
+    slot->channel = *channel;
+    slot->deadline_us = first_us;
+    if (out_index) {
+        *out_index = sched->count;
+    }
+    ++sched->count;
+    return ESP_OK;
+}
+
+/**
+ * @brief Change a channel's period. Takes effect from the deadline after the next one.
+ */
+esp_err_t sensor_scheduler_set_period(sensor_scheduler_t *sched, size_t index, uint32_t period_us)
+{
+    if (!sched || index >= sched->count || period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sched->slots[index].channel.period_us = period_us;
+    return ESP_OK;
+}
+
+static void collect(sensor_scheduler_slot_t *slot, int64_t now_us)
+{
+    uint32_t retry_us = 0;
+    esp_err_t err = slot->channel.collect(slot->channel.ctx, now_us, slot->sample_us, &retry_us);
+    if (err == ESP_ERR_NOT_FINISHED) {
+        slot->collect_us = now_us + (retry_us > 0 ? retry_us : 1000U);
+        slot->converting = true;
+        return;
+    }
+    slot->converting = false;
+}
+
+static void dispatch(sensor_scheduler_slot_t *slot, int64_t now_us)
+{
+    sensor_channel_stats_t *stats = &slot->stats;
+    uint32_t jitter_us = (uint32_t)(now_us - slot->deadline_us);
+    if (jitter_us > stats->max_jitter_us) {
+        stats->max_jitter_us = jitter_us;
+    }
+    stats->total_jitter_us += jitter_us;
+    ++stats->dispatched;
+
+    int64_t period = slot->channel.period_us;
+    slot->deadline_us += period;
+    if (slot->deadline_us <= now_us) {
+        int64_t missed = (now_us - slot->deadline_us) / period + 1;
+        stats->overruns += (uint32_t)missed;
+        slot->deadline_us += missed * period;
+        ESP_LOGD(TAG, "%s fell %lld period(s) behind", slot->channel.name, (long long)missed);
+    }
+
+    uint32_t latency_us = slot->channel.latency_us;
+    if (slot->channel.start && slot->channel.start(slot->channel.ctx, now_us, &latency_us) != ESP_OK) {
+        ++stats->skipped;
+        return;
+    }
+    slot->sample_us = now_us;
+    if (latency_us == 0) {
+        collect(slot, now_us);
+        return;
+    }
+    slot->collect_us = now_us + latency_us;
+    slot->converting = true;
+}
+
+int64_t sensor_scheduler_run(sensor_scheduler_t *sched, int64_t now_us)
+{
+    if (!sched) {
+        return INT64_MAX;
+    }
+    int64_t wake = INT64_MAX;
+    for (size_t i = 0; i < sched->count; ++i) {
+        sensor_scheduler_slot_t *slot = &sched->slots[i];
+        if (slot->converting && now_us >= slot->collect_us) {
+            collect(slot, now_us);
+        }
+        if (!slot->converting && now_us >= slot->deadline_us) {
+            dispatch(slot, now_us);
+        }
+        int64_t due = slot->converting ? slot->collect_us : slot->deadline_us;
+        if (due < wake) {
+            wake = due;
+        }
+    }
+    return wake;
+}
+
+esp_err_t sensor_scheduler_get_stats(const sensor_scheduler_t *sched, size_t index, sensor_channel_stats_t *out)
+{
+    if (!sched || !out || index >= sched->count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = sched->slots[index].stats;
+    return ESP_OK;
+}
+
+const char *sensor_scheduler_name(const sensor_scheduler_t *sched, size_t index)
+{
+    if (!sched || index >= sched->count) {
+        return NULL;
+    }
+    return sched->slots[index].channel.name;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SENSOR_SCHEDULER_MAX_CHANNELS 8U
+
+/**
+ * Trigger a measurement. @p latency_us holds the channel's declared conversion
+ * latency and may be overridden for this sample; return an error to skip it.
+ */
+typedef esp_err_t (*sensor_channel_start_fn)(void *ctx, int64_t now_us, uint32_t *latency_us);
+
+/**
+ * Fetch the result of the measurement started at @p sample_us. Return
+ * ESP_ERR_NOT_FINISHED with @p retry_us set to be called again later.
+ */
+typedef esp_err_t (*sensor_channel_collect_fn)(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us);
+
+typedef struct {
+    const char *name;
+    uint32_t period_us;
+    uint32_t latency_us; /**< Start-to-result delay; 0 collects right after starting. */
+    sensor_channel_start_fn start; /**< Optional. */
+    sensor_channel_collect_fn collect;
+    void *ctx;
+} sensor_channel_t;
+
+/**
+ * Jitter is the lateness of each dispatch against its deadline. Overruns count
+ * deadlines dropped because the channel fell more than a whole period behind.
+ */
+typedef struct {
+    uint32_t dispatched;
+    uint32_t skipped;
+    uint32_t overruns;
+    uint32_t max_jitter_us;
+    uint64_t total_jitter_us;
+} sensor_channel_stats_t;
+
+typedef struct {
+    sensor_channel_t channel;
+    int64_t deadline_us;
+    int64_t sample_us;
+    int64_t collect_us;
+    bool converting;
+    sensor_channel_stats_t stats;
+} sensor_scheduler_slot_t;
+
+/**
+ * Deadline scheduler for sensor acquisition.
+ *
+ * Deadlines advance on a fixed grid (deadline += period), so a late dispatch does
+ * not shift later samples. A channel is not restarted while its previous result is
+ * outstanding. Channels run in registration order when due together.
+ */
+typedef struct {
+    sensor_scheduler_slot_t slots[SENSOR_SCHEDULER_MAX_CHANNELS];
+    size_t count;
+} sensor_scheduler_t;
+
+void sensor_scheduler_init(sensor_scheduler_t *sched);
+esp_err_t sensor_scheduler_add(sensor_scheduler_t *sched, const sensor_channel_t *channel, int64_t first_us,
+                               size_t *out_index);
+esp_err_t sensor_scheduler_set_period(sensor_scheduler_t *sched, size_t index, uint32_t period_us);
+
+/**
+ * @brief Collect finished conversions and start every channel whose deadline passed.
+ *
+ * @return Time the scheduler next needs to run, INT64_MAX when it has no channels.
+ */
+int64_t sensor_scheduler_run(sensor_scheduler_t *sched, int64_t now_us);
+esp_err_t sensor_scheduler_get_stats(const sensor_scheduler_t *sched, size_t index, sensor_channel_stats_t *out);
+const char *sensor_scheduler_name(const sensor_scheduler_t *sched, size_t index);
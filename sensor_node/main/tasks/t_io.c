@@ -1,16 +1,27 @@
 #include "tasks/t_io.h"
 
+#include "board_pins.h"
+#include "driver/gpio.h"
 #include "drivers/mcp23017.h"
 #include "drivers/pca9685.h"
+#include "esp_attr.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "i2c_bus.h"
+#include "io/io_batch.h"
 #include "io/io_map.h"
+#include "io/mcp_inputs.h"
 #include "sdkconfig.h"
 #include <string.h>
 
+#define IO_POLL_PERIOD_MS 50
+#define IO_NOTIFY_MCP_MASK ((1UL << MCP_INPUTS_MAX_DEVICES) - 1UL)
+#define IO_NOTIFY_COMMAND (1UL << 8)
+#define IO_STATS_PERIOD_MS 60000
+
 static const char *TAG = "t_io";
 
 typedef enum {
@@ -21,6 +32,7 @@ typedef enum {
 
 typedef struct {
     io_command_type_t type;
+    int64_t enqueued_us;
     union {
         struct {
             uint8_t channel;
@@ -37,9 +49,151 @@ typedef struct {
 } io_command_t;
 
 static QueueHandle_t s_cmd_queue;
+static TaskHandle_t s_io_task;
 static sensor_data_model_t *s_model;
 static uint16_t s_pwm[16];
 static uint16_t s_pwm_freq = 500;
+static mcp_inputs_t s_inputs;
+static io_batch_t s_batch;
+
+static const int s_mcp_int_gpio[MCP_INPUTS_MAX_DEVICES] = {SENSOR_NODE_MCP23017_INT0, SENSOR_NODE_MCP23017_INT1};
+
+static void IRAM_ATTR mcp_int_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(s_io_task, 1UL << (uint32_t)(uintptr_t)arg, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void publish_gpio(size_t index, uint16_t value, void *ctx)
+{
+    (void)ctx;
+    data_model_set_gpio(s_model, index, value & 0xFF, (value >> 8) & 0xFF);
+}
+
+/**
+ * @brief Route the INT output of each expander that has a GPIO assigned to the task.
+ *
+ * The ISR is attached before the expander is armed so an edge raised while
+ * enabling is not lost. Expanders without a GPIO, or whose setup fails, stay polled.
+ *
+ * @return true when at least one expander is interrupt-driven.
+ */
+static bool setup_mcp_interrupts(void)
+{
+    bool any = false;
+    for (size_t i = 0; i < s_inputs.count; ++i) {
+        int pin = s_mcp_int_gpio[i];
+        if (pin < 0) {
+            continue;
+        }
+        gpio_config_t cfg = {
+            .pin_bit_mask = 1ULL << pin,
+            .mode = GPIO_MODE_INPUT,
+            .pull_up_en = GPIO_PULLUP_ENABLE,
+            .intr_type = GPIO_INTR_NEGEDGE,
+        };
+        esp_err_t err = gpio_config(&cfg);
+        if (err == ESP_OK) {
+            err = gpio_install_isr_service(0);
+            if (err == ESP_ERR_INVALID_STATE) {
+                err = ESP_OK;
+            }
+        }
+        if (err == ESP_OK) {
+            err = gpio_isr_handler_add((gpio_num_t)pin, mcp_int_isr, (void *)(uintptr_t)i);
+        }
+        if (err == ESP_OK) {
+            err = mcp_inputs_enable_irq(&s_inputs, i, 0xFFFF);
+            if (err != ESP_OK) {
+                gpio_isr_handler_remove((gpio_num_t)pin);
+            }
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "MCP23017 #%u interrupt on GPIO%d unavailable (%s); polling", (unsigned)i + 1U, pin,
+                     esp_err_to_name(err));
+            continue;
+        }
+        ESP_LOGI(TAG, "MCP23017 #%u inputs interrupt-driven on GPIO%d", (unsigned)i + 1U, pin);
+        any = true;
+    }
+    return any;
+}
+
+/**
+ * @brief Apply the commands collected this tick, most urgent lane first.
+ *
+ * GPIO latches go out before anything else so an output toggle never waits behind
+ * a PWM refresh; the frequency change precedes the duty burst so new duties start
+ * on the new carrier; all duty changes then leave as one PCA9685 update. A lane
+ * whose write fails stays pending and is retried on the next flush; duties wait
+ * for a pending frequency change.
+ */
+static void flush_batch(const io_map_t *map, bool pwm_hw_available)
+{
+    if (io_batch_pending(&s_batch, IO_LANE_GPIO)) {
+        esp_err_t err = ESP_OK;
+        for (size_t i = 0; i < IO_BATCH_GPIO_DEVICES; ++i) {
+            if (s_batch.gpio_mask[i]) {
+                esp_err_t dev_err =
+                    mcp23017_write_gpio(map->mcp23017_addresses[i], s_batch.gpio_mask[i], s_batch.gpio_value[i]);
+                if (dev_err != ESP_OK) {
+                    err = dev_err;
+                }
+            }
+        }
+        if (err == ESP_OK) {
+            io_batch_complete(&s_batch, IO_LANE_GPIO, esp_timer_get_time());
+        } else {
+            io_batch_fail(&s_batch, IO_LANE_GPIO);
+        }
+    }
+
+    bool pwm_changed = false;
+    if (io_batch_pending(&s_batch, IO_LANE_PWM_FREQ)) {
+        esp_err_t err = pwm_hw_available ? pca9685_set_frequency(map->pca9685_address, s_batch.freq) : ESP_OK;
+        if (err != ESP_OK) {
+            io_batch_fail(&s_batch, IO_LANE_PWM_FREQ);
+            return;
+        }
+        s_pwm_freq = s_batch.freq;
+        io_batch_complete(&s_batch, IO_LANE_PWM_FREQ, esp_timer_get_time());
+        pwm_changed = true;
+    }
+    if (io_batch_pending(&s_batch, IO_LANE_PWM)) {
+        for (size_t ch = 0; ch < IO_BATCH_PWM_CHANNELS; ++ch) {
+            if (s_batch.pwm_mask & (1U << ch)) {
+                s_pwm[ch] = s_batch.pwm[ch];
+            }
+        }
+        esp_err_t err = pwm_hw_available ? pca9685_set_all(map->pca9685_address, s_pwm, 16) : ESP_OK;
+        if (err == ESP_OK) {
+            io_batch_complete(&s_batch, IO_LANE_PWM, esp_timer_get_time());
+            pwm_changed = true;
+        } else {
+            io_batch_fail(&s_batch, IO_LANE_PWM);
+        }
+    }
+    if (pwm_changed) {
+        data_model_set_pwm(s_model, s_pwm, 16, s_pwm_freq);
+    }
+}
+
+static void log_latency(void)
+{
+    static const char *const names[IO_LANE_COUNT] = {"gpio", "pwm_freq", "pwm"};
+    for (size_t lane = 0; lane < IO_LANE_COUNT; ++lane) {
+        const io_lane_stats_t *stats = &s_batch.stats[lane];
+        uint32_t applied = stats->commands - stats->superseded;
+        if (applied == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: %u commands (%u superseded) in %u flushes, %u failed, queue-to-bus mean %u us max %u us",
+                 names[lane], (unsigned)stats->commands, (unsigned)stats->superseded, (unsigned)stats->flushes,
+                 (unsigned)stats->errors, (unsigned)(stats->total_latency_us / applied),
+                 (unsigned)stats->max_latency_us);
+    }
+}
 
 /**
  * @brief FreeRTOS task that owns the IO expanders and PWM controller.
@@ -59,49 +213,84 @@ static void io_task(void *arg)
     }
     mcp23017_init(map->mcp23017_addresses[0], 0xFFFF, 0xFFFF);
     mcp23017_init(map->mcp23017_addresses[1], 0xFFFF, 0xFFFF);
+    mcp_inputs_init(&s_inputs, map->mcp23017_addresses, 2, publish_gpio, NULL);
+    bool any_irq = setup_mcp_interrupts();
+    bool any_polled = false;
+    for (size_t i = 0; i < s_inputs.count; ++i) {
+        any_polled |= !mcp_inputs_has_irq(&s_inputs, i);
+    }
+    data_model_set_pwm(s_model, s_pwm, 16, s_pwm_freq);
+    io_batch_init(&s_batch);
 
+    uint32_t recoveries = i2c_bus_recovery_count();
+    int64_t next_poll_us = esp_timer_get_time() + IO_POLL_PERIOD_MS * 1000LL;
+    int64_t next_fallback_us = esp_timer_get_time() + CONFIG_SENSOR_MCP23017_FALLBACK_POLL_MS * 1000LL;
+    int64_t next_stats_us = esp_timer_get_time() + IO_STATS_PERIOD_MS * 1000LL;
     while (true) {
+        uint32_t recovered = i2c_bus_recovery_count();
+        if (recovered != recoveries) {
+            /* The bus was reset under us: writes may have been lost half way. */
+            recoveries = recovered;
+            for (size_t i = 0; i < 2; ++i) {
+                mcp23017_resync(map->mcp23017_addresses[i]);
+            }
+            if (pwm_hw_available) {
+                pca9685_invalidate(map->pca9685_address);
+                pca9685_set_all(map->pca9685_address, s_pwm, 16);
+            }
+        }
+
         io_command_t cmd;
         while (xQueueReceive(s_cmd_queue, &cmd, 0) == pdPASS) {
             switch (cmd.type) {
             case IO_CMD_SET_PWM:
-                s_pwm[cmd.data.pwm.channel % 16] = cmd.data.pwm.duty;
-                if (pwm_hw_available) {
-                    pca9685_set_pwm(map->pca9685_address, cmd.data.pwm.channel % 16, cmd.data.pwm.duty);
-                }
+                io_batch_add_pwm(&s_batch, cmd.data.pwm.channel % 16, cmd.data.pwm.duty, cmd.enqueued_us);
                 break;
             case IO_CMD_SET_PWM_FREQ:
-                s_pwm_freq = cmd.data.pwm_freq;
-                if (pwm_hw_available) {
-                    pca9685_init(map->pca9685_address, s_pwm_freq);
-                    for (uint8_t i = 0; i < 16; ++i) {
-                        pca9685_set_pwm(map->pca9685_address, i, s_pwm[i]);
-                    }
-                }
+                io_batch_add_pwm_freq(&s_batch, cmd.data.pwm_freq, cmd.enqueued_us);
                 break;
             case IO_CMD_WRITE_GPIO: {
-                uint8_t idx = cmd.data.gpio.device_index % 2;
                 uint16_t mask = (uint16_t)(cmd.data.gpio.mask & 0x00FFU);
                 uint16_t value = (uint16_t)(cmd.data.gpio.value & 0x00FFU);
-                uint8_t port = cmd.data.gpio.port ? 1U : 0U;
-                if (port == 1U) {
+                if (cmd.data.gpio.port) {
                     mask <<= 8;
                     value <<= 8;
                 }
-                mcp23017_write_gpio(map->mcp23017_addresses[idx], mask, value);
+                io_batch_add_gpio(&s_batch, cmd.data.gpio.device_index % 2, mask, value, cmd.enqueued_us);
                 break;
             }
             }
         }
+        flush_batch(map, pwm_hw_available);
 
-        for (uint8_t i = 0; i < 2; ++i) {
-            uint16_t value = 0;
-            if (mcp23017_read_gpio(map->mcp23017_addresses[i], &value) == ESP_OK) {
-                data_model_set_gpio(s_model, i, value & 0xFF, (value >> 8) & 0xFF);
-            }
+        int64_t now = esp_timer_get_time();
+        if (any_polled && now >= next_poll_us) {
+            mcp_inputs_poll(&s_inputs, false);
+            next_poll_us = now + IO_POLL_PERIOD_MS * 1000LL;
+        }
+        if (any_irq && now >= next_fallback_us) {
+            mcp_inputs_poll(&s_inputs, true);
+            next_fallback_us = now + CONFIG_SENSOR_MCP23017_FALLBACK_POLL_MS * 1000LL;
+        }
+        if (now >= next_stats_us) {
+            log_latency();
+            next_stats_us = now + IO_STATS_PERIOD_MS * 1000LL;
+        }
+
+        /* Sleep until an input edge, a queued command or the next poll. */
+        int64_t wake_us = next_stats_us;
+        if (any_polled && next_poll_us < wake_us) {
+            wake_us = next_poll_us;
+        }
+        if (any_irq && next_fallback_us < wake_us) {
+            wake_us = next_fallback_us;
+        }
+        int64_t wait_us = wake_us - esp_timer_get_time();
+        TickType_t wait = wait_us > 0 ? pdMS_TO_TICKS((uint32_t)((wait_us + 999) / 1000)) : 0;
+        uint32_t bits = 0;
+        if (xTaskNotifyWait(0, UINT32_MAX, &bits, wait) == pdTRUE && (bits & IO_NOTIFY_MCP_MASK)) {
+            mcp_inputs_on_interrupt(&s_inputs, bits & IO_NOTIFY_MCP_MASK);
         }
-        data_model_set_pwm(s_model, s_pwm, 16, s_pwm_freq);
-        vTaskDelay(pdMS_TO_TICKS(50));
     }
 }
 
@@ -116,7 +305,19 @@ void io_task_start(sensor_data_model_t *model)
     s_model = model;
     memset(s_pwm, 0, sizeof(s_pwm));
     s_cmd_queue = xQueueCreate(16, sizeof(io_command_t));
-    xTaskCreatePinnedToCore(io_task, "t_io", 4096, NULL, 5, NULL, 1);
+    xTaskCreatePinnedToCore(io_task, "t_io", 4096, NULL, 5, &s_io_task, 1);
+}
+
+static bool io_task_enqueue(io_command_t *cmd)
+{
+    cmd->enqueued_us = esp_timer_get_time();
+    if (xQueueSend(s_cmd_queue, cmd, pdMS_TO_TICKS(20)) != pdPASS) {
+        return false;
+    }
+    if (s_io_task) {
+        xTaskNotify(s_io_task, IO_NOTIFY_COMMAND, eSetBits);
+    }
+    return true;
 }
 
 /**
@@ -135,7 +336,7 @@ bool io_task_set_pwm(uint8_t channel, uint16_t duty)
             .duty = duty,
         },
     };
-    return xQueueSend(s_cmd_queue, &cmd, pdMS_TO_TICKS(20)) == pdPASS;
+    return io_task_enqueue(&cmd);
 }
 
 /**
@@ -150,7 +351,7 @@ bool io_task_set_pwm_frequency(uint16_t frequency_hz)
         .type = IO_CMD_SET_PWM_FREQ,
         .data.pwm_freq = frequency_hz,
     };
-    return xQueueSend(s_cmd_queue, &cmd, pdMS_TO_TICKS(20)) == pdPASS;
+    return io_task_enqueue(&cmd);
 }
 
 /**
@@ -173,5 +374,5 @@ bool io_task_write_gpio(uint8_t device_index, uint8_t port, uint16_t mask, uint1
             .value = value,
         },
     };
-    return xQueueSend(s_cmd_queue, &cmd, pdMS_TO_TICKS(20)) == pdPASS;
+    return io_task_enqueue(&cmd);
 }
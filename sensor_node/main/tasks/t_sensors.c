@@ -1,9 +1,9 @@
 #include "tasks/t_sensors.h"
 
 #include "drivers/ds18b20.h"
+#include "ds18b20_adaptive.h"
 #if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
 #include "drivers/sht20.h"
-#include "drivers/tca9548a.h"
 #endif
 #if CONFIG_SENSOR_AMBIENT_SENSOR_BME280
 #include "drivers/bme280.h"
@@ -11,31 +11,55 @@
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "i2c_bus.h"
+#include "i2c_mux.h"
 #include "io/io_map.h"
 #include "onewire_bus_manager.h"
+#include "sensor_scheduler.h"
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-#define SENSOR_TASK_PERIOD_MS 200
+#define AMBIENT_PERIOD_MS 200
 #define DS18B20_RESOLUTION_BITS 12
+#define DS18B20_MAX_PROBES 4
 #define DS18B20_SCAN_INTERVAL_MS 60000
+#define SENSOR_JITTER_REPORT_MS 60000
 #define AMBIENT_EMA_ALPHA 0.25f
 
+/**
+ * Each probe is its own scheduler channel whose period follows the conversion time
+ * of the resolution its rate of change calls for, so a fast 9-bit probe is read
+ * several times while a stable one completes a single 12-bit conversion.
+ */
+typedef struct {
+    ds18b20_adaptive_t adaptive;
+    uint8_t applied_bits; /**< Resolution in the probe's scratchpad, 0 when unknown. */
+    bool pending;         /**< A conversion is running, possibly started by another probe. */
+    size_t channel;
+} ds18b20_probe_t;
+
 typedef struct {
     sensor_data_model_t *model;
     onewire_bus_handle_t bus;
-    onewire_device_t ds_devices[4];
+    onewire_device_t ds_devices[DS18B20_MAX_PROBES];
+    ds18b20_probe_t ds_probes[DS18B20_MAX_PROBES];
     size_t ds_count;
-    bool ds_conversion_pending;
-    TickType_t ds_ready_tick;
-    TickType_t next_ds_scan_tick;
     size_t ambient_count;
     float ambient_temp_ema[IO_MAX_AMBIENT_SENSORS];
     float ambient_hum_ema[IO_MAX_AMBIENT_SENSORS];
     bool ambient_initialized[IO_MAX_AMBIENT_SENSORS];
+#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
+    sht20_measurement_t sht20[IO_MAX_AMBIENT_SENSORS];
+    bool sht20_pending[IO_MAX_AMBIENT_SENSORS];
+    size_t sht20_remaining;
+#endif
+    sensor_scheduler_t sched;
+    uint32_t i2c_recoveries; /**< Bus recoveries already reflected in the mux cache. */
 } sensors_task_ctx_t;
 
 static const char *TAG = "t_sensors";
@@ -61,19 +85,39 @@ static float ema_update(float prev, float sample, bool *initialized)
     return prev + AMBIENT_EMA_ALPHA * (sample - prev);
 }
 
+static i2c_mux_route_t ambient_route(const io_ambient_sensor_t *sensor)
+{
+    i2c_mux_route_t route = {.mux_address = 0, .channel = I2C_MUX_CHANNEL_NONE};
+    if (sensor->mux_channel != IO_MUX_CHANNEL_NONE && sensor->mux_address != 0) {
+        route.mux_address = sensor->mux_address;
+        route.channel = sensor->mux_channel;
+    }
+    return route;
+}
+
 static esp_err_t select_ambient_channel(const io_ambient_sensor_t *sensor)
 {
     if (!sensor) {
         return ESP_ERR_INVALID_ARG;
     }
-    if (sensor->mux_channel == IO_MUX_CHANNEL_NONE || sensor->mux_address == 0) {
-        return ESP_OK;
+    i2c_mux_route_t route = ambient_route(sensor);
+    return i2c_mux_select(&route);
+}
+
+static void ambient_transaction_failed(const io_ambient_sensor_t *sensor)
+{
+    i2c_mux_route_t route = ambient_route(sensor);
+    i2c_mux_route_failed(&route);
+}
+
+/* A bus recovery may have reset the multiplexers under the cached channel state. */
+static void sync_mux_cache(void)
+{
+    uint32_t recoveries = i2c_bus_recovery_count();
+    if (recoveries != s_ctx.i2c_recoveries) {
+        s_ctx.i2c_recoveries = recoveries;
+        i2c_mux_invalidate();
     }
-#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20 || CONFIG_SENSOR_AMBIENT_SENSOR_BME280
-    return tca9548a_select(sensor->mux_address, sensor->mux_channel);
-#else
-    return ESP_OK;
-#endif
 }
 
 static const char *ambient_sensor_name(io_ambient_sensor_type_t type)
@@ -96,14 +140,18 @@ static esp_err_t ambient_sensor_init(const io_ambient_sensor_t *sensor)
     switch (sensor->type) {
     case IO_AMBIENT_SENSOR_SHT20:
 #if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
-        return select_ambient_channel(sensor);
+        return ESP_OK;
 #else
         return ESP_ERR_NOT_SUPPORTED;
 #endif
     case IO_AMBIENT_SENSOR_BME280:
 #if CONFIG_SENSOR_AMBIENT_SENSOR_BME280
         ESP_RETURN_ON_ERROR(select_ambient_channel(sensor), TAG, "mux select");
-        return bme280_init(sensor->address);
+        esp_err_t err = bme280_init(sensor->address, AMBIENT_PERIOD_MS);
+        if (err != ESP_OK) {
+            ambient_transaction_failed(sensor);
+        }
+        return err;
 #else
         return ESP_ERR_NOT_SUPPORTED;
 #endif
@@ -112,23 +160,21 @@ static esp_err_t ambient_sensor_init(const io_ambient_sensor_t *sensor)
     }
 }
 
-static esp_err_t ambient_sensor_read(const io_ambient_sensor_t *sensor, float *temp, float *humidity)
+static esp_err_t ambient_sensor_read(const io_ambient_sensor_t *sensor, float *temp, float *humidity,
+                                     float *pressure)
 {
-    if (!sensor || !temp || !humidity) {
+    if (!sensor || !temp || !humidity || !pressure) {
         return ESP_ERR_INVALID_ARG;
     }
     switch (sensor->type) {
-    case IO_AMBIENT_SENSOR_SHT20:
-#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
-        ESP_RETURN_ON_ERROR(select_ambient_channel(sensor), TAG, "mux select");
-        return sht20_read_temperature_humidity(sensor->address, temp, humidity);
-#else
-        return ESP_ERR_NOT_SUPPORTED;
-#endif
     case IO_AMBIENT_SENSOR_BME280:
 #if CONFIG_SENSOR_AMBIENT_SENSOR_BME280
         ESP_RETURN_ON_ERROR(select_ambient_channel(sensor), TAG, "mux select");
-        return bme280_read(sensor->address, temp, humidity, NULL);
+        esp_err_t err = bme280_read(sensor->address, temp, humidity, pressure);
+        if (err != ESP_OK) {
+            ambient_transaction_failed(sensor);
+        }
+        return err;
 #else
         return ESP_ERR_NOT_SUPPORTED;
 #endif
@@ -137,19 +183,127 @@ static esp_err_t ambient_sensor_read(const io_ambient_sensor_t *sensor, float *t
     }
 }
 
+#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
 /**
- * @brief Refresh cached ambient measurements and publish them to the data model.
+ * @brief Advance every SHT20 measurement that is due, without waiting.
  *
- * @return void
+ * Work that is due together is ordered by mux channel so the active channel is
+ * drained first.
+ *
+ * @return Time the next pending measurement becomes due, INT64_MAX when all are done.
+ */
+static int64_t service_sht20(int64_t now)
+{
+    const io_map_t *map = io_map_get();
+    size_t due[IO_MAX_AMBIENT_SENSORS];
+    i2c_mux_route_t routes[IO_MAX_AMBIENT_SENSORS];
+    size_t order[IO_MAX_AMBIENT_SENSORS];
+    size_t due_count = 0;
+    for (size_t i = 0; i < s_ctx.ambient_count; ++i) {
+        if (s_ctx.sht20_pending[i] && now >= s_ctx.sht20[i].ready_us) {
+            routes[due_count] = ambient_route(&map->ambient[i]);
+            due[due_count++] = i;
+        }
+    }
+    i2c_mux_order(routes, due_count, order);
+    for (size_t k = 0; k < due_count; ++k) {
+        size_t i = due[order[k]];
+        esp_err_t err = i2c_mux_select(&routes[order[k]]);
+        if (err == ESP_OK) {
+            uint8_t attempts = s_ctx.sht20[i].attempts;
+            err = sht20_measurement_step(&s_ctx.sht20[i], esp_timer_get_time());
+            /* A failed transfer is retried after a backoff: make sure the retry is routed afresh. */
+            if (s_ctx.sht20[i].attempts > attempts || (err != ESP_OK && err != ESP_ERR_NOT_FINISHED)) {
+                i2c_mux_route_failed(&routes[order[k]]);
+            }
+        } else {
+            s_ctx.sht20[i].last_err = err;
+        }
+        if (err != ESP_ERR_NOT_FINISHED) {
+            s_ctx.sht20_pending[i] = false;
+            --s_ctx.sht20_remaining;
+        }
+    }
+    int64_t next_ready = INT64_MAX;
+    for (size_t i = 0; i < s_ctx.ambient_count; ++i) {
+        if (s_ctx.sht20_pending[i] && s_ctx.sht20[i].ready_us < next_ready) {
+            next_ready = s_ctx.sht20[i].ready_us;
+        }
+    }
+    return next_ready;
+}
+#endif
+
+/**
+ * @brief Scheduler start hook for the ambient channel.
+ *
+ * Every SHT20 is triggered back to back so the acquisition window is one
+ * temperature plus one humidity conversion regardless of the number of sensors.
+ * The reported latency is the time until the first conversion completes.
+ */
+static esp_err_t ambient_start(void *ctx, int64_t now_us, uint32_t *latency_us)
+{
+    (void)ctx;
+    *latency_us = 0;
+    sync_mux_cache();
+#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
+    const io_map_t *map = io_map_get();
+    s_ctx.sht20_remaining = 0;
+    for (size_t i = 0; i < s_ctx.ambient_count; ++i) {
+        s_ctx.sht20_pending[i] = (map->ambient[i].type == IO_AMBIENT_SENSOR_SHT20);
+        if (s_ctx.sht20_pending[i]) {
+            sht20_measurement_begin(&s_ctx.sht20[i], map->ambient[i].address, now_us);
+            ++s_ctx.sht20_remaining;
+        }
+    }
+    int64_t next_ready = service_sht20(now_us);
+    if (next_ready != INT64_MAX && next_ready > now_us) {
+        *latency_us = (uint32_t)(next_ready - now_us);
+    }
+#else
+    (void)now_us;
+#endif
+    return ESP_OK;
+}
+
+/**
+ * @brief Scheduler collect hook for the ambient channel.
+ *
+ * Steps pending SHT20 conversions until all have finished, then reads the other
+ * ambient sensors and publishes every entry stamped with the cycle's start time.
  */
-static void update_ambient_readings(void)
+static esp_err_t ambient_collect(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us)
 {
+    (void)ctx;
     const io_map_t *map = io_map_get();
+#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
+    int64_t next_ready = service_sht20(now_us);
+    if (s_ctx.sht20_remaining > 0) {
+        int64_t wait_us = next_ready - esp_timer_get_time();
+        *retry_us = wait_us > 0 ? (uint32_t)wait_us : 0;
+        return ESP_ERR_NOT_FINISHED;
+    }
+#else
+    (void)now_us;
+    (void)retry_us;
+#endif
+    uint32_t sample_ms = (uint32_t)(sample_us / 1000);
     for (size_t i = 0; i < s_ctx.ambient_count && i < IO_MAX_AMBIENT_SENSORS; ++i) {
         const io_ambient_sensor_t *sensor = &map->ambient[i];
         float temp = 0.0f;
         float hum = 0.0f;
-        esp_err_t err = ambient_sensor_read(sensor, &temp, &hum);
+        float pressure = 0.0f;
+        esp_err_t err;
+#if CONFIG_SENSOR_AMBIENT_SENSOR_SHT20
+        if (sensor->type == IO_AMBIENT_SENSOR_SHT20) {
+            err = s_ctx.sht20[i].last_err;
+            temp = s_ctx.sht20[i].temperature_c;
+            hum = s_ctx.sht20[i].humidity;
+        } else
+#endif
+        {
+            err = ambient_sensor_read(sensor, &temp, &hum, &pressure);
+        }
         bool valid = (err == ESP_OK);
         if (!valid) {
             ESP_LOGW(TAG, "%s %zu read failed: %s", ambient_sensor_name(sensor->type), i, esp_err_to_name(err));
@@ -168,105 +322,229 @@ static void update_ambient_readings(void)
 
         char id[16];
         snprintf(id, sizeof(id), "%s_%u", ambient_sensor_name(sensor->type), (unsigned)i + 1U);
-        data_model_set_sht20(s_ctx.model, i, id, filtered_temp, filtered_hum, valid);
+        data_model_set_sht20(s_ctx.model, i, id, filtered_temp, filtered_hum, valid, sample_ms);
+        if (valid && pressure > 0.0f) {
+            data_model_set_pressure(s_ctx.model, i, pressure);
+        }
     }
+    return ESP_OK;
 }
 
+#if CONFIG_SENSOR_DS18B20_ADAPTIVE_RESOLUTION
+_Static_assert(CONFIG_SENSOR_DS18B20_FAST_RATE_MC > CONFIG_SENSOR_DS18B20_MODERATE_RATE_MC,
+               "CONFIG_SENSOR_DS18B20_FAST_RATE_MC must exceed CONFIG_SENSOR_DS18B20_MODERATE_RATE_MC");
+static const ds18b20_adaptive_config_t s_ds_adaptive = {
+    .fast_mc_per_s = CONFIG_SENSOR_DS18B20_FAST_RATE_MC,
+    .moderate_mc_per_s = CONFIG_SENSOR_DS18B20_MODERATE_RATE_MC,
+    .settle_samples = CONFIG_SENSOR_DS18B20_SETTLE_SAMPLES,
+};
+#endif
+
 /**
- * @brief Scan the 1-Wire bus to maintain the list of DS18B20 sensors.
+ * @brief Scheduler hook rescanning the 1-Wire bus for DS18B20 sensors.
  *
- * @return void
+ * Probes already known keep their adaptive state. New probes have their default
+ * resolution verified and, when it differs, persisted to EEPROM once; later
+ * resolution changes only touch the scratchpad.
  */
-static void ensure_ds18b20_devices(void)
+static esp_err_t ds18b20_scan_collect(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us)
 {
-    TickType_t now = xTaskGetTickCount();
-    if (s_ctx.ds_count > 0 && now < s_ctx.next_ds_scan_tick) {
-        return;
-    }
+    (void)ctx;
+    (void)now_us;
+    (void)sample_us;
+    (void)retry_us;
+    onewire_device_t found[DS18B20_MAX_PROBES];
     size_t count = 0;
-    esp_err_t err = onewire_bus_scan(s_ctx.bus, s_ctx.ds_devices, 4, &count);
-    if (err == ESP_OK) {
-        if (count == 0) {
-            ESP_LOGW(TAG, "No DS18B20 sensors discovered on last scan");
-        } else if (count != s_ctx.ds_count) {
-            ESP_LOGI(TAG, "Discovered %u DS18B20 sensors", (unsigned)count);
-        }
-        s_ctx.ds_count = count;
-    } else {
+    esp_err_t err = onewire_bus_scan(s_ctx.bus, found, DS18B20_MAX_PROBES, &count);
+    if (err != ESP_OK) {
         ESP_LOGE(TAG, "1-Wire scan failed: %s", esp_err_to_name(err));
+        return err;
     }
-    s_ctx.next_ds_scan_tick = now + pdMS_TO_TICKS(DS18B20_SCAN_INTERVAL_MS);
+    if (count == 0) {
+        ESP_LOGW(TAG, "No DS18B20 sensors discovered on last scan");
+    } else if (count != s_ctx.ds_count) {
+        ESP_LOGI(TAG, "Discovered %u DS18B20 sensors", (unsigned)count);
+    }
+    ds18b20_probe_t probes[DS18B20_MAX_PROBES];
+    for (size_t i = 0; i < count; ++i) {
+        size_t known = 0;
+        while (known < s_ctx.ds_count &&
+               memcmp(s_ctx.ds_devices[known].rom_code, found[i].rom_code, sizeof(found[i].rom_code)) != 0) {
+            ++known;
+        }
+        if (known < s_ctx.ds_count) {
+            probes[i] = s_ctx.ds_probes[known];
+        } else {
+            memset(&probes[i], 0, sizeof(probes[i]));
+            ds18b20_adaptive_init(&probes[i].adaptive);
+            esp_err_t cfg_err = ds18b20_configure(s_ctx.bus, &found[i], DS18B20_RESOLUTION_BITS, true);
+            if (cfg_err == ESP_OK) {
+                probes[i].applied_bits = DS18B20_RESOLUTION_BITS;
+            } else {
+                ESP_LOGW(TAG, "DS18B20[%u] configuration failed: %s", (unsigned)i, esp_err_to_name(cfg_err));
+            }
+        }
+        /* Channels are bound to slots, not probes. */
+        probes[i].channel = s_ctx.ds_probes[i].channel;
+    }
+    memcpy(s_ctx.ds_devices, found, count * sizeof(found[0]));
+    memcpy(s_ctx.ds_probes, probes, count * sizeof(probes[0]));
+    s_ctx.ds_count = count;
+    return ESP_OK;
 }
 
 /**
- * @brief Start a new conversion on the discovered DS18B20 devices.
+ * @brief Scheduler start hook for one DS18B20 probe.
  *
- * @return void
+ * The probe is reconfigured first when its policy asks for a new resolution. When
+ * every probe is idle at the same resolution a single skip-ROM command starts them
+ * all and the other probes' start hooks find their conversion already running;
+ * otherwise the probe is addressed alone so in-flight conversions are not restarted.
  */
-static void kick_ds18b20_conversion(void)
+static esp_err_t ds18b20_probe_start(void *ctx, int64_t now_us, uint32_t *latency_us)
 {
-    if (s_ctx.ds_count == 0 || s_ctx.ds_conversion_pending) {
-        return;
+    (void)now_us;
+    size_t index = (size_t)(uintptr_t)ctx;
+    if (index >= s_ctx.ds_count) {
+        return ESP_ERR_NOT_FOUND;
     }
-    esp_err_t err =
-        ds18b20_start_conversion(s_ctx.bus, s_ctx.ds_devices, s_ctx.ds_count, DS18B20_RESOLUTION_BITS);
-    if (err == ESP_OK) {
-        uint32_t wait_ms = ds18b20_conversion_time_ms(DS18B20_RESOLUTION_BITS);
-        s_ctx.ds_ready_tick = xTaskGetTickCount() + pdMS_TO_TICKS(wait_ms);
-        s_ctx.ds_conversion_pending = true;
-    } else {
-        ESP_LOGE(TAG, "Failed to start DS18B20 conversion: %s", esp_err_to_name(err));
+    ds18b20_probe_t *probe = &s_ctx.ds_probes[index];
+    if (!probe->pending) {
+        uint8_t bits = probe->adaptive.resolution_bits;
+        if (bits != probe->applied_bits) {
+            esp_err_t err = ds18b20_configure(s_ctx.bus, &s_ctx.ds_devices[index], bits, false);
+            probe->applied_bits = (err == ESP_OK) ? bits : 0;
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "DS18B20[%u] resolution change failed: %s", (unsigned)index, esp_err_to_name(err));
+            }
+        }
+        bool group = s_ctx.ds_count > 1;
+        for (size_t i = 0; i < s_ctx.ds_count && group; ++i) {
+            group = !s_ctx.ds_probes[i].pending && s_ctx.ds_probes[i].applied_bits == probe->applied_bits;
+        }
+        esp_err_t err = ds18b20_start_conversion(s_ctx.bus, group ? NULL : &s_ctx.ds_devices[index]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start DS18B20 conversion: %s", esp_err_to_name(err));
+            return err;
+        }
+        for (size_t i = 0; i < s_ctx.ds_count; ++i) {
+            if (group || i == index) {
+                s_ctx.ds_probes[i].pending = true;
+            }
+        }
     }
+    /* An unknown resolution may still be 12 bit; wait the worst case. */
+    uint8_t bits = probe->applied_bits ? probe->applied_bits : DS18B20_ADAPTIVE_MAX_BITS;
+    *latency_us = ds18b20_conversion_time_ms(bits) * 1000U;
+    return ESP_OK;
 }
 
 /**
- * @brief Check whether the pending DS18B20 conversion finished.
- *
- * @return true if the conversion is complete, false otherwise.
+ * @brief Scheduler collect hook reading one DS18B20 probe.
  */
-static bool ds18b20_conversion_complete(void)
+static esp_err_t ds18b20_probe_collect(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us)
 {
-    if (!s_ctx.ds_conversion_pending) {
-        return false;
+    (void)retry_us;
+    size_t index = (size_t)(uintptr_t)ctx;
+    if (index >= s_ctx.ds_count) {
+        return ESP_ERR_NOT_FOUND;
     }
-    TickType_t now = xTaskGetTickCount();
-    if ((int32_t)(now - s_ctx.ds_ready_tick) >= 0) {
-        return true;
+    ds18b20_probe_t *probe = &s_ctx.ds_probes[index];
+    float temp = 0.0f;
+    esp_err_t err = ds18b20_read_temperature(s_ctx.bus, &s_ctx.ds_devices[index], &temp);
+    if (err == ESP_ERR_INVALID_CRC) {
+        /* The scratchpad holds its value until the next conversion; a re-read is safe. */
+        err = ds18b20_read_temperature(s_ctx.bus, &s_ctx.ds_devices[index], &temp);
     }
-    bool ready = false;
-    if (ds18b20_check_conversion(s_ctx.bus, &ready) == ESP_OK) {
-        return ready;
+    if (err == ESP_OK) {
+#if CONFIG_SENSOR_DS18B20_ADAPTIVE_RESOLUTION
+        uint8_t bits = ds18b20_adaptive_update(&probe->adaptive, &s_ds_adaptive, temp, now_us);
+        sensor_scheduler_set_period(&s_ctx.sched, probe->channel, ds18b20_conversion_time_ms(bits) * 1000U);
+#else
+        (void)now_us;
+#endif
+    } else {
+        ESP_LOGW(TAG, "DS18B20[%zu] read failed: %s, falling back to synthetic data", index,
+                 esp_err_to_name(err));
+        TickType_t ticks = xTaskGetTickCount();
+        temp = 21.0f + 0.5f * sinf((float)ticks / 1200.0f + (float)index);
     }
-    return false;
+    data_model_set_ds18b20(s_ctx.model, index, &s_ctx.ds_devices[index], temp, (uint32_t)(sample_us / 1000));
+    probe->pending = false;
+    return ESP_OK;
 }
 
 /**
- * @brief Read temperatures from DS18B20 sensors and update the data model.
+ * @brief Scheduler hook logging dispatch jitter for every channel.
+ */
+static esp_err_t jitter_report_collect(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us)
+{
+    (void)ctx;
+    (void)now_us;
+    (void)sample_us;
+    (void)retry_us;
+    for (size_t i = 0; i < s_ctx.sched.count; ++i) {
+        sensor_channel_stats_t stats;
+        if (sensor_scheduler_get_stats(&s_ctx.sched, i, &stats) != ESP_OK || stats.dispatched == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%s: %u dispatches, jitter mean %u us max %u us, %u skipped, %u overruns",
+                 sensor_scheduler_name(&s_ctx.sched, i), (unsigned)stats.dispatched,
+                 (unsigned)(stats.total_jitter_us / stats.dispatched), (unsigned)stats.max_jitter_us,
+                 (unsigned)stats.skipped, (unsigned)stats.overruns);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Declare every acquisition channel with its period and conversion latency.
  *
- * @return void
+ * Registration order is dispatch priority: the bus scan runs first so probes exist
+ * before their channels fire.
  */
-static void read_ds18b20_temperatures(void)
+static void register_channels(int64_t now_us)
 {
-    if (!ds18b20_conversion_complete()) {
-        return;
+    static const char *const probe_names[DS18B20_MAX_PROBES] = {"ds18b20_0", "ds18b20_1", "ds18b20_2",
+                                                                 "ds18b20_3"};
+    const sensor_channel_t scan = {
+        .name = "ds18b20_scan",
+        .period_us = DS18B20_SCAN_INTERVAL_MS * 1000U,
+        .collect = ds18b20_scan_collect,
+    };
+    ESP_ERROR_CHECK(sensor_scheduler_add(&s_ctx.sched, &scan, now_us, NULL));
+    if (s_ctx.ambient_count > 0) {
+        const sensor_channel_t ambient = {
+            .name = "ambient",
+            .period_us = AMBIENT_PERIOD_MS * 1000U,
+            .start = ambient_start,
+            .collect = ambient_collect,
+        };
+        ESP_ERROR_CHECK(sensor_scheduler_add(&s_ctx.sched, &ambient, now_us, NULL));
     }
-    for (size_t i = 0; i < s_ctx.ds_count && i < 4; ++i) {
-        float temp = 0.0f;
-        esp_err_t err = ds18b20_read_temperature(s_ctx.bus, &s_ctx.ds_devices[i], &temp);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "DS18B20[%zu] read failed: %s, falling back to synthetic data", i,
-                     esp_err_to_name(err));
-            TickType_t ticks = xTaskGetTickCount();
-            temp = 21.0f + 0.5f * sinf((float)ticks / 1200.0f + (float)i);
-        }
-        data_model_set_ds18b20(s_ctx.model, i, &s_ctx.ds_devices[i], temp);
+    for (size_t i = 0; i < DS18B20_MAX_PROBES; ++i) {
+        const sensor_channel_t probe = {
+            .name = probe_names[i],
+            .period_us = ds18b20_conversion_time_ms(DS18B20_RESOLUTION_BITS) * 1000U,
+            .latency_us = ds18b20_conversion_time_ms(DS18B20_RESOLUTION_BITS) * 1000U,
+            .start = ds18b20_probe_start,
+            .collect = ds18b20_probe_collect,
+            .ctx = (void *)(uintptr_t)i,
+        };
+        ESP_ERROR_CHECK(sensor_scheduler_add(&s_ctx.sched, &probe, now_us, &s_ctx.ds_probes[i].channel));
     }
-    s_ctx.ds_conversion_pending = false;
+    const sensor_channel_t report = {
+        .name = "jitter_report",
+        .period_us = SENSOR_JITTER_REPORT_MS * 1000U,
+        .collect = jitter_report_collect,
+    };
+    ESP_ERROR_CHECK(sensor_scheduler_add(&s_ctx.sched, &report, now_us + report.period_us, NULL));
 }
 
 /**
  * @brief FreeRTOS task body responsible for periodic sensor acquisition.
  *
+ * The task only sleeps until the scheduler's next deadline or pending result.
+ *
  * @param arg Unused task argument.
  * @return void
  */
@@ -286,18 +564,16 @@ static void sensors_task(void *arg)
         }
     }
     s_ctx.ds_count = 0;
-    s_ctx.ds_conversion_pending = false;
-    s_ctx.next_ds_scan_tick = xTaskGetTickCount();
-
-    ensure_ds18b20_devices();
-    kick_ds18b20_conversion();
+    sensor_scheduler_init(&s_ctx.sched);
+    register_channels(esp_timer_get_time());
 
     while (true) {
-        update_ambient_readings();
-        ensure_ds18b20_devices();
-        read_ds18b20_temperatures();
-        kick_ds18b20_conversion();
-        vTaskDelay(pdMS_TO_TICKS(SENSOR_TASK_PERIOD_MS));
+        int64_t wake_us = sensor_scheduler_run(&s_ctx.sched, esp_timer_get_time());
+        int64_t wait_us = wake_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            TickType_t ticks = pdMS_TO_TICKS((uint32_t)((wait_us + 999) / 1000));
+            vTaskDelay(ticks > 0 ? ticks : 1);
+        }
     }
 }
 
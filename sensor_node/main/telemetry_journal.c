@@ -0,0 +1,357 @@
+#include "telemetry_journal.h"
+
+#include "common/proto/proto_crc32.h"
+#include <string.h>
+
+#define RECORD_UNREAD 0xFFFFFFFFU
+#define RECORD_BLANK_LEN 0xFFFFU
+
+typedef enum {
+    RECORD_OK,
+    RECORD_END, /**< Erased flash or no room for another header: nothing more in this sector. */
+    RECORD_BAD, /**< Header cannot be trusted; the rest of the sector is unreadable. */
+} record_status_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t len_inv;
+    uint32_t crc;
+    uint32_t state; /**< RECORD_UNREAD until replayed, then cleared in place. */
+} record_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t seq_inv;
+} sector_header_t;
+
+_Static_assert(sizeof(record_header_t) == TELEMETRY_JOURNAL_RECORD_HEADER, "record header layout");
+_Static_assert(sizeof(sector_header_t) == TELEMETRY_JOURNAL_SECTOR_HEADER, "sector header layout");
+
+static size_t record_size(size_t len)
+{
+    return TELEMETRY_JOURNAL_RECORD_HEADER + ((len + 3U) & ~(size_t)3U);
+}
+
+static size_t sector_base(const telemetry_journal_t *journal, uint32_t sector)
+{
+    return (size_t)sector * journal->flash.sector_size;
+}
+
+static esp_err_t flash_write(telemetry_journal_t *journal, size_t offset, const void *src, size_t len)
+{
+    journal->stats.bytes_written += len;
+    return journal->flash.write(journal->flash.ctx, offset, src, len);
+}
+
+static bool sector_valid(const telemetry_journal_t *journal, uint32_t sector, uint32_t *seq)
+{
+    sector_header_t header;
+    if (journal->flash.read(journal->flash.ctx, sector_base(journal, sector), &header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    if (header.magic != TELEMETRY_JOURNAL_SECTOR_MAGIC || header.seq != (uint32_t)~header.seq_inv) {
+        return false;
+    }
+    if (seq) {
+        *seq = header.seq;
+    }
+    return true;
+}
+
+static record_status_t record_at(const telemetry_journal_t *journal, uint32_t sector, size_t offset,
+                                 record_header_t *out)
+{
+    size_t sector_size = journal->flash.sector_size;
+    if (offset + TELEMETRY_JOURNAL_RECORD_HEADER > sector_size) {
+        return RECORD_END;
+    }
+    if (journal->flash.read(journal->flash.ctx, sector_base(journal, sector) + offset, out, sizeof(*out)) != ESP_OK) {
+        return RECORD_BAD;
+    }
+    if (out->len == RECORD_BLANK_LEN && out->len_inv == RECORD_BLANK_LEN) {
+        return RECORD_END;
+    }
+    if ((uint16_t)(out->len ^ out->len_inv) != 0xFFFFU || out->len == 0 || offset + record_size(out->len) > sector_size) {
+        return RECORD_BAD;
+    }
+    return RECORD_OK;
+}
+
+static bool payload_intact(const telemetry_journal_t *journal, uint32_t sector, size_t offset,
+                           const record_header_t *header, uint8_t *scratch)
+{
+    size_t at = sector_base(journal, sector) + offset + TELEMETRY_JOURNAL_RECORD_HEADER;
+    if (journal->flash.read(journal->flash.ctx, at, scratch, header->len) != ESP_OK) {
+        return false;
+    }
+    return proto_crc32(scratch, header->len) == header->crc;
+}
+
+/**
+ * Find the end of the intact records in the head sector. Only this sector can hold a
+ * torn write, so its payloads are CRC-checked; the batch buffer serves as scratch
+ * since it is empty at mount.
+ *
+ * @return true when the sector ends cleanly in erased flash.
+ */
+static bool recover_head_end(telemetry_journal_t *journal, size_t *end)
+{
+    size_t offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+    record_header_t header;
+    while (true) {
+        record_status_t status = record_at(journal, journal->head, offset, &header);
+        *end = offset;
+        if (status == RECORD_END) {
+            return true;
+        }
+        if (status == RECORD_BAD || header.len > journal->batch_cap ||
+            !payload_intact(journal, journal->head, offset, &header, journal->batch)) {
+            /* Counted as corrupt when the reader reaches it. */
+            return false;
+        }
+        offset += record_size(header.len);
+    }
+}
+
+/** Count unread records of @p sector in [@p offset, @p end); the first one's offset goes to @p first. */
+static uint32_t count_unread(const telemetry_journal_t *journal, uint32_t sector, size_t offset, size_t end,
+                             size_t *first)
+{
+    uint32_t unread = 0;
+    record_header_t header;
+    while (offset < end && record_at(journal, sector, offset, &header) == RECORD_OK) {
+        if (header.state == RECORD_UNREAD) {
+            if (unread == 0 && first) {
+                *first = offset;
+            }
+            ++unread;
+        }
+        offset += record_size(header.len);
+    }
+    return unread;
+}
+
+esp_err_t telemetry_journal_mount(telemetry_journal_t *journal, const telemetry_journal_flash_t *flash,
+                                  uint8_t *batch, size_t batch_cap)
+{
+    if (!journal || !flash || !flash->read || !flash->write || !flash->erase || !batch ||
+        flash->sector_size == 0 || flash->size % flash->sector_size != 0 ||
+        flash->size / flash->sector_size < TELEMETRY_JOURNAL_MIN_SECTORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (batch_cap < record_size(1) || batch_cap > flash->sector_size - TELEMETRY_JOURNAL_SECTOR_HEADER) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(journal, 0, sizeof(*journal));
+    journal->flash = *flash;
+    journal->sectors = (uint32_t)(flash->size / flash->sector_size);
+    journal->batch = batch;
+    journal->batch_cap = batch_cap;
+
+    for (uint32_t sector = 0; sector < journal->sectors; ++sector) {
+        uint32_t seq = 0;
+        if (sector_valid(journal, sector, &seq) && (!journal->started || seq > journal->head_seq)) {
+            journal->head = sector;
+            journal->head_seq = seq;
+            journal->started = true;
+        }
+    }
+    if (!journal->started) {
+        journal->read_offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+        return ESP_OK;
+    }
+    size_t head_end = 0;
+    bool clean = recover_head_end(journal, &head_end);
+    /* Flash after a torn write cannot be programmed again: close the sector. */
+    journal->head_offset = clean ? head_end : journal->flash.sector_size;
+
+    /* Sectors are written in ring order, so the one after the head is the oldest. */
+    journal->read_sector = journal->head;
+    journal->read_offset = journal->head_offset;
+    bool found = false;
+    for (uint32_t i = 1; i <= journal->sectors; ++i) {
+        uint32_t sector = (journal->head + i) % journal->sectors;
+        if (!sector_valid(journal, sector, NULL)) {
+            continue;
+        }
+        size_t first = 0;
+        size_t end = sector == journal->head ? head_end : journal->flash.sector_size;
+        uint32_t unread = count_unread(journal, sector, TELEMETRY_JOURNAL_SECTOR_HEADER, end, &first);
+        if (unread > 0 && !found) {
+            journal->read_sector = sector;
+            journal->read_offset = first;
+            found = true;
+        }
+        journal->stats.records_recovered += unread;
+    }
+    return ESP_OK;
+}
+
+/**
+ * Move the writer to the next sector, erasing it. Unread records still there are
+ * lost; the reader skips to the sector after it.
+ */
+static esp_err_t open_next_sector(telemetry_journal_t *journal)
+{
+    uint32_t next = journal->started ? (journal->head + 1U) % journal->sectors : journal->head;
+    if (journal->started && journal->read_sector == next) {
+        journal->stats.records_dropped += count_unread(journal, next, journal->read_offset, journal->flash.sector_size, NULL);
+        journal->read_sector = (next + 1U) % journal->sectors;
+        journal->read_offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+    }
+    esp_err_t err = journal->flash.erase(journal->flash.ctx, sector_base(journal, next), journal->flash.sector_size);
+    ++journal->stats.erases;
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t seq = journal->started ? journal->head_seq + 1U : 1U;
+    sector_header_t header = {
+        .magic = TELEMETRY_JOURNAL_SECTOR_MAGIC,
+        .seq = seq,
+        .seq_inv = ~seq,
+    };
+    err = flash_write(journal, sector_base(journal, next), &header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!journal->started) {
+        journal->read_sector = next;
+        journal->read_offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+    }
+    journal->head = next;
+    journal->head_seq = seq;
+    journal->head_offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+    journal->started = true;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_journal_flush(telemetry_journal_t *journal)
+{
+    if (!journal) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (journal->batch_len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t err = flash_write(journal, sector_base(journal, journal->head) + journal->head_offset, journal->batch,
+                                journal->batch_len);
+    ++journal->stats.flushes;
+    if (err != ESP_OK) {
+        /* Whatever reached flash is unusable: close the sector as mount does after a torn write. */
+        journal->head_offset = journal->flash.sector_size;
+        journal->stats.records_dropped += journal->batch_records;
+    } else {
+        journal->head_offset += journal->batch_len;
+    }
+    journal->batch_len = 0;
+    journal->batch_records = 0;
+    return err;
+}
+
+esp_err_t telemetry_journal_append(telemetry_journal_t *journal, const void *data, size_t len)
+{
+    if (!journal || !data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t size = record_size(len);
+    if (len == 0 || len >= RECORD_BLANK_LEN || size > journal->batch_cap) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t err = ESP_OK;
+    if (journal->batch_len + size > journal->batch_cap) {
+        err = telemetry_journal_flush(journal);
+    }
+    if (!journal->started || journal->head_offset + journal->batch_len + size > journal->flash.sector_size) {
+        esp_err_t flush_err = telemetry_journal_flush(journal);
+        err = err != ESP_OK ? err : flush_err;
+        esp_err_t open_err = open_next_sector(journal);
+        if (open_err != ESP_OK) {
+            return open_err;
+        }
+    }
+    record_header_t header = {
+        .len = (uint16_t)len,
+        .len_inv = (uint16_t)~len,
+        .crc = proto_crc32(data, len),
+        .state = RECORD_UNREAD,
+    };
+    uint8_t *dst = journal->batch + journal->batch_len;
+    memcpy(dst, &header, sizeof(header));
+    memcpy(dst + sizeof(header), data, len);
+    memset(dst + sizeof(header) + len, 0xFF, size - sizeof(header) - len);
+    journal->batch_len += size;
+    ++journal->batch_records;
+    ++journal->stats.records_appended;
+    return err;
+}
+
+size_t telemetry_journal_pending(const telemetry_journal_t *journal)
+{
+    return journal ? journal->batch_len : 0;
+}
+
+bool telemetry_journal_has_unread(const telemetry_journal_t *journal)
+{
+    if (!journal || !journal->started) {
+        return false;
+    }
+    return journal->read_sector != journal->head || journal->read_offset < journal->head_offset;
+}
+
+esp_err_t telemetry_journal_read_next(telemetry_journal_t *journal, void *out, size_t cap, size_t *out_len)
+{
+    if (!journal || !out || !out_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (telemetry_journal_has_unread(journal)) {
+        record_header_t header;
+        record_status_t status = record_at(journal, journal->read_sector, journal->read_offset, &header);
+        if (status != RECORD_OK) {
+            if (status == RECORD_BAD) {
+                ++journal->stats.records_corrupt;
+            }
+            if (journal->read_sector == journal->head) {
+                journal->read_offset = journal->head_offset;
+                break;
+            }
+            /* Skip sectors whose erase or header write was cut short. */
+            do {
+                journal->read_sector = (journal->read_sector + 1U) % journal->sectors;
+            } while (journal->read_sector != journal->head && !sector_valid(journal, journal->read_sector, NULL));
+            journal->read_offset = TELEMETRY_JOURNAL_SECTOR_HEADER;
+            continue;
+        }
+        size_t offset = journal->read_offset;
+        if (header.state != RECORD_UNREAD) {
+            journal->read_offset += record_size(header.len);
+            continue;
+        }
+        if (header.len > cap) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        journal->read_offset += record_size(header.len);
+        if (!payload_intact(journal, journal->read_sector, offset, &header, out)) {
+            ++journal->stats.records_corrupt;
+            continue;
+        }
+        static const uint32_t replayed = 0;
+        size_t state_at = sector_base(journal, journal->read_sector) + offset + offsetof(record_header_t, state);
+        esp_err_t err = flash_write(journal, state_at, &replayed, sizeof(replayed));
+        if (err != ESP_OK) {
+            return err;
+        }
+        ++journal->stats.records_replayed;
+        *out_len = header.len;
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+void telemetry_journal_get_stats(const telemetry_journal_t *journal, telemetry_journal_stats_t *out)
+{
+    if (!journal || !out) {
+        return;
+    }
+    *out = journal->stats;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_JOURNAL_SECTOR_MAGIC 0x314C4A54U /* "TJL1" */
+#define TELEMETRY_JOURNAL_SECTOR_HEADER 12U
+#define TELEMETRY_JOURNAL_RECORD_HEADER 12U
+#define TELEMETRY_JOURNAL_MIN_SECTORS 2U
+
+/**
+ * Raw access to the journal's flash region. Offsets are relative to the region.
+ * Writes follow NOR rules: they may only clear bits of erased (0xFF) flash, which is
+ * how a record is marked replayed in place.
+ */
+typedef struct {
+    esp_err_t (*read)(void *ctx, size_t offset, void *dst, size_t len);
+    esp_err_t (*write)(void *ctx, size_t offset, const void *src, size_t len);
+    esp_err_t (*erase)(void *ctx, size_t offset, size_t len);
+    void *ctx;
+    size_t size;        /**< Region size, a multiple of @c sector_size. */
+    size_t sector_size; /**< Erase granularity. */
+} telemetry_journal_flash_t;
+
+typedef struct {
+    uint32_t records_appended;
+    uint32_t records_replayed;
+    uint32_t records_dropped;   /**< Lost to a failed flush or to the ring wrapping over them unread. */
+    uint32_t records_corrupt;   /**< Records or torn sector tails the reader skipped. */
+    uint32_t records_recovered; /**< Unread records found at mount. */
+    uint32_t flushes;
+    uint32_t erases;
+    uint64_t bytes_written;
+} telemetry_journal_stats_t;
+
+/**
+ * @brief Append-only ring of CRC-checked records on a raw flash region.
+ *
+ * Sectors are filled strictly in order and erased only when the writer wraps back to
+ * them, so every sector sees the same number of erases. Each sector starts with a
+ * header carrying a sequence number; the highest one marks the sector being written.
+ * Appends collect in a RAM batch that is written with one flash write when it fills
+ * or on telemetry_journal_flush(), so a record costs no erase and a fraction of a
+ * write. Replayed records are marked by clearing their state word, so a reboot
+ * resumes replay at the first record not yet delivered. The journal is not
+ * thread-safe; one task owns it.
+ */
+typedef struct {
+    telemetry_journal_flash_t flash;
+    uint32_t sectors;
+    uint32_t head;        /**< Sector being written. */
+    uint32_t head_seq;    /**< Sequence number in the head sector's header. */
+    size_t head_offset;   /**< Next write position in @c head; sector_size once closed. */
+    bool started;         /**< False until the first sector has been opened. */
+    uint32_t read_sector; /**< Position of the oldest record not yet replayed. */
+    size_t read_offset;
+    uint8_t *batch;
+    size_t batch_len;
+    size_t batch_cap;
+    uint32_t batch_records;
+    telemetry_journal_stats_t stats;
+} telemetry_journal_t;
+
+/**
+ * @brief Mount the journal, recovering the write and replay positions from flash.
+ *
+ * A torn record at the end of the last sector (power lost mid-write) is skipped and
+ * its sector closed. @p batch must hold at least one record header plus the largest
+ * payload to be appended, and fit in a sector with its header.
+ *
+ * @return ESP_ERR_INVALID_ARG for missing hooks or a region below two sectors,
+ *         ESP_ERR_INVALID_SIZE for a batch that does not fit a sector. Unreadable
+ *         sectors are treated as empty.
+ */
+esp_err_t telemetry_journal_mount(telemetry_journal_t *journal, const telemetry_journal_flash_t *flash,
+                                  uint8_t *batch, size_t batch_cap);
+
+/**
+ * @brief Queue one record; it reaches flash when the batch fills or is flushed.
+ *
+ * @return ESP_ERR_INVALID_SIZE when the record does not fit the batch, or the
+ *         flash error of the write or erase this append triggered. A failed flush
+ *         drops the batch written so far but still queues this record.
+ */
+esp_err_t telemetry_journal_append(telemetry_journal_t *journal, const void *data, size_t len);
+
+/** @brief Write out the pending batch, if any. */
+esp_err_t telemetry_journal_flush(telemetry_journal_t *journal);
+
+/** @brief Bytes appended but not yet written to flash. */
+size_t telemetry_journal_pending(const telemetry_journal_t *journal);
+
+/** @brief True while records written to flash remain to be replayed. */
+bool telemetry_journal_has_unread(const telemetry_journal_t *journal);
+
+/**
+ * @brief Copy out the oldest record not yet replayed and mark it replayed.
+ *
+ * Only flushed records are returned. Corrupt records are skipped and counted.
+ *
+ * @return ESP_OK with @p out_len set, ESP_ERR_NOT_FOUND when nothing is left,
+ *         ESP_ERR_INVALID_SIZE when @p cap is too small (the record stays unread).
+ */
+esp_err_t telemetry_journal_read_next(telemetry_journal_t *journal, void *out, size_t cap, size_t *out_len);
+
+void telemetry_journal_get_stats(const telemetry_journal_t *journal, telemetry_journal_stats_t *out);
@@ -0,0 +1,174 @@
+#include "flash_emu.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static esp_err_t backing_read(flash_emu_t *emu, size_t offset, void *dst, size_t len)
+{
+    if (emu->ram) {
+        memcpy(dst, emu->ram + offset, len);
+        return ESP_OK;
+    }
+    if (fseek(emu->file, (long)offset, SEEK_SET) != 0 || fread(dst, 1, len, emu->file) != len) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t backing_write(flash_emu_t *emu, size_t offset, const void *src, size_t len)
+{
+    if (emu->ram) {
+        memcpy(emu->ram + offset, src, len);
+        return ESP_OK;
+    }
+    if (fseek(emu->file, (long)offset, SEEK_SET) != 0 || fwrite(src, 1, len, emu->file) != len) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t flash_emu_open(flash_emu_t *emu, const char *path, size_t size, size_t sector_size)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->size = size;
+    emu->sector_size = sector_size;
+    emu->power_budget = -1;
+    emu->sector_erases = calloc(size / sector_size, sizeof(uint32_t));
+    if (!emu->sector_erases) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (path) {
+        emu->file = fopen(path, "w+b");
+        if (!emu->file) {
+            free(emu->sector_erases);
+            return ESP_FAIL;
+        }
+    } else {
+        emu->ram = malloc(size);
+        if (!emu->ram) {
+            free(emu->sector_erases);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    /* A factory-fresh part reads erased. */
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+    for (size_t offset = 0; offset < size; offset += sizeof(blank)) {
+        backing_write(emu, offset, blank, size - offset < sizeof(blank) ? size - offset : sizeof(blank));
+    }
+    return ESP_OK;
+}
+
+void flash_emu_close(flash_emu_t *emu)
+{
+    if (emu->file) {
+        fclose(emu->file);
+    }
+    free(emu->ram);
+    free(emu->sector_erases);
+    memset(emu, 0, sizeof(*emu));
+}
+
+static esp_err_t emu_read(void *ctx, size_t offset, void *dst, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset + len > emu->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return backing_read(emu, offset, dst, len);
+}
+
+static esp_err_t emu_write(void *ctx, size_t offset, const void *src, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset + len > emu->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t applied = len;
+    if (emu->power_budget >= 0 && (int64_t)len > emu->power_budget) {
+        applied = (size_t)emu->power_budget;
+    }
+    uint8_t cell[256];
+    const uint8_t *in = src;
+    for (size_t done = 0; done < applied;) {
+        size_t chunk = applied - done < sizeof(cell) ? applied - done : sizeof(cell);
+        esp_err_t err = backing_read(emu, offset + done, cell, chunk);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (size_t i = 0; i < chunk; ++i) {
+            if (in[done + i] & ~cell[i]) {
+                ++emu->bit_set_attempts;
+            }
+            cell[i] &= in[done + i];
+        }
+        err = backing_write(emu, offset + done, cell, chunk);
+        if (err != ESP_OK) {
+            return err;
+        }
+        done += chunk;
+    }
+    if (len > 0) {
+        ++emu->writes;
+        emu->page_programs +=
+            (uint32_t)((offset + len - 1U) / FLASH_EMU_PAGE_SIZE - offset / FLASH_EMU_PAGE_SIZE + 1U);
+    }
+    if (emu->power_budget >= 0) {
+        emu->power_budget -= (int64_t)applied;
+        if (applied < len) {
+            return ESP_FAIL;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t emu_erase(void *ctx, size_t offset, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset % emu->sector_size != 0 || len % emu->sector_size != 0 || offset + len > emu->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (emu->power_budget == 0) {
+        return ESP_FAIL;
+    }
+    uint8_t blank[256];
+    memset(blank, 0xFF, sizeof(blank));
+    for (size_t done = 0; done < len; done += sizeof(blank)) {
+        esp_err_t err = backing_write(emu, offset + done, blank, sizeof(blank));
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    for (size_t sector = offset / emu->sector_size; sector < (offset + len) / emu->sector_size; ++sector) {
+        ++emu->sector_erases[sector];
+        ++emu->erases;
+    }
+    return ESP_OK;
+}
+
+void flash_emu_bind(flash_emu_t *emu, telemetry_journal_flash_t *out)
+{
+    *out = (telemetry_journal_flash_t){
+        .read = emu_read,
+        .write = emu_write,
+        .erase = emu_erase,
+        .ctx = emu,
+        .size = emu->size,
+        .sector_size = emu->sector_size,
+    };
+}
+
+void flash_emu_cut_power_after(flash_emu_t *emu, int64_t bytes)
+{
+    emu->power_budget = bytes;
+}
+
+void flash_emu_restore_power(flash_emu_t *emu)
+{
+    emu->power_budget = -1;
+}
+
+uint64_t flash_emu_busy_us(const flash_emu_t *emu)
+{
+    return (uint64_t)emu->erases * FLASH_EMU_ERASE_US + (uint64_t)emu->page_programs * FLASH_EMU_PAGE_PROGRAM_US;
+}
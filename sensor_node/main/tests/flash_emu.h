@@ -0,0 +1,39 @@
+#pragma once
+
+#include "telemetry_journal.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Typical SPI NOR timings (4 KiB sector erase, 256-byte page program). */
+#define FLASH_EMU_ERASE_US 45000U
+#define FLASH_EMU_PAGE_PROGRAM_US 400U
+#define FLASH_EMU_PAGE_SIZE 256U
+
+/**
+ * NOR flash emulator backed by a file (or RAM when no path is given), so journal
+ * contents survive a simulated reboot. Writes can only clear bits, erases set a
+ * sector to 0xFF, and a power cut can be armed to tear a write part way through.
+ */
+typedef struct {
+    FILE *file;
+    uint8_t *ram;
+    size_t size;
+    size_t sector_size;
+    uint32_t *sector_erases;
+    uint32_t writes;
+    uint32_t erases;
+    uint32_t page_programs;
+    uint32_t bit_set_attempts; /**< Writes that tried to turn a 0 back into a 1. */
+    int64_t power_budget;      /**< Bytes left before the cut; negative = no cut armed. */
+} flash_emu_t;
+
+esp_err_t flash_emu_open(flash_emu_t *emu, const char *path, size_t size, size_t sector_size);
+void flash_emu_close(flash_emu_t *emu);
+void flash_emu_bind(flash_emu_t *emu, telemetry_journal_flash_t *out);
+
+/** @brief Let @p bytes more bytes reach flash, then fail every write and erase. */
+void flash_emu_cut_power_after(flash_emu_t *emu, int64_t bytes);
+void flash_emu_restore_power(flash_emu_t *emu);
+
+/** @brief Time the real part would have spent erasing and programming so far. */
+uint64_t flash_emu_busy_us(const flash_emu_t *emu);
@@ -7,6 +7,12 @@
 static i2c_mock_op_t s_ops[16];
 static size_t s_op_count;
 static size_t s_op_index;
+static uint32_t s_bus_bits;
+static uint32_t s_transactions;
+static uint32_t s_bytes;
+
+/* 400 kHz: 2.5 us per SCL period. */
+#define I2C_MOCK_BIT_TIME_NS 2500U
 
 void i2c_mock_set_sequence(const i2c_mock_op_t *ops, size_t count)
 {
@@ -17,12 +23,40 @@ void i2c_mock_set_sequence(const i2c_mock_op_t *ops, size_t count)
     }
     s_op_count = count;
     s_op_index = 0;
+    s_bus_bits = 0;
+    s_transactions = 0;
+    s_bytes = 0;
 }
 
 void i2c_mock_reset(void)
 {
     s_op_count = 0;
     s_op_index = 0;
+    s_bus_bits = 0;
+    s_transactions = 0;
+    s_bytes = 0;
+}
+
+uint32_t i2c_mock_bus_time_us(void)
+{
+    return (uint32_t)(((uint64_t)s_bus_bits * I2C_MOCK_BIT_TIME_NS + 999U) / 1000U);
+}
+
+/* Start + address byte + data bytes (9 clocks each with ACK), stop/repeated start. */
+static void account_segment(size_t data_len)
+{
+    s_bus_bits += 1U + 9U * (1U + (uint32_t)data_len) + 1U;
+    s_bytes += 1U + (uint32_t)data_len;
+}
+
+void i2c_mock_get_traffic(uint32_t *transactions, uint32_t *bytes)
+{
+    if (transactions) {
+        *transactions = s_transactions;
+    }
+    if (bytes) {
+        *bytes = s_bytes;
+    }
 }
 
 void i2c_mock_assert_complete(void)
@@ -34,6 +68,7 @@ static const i2c_mock_op_t *next_op(i2c_mock_op_type_t type, uint8_t addr)
 {
     TEST_ASSERT_TRUE_MESSAGE(s_op_index < s_op_count, "I2C mock sequence exhausted");
     const i2c_mock_op_t *op = &s_ops[s_op_index++];
+    ++s_transactions;
     TEST_ASSERT_EQUAL_UINT32(type, op->type);
     TEST_ASSERT_EQUAL_UINT8(addr, op->address);
     return op;
@@ -42,6 +77,7 @@ static const i2c_mock_op_t *next_op(i2c_mock_op_type_t type, uint8_t addr)
 esp_err_t i2c_bus_write(uint8_t addr, const uint8_t *data, size_t len)
 {
     const i2c_mock_op_t *op = next_op(I2C_MOCK_WRITE, addr);
+    account_segment(len);
     TEST_ASSERT_EQUAL_size_t(op->write_len, len);
     if (len > 0) {
         TEST_ASSERT_NOT_NULL(data);
@@ -53,6 +89,7 @@ esp_err_t i2c_bus_write(uint8_t addr, const uint8_t *data, size_t len)
 esp_err_t i2c_bus_read(uint8_t addr, uint8_t *data, size_t len)
 {
     const i2c_mock_op_t *op = next_op(I2C_MOCK_READ, addr);
+    account_segment(len);
     TEST_ASSERT_EQUAL_size_t(op->read_len, len);
     if (len > 0) {
         TEST_ASSERT_NOT_NULL(data);
@@ -65,6 +102,8 @@ esp_err_t i2c_bus_write_read(uint8_t addr, const uint8_t *wr_data, size_t wr_len
                              size_t rd_len)
 {
     const i2c_mock_op_t *op = next_op(I2C_MOCK_WRITE_READ, addr);
+    account_segment(wr_len);
+    account_segment(rd_len);
     TEST_ASSERT_EQUAL_size_t(op->write_len, wr_len);
     if (wr_len > 0) {
         TEST_ASSERT_NOT_NULL(wr_data);
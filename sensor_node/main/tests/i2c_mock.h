@@ -4,6 +4,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/* Large enough for a full PCA9685 LED burst (register byte + 16 x 4). */
+#define I2C_MOCK_MAX_WRITE 72U
+
 typedef enum {
     I2C_MOCK_WRITE,
     I2C_MOCK_READ,
@@ -13,9 +16,9 @@ typedef enum {
 typedef struct {
     i2c_mock_op_type_t type;
     uint8_t address;
-    uint8_t write_data[8];
+    uint8_t write_data[I2C_MOCK_MAX_WRITE];
     size_t write_len;
-    uint8_t read_data[8];
+    uint8_t read_data[32];
     size_t read_len;
     esp_err_t result;
 } i2c_mock_op_t;
@@ -23,3 +26,15 @@ typedef struct {
 void i2c_mock_set_sequence(const i2c_mock_op_t *ops, size_t count);
 void i2c_mock_reset(void);
 void i2c_mock_assert_complete(void);
+
+/**
+ * @brief Bus time consumed by the operations replayed since the last reset,
+ *        estimated at 400 kHz (start/stop, address bytes and ACK clocks included).
+ */
+uint32_t i2c_mock_bus_time_us(void);
+
+/**
+ * @brief Transactions (one per i2c_bus_* call) and bytes on the wire, address bytes
+ *        included, replayed since the last reset.
+ */
+void i2c_mock_get_traffic(uint32_t *transactions, uint32_t *bytes);
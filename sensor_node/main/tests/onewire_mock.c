@@ -1,11 +1,29 @@
 #include "onewire_mock.h"
 
+#include "drivers/ds18b20.h"
 #include "unity.h"
 #include <string.h>
 
 static uint8_t s_scratch[9];
 static size_t s_scratch_len;
 static bool s_ready;
+static bool s_corrupt_next;
+static uint8_t s_last_cmd;
+static uint32_t s_eeprom_writes;
+static uint32_t s_resets;
+static uint32_t s_slots;
+
+void onewire_mock_reset(void)
+{
+    memset(s_scratch, 0, sizeof(s_scratch));
+    s_scratch_len = 0;
+    s_ready = false;
+    s_corrupt_next = false;
+    s_last_cmd = 0;
+    s_eeprom_writes = 0;
+    s_resets = 0;
+    s_slots = 0;
+}
 
 void onewire_mock_set_scratch(const uint8_t *data, size_t len)
 {
@@ -19,31 +37,70 @@ void onewire_mock_set_ready(bool ready)
     s_ready = ready;
 }
 
+void onewire_mock_corrupt_next_read(void)
+{
+    s_corrupt_next = true;
+}
+
+uint32_t onewire_mock_eeprom_writes(void)
+{
+    return s_eeprom_writes;
+}
+
+uint32_t onewire_mock_resets(void)
+{
+    return s_resets;
+}
+
+uint32_t onewire_mock_bus_time_us(void)
+{
+    return s_resets * ONEWIRE_MOCK_RESET_US + s_slots * ONEWIRE_MOCK_SLOT_US;
+}
+
 esp_err_t onewire_bus_reset(onewire_bus_handle_t bus)
 {
     (void)bus;
+    ++s_resets;
+    s_last_cmd = 0;
     return ESP_OK;
 }
 
 esp_err_t onewire_bus_write_bytes(onewire_bus_handle_t bus, const uint8_t *data, size_t len)
 {
     (void)bus;
-    (void)data;
-    (void)len;
+    s_slots += (uint32_t)len * 8U;
+    if (len == 0) {
+        return ESP_OK;
+    }
+    if (data[0] == 0x4E && len == 4) {
+        memcpy(&s_scratch[2], &data[1], 3);
+        s_scratch[8] = ds18b20_crc8(s_scratch, 8);
+        s_scratch_len = sizeof(s_scratch);
+    } else if (data[0] == 0x48 && len == 1) {
+        ++s_eeprom_writes;
+    }
+    s_last_cmd = data[0];
     return ESP_OK;
 }
 
 esp_err_t onewire_bus_read_bytes(onewire_bus_handle_t bus, uint8_t *data, size_t len)
 {
     (void)bus;
+    TEST_ASSERT_EQUAL_HEX8(0xBE, s_last_cmd);
     TEST_ASSERT_LESS_OR_EQUAL(s_scratch_len, len);
+    s_slots += (uint32_t)len * 8U;
     memcpy(data, s_scratch, len);
+    if (s_corrupt_next) {
+        data[0] ^= 0x01U;
+        s_corrupt_next = false;
+    }
     return ESP_OK;
 }
 
 esp_err_t onewire_bus_read_bit(onewire_bus_handle_t bus, bool *bit)
 {
     (void)bus;
+    ++s_slots;
     if (bit) {
         *bit = s_ready;
     }
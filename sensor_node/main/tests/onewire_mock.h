@@ -6,5 +6,19 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/* Standard-speed slot timings used for bus time accounting. */
+#define ONEWIRE_MOCK_RESET_US 960U
+#define ONEWIRE_MOCK_SLOT_US 65U
+
+/**
+ * Minimal DS18B20 model: WRITE_SCRATCH updates bytes 2-4 of the scratchpad and
+ * refreshes its CRC, COPY_SCRATCHPAD counts EEPROM writes, every read returns the
+ * current scratchpad.
+ */
+void onewire_mock_reset(void);
 void onewire_mock_set_scratch(const uint8_t *data, size_t len);
 void onewire_mock_set_ready(bool ready);
+void onewire_mock_corrupt_next_read(void);
+uint32_t onewire_mock_eeprom_writes(void);
+uint32_t onewire_mock_resets(void);
+uint32_t onewire_mock_bus_time_us(void);
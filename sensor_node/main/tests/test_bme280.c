@@ -0,0 +1,138 @@
+#include "drivers/bme280.h"
+
+#include "i2c_mock.h"
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Calibration example from the BME280 datasheet (section 8.2), plus typical humidity trims. */
+static const uint16_t T1 = 27504;
+static const int16_t T2 = 26435;
+static const int16_t T3 = -1000;
+static const uint16_t P1 = 36477;
+static const int16_t P_TRIM[8] = {-10685, 3024, 2855, 140, -7, 15500, -14600, 6000};
+static const uint8_t H1 = 75;
+static const int16_t H2 = 362;
+static const uint8_t H3 = 0;
+static const int16_t H4 = 324;
+static const int16_t H5 = 0;
+static const int8_t H6 = 30;
+
+static void put_le16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)(value & 0xFF);
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static void put_adc20(uint8_t *out, uint32_t adc)
+{
+    out[0] = (uint8_t)(adc >> 12);
+    out[1] = (uint8_t)(adc >> 4);
+    out[2] = (uint8_t)((adc & 0x0F) << 4);
+}
+
+static void expect_init(uint8_t addr)
+{
+    i2c_mock_op_t ops[7] = {
+        {I2C_MOCK_WRITE, addr, {0xE0, 0xB6}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0x88}, 1, {0}, 26, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0xA1}, 1, {H1}, 1, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0xE1}, 1, {0}, 7, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0xF2, 0x01}, 2, {0}, 0, ESP_OK},
+        /* 200 ms period -> 125 ms standby, IIR filter x4. */
+        {I2C_MOCK_WRITE, addr, {0xF5, 0x48}, 2, {0}, 0, ESP_OK},
+        /* osrs_t = osrs_p = x1, normal mode. */
+        {I2C_MOCK_WRITE, addr, {0xF4, 0x27}, 2, {0}, 0, ESP_OK},
+    };
+    uint8_t *tph = ops[1].read_data;
+    put_le16(&tph[0], T1);
+    put_le16(&tph[2], (uint16_t)T2);
+    put_le16(&tph[4], (uint16_t)T3);
+    put_le16(&tph[6], P1);
+    for (size_t i = 0; i < 8; ++i) {
+        put_le16(&tph[8 + 2 * i], (uint16_t)P_TRIM[i]);
+    }
+    uint8_t *h = ops[3].read_data;
+    put_le16(&h[0], (uint16_t)H2);
+    h[2] = H3;
+    h[3] = (uint8_t)(H4 >> 4);
+    h[4] = (uint8_t)((H4 & 0x0F) | ((H5 & 0x0F) << 4));
+    h[5] = (uint8_t)(H5 >> 4);
+    h[6] = (uint8_t)H6;
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+}
+
+static double reference_humidity(int32_t adc_T, int32_t adc_H)
+{
+    double var1 = ((double)adc_T / 16384.0 - (double)T1 / 1024.0) * (double)T2;
+    double var2 = ((double)adc_T / 131072.0 - (double)T1 / 8192.0);
+    var2 = var2 * var2 * (double)T3;
+    double t_fine = var1 + var2;
+    double h = t_fine - 76800.0;
+    h = ((double)adc_H - ((double)H4 * 64.0 + (double)H5 / 16384.0 * h)) *
+        ((double)H2 / 65536.0 * (1.0 + (double)H6 / 67108864.0 * h * (1.0 + (double)H3 / 67108864.0 * h)));
+    h = h * (1.0 - (double)H1 * h / 524288.0);
+    return h < 0.0 ? 0.0 : (h > 100.0 ? 100.0 : h);
+}
+
+TEST_CASE("bme280 starts normal mode matched to the sample period", "[bme280]")
+{
+    const uint8_t addr = 0x76;
+    expect_init(addr);
+    TEST_ASSERT_EQUAL(ESP_OK, bme280_init(addr, 200));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("bme280 samples with one burst read and integer compensation", "[bme280]")
+{
+    const uint8_t addr = 0x77;
+    expect_init(addr);
+    TEST_ASSERT_EQUAL(ESP_OK, bme280_init(addr, 200));
+    i2c_mock_assert_complete();
+
+    const uint32_t adc_P = 415148;
+    const uint32_t adc_T = 519888;
+    const uint16_t adc_H = 30000;
+    i2c_mock_op_t read = {I2C_MOCK_WRITE_READ, addr, {0xF7}, 1, {0}, 8, ESP_OK};
+    put_adc20(&read.read_data[0], adc_P);
+    put_adc20(&read.read_data[3], adc_T);
+    read.read_data[6] = (uint8_t)(adc_H >> 8);
+    read.read_data[7] = (uint8_t)(adc_H & 0xFF);
+    i2c_mock_set_sequence(&read, 1);
+
+    bme280_sample_t sample;
+    TEST_ASSERT_EQUAL(ESP_OK, bme280_read_sample(addr, &sample));
+    i2c_mock_assert_complete();
+    uint32_t bus_us = i2c_mock_bus_time_us();
+    printf("bme280 sample: 1 transaction, %u us of bus time at 400 kHz\n", (unsigned)bus_us);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(300, bus_us);
+
+    /* Datasheet worked example: 25.08 degC, 100653 Pa. */
+    TEST_ASSERT_EQUAL_INT(2508, sample.temperature_centi_c);
+    TEST_ASSERT_EQUAL_UINT32(100653, sample.pressure_pa_q8 >> 8);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, (float)reference_humidity((int32_t)adc_T, adc_H),
+                             (float)sample.humidity_q10 / 1024.0f);
+
+    i2c_mock_set_sequence(&read, 1);
+    float temperature = 0.0f;
+    float humidity = 0.0f;
+    float pressure = 0.0f;
+    TEST_ASSERT_EQUAL(ESP_OK, bme280_read(addr, &temperature, &humidity, &pressure));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.08f, temperature);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 100653.0f, pressure);
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("bme280 reports no data before the first conversion", "[bme280]")
+{
+    const uint8_t addr = 0x76;
+    expect_init(addr);
+    TEST_ASSERT_EQUAL(ESP_OK, bme280_init(addr, 200));
+    i2c_mock_op_t read = {
+        I2C_MOCK_WRITE_READ, addr, {0xF7}, 1, {0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x80, 0x00}, 8, ESP_OK,
+    };
+    i2c_mock_set_sequence(&read, 1);
+    bme280_sample_t sample;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, bme280_read_sample(addr, &sample));
+    i2c_mock_assert_complete();
+}
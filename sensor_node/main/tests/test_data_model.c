@@ -2,72 +2,335 @@
 
 #include "unity.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 static void seed_baseline(sensor_data_model_t *model)
 {
     uint16_t duty[16] = {0};
     onewire_device_t device = {0};
 
-    data_model_set_sht20(model, 0, "SHT20_A", 20.0f, 50.0f, true);
-    data_model_set_sht20(model, 1, "SHT20_B", 21.5f, 48.5f, true);
-    data_model_set_ds18b20(model, 0, &device, 19.75f);
+    data_model_set_sht20(model, 0, "SHT20_A", 20.0f, 50.0f, true, 1000);
+    data_model_set_sht20(model, 1, "SHT20_B", 21.5f, 48.5f, true, 1000);
+    data_model_set_ds18b20(model, 0, &device, 19.75f, 1000);
     data_model_set_gpio(model, 0, 0xAAAA, 0x5555);
     data_model_set_pwm(model, duty, 16, 500);
     data_model_set_timestamp(model, 1000);
     data_model_increment_seq(model);
 }
 
-TEST_CASE("data_model rotates staging buffers", "[data_model]")
+TEST_CASE("data_model encodes every new sequence into its frame", "[data_model]")
 {
-    sensor_data_model_t model;
+    static sensor_data_model_t model;
     data_model_init(&model);
 
     for (int i = 0; i < 3; ++i) {
         seed_baseline(&model);
         onewire_device_t device = {0};
-        data_model_set_ds18b20(&model, 0, &device, 19.75f + (float)i);
+        data_model_set_ds18b20(&model, 0, &device, 19.75f + (float)i, 1000);
+
+        const data_model_frame_t *frame = data_model_build(&model, false);
+        TEST_ASSERT_NOT_NULL(frame);
+        TEST_ASSERT_EQUAL_PTR(&model.frame, frame);
+        TEST_ASSERT_EQUAL_UINT32(model.current.sequence_id, frame->sequence_id);
 
-        size_t buffer_index = model.next_encode_index;
-        uint8_t *payload = NULL;
-        size_t payload_len = 0;
         uint32_t crc = 0;
+        memcpy(&crc, frame->data, sizeof(crc));
+        proto_sensor_update_t decoded;
+        TEST_ASSERT_TRUE(proto_decode_sensor_update(frame->data + sizeof(crc), frame->len - sizeof(crc), false,
+                                                    &decoded, crc));
+        TEST_ASSERT_EQUAL_UINT32(frame->sequence_id, decoded.sequence_id);
+    }
+}
+
+TEST_CASE("data_model encodes each sequence once", "[data_model]")
+{
+    static sensor_data_model_t model;
+    data_model_init(&model);
+    seed_baseline(&model);
+
+    const data_model_frame_t *first = data_model_build(&model, false);
+    TEST_ASSERT_NOT_NULL(first);
 
-        TEST_ASSERT_TRUE(data_model_build(&model, false, &payload, &payload_len, &crc));
-        TEST_ASSERT_NOT_NULL(payload);
-        TEST_ASSERT_TRUE(payload_len > 0);
-        TEST_ASSERT_EQUAL_PTR(model.encode_buffers[buffer_index], payload);
-        TEST_ASSERT_EQUAL(payload_len, model.encode_lengths[buffer_index]);
-        TEST_ASSERT_EQUAL((buffer_index + 1U) % SENSOR_DATA_MODEL_BUFFER_COUNT, model.next_encode_index);
+    /* A change after the first build does not leak into frames of the same sequence. */
+    data_model_set_gpio(&model, 0, 0x0F0F, 0x5555);
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL_PTR(first, data_model_build(&model, false));
     }
+    uint32_t crc = 0;
+    memcpy(&crc, first->data, sizeof(crc));
+    proto_sensor_update_t decoded;
+    TEST_ASSERT_TRUE(
+        proto_decode_sensor_update(first->data + sizeof(crc), first->len - sizeof(crc), false, &decoded, crc));
+    TEST_ASSERT_EQUAL_HEX16(0xAAAA, decoded.mcp[0].port_a);
+
+    sensor_data_model_stats_t stats;
+    data_model_get_stats(&model, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.frames_encoded);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.frame_cache_hits);
+    TEST_ASSERT_TRUE(data_model_should_publish(&model, NULL));
+
+    data_model_increment_seq(&model);
+    const data_model_frame_t *next = data_model_build(&model, false);
+    TEST_ASSERT_NOT_NULL(next);
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
+}
+
+TEST_CASE("data_model freezes a sequence without encoding it", "[data_model]")
+{
+    static sensor_data_model_t model;
+    data_model_init(&model);
+    seed_baseline(&model);
+
+    const proto_sensor_update_t *frozen = data_model_freeze(&model);
+    TEST_ASSERT_NOT_NULL(frozen);
+    TEST_ASSERT_EQUAL_UINT32(model.current.sequence_id, frozen->sequence_id);
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
+
+    /* The same sequence built later comes from the frozen state, not the newer one. */
+    data_model_set_gpio(&model, 0, 0x0F0F, 0x5555);
+    TEST_ASSERT_EQUAL_PTR(frozen, data_model_freeze(&model));
+    TEST_ASSERT_EQUAL_HEX16(0xAAAA, frozen->mcp[0].port_a);
+    const data_model_frame_t *frame = data_model_build(&model, false);
+    TEST_ASSERT_NOT_NULL(frame);
+    uint32_t crc = 0;
+    memcpy(&crc, frame->data, sizeof(crc));
+    proto_sensor_update_t decoded;
+    TEST_ASSERT_TRUE(
+        proto_decode_sensor_update(frame->data + sizeof(crc), frame->len - sizeof(crc), false, &decoded, crc));
+    TEST_ASSERT_EQUAL_HEX16(0xAAAA, decoded.mcp[0].port_a);
+
+    sensor_data_model_stats_t stats;
+    data_model_get_stats(&model, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.frames_encoded);
+    TEST_ASSERT_TRUE(data_model_should_publish(&model, NULL));
 }
 
 TEST_CASE("data_model publish thresholding", "[data_model]")
 {
-    sensor_data_model_t model;
+    static sensor_data_model_t model;
     data_model_init(&model);
+    data_model_deadbands_t deadbands;
+    data_model_default_deadbands(&deadbands);
+    deadbands.ambient_humidity_pct[0] = 2.0f;
+    deadbands.ds18b20_temp_c[0] = 0.5f;
+    data_model_set_deadbands(&model, &deadbands);
 
     seed_baseline(&model);
 
-    uint8_t *payload = NULL;
-    size_t payload_len = 0;
-    uint32_t crc = 0;
-    TEST_ASSERT_TRUE(data_model_build(&model, false, &payload, &payload_len, &crc));
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
 
-    TEST_ASSERT_FALSE(data_model_should_publish(&model, 0.5f, 2.0f));
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
 
-    data_model_set_sht20(&model, 0, "SHT20_A", 20.0f, 53.5f, true);
-    TEST_ASSERT_TRUE(data_model_should_publish(&model, 0.5f, 2.0f));
+    data_model_set_sht20(&model, 0, "SHT20_A", 20.0f, 53.5f, true, 1000);
+    TEST_ASSERT_TRUE(data_model_should_publish(&model, NULL));
 
     data_model_set_timestamp(&model, 2000);
     data_model_increment_seq(&model);
-    TEST_ASSERT_TRUE(data_model_build(&model, false, &payload, &payload_len, &crc));
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
+
+    onewire_device_t device = {0};
+    data_model_set_ds18b20(&model, 0, &device, 20.1f, 1000);
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
+
+    data_model_set_ds18b20(&model, 0, &device, 21.0f, 1000);
+    TEST_ASSERT_TRUE(data_model_should_publish(&model, NULL));
+}
+
+TEST_CASE("data_model applies deadbands per channel", "[data_model]")
+{
+    static sensor_data_model_t model;
+    data_model_init(&model);
+    data_model_deadbands_t deadbands;
+    data_model_default_deadbands(&deadbands);
+    deadbands.ds18b20_temp_c[1] = 0.0f;
+    deadbands.ds18b20_temp_c[2] = 5.0f;
+    deadbands.ambient_pressure_pa[0] = 20.0f;
+    data_model_set_deadbands(&model, &deadbands);
 
     onewire_device_t device = {0};
-    data_model_set_ds18b20(&model, 0, &device, 20.1f);
-    TEST_ASSERT_FALSE(data_model_should_publish(&model, 0.5f, 2.0f));
+    seed_baseline(&model);
+    data_model_set_ds18b20(&model, 1, &device, 20.0f, 1000);
+    data_model_set_ds18b20(&model, 2, &device, 20.0f, 1000);
+    data_model_set_pressure(&model, 0, 101325.0f);
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
+    TEST_ASSERT_EQUAL_HEX32(0, atomic_load(&model.dirty));
+
+    /* 0.0625 °C is one DS18B20 LSB: only the zero-deadband probe reports it. */
+    data_model_set_ds18b20(&model, 1, &device, 20.0625f, 2000);
+    data_model_set_ds18b20(&model, 2, &device, 24.0f, 2000);
+    data_model_set_pressure(&model, 0, 101340.0f);
+    TEST_ASSERT_EQUAL_HEX32(DATA_MODEL_DIRTY_DS18B20(1), atomic_load(&model.dirty));
+    data_model_set_pressure(&model, 0, 101350.0f);
+    TEST_ASSERT_EQUAL_HEX32(DATA_MODEL_DIRTY_DS18B20(1) | DATA_MODEL_DIRTY_SHT20(0), atomic_load(&model.dirty));
+
+    data_model_increment_seq(&model);
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
+    TEST_ASSERT_EQUAL_HEX32(0, atomic_load(&model.dirty));
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
+}
+
+static void count_notifications(void *ctx)
+{
+    ++*(uint32_t *)ctx;
+}
+
+TEST_CASE("data_model notifies the publisher once per newly dirty entry", "[data_model]")
+{
+    static sensor_data_model_t model;
+    data_model_init(&model);
+    uint32_t notifications = 0;
+    data_model_set_listener(&model, count_notifications, &notifications);
+
+    seed_baseline(&model);
+    uint32_t seeded = notifications;
+    TEST_ASSERT_TRUE(seeded > 0);
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
+
+    /* Same GPIO state: nothing to do. A new one notifies once, repeats stay quiet. */
+    data_model_set_gpio(&model, 0, 0xAAAA, 0x5555);
+    TEST_ASSERT_EQUAL_UINT32(seeded, notifications);
+    data_model_set_gpio(&model, 0, 0xAAAB, 0x5555);
+    data_model_set_gpio(&model, 0, 0xAAAC, 0x5555);
+    TEST_ASSERT_EQUAL_UINT32(seeded + 1, notifications);
+    uint16_t duty[16] = {0};
+    duty[4] = 100;
+    data_model_set_pwm(&model, duty, 16, 500);
+    TEST_ASSERT_EQUAL_UINT32(seeded + 2, notifications);
+    TEST_ASSERT_EQUAL_HEX32(DATA_MODEL_DIRTY_GPIO(0) | DATA_MODEL_DIRTY_PWM, atomic_load(&model.dirty));
+    TEST_ASSERT_TRUE(data_model_should_publish(&model, NULL));
 
-    data_model_set_ds18b20(&model, 0, &device, 21.0f);
-    TEST_ASSERT_TRUE(data_model_should_publish(&model, 0.5f, 2.0f));
+    data_model_increment_seq(&model);
+    TEST_ASSERT_NOT_NULL(data_model_build(&model, false));
+    TEST_ASSERT_FALSE(data_model_should_publish(&model, NULL));
 }
 
+#define STRESS_DURATION_US 300000
+
+typedef struct {
+    sensor_data_model_t *model;
+    atomic_bool *stop;
+    uint32_t writes;
+} stress_writer_t;
+
+static int64_t stress_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* t_sensors stand-in: every entry carries one counter value in all of its fields. */
+static void *stress_sensor_writer(void *arg)
+{
+    stress_writer_t *writer = arg;
+    uint32_t i = 0;
+    while (!atomic_load(writer->stop)) {
+        ++i;
+        float v = (float)(i & 0xFFFFFU);
+        onewire_device_t device;
+        memset(device.rom_code, (int)(i & 0xFFU), sizeof(device.rom_code));
+        data_model_set_sht20(writer->model, i & 1U, "SHT20", v, v, true, i & 0xFFFFFU);
+        data_model_set_ds18b20(writer->model, i & 3U, &device, (float)(i & 0xFFU), i & 0xFFU);
+        writer->writes += 2;
+    }
+    return NULL;
+}
+
+/* t_io stand-in: all PWM channels and the frequency share one value, port B mirrors port A. */
+static void *stress_io_writer(void *arg)
+{
+    stress_writer_t *writer = arg;
+    uint32_t i = 0;
+    uint16_t duty[16];
+    while (!atomic_load(writer->stop)) {
+        ++i;
+        for (size_t ch = 0; ch < 16; ++ch) {
+            duty[ch] = (uint16_t)i;
+        }
+        data_model_set_pwm(writer->model, duty, 16, (uint16_t)i);
+        data_model_set_gpio(writer->model, i & 1U, (uint16_t)i, (uint16_t)~i);
+        writer->writes += 2;
+    }
+    return NULL;
+}
+
+static bool snapshot_consistent(const proto_sensor_update_t *snap)
+{
+    for (size_t i = 0; i < snap->sht20_count; ++i) {
+        const proto_sht20_reading_t *e = &snap->sht20[i];
+        if (e->temperature_c != e->humidity_percent || e->temperature_c != (float)e->sample_ms) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < snap->ds18b20_count; ++i) {
+        const proto_ds18b20_reading_t *e = &snap->ds18b20[i];
+        for (size_t b = 0; b < sizeof(e->rom_code); ++b) {
+            if (e->rom_code[b] != (uint8_t)e->sample_ms) {
+                return false;
+            }
+        }
+        if (e->temperature_c != (float)e->sample_ms) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < 16; ++i) {
+        if (snap->pwm.duty_cycle[i] != snap->pwm.frequency_hz) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if ((uint16_t)(snap->mcp[i].port_a ^ snap->mcp[i].port_b) != 0xFFFFU) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST_CASE("data_model snapshots stay consistent under concurrent writers", "[data_model][stress]")
+{
+    static sensor_data_model_t model;
+    data_model_init(&model);
+    uint16_t duty[16] = {0};
+    data_model_set_pwm(&model, duty, 16, 0);
+    data_model_set_gpio(&model, 0, 0, 0xFFFF);
+    data_model_set_gpio(&model, 1, 0, 0xFFFF);
+
+    atomic_bool stop;
+    atomic_init(&stop, false);
+    stress_writer_t sensors = {&model, &stop, 0};
+    stress_writer_t io = {&model, &stop, 0};
+    pthread_t threads[2];
+    TEST_ASSERT_EQUAL(0, pthread_create(&threads[0], NULL, stress_sensor_writer, &sensors));
+    TEST_ASSERT_EQUAL(0, pthread_create(&threads[1], NULL, stress_io_writer, &io));
+
+    proto_sensor_update_t snap;
+    uint32_t torn = 0;
+    int64_t start = stress_now_us();
+    while (stress_now_us() - start < STRESS_DURATION_US) {
+        data_model_snapshot(&model, &snap);
+        if (!snapshot_consistent(&snap)) {
+            ++torn;
+        }
+    }
+    atomic_store(&stop, true);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+
+    sensor_data_model_stats_t stats;
+    data_model_get_stats(&model, &stats);
+    printf("data_model stress: %u snapshots, %u writes, %u read retries (%.3f per snapshot), %u reader sleeps, "
+           "%u write collisions, %u torn\n",
+           (unsigned)stats.snapshots, (unsigned)(sensors.writes + io.writes), (unsigned)stats.read_retries,
+           stats.snapshots ? (double)stats.read_retries / stats.snapshots : 0.0, (unsigned)stats.reader_sleeps,
+           (unsigned)stats.write_collisions, (unsigned)torn);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.write_collisions);
+    TEST_ASSERT_TRUE(stats.snapshots > 0);
+    TEST_ASSERT_TRUE(sensors.writes > 0 && io.writes > 0);
+}
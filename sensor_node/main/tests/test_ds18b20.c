@@ -2,6 +2,16 @@
 
 #include "onewire_mock.h"
 #include "unity.h"
+#include <stdio.h>
+
+#define TEST_BUS ((onewire_bus_handle_t)1)
+
+static void load_scratch(uint8_t temp_lsb, uint8_t temp_msb, uint8_t config)
+{
+    uint8_t scratch[9] = {temp_lsb, temp_msb, 0x4B, 0x46, config, 0xFF, 0x0C, 0x10, 0};
+    scratch[8] = ds18b20_crc8(scratch, 8);
+    onewire_mock_set_scratch(scratch, sizeof(scratch));
+}
 
 TEST_CASE("ds18b20 conversion timing", "[ds18b20]")
 {
@@ -11,14 +21,91 @@ TEST_CASE("ds18b20 conversion timing", "[ds18b20]")
     TEST_ASSERT_EQUAL_UINT32(750, ds18b20_conversion_time_ms(12));
 }
 
+TEST_CASE("ds18b20 crc8 matches the datasheet example", "[ds18b20]")
+{
+    const uint8_t rom[7] = {0x02, 0x1C, 0xB8, 0x01, 0x00, 0x00, 0x00};
+    TEST_ASSERT_EQUAL_HEX8(0xA2, ds18b20_crc8(rom, sizeof(rom)));
+}
+
 TEST_CASE("ds18b20 decodes temperature", "[ds18b20]")
 {
-    uint8_t scratch[9] = {0x50, 0x05, 0, 0, 0, 0, 0, 0, 0};
-    onewire_mock_set_scratch(scratch, sizeof(scratch));
+    onewire_mock_reset();
+    load_scratch(0x50, 0x05, 0x7F);
     onewire_mock_set_ready(true);
 
     onewire_device_t device = {0};
     float temp = 0.0f;
-    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature((onewire_bus_handle_t)1, &device, &temp));
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &device, &temp));
     TEST_ASSERT_FLOAT_WITHIN(0.1f, 85.0f, temp);
+
+    load_scratch(0x5E, 0xFF, 0x7F);
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, -10.125f, temp);
+
+    /* 9-bit conversions leave bits 0-2 undefined. */
+    load_scratch(0x97, 0x01, 0x1F);
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0f, temp);
+}
+
+TEST_CASE("ds18b20 rejects corrupted scratchpads", "[ds18b20]")
+{
+    onewire_mock_reset();
+    load_scratch(0x91, 0x01, 0x7F);
+    onewire_device_t device = {0};
+    float temp = 0.0f;
+    onewire_mock_corrupt_next_read();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 25.0625f, temp);
+
+    /* A shorted bus reads all zeros, which has a valid CRC but no reserved bits. */
+    const uint8_t zeros[9] = {0};
+    onewire_mock_set_scratch(zeros, sizeof(zeros));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+}
+
+TEST_CASE("ds18b20 configuration is persisted once", "[ds18b20]")
+{
+    onewire_mock_reset();
+    load_scratch(0x50, 0x05, 0x1F);
+    onewire_device_t device = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_configure(TEST_BUS, &device, 12, true));
+    TEST_ASSERT_EQUAL_UINT32(1, onewire_mock_eeprom_writes());
+
+    /* Already configured: a single verification read, no EEPROM wear. */
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_configure(TEST_BUS, &device, 12, true));
+    TEST_ASSERT_EQUAL_UINT32(1, onewire_mock_eeprom_writes());
+
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_configure(TEST_BUS, &device, 10, false));
+    TEST_ASSERT_EQUAL_UINT32(1, onewire_mock_eeprom_writes());
+    float temp = 0.0f;
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &device, &temp));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 85.0f, temp);
+}
+
+TEST_CASE("ds18b20 conversion cycle bus time", "[ds18b20][perf]")
+{
+    enum { PROBES = 4 };
+    onewire_mock_reset();
+    load_scratch(0x91, 0x01, 0x7F);
+    onewire_mock_set_ready(true);
+    onewire_device_t devices[PROBES] = {0};
+
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_start_conversion(TEST_BUS, NULL));
+    bool ready = false;
+    TEST_ASSERT_EQUAL(ESP_OK, ds18b20_check_conversion(TEST_BUS, &ready));
+    TEST_ASSERT_TRUE(ready);
+    for (int i = 0; i < PROBES; ++i) {
+        float temp = 0.0f;
+        TEST_ASSERT_EQUAL(ESP_OK, ds18b20_read_temperature(TEST_BUS, &devices[i], &temp));
+    }
+    uint32_t cycle_us = onewire_mock_bus_time_us();
+    /* One skip-ROM CONVERT_T, then MATCH_ROM + READ_SCRATCH + 9 bytes per probe. */
+    uint32_t expected = (1U + PROBES) * ONEWIRE_MOCK_RESET_US +
+                        (16U + 1U + PROBES * (9U + 1U + 9U) * 8U) * ONEWIRE_MOCK_SLOT_US;
+    TEST_ASSERT_EQUAL_UINT32(expected, cycle_us);
+    TEST_ASSERT_EQUAL_UINT32(1U + PROBES, onewire_mock_resets());
+    TEST_ASSERT_EQUAL_UINT32(0, onewire_mock_eeprom_writes());
+    printf("ds18b20 cycle with %d probes: %u us of bus time\n", PROBES, (unsigned)cycle_us);
 }
@@ -0,0 +1,112 @@
+#include "ds18b20_adaptive.h"
+
+#include "drivers/ds18b20.h"
+#include "unity.h"
+#include <math.h>
+
+static const ds18b20_adaptive_config_t s_config = {
+    .fast_mc_per_s = 250,
+    .moderate_mc_per_s = 50,
+    .settle_samples = 3,
+};
+
+/* Sample a signal at the cadence the probe's own resolution allows. */
+static uint8_t run(ds18b20_adaptive_t *probe, float (*signal)(int64_t), int64_t *now_us, int64_t until_us,
+                   uint32_t *samples)
+{
+    uint8_t bits = probe->resolution_bits;
+    while (*now_us < until_us) {
+        *now_us += (int64_t)ds18b20_conversion_time_ms(bits) * 1000;
+        float lsb = 0.0625f * (float)(1U << (12U - bits));
+        float quantised = floorf(signal(*now_us) / lsb) * lsb;
+        bits = ds18b20_adaptive_update(probe, &s_config, quantised, *now_us);
+        if (samples) {
+            ++*samples;
+        }
+    }
+    return bits;
+}
+
+static float flat(int64_t now_us)
+{
+    (void)now_us;
+    return 21.3f;
+}
+
+static float ramp(int64_t now_us)
+{
+    return 20.0f + (float)now_us / 1e6f;
+}
+
+static float step_then_flat(int64_t now_us)
+{
+    return now_us < 5000000 ? ramp(now_us) : ramp(5000000);
+}
+
+TEST_CASE("ds18b20 adaptive stays at 12 bit when stable", "[ds18b20]")
+{
+    ds18b20_adaptive_t probe;
+    ds18b20_adaptive_init(&probe);
+    int64_t now = 0;
+    TEST_ASSERT_EQUAL_UINT8(12, run(&probe, flat, &now, 20000000, NULL));
+}
+
+TEST_CASE("ds18b20 adaptive drops resolution on fast change and recovers", "[ds18b20]")
+{
+    ds18b20_adaptive_t probe;
+    ds18b20_adaptive_init(&probe);
+    int64_t now = 0;
+    TEST_ASSERT_EQUAL_UINT8(9, run(&probe, step_then_flat, &now, 3000000, NULL));
+    /* Quantisation flicker at 9 bit must not hold the probe fast once the ramp ends. */
+    TEST_ASSERT_EQUAL_UINT8(12, run(&probe, step_then_flat, &now, 20000000, NULL));
+}
+
+TEST_CASE("ds18b20 adaptive uses 10 bit for moderate drift", "[ds18b20]")
+{
+    ds18b20_adaptive_t probe;
+    ds18b20_adaptive_init(&probe);
+    probe.resolution_bits = 10;
+    probe.has_sample = true;
+    probe.anchor_c = 20.0f;
+    probe.anchor_us = 0;
+    probe.moved_c = 20.0f;
+    probe.rate_mc_per_s = 100.0f;
+    /* 0.1 C/s sustained: above the moderate threshold, below the fast one. */
+    TEST_ASSERT_EQUAL_UINT8(10, ds18b20_adaptive_update(&probe, &s_config, 20.5f, 2000000));
+    TEST_ASSERT_EQUAL_UINT8(10, ds18b20_adaptive_update(&probe, &s_config, 21.0f, 4000000));
+}
+
+TEST_CASE("ds18b20 adaptive samples a moving probe faster than fixed 12 bit", "[ds18b20]")
+{
+    ds18b20_adaptive_t probe;
+    ds18b20_adaptive_init(&probe);
+    int64_t now = 0;
+    uint32_t adaptive = 0;
+    run(&probe, ramp, &now, 10000000, &adaptive);
+    uint32_t fixed = 10000U / ds18b20_conversion_time_ms(12);
+    TEST_ASSERT_GREATER_OR_EQUAL(fixed * 5U, adaptive);
+}
+
+static float s_ramp_c_per_s;
+
+static float slow_ramp(int64_t now_us)
+{
+    return 20.3f + s_ramp_c_per_s * (float)now_us / 1e6f;
+}
+
+TEST_CASE("ds18b20 adaptive holds one resolution on a ramp near a threshold", "[ds18b20]")
+{
+    /* Both sides of each threshold: the coarser LSB discounts enough to make these
+     * ramps look calm to the windowed rate right after a drop. */
+    static const float rates[] = {0.09f, 0.1f, 0.15f, 0.25f, 0.5f, 0.6f};
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i) {
+        ds18b20_adaptive_t probe;
+        ds18b20_adaptive_init(&probe);
+        s_ramp_c_per_s = rates[i];
+        int64_t now = 0;
+        uint8_t settled = run(&probe, slow_ramp, &now, 20000000, NULL);
+        while (now < 80000000) {
+            TEST_ASSERT_EQUAL_UINT8(settled, run(&probe, slow_ramp, &now, now + 1, NULL));
+        }
+    }
+}
@@ -0,0 +1,208 @@
+#include "history_store.h"
+
+#include "esp_timer.h"
+#include "unity.h"
+#include <math.h>
+#include <stdio.h>
+
+static const history_tier_config_t s_tiers[PROTO_HISTORY_TIER_COUNT] = {
+    [PROTO_HISTORY_TIER_RAW] = {5, 8},
+    [PROTO_HISTORY_TIER_MINUTE] = {60, 16},
+    [PROTO_HISTORY_TIER_HOUR] = {3600, 4},
+};
+
+static proto_history_t s_page;
+
+static void read_page(history_store_t *store, proto_history_tier_t tier, uint32_t from_s, uint16_t max_points)
+{
+    proto_history_request_t request = {
+        .sequence_id = 7,
+        .channel = PROTO_HISTORY_CH_AMBIENT_TEMP_0,
+        .tier = tier,
+        .from_s = from_s,
+        .max_points = max_points,
+    };
+    TEST_ASSERT_TRUE(history_store_read(store, &request, &s_page));
+    TEST_ASSERT_EQUAL_UINT32(7, s_page.sequence_id);
+}
+
+TEST_CASE("history store converts readings to wire fixed point", "[history_store]")
+{
+    TEST_ASSERT_EQUAL_INT(2153, history_store_to_fixed(PROTO_HISTORY_CH_AMBIENT_TEMP_0, 21.53f));
+    TEST_ASSERT_EQUAL_INT(-1025, history_store_to_fixed(PROTO_HISTORY_CH_DS18B20_2, -10.25f));
+    TEST_ASSERT_EQUAL_INT(10132, history_store_to_fixed(PROTO_HISTORY_CH_AMBIENT_PRESSURE_1, 101324.0f));
+    TEST_ASSERT_EQUAL_INT(INT16_MAX, history_store_to_fixed(PROTO_HISTORY_CH_AMBIENT_TEMP_0, 900.0f));
+    TEST_ASSERT_EQUAL_INT(INT16_MIN + 1, history_store_to_fixed(PROTO_HISTORY_CH_AMBIENT_TEMP_0, -900.0f));
+    TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, history_store_to_fixed(PROTO_HISTORY_CH_AMBIENT_TEMP_0, NAN));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 45.5f, history_store_from_fixed(PROTO_HISTORY_CH_AMBIENT_HUMIDITY_0, 4550));
+    TEST_ASSERT_TRUE(isnan(history_store_from_fixed(PROTO_HISTORY_CH_AMBIENT_TEMP_0, PROTO_HISTORY_NONE)));
+}
+
+TEST_CASE("history store aggregates min max mean per bucket", "[history_store]")
+{
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 10, 20.0f);
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 12, 22.0f);
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 14, 21.5f);
+
+    /* The open bucket is not readable yet. */
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(0, s_page.count);
+
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 15, 19.0f);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(1, s_page.count);
+    TEST_ASSERT_EQUAL_UINT32(10, s_page.start_s);
+    TEST_ASSERT_EQUAL_UINT32(5, s_page.period_s);
+    TEST_ASSERT_FALSE(s_page.more);
+    TEST_ASSERT_EQUAL_INT(2000, s_page.min[0]);
+    TEST_ASSERT_EQUAL_INT(2200, s_page.max[0]);
+    TEST_ASSERT_EQUAL_INT(2117, s_page.mean[0]);
+
+    /* Coarser tiers keep accumulating until their own boundary. */
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 61, 30.0f);
+    read_page(&store, PROTO_HISTORY_TIER_MINUTE, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(1, s_page.count);
+    TEST_ASSERT_EQUAL_UINT32(0, s_page.start_s);
+    TEST_ASSERT_EQUAL_INT(1900, s_page.min[0]);
+    TEST_ASSERT_EQUAL_INT(2200, s_page.max[0]);
+    TEST_ASSERT_EQUAL_INT(2063, s_page.mean[0]);
+    history_store_deinit(&store);
+}
+
+TEST_CASE("history store marks silent buckets and channels empty", "[history_store]")
+{
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 0, 20.0f);
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 16, 21.0f);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(3, s_page.count);
+    TEST_ASSERT_EQUAL_INT(2000, s_page.mean[0]);
+    TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, s_page.min[1]);
+    TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, s_page.max[2]);
+    TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, s_page.mean[2]);
+
+    proto_history_request_t request = {.channel = PROTO_HISTORY_CH_DS18B20_3, .tier = PROTO_HISTORY_TIER_RAW};
+    TEST_ASSERT_TRUE(history_store_read(&store, &request, &s_page));
+    TEST_ASSERT_EQUAL_UINT16(3, s_page.count);
+    TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, s_page.mean[0]);
+
+    request.channel = PROTO_HISTORY_CHANNEL_COUNT;
+    TEST_ASSERT_FALSE(history_store_read(&store, &request, &s_page));
+    history_store_deinit(&store);
+}
+
+TEST_CASE("history store pages from the oldest bucket kept after wrapping", "[history_store]")
+{
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    for (uint32_t t = 0; t <= 100; t += 5) {
+        history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, t, (float)t);
+    }
+    /* Bucket 20 is open; the ring of 8 keeps closed buckets 13..19. */
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 3);
+    TEST_ASSERT_EQUAL_UINT32(65, s_page.start_s);
+    TEST_ASSERT_EQUAL_UINT16(3, s_page.count);
+    TEST_ASSERT_TRUE(s_page.more);
+    const int16_t first[] = {6500, 7000, 7500};
+    TEST_ASSERT_EQUAL_INT16_ARRAY(first, s_page.mean, 3);
+
+    read_page(&store, PROTO_HISTORY_TIER_RAW, s_page.start_s + s_page.count * s_page.period_s, 3);
+    TEST_ASSERT_EQUAL_UINT32(80, s_page.start_s);
+    TEST_ASSERT_TRUE(s_page.more);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, s_page.start_s + s_page.count * s_page.period_s, 3);
+    TEST_ASSERT_EQUAL_UINT32(95, s_page.start_s);
+    TEST_ASSERT_EQUAL_UINT16(1, s_page.count);
+    TEST_ASSERT_FALSE(s_page.more);
+    TEST_ASSERT_EQUAL_INT(9500, s_page.max[0]);
+
+    /* A jump longer than the ring leaves only empty buckets behind. */
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 1000, 1.0f);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(965, s_page.start_s);
+    TEST_ASSERT_EQUAL_UINT16(7, s_page.count);
+    for (uint16_t i = 0; i < s_page.count; ++i) {
+        TEST_ASSERT_EQUAL_INT(PROTO_HISTORY_NONE, s_page.mean[i]);
+    }
+    history_store_deinit(&store);
+}
+
+TEST_CASE("history store folds late samples into the open bucket", "[history_store]")
+{
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 20, 10.0f);
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 12, 30.0f);
+    history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, 25, 0.0f);
+    history_store_stats_t stats;
+    history_store_get_stats(&store, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.late_samples);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT32(20, s_page.start_s);
+    TEST_ASSERT_EQUAL_UINT16(1, s_page.count);
+    TEST_ASSERT_EQUAL_INT(3000, s_page.max[0]);
+    history_store_deinit(&store);
+}
+
+TEST_CASE("history store keeps closing buckets across the millisecond stamp wrap", "[history_store]")
+{
+    const uint64_t wrap_ms = (uint64_t)UINT32_MAX + 1U;
+    TEST_ASSERT_EQUAL_UINT32(1000, history_store_sample_time_s(1000500U, 1000700000LL));
+    /* 49.7 days in: the stamp has wrapped to 200 ms but the sample is 4294967.496 s old. */
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)((wrap_ms + 200U) / 1000U),
+                             history_store_sample_time_s(200U, (int64_t)(wrap_ms + 300U) * 1000));
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)((wrap_ms - 600U) / 1000U),
+                             history_store_sample_time_s(UINT32_MAX - 599U, (int64_t)(wrap_ms + 300U) * 1000));
+
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    /* One sample every 5 s from 20 s before the wrap to 20 s after, stamped like t_sensors does. */
+    uint64_t first_ms = wrap_ms - 20000U;
+    for (uint64_t t_ms = first_ms; t_ms <= wrap_ms + 20000U; t_ms += 5000U) {
+        uint32_t time_s = history_store_sample_time_s((uint32_t)t_ms, (int64_t)(t_ms + 50U) * 1000);
+        history_store_record(&store, PROTO_HISTORY_CH_AMBIENT_TEMP_0, time_s, (float)(t_ms - first_ms) / 1000.0f);
+    }
+    history_store_stats_t stats;
+    history_store_get_stats(&store, &stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.late_samples);
+    read_page(&store, PROTO_HISTORY_TIER_RAW, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(7, s_page.count);
+    TEST_ASSERT_EQUAL_UINT32(5U * (uint32_t)(first_ms / 5000U) + 5U, s_page.start_s);
+    for (uint16_t i = 0; i < s_page.count; ++i) {
+        TEST_ASSERT_NOT_EQUAL(PROTO_HISTORY_NONE, s_page.mean[i]);
+    }
+    TEST_ASSERT_TRUE(s_page.mean[6] > s_page.mean[0]);
+    history_store_deinit(&store);
+}
+
+TEST_CASE("history store rejects unusable tiers", "[history_store]")
+{
+    history_store_t store;
+    history_tier_config_t tiers[PROTO_HISTORY_TIER_COUNT] = {{5, 8}, {60, 1}, {3600, 4}};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, history_store_init(&store, tiers));
+    tiers[1] = (history_tier_config_t){0, 8};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, history_store_init(&store, tiers));
+    TEST_ASSERT_EQUAL_size_t(28U * PROTO_HISTORY_CHANNEL_COUNT * 3U * sizeof(int16_t), history_store_size(s_tiers));
+}
+
+TEST_CASE("history store append cost", "[history_store][perf]")
+{
+    history_store_t store;
+    TEST_ASSERT_EQUAL(ESP_OK, history_store_init(&store, s_tiers));
+    const uint32_t samples = 100000;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < samples; ++i) {
+        history_store_record(&store, (proto_history_channel_t)(i % PROTO_HISTORY_CHANNEL_COUNT), i / 10U,
+                             20.0f + (float)(i % 7U));
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    printf("history store: %u samples in %lld us (%u ns each)\n", (unsigned)samples, (long long)elapsed,
+           (unsigned)(elapsed * 1000 / samples));
+    read_page(&store, PROTO_HISTORY_TIER_HOUR, 0, 0);
+    TEST_ASSERT_EQUAL_UINT16(2, s_page.count);
+    TEST_ASSERT_EQUAL_INT(2000, s_page.min[0]);
+    TEST_ASSERT_EQUAL_INT(2600, s_page.max[0]);
+    history_store_deinit(&store);
+}
@@ -0,0 +1,296 @@
+#include "i2c_engine.h"
+
+#include "i2c_bus.h"
+#include "i2c_mock.h"
+#include "unity.h"
+#include <string.h>
+
+/* Roughly a 400 kHz transaction: start/address overhead plus 9 clocks per byte. */
+#define FAKE_BUS_OVERHEAD_US 50
+#define FAKE_BUS_BYTE_US 23
+
+static int64_t s_now_us;
+static unsigned s_recoveries;
+static unsigned s_notifications;
+static uint8_t s_order[16];
+static size_t s_order_len;
+
+static esp_err_t fake_transfer(uint8_t addr, const uint8_t *wr, size_t wr_len, uint8_t *rd, size_t rd_len,
+                               uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    s_now_us += FAKE_BUS_OVERHEAD_US + (int64_t)(wr_len + rd_len + 1) * FAKE_BUS_BYTE_US;
+    if (wr_len > 0 && rd_len > 0) {
+        return i2c_bus_write_read(addr, wr, wr_len, rd, rd_len);
+    }
+    if (rd_len > 0) {
+        return i2c_bus_read(addr, rd, rd_len);
+    }
+    return i2c_bus_write(addr, wr, wr_len);
+}
+
+static esp_err_t fake_recover(void)
+{
+    ++s_recoveries;
+    return ESP_OK;
+}
+
+static int64_t fake_now(void)
+{
+    return s_now_us;
+}
+
+static void fake_notify(void)
+{
+    ++s_notifications;
+}
+
+static void record_done(esp_err_t err, void *ctx)
+{
+    (void)err;
+    s_order[s_order_len++] = (uint8_t)(uintptr_t)ctx;
+}
+
+static void setup_engine(i2c_engine_t *engine)
+{
+    const i2c_engine_platform_t platform = {
+        .transfer = fake_transfer,
+        .recover = fake_recover,
+        .now_us = fake_now,
+        .notify = fake_notify,
+    };
+    s_now_us = 1000;
+    s_recoveries = 0;
+    s_notifications = 0;
+    s_order_len = 0;
+    i2c_mock_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_init(engine, &platform));
+}
+
+static void drain(i2c_engine_t *engine)
+{
+    while (i2c_engine_pending(engine) > 0) {
+        if (!i2c_engine_process(engine)) {
+            int64_t wake = i2c_engine_next_wake_us(engine);
+            TEST_ASSERT_TRUE(wake > s_now_us);
+            s_now_us = wake;
+        }
+    }
+}
+
+static i2c_engine_request_t make_write(uint8_t addr, i2c_class_t cls, const uint8_t *data, size_t len, uintptr_t tag)
+{
+    i2c_engine_request_t req = {
+        .addr = addr,
+        .cls = cls,
+        .write_data = data,
+        .write_len = len,
+        .done = record_done,
+        .ctx = (void *)tag,
+    };
+    return req;
+}
+
+TEST_CASE("i2c engine serves higher classes first", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    const uint8_t reg = 0x00;
+    const uint8_t duty[] = {0x06, 0x00, 0x00, 0x00, 0x04};
+    uint8_t id = 0;
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x41, {0x06, 0x00, 0x00, 0x00, 0x04}, 5, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, 0x20, {0x00}, 1, {0xAB}, 1, ESP_OK},
+        {I2C_MOCK_WRITE, 0x40, {0x00}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x76, {0x00}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+
+    i2c_engine_request_t ambient = make_write(0x40, I2C_CLASS_AMBIENT, &reg, 1, 1);
+    i2c_engine_request_t input = make_write(0x20, I2C_CLASS_GPIO_INPUT, &reg, 1, 2);
+    input.read_data = &id;
+    input.read_len = 1;
+    i2c_engine_request_t ambient2 = make_write(0x76, I2C_CLASS_AMBIENT, &reg, 1, 3);
+    i2c_engine_request_t actuation = make_write(0x41, I2C_CLASS_ACTUATION, duty, sizeof(duty), 4);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &ambient));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &input));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &ambient2));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &actuation));
+    TEST_ASSERT_EQUAL_UINT32(4, s_notifications);
+
+    drain(&engine);
+    i2c_mock_assert_complete();
+    const uint8_t expected[] = {4, 2, 1, 3};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, s_order, sizeof(expected));
+    TEST_ASSERT_EQUAL_HEX8(0xAB, id);
+}
+
+TEST_CASE("i2c engine backs off retries without blocking other classes", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    const uint8_t reg = 0x12;
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x40, {0x12}, 1, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE, 0x41, {0x12}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x40, {0x12}, 1, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE, 0x40, {0x12}, 1, {0}, 0, ESP_FAIL},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+
+    i2c_engine_request_t ambient = make_write(0x40, I2C_CLASS_AMBIENT, &reg, 1, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &ambient));
+    TEST_ASSERT_TRUE(i2c_engine_process(&engine));
+    TEST_ASSERT_FALSE(i2c_engine_process(&engine));
+
+    /* The actuation request arrives during the backoff and goes straight through. */
+    i2c_engine_request_t actuation = make_write(0x41, I2C_CLASS_ACTUATION, &reg, 1, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &actuation));
+    drain(&engine);
+    i2c_mock_assert_complete();
+
+    const uint8_t expected[] = {2, 1};
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, s_order, sizeof(expected));
+    TEST_ASSERT_EQUAL_UINT32(0, s_recoveries);
+
+    i2c_engine_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_get_stats(&engine, I2C_CLASS_AMBIENT, &stats));
+    TEST_ASSERT_EQUAL_UINT32(2, stats.retries);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.failed);
+    TEST_ASSERT_TRUE(stats.max_latency_us >= I2C_ENGINE_BACKOFF_BASE_US * 3);
+}
+
+TEST_CASE("i2c engine recovers the bus after consecutive failures", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    const uint8_t reg = 0x00;
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x40, {0x00}, 1, {0}, 0, ESP_ERR_TIMEOUT},
+        {I2C_MOCK_WRITE, 0x76, {0x00}, 1, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE, 0x40, {0x00}, 1, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE, 0x76, {0x00}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x40, {0x00}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    i2c_engine_request_t first = make_write(0x40, I2C_CLASS_AMBIENT, &reg, 1, 1);
+    i2c_engine_request_t second = make_write(0x76, I2C_CLASS_GPIO_INPUT, &reg, 1, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &first));
+    TEST_ASSERT_TRUE(i2c_engine_process(&engine));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &second));
+    TEST_ASSERT_TRUE(i2c_engine_process(&engine));
+    TEST_ASSERT_EQUAL_UINT32(0, s_recoveries);
+    drain(&engine);
+    i2c_mock_assert_complete();
+    TEST_ASSERT_EQUAL_UINT32(1, s_recoveries);
+    TEST_ASSERT_EQUAL_UINT32(1, engine.recoveries);
+    TEST_ASSERT_EQUAL_UINT32(1, i2c_engine_recoveries(&engine));
+}
+
+TEST_CASE("i2c engine expires requests past their deadline without touching the bus", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    const uint8_t reg = 0x00;
+    i2c_engine_set_device_timeout(&engine, 0x40, 5);
+    i2c_engine_request_t req = make_write(0x40, I2C_CLASS_AMBIENT, &reg, 1, 1);
+    req.done = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &req));
+    TEST_ASSERT_EQUAL_INT64(1000, i2c_engine_next_wake_us(&engine));
+    s_now_us += 6000;
+    TEST_ASSERT_TRUE(i2c_engine_process(&engine));
+    TEST_ASSERT_EQUAL_size_t(0, i2c_engine_pending(&engine));
+    TEST_ASSERT_EQUAL_INT64(-1, i2c_engine_next_wake_us(&engine));
+    i2c_mock_assert_complete();
+
+    i2c_engine_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_get_stats(&engine, I2C_CLASS_AMBIENT, &stats));
+    TEST_ASSERT_EQUAL_UINT32(1, stats.timed_out);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.completed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.histogram[6]);
+}
+
+TEST_CASE("i2c engine rejects oversized writes and a full queue", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    static const uint8_t big[I2C_ENGINE_MAX_WRITE + 1];
+    i2c_engine_request_t req = make_write(0x41, I2C_CLASS_ACTUATION, big, sizeof(big), 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, i2c_engine_submit(&engine, &req));
+    req.write_len = 1;
+    for (int i = 0; i < I2C_ENGINE_QUEUE_DEPTH; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &req));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, i2c_engine_submit(&engine, &req));
+    TEST_ASSERT_EQUAL_size_t(I2C_ENGINE_QUEUE_DEPTH, i2c_engine_pending(&engine));
+}
+
+TEST_CASE("i2c engine keeps actuation latency bounded under mixed load", "[i2c_engine]")
+{
+    static i2c_engine_t engine;
+    setup_engine(&engine);
+    /* Every 1 ms tick: one PWM update, one MCP poll and, every 5 ticks, a burst of ambient reads. */
+    static const uint8_t duty[] = {0x06, 0x00, 0x00, 0x00, 0x04};
+    static const uint8_t reg = 0x00;
+    static uint8_t rx[8];
+    size_t ops = 0;
+    for (int tick = 0; tick < 200; ++tick) {
+        i2c_engine_request_t ambient = make_write(0x76, I2C_CLASS_AMBIENT, &reg, 1, 0);
+        ambient.read_data = rx;
+        ambient.read_len = sizeof(rx);
+        ambient.done = NULL;
+        if (tick % 5 == 0) {
+            for (int i = 0; i < 4; ++i) {
+                TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &ambient));
+                ++ops;
+            }
+        }
+        i2c_engine_request_t input = make_write(0x20, I2C_CLASS_GPIO_INPUT, &reg, 1, 0);
+        input.read_data = rx;
+        input.read_len = 2;
+        input.done = NULL;
+        i2c_engine_request_t actuation = make_write(0x41, I2C_CLASS_ACTUATION, duty, sizeof(duty), 0);
+        actuation.done = NULL;
+        TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &input));
+        TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_submit(&engine, &actuation));
+        ops += 2;
+
+        int64_t tick_end = 1000 + (int64_t)(tick + 1) * 1000;
+        while (s_now_us < tick_end && i2c_engine_pending(&engine) > 0) {
+            i2c_mock_op_t op = {I2C_MOCK_WRITE, 0, {0}, 0, {0}, 0, ESP_OK};
+            const i2c_engine_slot_t *next = NULL;
+            for (int cls = 0; cls < I2C_CLASS_COUNT && !next; ++cls) {
+                if (engine.head[cls] >= 0) {
+                    next = &engine.slots[engine.head[cls]];
+                }
+            }
+            op.type = next->req.read_len ? I2C_MOCK_WRITE_READ : I2C_MOCK_WRITE;
+            op.address = next->req.addr;
+            op.write_len = next->req.write_len;
+            memcpy(op.write_data, next->req.write_data, next->req.write_len);
+            op.read_len = next->req.read_len;
+            i2c_mock_set_sequence(&op, 1);
+            TEST_ASSERT_TRUE(i2c_engine_process(&engine));
+        }
+        if (s_now_us < tick_end) {
+            s_now_us = tick_end;
+        }
+    }
+    TEST_ASSERT_EQUAL_size_t(0, i2c_engine_pending(&engine));
+
+    uint32_t total = 0;
+    i2c_engine_stats_t stats[I2C_CLASS_COUNT];
+    for (int cls = 0; cls < I2C_CLASS_COUNT; ++cls) {
+        TEST_ASSERT_EQUAL(ESP_OK, i2c_engine_get_stats(&engine, (i2c_class_t)cls, &stats[cls]));
+        uint32_t binned = 0;
+        for (unsigned i = 0; i < I2C_ENGINE_HIST_BUCKETS; ++i) {
+            binned += stats[cls].histogram[i];
+        }
+        TEST_ASSERT_EQUAL_UINT32(stats[cls].completed, binned);
+        total += stats[cls].completed;
+    }
+    TEST_ASSERT_EQUAL_UINT32(ops, total);
+    TEST_ASSERT_TRUE(stats[I2C_CLASS_ACTUATION].max_latency_us <= stats[I2C_CLASS_AMBIENT].max_latency_us);
+    /* An ambient burst may delay actuation by one transaction, never by a whole tick. */
+    TEST_ASSERT_LESS_THAN_UINT32(1000, stats[I2C_CLASS_ACTUATION].max_latency_us);
+}
@@ -0,0 +1,140 @@
+#include "i2c_mux.h"
+
+#include "i2c_mock.h"
+#include "unity.h"
+
+TEST_CASE("i2c mux skips redundant channel selects", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x70, {0x04}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x70, {0x20}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    const i2c_mux_route_t ch2 = {.mux_address = 0x70, .channel = 2};
+    const i2c_mux_route_t ch5 = {.mux_address = 0x70, .channel = 5};
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch2));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch2));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch5));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch5));
+    i2c_mock_assert_complete();
+
+    i2c_mux_stats_t stats;
+    i2c_mux_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.selects);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.channel_writes);
+}
+
+TEST_CASE("i2c mux routes through cascaded multiplexers", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x71, 0, I2C_MUX_CHANNEL_NONE));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x72, 0x70, 3));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, i2c_mux_register(0x73, 0x74, 0));
+
+    i2c_mock_op_t ops[] = {
+        /* Leaf behind 0x70:3 -> 0x72:1; the other root mux is disconnected. */
+        {I2C_MOCK_WRITE, 0x70, {0x08}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x72, {0x02}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x71, {0x00}, 1, {0}, 0, ESP_OK},
+        /* Switching to 0x71:0 hides 0x72 by disconnecting its parent. */
+        {I2C_MOCK_WRITE, 0x71, {0x01}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x70, {0x00}, 1, {0}, 0, ESP_OK},
+        /* Coming back only re-opens the parent; 0x72 kept its channel. */
+        {I2C_MOCK_WRITE, 0x70, {0x08}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x71, {0x00}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    const i2c_mux_route_t leaf = {.mux_address = 0x72, .channel = 1};
+    const i2c_mux_route_t other = {.mux_address = 0x71, .channel = 0};
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&other));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("i2c mux rewrites a channel after a failed select", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x70, {0x01}, 1, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE, 0x70, {0x01}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    const i2c_mux_route_t ch0 = {.mux_address = 0x70, .channel = 0};
+    TEST_ASSERT_EQUAL(ESP_FAIL, i2c_mux_select(&ch0));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch0));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("i2c mux orders work to minimise channel switches", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    i2c_mock_op_t op = {I2C_MOCK_WRITE, 0x70, {0x20}, 1, {0}, 0, ESP_OK};
+    i2c_mock_set_sequence(&op, 1);
+    const i2c_mux_route_t ch5 = {.mux_address = 0x70, .channel = 5};
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch5));
+    i2c_mock_assert_complete();
+
+    const i2c_mux_route_t routes[] = {
+        {.mux_address = 0x70, .channel = 2},
+        {.mux_address = 0x70, .channel = 5},
+        {.mux_address = 0, .channel = I2C_MUX_CHANNEL_NONE},
+        {.mux_address = 0x70, .channel = 2},
+        {.mux_address = 0x70, .channel = 5},
+    };
+    size_t order[5];
+    i2c_mux_order(routes, 5, order);
+    const size_t expected[] = {1, 4, 0, 3, 2};
+    for (size_t i = 0; i < 5; ++i) {
+        TEST_ASSERT_EQUAL_size_t(expected[i], order[i]);
+    }
+}
+
+TEST_CASE("i2c mux rewrites the route after a transaction behind it fails", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x72, 0x70, 3));
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x70, {0x08}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x72, {0x02}, 1, {0}, 0, ESP_OK},
+        /* The device behind 0x72:1 stopped answering: the whole path is rewritten. */
+        {I2C_MOCK_WRITE, 0x70, {0x08}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x72, {0x02}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    const i2c_mux_route_t leaf = {.mux_address = 0x72, .channel = 1};
+    const i2c_mux_route_t root = {.mux_address = 0, .channel = I2C_MUX_CHANNEL_NONE};
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    i2c_mux_route_failed(&root);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    i2c_mux_route_failed(&leaf);
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&leaf));
+    i2c_mock_assert_complete();
+
+    i2c_mux_stats_t stats;
+    i2c_mux_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(4, stats.channel_writes);
+}
+
+TEST_CASE("i2c mux rewrites every channel after invalidation", "[i2c_mux]")
+{
+    i2c_mux_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_register(0x70, 0, I2C_MUX_CHANNEL_NONE));
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, 0x70, {0x10}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x70, {0x10}, 1, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    const i2c_mux_route_t ch4 = {.mux_address = 0x70, .channel = 4};
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch4));
+    i2c_mux_invalidate();
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_mux_select(&ch4));
+    i2c_mock_assert_complete();
+}
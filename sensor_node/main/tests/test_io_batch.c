@@ -0,0 +1,88 @@
+#include "io/io_batch.h"
+
+#include "unity.h"
+
+TEST_CASE("io batch collapses superseded pwm commands", "[io_batch]")
+{
+    io_batch_t batch;
+    io_batch_init(&batch);
+    for (uint16_t i = 0; i < 16; ++i) {
+        io_batch_add_pwm(&batch, 3, (uint16_t)(i * 100), 1000 + i);
+    }
+    io_batch_add_pwm(&batch, 7, 42, 1100);
+    TEST_ASSERT_TRUE(io_batch_pending(&batch, IO_LANE_PWM));
+    TEST_ASSERT_FALSE(io_batch_pending(&batch, IO_LANE_GPIO));
+    TEST_ASSERT_EQUAL_HEX16((1U << 3) | (1U << 7), batch.pwm_mask);
+    TEST_ASSERT_EQUAL_UINT16(1500, batch.pwm[3]);
+    TEST_ASSERT_EQUAL_UINT16(42, batch.pwm[7]);
+    TEST_ASSERT_EQUAL_UINT32(17, batch.stats[IO_LANE_PWM].commands);
+    TEST_ASSERT_EQUAL_UINT32(15, batch.stats[IO_LANE_PWM].superseded);
+
+    io_batch_complete(&batch, IO_LANE_PWM, 2000);
+    TEST_ASSERT_FALSE(io_batch_pending(&batch, IO_LANE_PWM));
+    TEST_ASSERT_EQUAL_HEX16(0, batch.pwm_mask);
+    TEST_ASSERT_EQUAL_UINT32(1, batch.stats[IO_LANE_PWM].flushes);
+}
+
+TEST_CASE("io batch merges gpio writes per pin", "[io_batch]")
+{
+    io_batch_t batch;
+    io_batch_init(&batch);
+    io_batch_add_gpio(&batch, 0, 0x000F, 0x0005, 0);
+    io_batch_add_gpio(&batch, 0, 0x0003, 0x0002, 0);
+    io_batch_add_gpio(&batch, 0, 0x0100, 0x0100, 0);
+    io_batch_add_gpio(&batch, 1, 0x00F0, 0x0010, 0);
+    TEST_ASSERT_EQUAL_HEX16(0x010F, batch.gpio_mask[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x0106, batch.gpio_value[0]);
+    TEST_ASSERT_EQUAL_HEX16(0x00F0, batch.gpio_mask[1]);
+    TEST_ASSERT_EQUAL_HEX16(0x0010, batch.gpio_value[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, batch.stats[IO_LANE_GPIO].superseded);
+
+    io_batch_add_pwm_freq(&batch, 500, 0);
+    io_batch_add_pwm_freq(&batch, 1000, 0);
+    TEST_ASSERT_EQUAL_UINT16(1000, batch.freq);
+    TEST_ASSERT_EQUAL_UINT32(1, batch.stats[IO_LANE_PWM_FREQ].superseded);
+}
+
+TEST_CASE("io batch tracks queue-to-hardware latency", "[io_batch]")
+{
+    io_batch_t batch;
+    io_batch_init(&batch);
+    io_batch_add_gpio(&batch, 0, 0x0001, 0x0001, 1000);
+    io_batch_add_gpio(&batch, 1, 0x0001, 0x0001, 1400);
+    io_batch_complete(&batch, IO_LANE_GPIO, 1500);
+    TEST_ASSERT_EQUAL_UINT32(500, batch.stats[IO_LANE_GPIO].max_latency_us);
+    TEST_ASSERT_EQUAL_UINT64(600, batch.stats[IO_LANE_GPIO].total_latency_us);
+
+    /* A superseded value is timed from the first request for that channel. */
+    io_batch_add_pwm(&batch, 0, 1, 2000);
+    io_batch_add_pwm(&batch, 0, 2, 2900);
+    io_batch_complete(&batch, IO_LANE_PWM, 3000);
+    TEST_ASSERT_EQUAL_UINT32(1000, batch.stats[IO_LANE_PWM].max_latency_us);
+    TEST_ASSERT_EQUAL_UINT64(1000, batch.stats[IO_LANE_PWM].total_latency_us);
+
+    /* Completing an idle lane records nothing. */
+    io_batch_complete(&batch, IO_LANE_PWM, 9000);
+    TEST_ASSERT_EQUAL_UINT32(1, batch.stats[IO_LANE_PWM].flushes);
+}
+
+TEST_CASE("io batch keeps a failed lane pending", "[io_batch]")
+{
+    io_batch_t batch;
+    io_batch_init(&batch);
+    io_batch_add_gpio(&batch, 1, 0x0004, 0x0004, 1000);
+    io_batch_fail(&batch, IO_LANE_GPIO);
+    TEST_ASSERT_TRUE(io_batch_pending(&batch, IO_LANE_GPIO));
+    TEST_ASSERT_EQUAL_HEX16(0x0004, batch.gpio_mask[1]);
+    TEST_ASSERT_EQUAL_UINT32(1, batch.stats[IO_LANE_GPIO].errors);
+    TEST_ASSERT_EQUAL_UINT32(0, batch.stats[IO_LANE_GPIO].flushes);
+
+    /* The retry is timed from the original request. */
+    io_batch_complete(&batch, IO_LANE_GPIO, 3000);
+    TEST_ASSERT_FALSE(io_batch_pending(&batch, IO_LANE_GPIO));
+    TEST_ASSERT_EQUAL_UINT32(2000, batch.stats[IO_LANE_GPIO].max_latency_us);
+
+    /* Failing an idle lane records nothing. */
+    io_batch_fail(&batch, IO_LANE_PWM);
+    TEST_ASSERT_EQUAL_UINT32(0, batch.stats[IO_LANE_PWM].errors);
+}
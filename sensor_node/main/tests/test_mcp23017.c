@@ -1,7 +1,21 @@
 #include "drivers/mcp23017.h"
 
+#include "i2c_bus.h"
 #include "i2c_mock.h"
 #include "unity.h"
+#include <string.h>
+
+static void init_device(uint8_t addr, uint16_t olat)
+{
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x00, 0x00, 0x00}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x0C, 0x00, 0x00}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0x14}, 1, {(uint8_t)(olat & 0xFF), (uint8_t)(olat >> 8)}, 2, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_init(addr, 0x0000, 0x0000));
+    i2c_mock_assert_complete();
+}
 
 TEST_CASE("mcp23017 configures directions and pullups", "[mcp23017]")
 {
@@ -9,6 +23,7 @@ TEST_CASE("mcp23017 configures directions and pullups", "[mcp23017]")
     i2c_mock_op_t ops[] = {
         {I2C_MOCK_WRITE, addr, {0x00, 0xFF, 0x00}, 3, {0}, 0, ESP_OK},
         {I2C_MOCK_WRITE, addr, {0x0C, 0xFF, 0xFF}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0x14}, 1, {0x00, 0x00}, 2, ESP_OK},
     };
     i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
     TEST_ASSERT_EQUAL(ESP_OK, mcp23017_init(addr, 0x00FF, 0xFFFF));
@@ -18,11 +33,105 @@ TEST_CASE("mcp23017 configures directions and pullups", "[mcp23017]")
 TEST_CASE("mcp23017 write gpio applies mask", "[mcp23017]")
 {
     const uint8_t addr = 0x20;
+    init_device(addr, 0x55AA);
     i2c_mock_op_t ops[] = {
-        {I2C_MOCK_WRITE_READ, addr, {0x14}, 1, {0xAA, 0x55}, 2, ESP_OK},
-        {I2C_MOCK_WRITE, addr, {0x14, (uint8_t)((0xAA & ~0x0F) | 0x05), 0x55}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x14, (uint8_t)((0xAA & ~0x0F) | 0x05)}, 2, {0}, 0, ESP_OK},
     };
     i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
     TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x000F, 0x0005));
     i2c_mock_assert_complete();
 }
+
+TEST_CASE("mcp23017 writes only the ports that change", "[mcp23017]")
+{
+    const uint8_t addr = 0x21;
+    init_device(addr, 0x0000);
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x15, 0x80}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x14, 0x01, 0x00}, 3, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x8000, 0x8000));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x8000, 0xFFFF));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x8001, 0x0001));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("mcp23017 re-reads the latches after a failed write", "[mcp23017]")
+{
+    const uint8_t addr = 0x22;
+    init_device(addr, 0x0000);
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x14, 0x01}, 2, {0}, 0, ESP_FAIL},
+        {I2C_MOCK_WRITE_READ, addr, {0x14}, 1, {0x01, 0x00}, 2, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x14, 0x03}, 2, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x0001, 0x0001));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x0002, 0x0002));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("mcp23017 resync restores a reset device", "[mcp23017]")
+{
+    const uint8_t addr = 0x23;
+    init_device(addr, 0x0000);
+    i2c_mock_op_t ops[5] = {
+        {I2C_MOCK_WRITE, addr, {0x14, 0x0F}, 2, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x00FF, 0x000F));
+    i2c_mock_assert_complete();
+
+    /* Device still configured: its OLAT is adopted without writing. */
+    memset(ops, 0, sizeof(ops));
+    ops[0] = (i2c_mock_op_t){I2C_MOCK_WRITE_READ, addr, {0x00}, 1, {0}, 0x16, ESP_OK};
+    ops[0].read_data[0x14] = 0x0E;
+    i2c_mock_set_sequence(ops, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_resync(addr));
+    i2c_mock_assert_complete();
+
+    /* Power-on defaults (IODIR 0xFFFF, OLAT 0): configuration and latches are rewritten. */
+    memset(ops, 0, sizeof(ops));
+    ops[0] = (i2c_mock_op_t){I2C_MOCK_WRITE_READ, addr, {0x00}, 1, {0xFF, 0xFF}, 0x16, ESP_OK};
+    ops[1] = (i2c_mock_op_t){I2C_MOCK_WRITE, addr, {0x14, 0x0E, 0x00}, 3, {0}, 0, ESP_OK};
+    ops[2] = (i2c_mock_op_t){I2C_MOCK_WRITE, addr, {0x00, 0x00, 0x00}, 3, {0}, 0, ESP_OK};
+    ops[3] = (i2c_mock_op_t){I2C_MOCK_WRITE, addr, {0x0C, 0x00, 0x00}, 3, {0}, 0, ESP_OK};
+    i2c_mock_set_sequence(ops, 4);
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_resync(addr));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("mcp23017 masked write needs less traffic than read-modify-write", "[mcp23017]")
+{
+    const uint8_t addr = 0x24;
+    init_device(addr, 0x0000);
+
+    /* Previous driver: read OLATA/B, then write both back. */
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE_READ, addr, {0x14}, 1, {0x00, 0x00}, 2, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x14, 0x01, 0x00}, 3, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, 2);
+    uint8_t reg = 0x14;
+    uint8_t olat[2];
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_bus_write_read(addr, &reg, 1, olat, sizeof(olat)));
+    TEST_ASSERT_EQUAL(ESP_OK, i2c_bus_write(addr, ops[1].write_data, 3));
+    i2c_mock_assert_complete();
+    uint32_t rmw_tx = 0;
+    uint32_t rmw_bytes = 0;
+    i2c_mock_get_traffic(&rmw_tx, &rmw_bytes);
+
+    i2c_mock_op_t shadow_ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x14, 0x01}, 2, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(shadow_ops, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_write_gpio(addr, 0x0001, 0x0001));
+    i2c_mock_assert_complete();
+    uint32_t tx = 0;
+    uint32_t bytes = 0;
+    i2c_mock_get_traffic(&tx, &bytes);
+    TEST_ASSERT_EQUAL_UINT32(2, rmw_tx);
+    TEST_ASSERT_EQUAL_UINT32(1, tx);
+    TEST_ASSERT_LESS_THAN_UINT32(rmw_bytes, bytes);
+}
@@ -0,0 +1,102 @@
+#include "mcp_inputs.h"
+
+#include "drivers/mcp23017.h"
+#include "i2c_mock.h"
+#include "unity.h"
+
+typedef struct {
+    uint32_t calls;
+    size_t index;
+    uint16_t value;
+} publish_log_t;
+
+static void record_publish(size_t index, uint16_t value, void *ctx)
+{
+    publish_log_t *log = ctx;
+    ++log->calls;
+    log->index = index;
+    log->value = value;
+}
+
+TEST_CASE("mcp23017 enables interrupt-on-change", "[mcp23017]")
+{
+    const uint8_t addr = 0x20;
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x0A, 0x40}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x08, 0x00, 0x00}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x04, 0xFF, 0x0F}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0x0E}, 1, {0, 0, 0, 0, 0xFF, 0xFF}, 6, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp23017_enable_interrupts(addr, 0x0FFF));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("mcp inputs publish only changes", "[mcp23017]")
+{
+    const uint8_t addrs[2] = {0x20, 0x21};
+    publish_log_t log = {0};
+    mcp_inputs_t inputs;
+    i2c_mock_op_t init_ops[] = {
+        {I2C_MOCK_WRITE_READ, 0x20, {0x12}, 1, {0xFF, 0xFF}, 2, ESP_OK},
+        {I2C_MOCK_WRITE_READ, 0x21, {0x12}, 1, {0xF0, 0x0F}, 2, ESP_OK},
+    };
+    i2c_mock_set_sequence(init_ops, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, mcp_inputs_init(&inputs, addrs, 2, record_publish, &log));
+    TEST_ASSERT_EQUAL_UINT32(2, log.calls);
+
+    i2c_mock_op_t irq_ops[] = {
+        {I2C_MOCK_WRITE, 0x21, {0x0A, 0x40}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x21, {0x08, 0x00, 0x00}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, 0x21, {0x04, 0xFF, 0xFF}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, 0x21, {0x0E}, 1, {0, 0, 0, 0, 0xF0, 0x0F}, 6, ESP_OK},
+        /* Pin A0 pulsed and returned before the read: counted, not published. */
+        {I2C_MOCK_WRITE_READ, 0x21, {0x0E}, 1, {0x01, 0, 0xF1, 0x0F, 0xF0, 0x0F}, 6, ESP_OK},
+        /* Pin B7 changed. */
+        {I2C_MOCK_WRITE_READ, 0x21, {0x0E}, 1, {0, 0x80, 0xF0, 0x8F, 0xF0, 0x8F}, 6, ESP_OK},
+        /* Polling skips the interrupt-driven device unless asked to cover it. */
+        {I2C_MOCK_WRITE_READ, 0x20, {0x12}, 1, {0xFF, 0xFF}, 2, ESP_OK},
+    };
+    i2c_mock_set_sequence(irq_ops, sizeof(irq_ops) / sizeof(irq_ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp_inputs_enable_irq(&inputs, 1, 0xFFFF));
+    TEST_ASSERT_TRUE(mcp_inputs_has_irq(&inputs, 1));
+    mcp_inputs_on_interrupt(&inputs, 1U << 1);
+    TEST_ASSERT_EQUAL_UINT32(2, log.calls);
+    TEST_ASSERT_EQUAL_UINT32(1, inputs.stats.pulses);
+    mcp_inputs_on_interrupt(&inputs, 1U << 1);
+    TEST_ASSERT_EQUAL_UINT32(3, log.calls);
+    TEST_ASSERT_EQUAL_size_t(1, log.index);
+    TEST_ASSERT_EQUAL_HEX16(0x8FF0, log.value);
+    mcp_inputs_poll(&inputs, false);
+    TEST_ASSERT_EQUAL_UINT32(3, log.calls);
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("mcp inputs publish an edge with one read after the interrupt", "[mcp23017]")
+{
+    const uint8_t addr = 0x20;
+    publish_log_t log = {0};
+    mcp_inputs_t inputs;
+    i2c_mock_op_t init_ops[] = {
+        {I2C_MOCK_WRITE_READ, addr, {0x12}, 1, {0x00, 0x00}, 2, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x0A, 0x40}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x08, 0x00, 0x00}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x04, 0xFF, 0xFF}, 3, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE_READ, addr, {0x0E}, 1, {0}, 6, ESP_OK},
+    };
+    i2c_mock_set_sequence(init_ops, sizeof(init_ops) / sizeof(init_ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp_inputs_init(&inputs, &addr, 1, record_publish, &log));
+    TEST_ASSERT_EQUAL(ESP_OK, mcp_inputs_enable_irq(&inputs, 0, 0xFFFF));
+
+    /* Edge on A3: the ISR notifies the task, which needs a single read to publish. */
+    i2c_mock_op_t edge_ops[] = {
+        {I2C_MOCK_WRITE_READ, addr, {0x0E}, 1, {0x08, 0, 0x08, 0, 0x08, 0}, 6, ESP_OK},
+    };
+    i2c_mock_set_sequence(edge_ops, 1);
+    uint32_t calls = log.calls;
+    mcp_inputs_on_interrupt(&inputs, 1U);
+    i2c_mock_assert_complete();
+    TEST_ASSERT_EQUAL_HEX16(0x0008, log.value);
+    TEST_ASSERT_EQUAL_UINT32(calls + 1, log.calls);
+    TEST_ASSERT_LESS_THAN(1000, i2c_mock_bus_time_us());
+}
@@ -2,6 +2,23 @@
 
 #include "i2c_mock.h"
 #include "unity.h"
+#include <stdio.h>
+#include <string.h>
+
+static void expect_burst(i2c_mock_op_t *op, uint8_t addr, uint8_t first, const uint16_t *duty, size_t count)
+{
+    memset(op, 0, sizeof(*op));
+    op->type = I2C_MOCK_WRITE;
+    op->address = addr;
+    op->write_data[0] = (uint8_t)(0x06 + 4 * first);
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t *quad = &op->write_data[1 + 4 * i];
+        quad[2] = (uint8_t)(duty[i] & 0xFF);
+        quad[3] = (uint8_t)(duty[i] >> 8);
+    }
+    op->write_len = 1 + 4 * count;
+    op->result = ESP_OK;
+}
 
 TEST_CASE("pca9685 initialises frequency", "[pca9685]")
 {
@@ -20,6 +37,7 @@ TEST_CASE("pca9685 initialises frequency", "[pca9685]")
 TEST_CASE("pca9685 sets pwm duty", "[pca9685]")
 {
     const uint8_t addr = 0x41;
+    pca9685_invalidate(addr);
     i2c_mock_op_t ops[] = {
         {I2C_MOCK_WRITE, addr, {0x06 + 4 * 3, 0x00, 0x00, 0x00, 0x04}, 5, {0}, 0, ESP_OK},
     };
@@ -27,3 +45,152 @@ TEST_CASE("pca9685 sets pwm duty", "[pca9685]")
     TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 3, 1024));
     i2c_mock_assert_complete();
 }
+
+TEST_CASE("pca9685 skips unchanged channels", "[pca9685]")
+{
+    const uint8_t addr = 0x41;
+    pca9685_invalidate(addr);
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x06 + 4 * 5, 0x00, 0x00, 0xFF, 0x0F}, 5, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x06 + 4 * 5, 0x00, 0x10, 0x00, 0x00}, 5, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 5, 4095));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 5, 4095));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 5, 0xFFFF));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 5, 4096));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("pca9685 writes uniform values through ALL_LED", "[pca9685]")
+{
+    const uint8_t addr = 0x41;
+    pca9685_invalidate(addr);
+    uint16_t duty[16];
+    for (size_t i = 0; i < 16; ++i) {
+        duty[i] = 2048;
+    }
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0xFA, 0x00, 0x00, 0x00, 0x08}, 5, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, 9, 2048));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("pca9685 bursts only the changed runs", "[pca9685]")
+{
+    const uint8_t addr = 0x41;
+    pca9685_invalidate(addr);
+    uint16_t duty[16];
+    for (size_t i = 0; i < 16; ++i) {
+        duty[i] = (uint16_t)(i * 200);
+    }
+    i2c_mock_op_t ops[3];
+    expect_burst(&ops[0], addr, 0, duty, 16);
+    i2c_mock_set_sequence(ops, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    i2c_mock_assert_complete();
+
+    /* 2 and 4 are one gap apart and share a burst; 12 is far enough for its own. */
+    duty[2] = 10;
+    duty[4] = 20;
+    duty[12] = 30;
+    expect_burst(&ops[0], addr, 2, &duty[2], 3);
+    expect_burst(&ops[1], addr, 12, &duty[12], 1);
+    i2c_mock_set_sequence(ops, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("pca9685 rewrites channels after a failed burst", "[pca9685]")
+{
+    const uint8_t addr = 0x41;
+    pca9685_invalidate(addr);
+    uint16_t duty[4] = {100, 200, 300, 400};
+    i2c_mock_op_t ops[2];
+    expect_burst(&ops[0], addr, 0, duty, 4);
+    ops[0].result = ESP_FAIL;
+    expect_burst(&ops[1], addr, 0, duty, 4);
+    i2c_mock_set_sequence(ops, 2);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 4));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 4));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("pca9685 changes frequency without rewriting channels", "[pca9685]")
+{
+    const uint8_t addr = 0x41;
+    i2c_mock_op_t init_ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x00, 0x10}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0xFE, 0x0B}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x00, 0xA1}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x01, 0x04}, 2, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(init_ops, sizeof(init_ops) / sizeof(init_ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_init(addr, 500));
+    i2c_mock_assert_complete();
+
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0x00, 0x31}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0xFE, 0x05}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x00, 0x21}, 2, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0x00, 0xA1}, 2, {0}, 0, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_frequency(addr, 500));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_frequency(addr, 1000));
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_frequency(addr, 1000));
+    i2c_mock_assert_complete();
+}
+
+TEST_CASE("pca9685 burst traffic against per-channel writes", "[pca9685][perf]")
+{
+    const uint8_t addr = 0x41;
+    uint16_t duty[16];
+    for (size_t i = 0; i < 16; ++i) {
+        duty[i] = (uint16_t)(4095 - i * 100);
+    }
+    i2c_mock_op_t ops[16];
+
+    /* Baseline: one 5-byte transaction per channel, as the driver used to do. */
+    pca9685_invalidate(addr);
+    for (size_t i = 0; i < 16; ++i) {
+        expect_burst(&ops[i], addr, (uint8_t)i, &duty[i], 1);
+    }
+    i2c_mock_set_sequence(ops, 16);
+    for (uint8_t i = 0; i < 16; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_pwm(addr, i, duty[i]));
+    }
+    i2c_mock_assert_complete();
+    uint32_t single_tx = 0;
+    uint32_t single_bytes = 0;
+    i2c_mock_get_traffic(&single_tx, &single_bytes);
+    uint32_t single_us = i2c_mock_bus_time_us();
+
+    pca9685_invalidate(addr);
+    expect_burst(&ops[0], addr, 0, duty, 16);
+    i2c_mock_set_sequence(ops, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    i2c_mock_assert_complete();
+    uint32_t burst_tx = 0;
+    uint32_t burst_bytes = 0;
+    i2c_mock_get_traffic(&burst_tx, &burst_bytes);
+    uint32_t burst_us = i2c_mock_bus_time_us();
+
+    i2c_mock_set_sequence(ops, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, pca9685_set_all(addr, duty, 16));
+    uint32_t repeat_tx = 0;
+    i2c_mock_get_traffic(&repeat_tx, NULL);
+
+    printf("pca9685 16-channel refresh: per-channel %u tx / %u bytes / %u us, burst %u tx / %u bytes / %u us, "
+           "unchanged %u tx\n",
+           (unsigned)single_tx, (unsigned)single_bytes, (unsigned)single_us, (unsigned)burst_tx,
+           (unsigned)burst_bytes, (unsigned)burst_us, (unsigned)repeat_tx);
+    TEST_ASSERT_EQUAL_UINT32(16, single_tx);
+    TEST_ASSERT_EQUAL_UINT32(1, burst_tx);
+    TEST_ASSERT_LESS_THAN_UINT32(single_bytes, burst_bytes);
+    TEST_ASSERT_EQUAL_UINT32(0, repeat_tx);
+}
@@ -0,0 +1,111 @@
+#include "publish_pacer.h"
+
+#include "unity.h"
+#include <stdio.h>
+
+TEST_CASE("publish pacer sends changes at once but not faster than the minimum interval", "[publish_pacer]")
+{
+    publish_pacer_t pacer;
+    publish_pacer_init(&pacer, 50, 5000);
+    bool heartbeat = false;
+    int64_t wait_us = 0;
+
+    TEST_ASSERT_TRUE(publish_pacer_poll(&pacer, 1000, false, &heartbeat, &wait_us));
+    publish_pacer_sent(&pacer, 1000, heartbeat, 0);
+
+    /* 20 ms later: held back for the remaining 30 ms. */
+    TEST_ASSERT_FALSE(publish_pacer_poll(&pacer, 21000, true, &heartbeat, &wait_us));
+    TEST_ASSERT_EQUAL_INT64(30000, wait_us);
+    TEST_ASSERT_FALSE(publish_pacer_poll(&pacer, 40000, true, &heartbeat, &wait_us));
+    TEST_ASSERT_EQUAL_UINT32(1, pacer.stats.rate_limited);
+    TEST_ASSERT_TRUE(publish_pacer_poll(&pacer, 51000, true, &heartbeat, &wait_us));
+    TEST_ASSERT_FALSE(heartbeat);
+    publish_pacer_sent(&pacer, 51000, false, 30000);
+
+    /* Far enough apart: no wait. */
+    TEST_ASSERT_TRUE(publish_pacer_poll(&pacer, 200000, true, &heartbeat, &wait_us));
+    publish_pacer_sent(&pacer, 200000, false, 100);
+    TEST_ASSERT_EQUAL_UINT32(30000, pacer.stats.max_latency_us);
+    TEST_ASSERT_EQUAL_UINT64(30100, pacer.stats.total_latency_us);
+}
+
+TEST_CASE("publish pacer emits heartbeats when idle", "[publish_pacer]")
+{
+    publish_pacer_t pacer;
+    publish_pacer_init(&pacer, 50, 5000);
+    bool heartbeat = false;
+    int64_t wait_us = 0;
+    TEST_ASSERT_TRUE(publish_pacer_poll(&pacer, 0, false, &heartbeat, &wait_us));
+    publish_pacer_sent(&pacer, 0, heartbeat, 0);
+
+    TEST_ASSERT_FALSE(publish_pacer_poll(&pacer, 1000000, false, &heartbeat, &wait_us));
+    TEST_ASSERT_EQUAL_INT64(4000000, wait_us);
+    TEST_ASSERT_TRUE(publish_pacer_poll(&pacer, 5000000, false, &heartbeat, &wait_us));
+    TEST_ASSERT_TRUE(heartbeat);
+    publish_pacer_sent(&pacer, 5000000, heartbeat, 123456);
+    TEST_ASSERT_EQUAL_UINT32(1, pacer.stats.heartbeats);
+    TEST_ASSERT_EQUAL_UINT32(0, pacer.stats.max_latency_us);
+}
+
+/* Pseudo-random change times, on average one every ~350 ms. */
+static int64_t next_event(uint32_t *state, int64_t now)
+{
+    *state = *state * 1664525U + 1013904223U;
+    return now + 1000 + (int64_t)(*state >> 8) % 700000;
+}
+
+TEST_CASE("publish pacer detect-to-send latency against the 200 ms poll", "[publish_pacer][perf]")
+{
+    const int64_t duration_us = 60LL * 1000000;
+
+    /* Before: app_main checked the model every 200 ms. */
+    uint32_t rng = 1;
+    uint64_t poll_total = 0;
+    uint32_t poll_max = 0;
+    uint32_t events = 0;
+    for (int64_t t = next_event(&rng, 0); t < duration_us; t = next_event(&rng, t)) {
+        int64_t sent = (t / 200000 + 1) * 200000;
+        uint32_t latency = (uint32_t)(sent - t);
+        poll_total += latency;
+        poll_max = latency > poll_max ? latency : poll_max;
+        ++events;
+    }
+
+    /* After: setters notify the publisher, which only waits for the rate limit. */
+    publish_pacer_t pacer;
+    publish_pacer_init(&pacer, 50, 5000);
+    rng = 1;
+    bool dirty = false;
+    int64_t since = 0;
+    int64_t wake = 0;
+    int64_t event = next_event(&rng, 0);
+    while (wake < duration_us || dirty) {
+        int64_t now;
+        if (event < duration_us && event <= wake) {
+            now = event;
+            if (!dirty) {
+                dirty = true;
+                since = event;
+            }
+            event = next_event(&rng, event);
+        } else {
+            now = wake;
+        }
+        bool heartbeat = false;
+        int64_t wait_us = 0;
+        if (publish_pacer_poll(&pacer, now, dirty, &heartbeat, &wait_us)) {
+            publish_pacer_sent(&pacer, now, heartbeat, (uint32_t)(now - since));
+            dirty = false;
+            publish_pacer_poll(&pacer, now, dirty, &heartbeat, &wait_us);
+        }
+        wake = now + wait_us;
+    }
+    uint32_t change_frames = pacer.stats.frames - pacer.stats.heartbeats;
+    printf("publish detect-to-send over %u changes: 200 ms poll mean %u us max %u us; event-driven mean %u us "
+           "max %u us (%u frames, %u heartbeats, %u rate-limited)\n",
+           (unsigned)events, (unsigned)(poll_total / events), (unsigned)poll_max,
+           (unsigned)(pacer.stats.total_latency_us / change_frames), (unsigned)pacer.stats.max_latency_us,
+           (unsigned)pacer.stats.frames, (unsigned)pacer.stats.heartbeats, (unsigned)pacer.stats.rate_limited);
+    TEST_ASSERT_TRUE(pacer.stats.max_latency_us <= 50000);
+    TEST_ASSERT_TRUE(pacer.stats.total_latency_us / change_frames < poll_total / events);
+}
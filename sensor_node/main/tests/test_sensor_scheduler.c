@@ -0,0 +1,135 @@
+#include "sensor_scheduler.h"
+
+#include "unity.h"
+#include <string.h>
+
+typedef struct {
+    uint32_t starts;
+    uint32_t collects;
+    int64_t last_sample_us;
+    int64_t last_collect_us;
+    uint32_t not_finished; /* collect calls to answer ESP_ERR_NOT_FINISHED */
+} fake_channel_t;
+
+static esp_err_t fake_start(void *ctx, int64_t now_us, uint32_t *latency_us)
+{
+    (void)now_us;
+    (void)latency_us;
+    ++((fake_channel_t *)ctx)->starts;
+    return ESP_OK;
+}
+
+static esp_err_t fake_collect(void *ctx, int64_t now_us, int64_t sample_us, uint32_t *retry_us)
+{
+    fake_channel_t *fake = ctx;
+    if (fake->not_finished > 0) {
+        --fake->not_finished;
+        *retry_us = 2000;
+        return ESP_ERR_NOT_FINISHED;
+    }
+    ++fake->collects;
+    fake->last_sample_us = sample_us;
+    fake->last_collect_us = now_us;
+    return ESP_OK;
+}
+
+/* Run the scheduler as its task would: sleep exactly until the requested wake time. */
+static void run_until(sensor_scheduler_t *sched, int64_t *now, int64_t end_us, int64_t wake_delay_us)
+{
+    while (*now < end_us) {
+        int64_t wake = sensor_scheduler_run(sched, *now);
+        *now = (wake > *now ? wake : *now + 1) + wake_delay_us;
+    }
+}
+
+TEST_CASE("sensor scheduler dispatches channels at their own rates", "[sensor_sched]")
+{
+    sensor_scheduler_t sched;
+    sensor_scheduler_init(&sched);
+    fake_channel_t fast = {0};
+    fake_channel_t slow = {0};
+    sensor_channel_t ch_fast = {.name = "fast", .period_us = 100000, .start = fake_start,
+                                .collect = fake_collect, .ctx = &fast};
+    sensor_channel_t ch_slow = {.name = "slow", .period_us = 750000, .latency_us = 750000,
+                                .start = fake_start, .collect = fake_collect, .ctx = &slow};
+    size_t fast_idx = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_add(&sched, &ch_fast, 0, &fast_idx));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_add(&sched, &ch_slow, 0, NULL));
+
+    int64_t now = 0;
+    run_until(&sched, &now, 3000000, 0);
+    TEST_ASSERT_EQUAL_UINT32(30, fast.collects);
+    TEST_ASSERT_EQUAL_UINT32(4, slow.starts);
+    TEST_ASSERT_EQUAL_UINT32(3, slow.collects);
+    /* Back-to-back conversions: each result carries the time its conversion started. */
+    TEST_ASSERT_EQUAL_INT64(1500000, slow.last_sample_us);
+    TEST_ASSERT_EQUAL_INT64(2250000, slow.last_collect_us);
+
+    sensor_channel_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_get_stats(&sched, fast_idx, &stats));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.max_jitter_us);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overruns);
+}
+
+TEST_CASE("sensor scheduler keeps deadlines on grid when woken late", "[sensor_sched]")
+{
+    sensor_scheduler_t sched;
+    sensor_scheduler_init(&sched);
+    fake_channel_t fake = {0};
+    sensor_channel_t ch = {.name = "amb", .period_us = 200000, .start = fake_start, .collect = fake_collect,
+                           .ctx = &fake};
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_add(&sched, &ch, 0, NULL));
+
+    int64_t now = 0;
+    run_until(&sched, &now, 2000000, 3000);
+    TEST_ASSERT_EQUAL_UINT32(10, fake.collects);
+    /* Every dispatch is 3 ms late, but the lateness does not accumulate. */
+    TEST_ASSERT_EQUAL_INT64(1803000, fake.last_sample_us);
+    sensor_channel_stats_t stats;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_get_stats(&sched, 0, &stats));
+    TEST_ASSERT_EQUAL_UINT32(3000, stats.max_jitter_us);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overruns);
+
+    /* A stall past the 2.0 s deadline drops 2.2, 2.4 and 2.6 s instead of bursting. */
+    now = 2650000;
+    sensor_scheduler_run(&sched, now);
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_get_stats(&sched, 0, &stats));
+    TEST_ASSERT_EQUAL_UINT32(3, stats.overruns);
+    TEST_ASSERT_EQUAL_UINT32(650000, stats.max_jitter_us);
+    TEST_ASSERT_EQUAL_INT64(2800000, sensor_scheduler_run(&sched, now));
+}
+
+TEST_CASE("sensor scheduler retries unfinished collections", "[sensor_sched]")
+{
+    sensor_scheduler_t sched;
+    sensor_scheduler_init(&sched);
+    fake_channel_t fake = {.not_finished = 2};
+    sensor_channel_t ch = {.name = "sht", .period_us = 1000000, .latency_us = 85000, .start = fake_start,
+                           .collect = fake_collect, .ctx = &fake};
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_add(&sched, &ch, 0, NULL));
+
+    TEST_ASSERT_EQUAL_INT64(85000, sensor_scheduler_run(&sched, 0));
+    TEST_ASSERT_EQUAL_INT64(87000, sensor_scheduler_run(&sched, 85000));
+    TEST_ASSERT_EQUAL_INT64(89000, sensor_scheduler_run(&sched, 87000));
+    TEST_ASSERT_EQUAL_INT64(1000000, sensor_scheduler_run(&sched, 89000));
+    TEST_ASSERT_EQUAL_UINT32(1, fake.collects);
+    TEST_ASSERT_EQUAL_INT64(0, fake.last_sample_us);
+}
+
+TEST_CASE("sensor scheduler applies period changes", "[sensor_sched]")
+{
+    sensor_scheduler_t sched;
+    sensor_scheduler_init(&sched);
+    fake_channel_t fake = {0};
+    sensor_channel_t ch = {.name = "ds", .period_us = 750000, .start = fake_start, .collect = fake_collect,
+                           .ctx = &fake};
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_add(&sched, &ch, 0, NULL));
+    int64_t now = 0;
+    run_until(&sched, &now, 1500000, 0);
+    TEST_ASSERT_EQUAL_UINT32(2, fake.collects);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sensor_scheduler_set_period(&sched, 1, 94000));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_set_period(&sched, 0, 94000));
+    run_until(&sched, &now, 1500000 + 94000 * 5, 0);
+    TEST_ASSERT_EQUAL_UINT32(7, fake.collects);
+}
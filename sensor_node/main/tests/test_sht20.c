@@ -52,3 +52,91 @@ TEST_CASE("sht20 retries and averages data", "[sht20]")
     TEST_ASSERT_FLOAT_WITHIN(0.5f, 52.1f, humidity);
     i2c_mock_assert_complete();
 }
+
+static void encode_frame(uint16_t raw, uint8_t out[3])
+{
+    out[0] = (uint8_t)(raw >> 8);
+    out[1] = (uint8_t)(raw & 0xFF);
+    out[2] = crc8(out, 2);
+}
+
+TEST_CASE("sht20 measurements interleave across sensors", "[sht20]")
+{
+    const uint8_t addr_a = 0x40;
+    const uint8_t addr_b = 0x41;
+    uint8_t temp_a[3];
+    uint8_t temp_b[3];
+    uint8_t hum_a[3];
+    uint8_t hum_b[3];
+    encode_frame((uint16_t)lrintf(((20.0f + 46.85f) / 175.72f) * 65536.0f), temp_a);
+    encode_frame((uint16_t)lrintf(((30.0f + 46.85f) / 175.72f) * 65536.0f), temp_b);
+    encode_frame((uint16_t)lrintf(((40.0f + 6.0f) / 125.0f) * 65536.0f), hum_a);
+    encode_frame((uint16_t)lrintf(((60.0f + 6.0f) / 125.0f) * 65536.0f), hum_b);
+
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr_a, {0xF3}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_WRITE, addr_b, {0xF3}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_READ, addr_a, {0}, 0, {temp_a[0], temp_a[1], temp_a[2]}, 3, ESP_OK},
+        {I2C_MOCK_WRITE, addr_a, {0xF5}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_READ, addr_b, {0}, 0, {temp_b[0], temp_b[1], temp_b[2]}, 3, ESP_OK},
+        {I2C_MOCK_WRITE, addr_b, {0xF5}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_READ, addr_a, {0}, 0, {hum_a[0], hum_a[1], hum_a[2]}, 3, ESP_OK},
+        {I2C_MOCK_READ, addr_b, {0}, 0, {hum_b[0], hum_b[1], hum_b[2]}, 3, ESP_OK},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+
+    sht20_measurement_t a;
+    sht20_measurement_t b;
+    int64_t now = 0;
+    sht20_measurement_begin(&a, addr_a, now);
+    sht20_measurement_begin(&b, addr_b, now);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&a, now));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&b, now));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&a, now + 1000));
+
+    now = a.ready_us;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&a, now));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&b, now));
+    now = a.ready_us > b.ready_us ? a.ready_us : b.ready_us;
+    TEST_ASSERT_EQUAL(ESP_OK, sht20_measurement_step(&a, now));
+    TEST_ASSERT_EQUAL(ESP_OK, sht20_measurement_step(&b, now));
+    i2c_mock_assert_complete();
+
+    /* Both sensors finish within one temperature plus one humidity conversion. */
+    TEST_ASSERT_LESS_OR_EQUAL(85000 + 29000, now);
+    TEST_ASSERT_TRUE(sht20_measurement_finished(&a));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 20.0f, a.temperature_c);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 30.0f, b.temperature_c);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 40.0f, a.humidity);
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 60.0f, b.humidity);
+}
+
+TEST_CASE("sht20 measurement backs off after a bad frame", "[sht20]")
+{
+    const uint8_t addr = 0x40;
+    uint8_t temp[3];
+    encode_frame((uint16_t)lrintf(((21.0f + 46.85f) / 175.72f) * 65536.0f), temp);
+    i2c_mock_op_t ops[] = {
+        {I2C_MOCK_WRITE, addr, {0xF3}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_READ, addr, {0}, 0, {temp[0], temp[1], (uint8_t)(temp[2] ^ 0x5A)}, 3, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0xF3}, 1, {0}, 0, ESP_OK},
+        {I2C_MOCK_READ, addr, {0}, 0, {temp[0], temp[1], temp[2]}, 3, ESP_OK},
+        {I2C_MOCK_WRITE, addr, {0xF5}, 1, {0}, 0, ESP_FAIL},
+    };
+    i2c_mock_set_sequence(ops, sizeof(ops) / sizeof(ops[0]));
+
+    sht20_measurement_t m;
+    sht20_measurement_begin(&m, addr, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&m, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&m, 85000));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, m.last_err);
+    TEST_ASSERT_EQUAL(SHT20_STEP_TRIGGER_TEMP, m.step);
+    TEST_ASSERT_EQUAL_INT64(85000 + 10000, m.ready_us);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&m, 90000));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&m, 95000));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FINISHED, sht20_measurement_step(&m, 180000));
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 21.0f, m.temperature_c);
+    TEST_ASSERT_EQUAL(SHT20_STEP_TRIGGER_HUM, m.step);
+    TEST_ASSERT_EQUAL_UINT32(1, m.attempts);
+    i2c_mock_assert_complete();
+}
@@ -0,0 +1,216 @@
+#include "telemetry_journal.h"
+
+#include "esp_timer.h"
+#include "flash_emu.h"
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SECTOR 4096U
+
+/* On the host target the emulator is file-backed, so remounts read a real file. */
+#if defined(__linux__)
+#define EMU_PATH "/tmp/sensor_journal_test.bin"
+#else
+#define EMU_PATH NULL
+#endif
+
+static uint8_t s_batch[SECTOR - TELEMETRY_JOURNAL_SECTOR_HEADER];
+static uint8_t s_record[1024];
+
+static size_t make_record(uint32_t index, uint8_t *out)
+{
+    size_t len = 64U + (index * 37U) % 300U;
+    for (size_t i = 0; i < len; ++i) {
+        out[i] = (uint8_t)(index * 31U + i);
+    }
+    memcpy(out, &index, sizeof(index));
+    return len;
+}
+
+static void append_records(telemetry_journal_t *journal, uint32_t from, uint32_t count)
+{
+    uint8_t record[512];
+    for (uint32_t i = from; i < from + count; ++i) {
+        size_t len = make_record(i, record);
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_append(journal, record, len));
+    }
+}
+
+/* Replays everything left and checks it is the contiguous run starting at @p first. */
+static uint32_t replay_all(telemetry_journal_t *journal, uint32_t first)
+{
+    uint8_t expected[512];
+    uint32_t count = 0;
+    size_t len = 0;
+    while (telemetry_journal_read_next(journal, s_record, sizeof(s_record), &len) == ESP_OK) {
+        size_t expected_len = make_record(first + count, expected);
+        TEST_ASSERT_EQUAL_size_t(expected_len, len);
+        TEST_ASSERT_EQUAL_MEMORY(expected, s_record, len);
+        ++count;
+    }
+    TEST_ASSERT_FALSE(telemetry_journal_has_unread(journal));
+    return count;
+}
+
+TEST_CASE("telemetry journal replays flushed records once, across remounts", "[telemetry_journal]")
+{
+    flash_emu_t emu;
+    TEST_ASSERT_EQUAL(ESP_OK, flash_emu_open(&emu, EMU_PATH, 8 * SECTOR, SECTOR));
+    telemetry_journal_flash_t flash;
+    flash_emu_bind(&emu, &flash);
+    telemetry_journal_t journal;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 1024));
+    TEST_ASSERT_FALSE(telemetry_journal_has_unread(&journal));
+
+    append_records(&journal, 0, 40);
+    TEST_ASSERT_GREATER_THAN(0, telemetry_journal_pending(&journal));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+    TEST_ASSERT_EQUAL_size_t(0, telemetry_journal_pending(&journal));
+
+    size_t len = 0;
+    for (uint32_t i = 0; i < 15; ++i) {
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_read_next(&journal, s_record, sizeof(s_record), &len));
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_journal_read_next(&journal, s_record, 8, &len));
+
+    /* Reboot: replay resumes after the records already delivered. */
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 1024));
+    telemetry_journal_stats_t stats;
+    telemetry_journal_get_stats(&journal, &stats);
+    TEST_ASSERT_EQUAL_UINT32(25, stats.records_recovered);
+    TEST_ASSERT_EQUAL_UINT32(25, replay_all(&journal, 15));
+
+    append_records(&journal, 40, 5);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+    TEST_ASSERT_EQUAL_UINT32(5, replay_all(&journal, 40));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 1024));
+    TEST_ASSERT_FALSE(telemetry_journal_has_unread(&journal));
+    TEST_ASSERT_EQUAL_UINT32(0, emu.bit_set_attempts);
+    flash_emu_close(&emu);
+}
+
+TEST_CASE("telemetry journal skips a write torn by power loss", "[telemetry_journal]")
+{
+    flash_emu_t emu;
+    TEST_ASSERT_EQUAL(ESP_OK, flash_emu_open(&emu, EMU_PATH, 4 * SECTOR, SECTOR));
+    telemetry_journal_flash_t flash;
+    flash_emu_bind(&emu, &flash);
+    telemetry_journal_t journal;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 1024));
+    append_records(&journal, 0, 6);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+
+    /* The next batch loses power 100 bytes in: mid-way through its first record. */
+    append_records(&journal, 6, 3);
+    flash_emu_cut_power_after(&emu, 100);
+    TEST_ASSERT_NOT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+    flash_emu_restore_power(&emu);
+
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 1024));
+    telemetry_journal_stats_t stats;
+    telemetry_journal_get_stats(&journal, &stats);
+    TEST_ASSERT_EQUAL_UINT32(6, stats.records_recovered);
+
+    TEST_ASSERT_EQUAL_UINT32(6, replay_all(&journal, 0));
+    telemetry_journal_get_stats(&journal, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.records_corrupt);
+
+    /* New records go to a fresh sector after the torn one. */
+    append_records(&journal, 100, 2);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+    TEST_ASSERT_EQUAL_UINT32(2, replay_all(&journal, 100));
+    TEST_ASSERT_EQUAL_UINT32(2, emu.erases);
+    flash_emu_close(&emu);
+}
+
+TEST_CASE("telemetry journal drops the oldest sector when full and wears sectors evenly", "[telemetry_journal]")
+{
+    flash_emu_t emu;
+    TEST_ASSERT_EQUAL(ESP_OK, flash_emu_open(&emu, NULL, 4 * SECTOR, SECTOR));
+    telemetry_journal_flash_t flash;
+    flash_emu_bind(&emu, &flash);
+    telemetry_journal_t journal;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, sizeof(s_batch)));
+    const uint32_t total = 2000;
+    append_records(&journal, 0, total);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+
+    telemetry_journal_stats_t stats;
+    telemetry_journal_get_stats(&journal, &stats);
+    TEST_ASSERT_GREATER_THAN(0, stats.records_dropped);
+    uint32_t kept = replay_all(&journal, stats.records_dropped);
+    TEST_ASSERT_EQUAL_UINT32(total, stats.records_dropped + kept);
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        min = emu.sector_erases[i] < min ? emu.sector_erases[i] : min;
+        max = emu.sector_erases[i] > max ? emu.sector_erases[i] : max;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(1, max - min);
+    TEST_ASSERT_EQUAL_UINT32(0, emu.bit_set_attempts);
+    flash_emu_close(&emu);
+}
+
+TEST_CASE("telemetry journal rejects unusable regions and records", "[telemetry_journal]")
+{
+    flash_emu_t emu;
+    TEST_ASSERT_EQUAL(ESP_OK, flash_emu_open(&emu, NULL, 2 * SECTOR, SECTOR));
+    telemetry_journal_flash_t flash;
+    flash_emu_bind(&emu, &flash);
+    telemetry_journal_t journal;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_journal_mount(&journal, &flash, s_batch, SECTOR));
+    flash.size = SECTOR;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, telemetry_journal_mount(&journal, &flash, s_batch, 256));
+    flash.size = 2 * SECTOR;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, 256));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_journal_append(&journal, s_record, 0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, telemetry_journal_append(&journal, s_record, 245));
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_append(&journal, s_record, 244));
+    flash_emu_close(&emu);
+}
+
+static void run_append(uint32_t records, size_t batch_cap, uint64_t *cpu_us, uint64_t *flash_us, uint32_t *writes)
+{
+    flash_emu_t emu;
+    TEST_ASSERT_EQUAL(ESP_OK, flash_emu_open(&emu, EMU_PATH, 256 * SECTOR, SECTOR));
+    telemetry_journal_flash_t flash;
+    flash_emu_bind(&emu, &flash);
+    telemetry_journal_t journal;
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, batch_cap));
+    int64_t start = esp_timer_get_time();
+    append_records(&journal, 0, records);
+    TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_flush(&journal));
+    *cpu_us = (uint64_t)(esp_timer_get_time() - start);
+    *flash_us = flash_emu_busy_us(&emu);
+    *writes = emu.writes;
+
+    if (batch_cap == sizeof(s_batch)) {
+        start = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(ESP_OK, telemetry_journal_mount(&journal, &flash, s_batch, batch_cap));
+        int64_t mount_us = esp_timer_get_time() - start;
+        telemetry_journal_stats_t stats;
+        telemetry_journal_get_stats(&journal, &stats);
+        printf("journal recovery: %u unread records over %u sectors mounted in %lld us\n",
+               (unsigned)stats.records_recovered, (unsigned)(flash.size / SECTOR), (long long)mount_us);
+        TEST_ASSERT_EQUAL_UINT32(records, stats.records_recovered);
+    }
+    flash_emu_close(&emu);
+}
+
+TEST_CASE("telemetry journal sustained append throughput", "[telemetry_journal][perf]")
+{
+    /* ~ 1 MiB of frames, enough to fill the region once without wrapping. */
+    const uint32_t records = 3000;
+    uint64_t cpu_single = 0, flash_single = 0, cpu_batched = 0, flash_batched = 0;
+    uint32_t writes_single = 0, writes_batched = 0;
+    run_append(records, TELEMETRY_JOURNAL_RECORD_HEADER + 400U, &cpu_single, &flash_single, &writes_single);
+    run_append(records, sizeof(s_batch), &cpu_batched, &flash_batched, &writes_batched);
+    printf("journal append %u records: per-record flush %u writes, %u ms flash busy; batched %u writes, %u ms "
+           "flash busy (%u records/s); host CPU %u us vs %u us\n",
+           (unsigned)records, (unsigned)writes_single, (unsigned)(flash_single / 1000), (unsigned)writes_batched,
+           (unsigned)(flash_batched / 1000), (unsigned)(records * 1000000ULL / (flash_batched + cpu_batched)),
+           (unsigned)cpu_single, (unsigned)cpu_batched);
+    TEST_ASSERT_LESS_THAN(writes_single, writes_batched);
+    TEST_ASSERT_LESS_THAN(flash_single, flash_batched);
+}
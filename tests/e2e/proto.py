@@ -36,6 +36,11 @@ def _ensure_list(value: Iterable[Any]) -> List[Any]:
     return list(value) if not isinstance(value, list) else value
 
 
+def _entries(value: Any) -> List[Any]:
+    """Batched command fields are arrays; single updates keep the object form."""
+    return value if isinstance(value, list) else [value]
+
+
 def encode_sensor_update(update: MutableMapping[str, Any], *, use_cbor: bool = False) -> bytes:
     """Serialize a sensor update message following the JSON schema."""
     if use_cbor:
@@ -92,6 +97,31 @@ def decode_command(payload: bytes, *, use_cbor: bool = False) -> Dict[str, Any]:
     return data
 
 
+ACK_OK = 0
+ACK_DUPLICATE = 1
+ACK_BUSY = 2
+
+
+def encode_command_ack(sequence_id: int, status: int = ACK_OK, *, timestamp_ms: int = 0) -> bytes:
+    canonical: Dict[str, Any] = {
+        "v": 1,
+        "type": "ack",
+        "ts": int(timestamp_ms),
+        "seq": int(sequence_id),
+        "status": int(status),
+    }
+    return json.dumps(canonical, separators=(",", ":"), ensure_ascii=False).encode("utf-8")
+
+
+def decode_command_ack(payload: bytes, *, use_cbor: bool = False) -> Dict[str, Any]:
+    if use_cbor:
+        raise NotImplementedError("CBOR decoding is not required for the Python test bench")
+    data = json.loads(payload.decode("utf-8"))
+    if data.get("type") != "ack":
+        raise ValueError("Unexpected message type")
+    return data
+
+
 @dataclass
 class CommandEffects:
     """In-memory representation of IO state mutations."""
@@ -106,13 +136,13 @@ class CommandEffects:
 
     def apply(self, command: Dict[str, Any]) -> None:
         if "set_pwm" in command:
-            entry = command["set_pwm"]
-            self.pwm_channels[int(entry["ch"])] = int(entry["duty"])
+            for entry in _entries(command["set_pwm"]):
+                self.pwm_channels[int(entry["ch"])] = int(entry["duty"])
         if "pwm_freq" in command:
             entry = command["pwm_freq"]
             self.pwm_frequency = int(entry["freq"])
         if "write_gpio" in command:
-            entry = command["write_gpio"]
-            dev = 0 if entry.get("dev") == "mcp0" else 1
-            port = str(entry.get("port", "A"))
-            self.gpio[(dev, port)] = (int(entry.get("mask", 0)), int(entry.get("value", 0)))
+            for entry in _entries(command["write_gpio"]):
+                dev = 0 if entry.get("dev") == "mcp0" else 1
+                port = str(entry.get("port", "A"))
+                self.gpio[(dev, port)] = (int(entry.get("mask", 0)), int(entry.get("value", 0)))